@@ -0,0 +1,151 @@
+#ifndef BSPLINEFIT_H
+#define BSPLINEFIT_H
+
+/* Least squares approximation by B-splines with NC coefficients
+ * and uniform knots on [0,1]. The knot vector is clamped at both ends
+ * (like gsl_bspline_knots_uniform). ORDER is the order of the pieces,
+ * i.e. the k argument of gsl_bspline_alloc (3 = piecewise quadratic).
+ *
+ * The sizes are template parameters, thus all arrays are on the stack.
+ * Fitting solves the normal equations by a Cholesky factorization. Basis
+ * functions without support nodes (zero pivot) will be dropped and their
+ * coefficients set to zero, which equals the minimal norm solution of
+ * gsl_multifit_linear.
+ */
+
+#include <cmath>
+#include <cstddef>
+
+/* Relative limit for the pivot elements of the Cholesky factorization. */
+#define BSPLINE_FIT_EPS 1E-12
+
+template<size_t NC, size_t ORDER>
+class BSplineFit{
+	public:
+		static const size_t NBREAK = NC + 2 - ORDER;
+
+		/* Knot i of the extended knot vector (NC+ORDER elements). */
+		static double knot(size_t i){
+			if( i < ORDER ) return 0.0;
+			if( i >= NC ) return 1.0;
+			return ((double)(i+1-ORDER))/(NBREAK-1);
+		}
+
+		/* Returns s with knot(s) <= t < knot(s+1), ORDER-1 <= s < NC.
+		 * t=1 will be mapped into the last interval. */
+		static size_t span(double t){
+			if( t <= 0.0 ) return ORDER-1;
+			if( t >= 1.0 ) return NC-1;
+			size_t s = ORDER-1 + (size_t)(t*(NBREAK-1));
+			if( s > NC-1 ) s = NC-1;
+			//Fix rounding errors at the breakpoints
+			while( s < NC-1 && t >= knot(s+1) ) ++s;
+			while( s > ORDER-1 && t < knot(s) ) --s;
+			return s;
+		}
+
+		/* Evaluate the ORDER nonzero basis functions at t (de Boor).
+		 * Returns the index of the basis function N[0]. */
+		static size_t evalNonzero(double t, double *N){
+			const size_t s = span(t);
+			double left[ORDER], right[ORDER];
+			N[0] = 1.0;
+			for( size_t j=1; j<ORDER; ++j){
+				left[j] = t - knot(s+1-j);
+				right[j] = knot(s+j) - t;
+				double saved = 0.0;
+				for( size_t r=0; r<j; ++r){
+					const double tmp = N[r]/(right[r+1] + left[j-r]);
+					N[r] = saved + right[r+1]*tmp;
+					saved = left[j-r]*tmp;
+				}
+				N[j] = saved;
+			}
+			return s+1-ORDER;
+		}
+
+		/* Evaluate all NC basis functions at t. */
+		static void eval(double t, double *B){
+			double N[ORDER];
+			const size_t first = evalNonzero(t, N);
+			for( size_t r=0; r<NC; ++r) B[r] = 0.0;
+			for( size_t r=0; r<ORDER; ++r) B[first+r] = N[r];
+		}
+
+		/* Fit D dimensions at once. Node i has the basis values
+		 * basis[steps[i]*stride + (0,…,NC-1)] and the values y[d*ystride + i].
+		 * The coefficients will be written into c[d*cstride + (0,…,NC-1)].
+		 * Returns the number of used basis functions.
+		 */
+		template<size_t D>
+		static size_t fit(const double *basis, size_t stride, const unsigned short *steps,
+				size_t n, const double *y, size_t ystride, double *c, size_t cstride){
+			double A[NC][NC]; // lower triangle
+			double b[D][NC];
+			bool used[NC];
+			size_t i, j, k, d;
+
+			for( j=0; j<NC; ++j){
+				for( k=0; k<=j; ++k) A[j][k] = 0.0;
+				for( d=0; d<D; ++d) b[d][j] = 0.0;
+			}
+
+			// Normal equations
+			for( i=0; i<n; ++i){
+				const double *B = basis + steps[i]*stride;
+				for( j=0; j<NC; ++j){
+					if( B[j] == 0.0 ) continue;
+					for( k=0; k<=j; ++k) A[j][k] += B[j]*B[k];
+					for( d=0; d<D; ++d) b[d][j] += B[j]*y[d*ystride + i];
+				}
+			}
+
+			// Cholesky factorization A = L L^T, in place.
+			double diagMax = 0.0;
+			for( j=0; j<NC; ++j){
+				if( A[j][j] > diagMax ) diagMax = A[j][j];
+			}
+			size_t rank = 0;
+			for( j=0; j<NC; ++j){
+				double s = A[j][j];
+				for( k=0; k<j; ++k) s -= A[j][k]*A[j][k];
+				if( s <= BSPLINE_FIT_EPS*diagMax ){
+					used[j] = false;
+					for( k=0; k<j; ++k) A[j][k] = 0.0;
+					for( i=j+1; i<NC; ++i) A[i][j] = 0.0;
+					A[j][j] = 0.0;
+					continue;
+				}
+				used[j] = true;
+				++rank;
+				const double l = sqrt(s);
+				A[j][j] = l;
+				for( i=j+1; i<NC; ++i){
+					double t = A[i][j];
+					for( k=0; k<j; ++k) t -= A[i][k]*A[j][k];
+					A[i][j] = t/l;
+				}
+			}
+
+			// Solve L z = b and L^T c = z
+			for( d=0; d<D; ++d){
+				double z[NC];
+				double *cd = c + d*cstride;
+				for( j=0; j<NC; ++j){
+					if( !used[j] ){ z[j] = 0.0; continue; }
+					double s = b[d][j];
+					for( k=0; k<j; ++k) s -= A[j][k]*z[k];
+					z[j] = s/A[j][j];
+				}
+				for( j=NC; j-- > 0; ){
+					if( !used[j] ){ cd[j] = 0.0; continue; }
+					double s = z[j];
+					for( k=j+1; k<NC; ++k) s -= A[k][j]*cd[k];
+					cd[j] = s/A[j][j];
+				}
+			}
+			return rank;
+		}
+};
+
+#endif
@@ -3,11 +3,70 @@
 #include <algorithm>
 #include "Gestures.h"
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #ifdef WITH_OPENGL
 #include "TrackerDrawingOpenGL.h"
 #include "DrawingFunctions.h"
 #endif
 
+/* Fixed size implementations of BSplineFit for
+ * NCOEFFS_MIN <= nc < NCOEFFS_MAX. Index is nc-NCOEFFS_MIN.
+ */
+typedef size_t (*splineFitFunc)(const double *basis, size_t stride, const unsigned short *steps,
+		size_t n, const double *y, size_t ystride, double *c, size_t cstride);
+typedef size_t (*splineEvalNonzeroFunc)(double t, double *N);
+typedef void (*splineEvalFunc)(double t, double *B);
+
+#define SPLINE_FUNCS(nc) { \
+	&BSplineFit<nc,SPLINE_DEG>::fit<DIM>, \
+	&BSplineFit<nc,SPLINE_DEG>::evalNonzero, \
+	&BSplineFit<nc,SPLINE_DEG>::eval }
+
+static const struct {
+	splineFitFunc fit;
+	splineEvalNonzeroFunc evalNonzero;
+	splineEvalFunc eval;
+} SplineFuncs[NCOEFFS_MAX-NCOEFFS_MIN] = {
+	SPLINE_FUNCS(4), SPLINE_FUNCS(5), SPLINE_FUNCS(6), SPLINE_FUNCS(7), SPLINE_FUNCS(8)
+};
+static_assert( NCOEFFS_MIN == 4 && NCOEFFS_MAX == 9, "Update SplineFuncs." );
+
+GestureEngine::GestureEngine():
+	m_gestureIdCounter(0)
+{
+	size_t i,j, ncoeffs;
+
+	/* Evaluate the basisvalues for MAX_DURATION_STEPS points in [0,1] and different
+	 * values of ncoeffs. */
+	for ( i=0, ncoeffs = NCOEFFS_MIN; ncoeffs < NCOEFFS_MAX; ++ncoeffs, ++i ){
+		double step = 1.0/(MAX_DURATION_STEPS-1);
+		double t = 0;
+		for (j = 0; j < MAX_DURATION_STEPS; ++j, t+=step )
+		{
+			SplineFuncs[i].eval(std::min(t, 1.0), &m_fullBasis[i][j*NCOEFFS_MAX]);
+		}
+	}
+}
+
+const GestureEngine &GestureEngine::shared(){
+	static const GestureEngine engine; // Thread safe initialisation since C++11
+	return engine;
+}
+
+const double *GestureEngine::fullBasis(size_t ncoeffs) const{
+	assert( ncoeffs >= NCOEFFS_MIN && ncoeffs < NCOEFFS_MAX );
+	return m_fullBasis[ncoeffs-NCOEFFS_MIN];
+}
+
+size_t GestureEngine::nextGestureId() const{
+	return m_gestureIdCounter++;
+}
+
 //Sorting functions to find best fitting gestures.
 static bool sortByLevel0(const GestureDistance *lhs, const GestureDistance *rhs) { 
 	return lhs->m_L2NormSquared[0] < rhs->m_L2NormSquared[0];
@@ -21,12 +80,6 @@ static bool sortByLevel2(const GestureDistance *lhs, const GestureDistance *rhs)
 static bool sortByLevel3(const GestureDistance *lhs, const GestureDistance *rhs) { 
 	return lhs->m_L2NormSquared[3] < rhs->m_L2NormSquared[3];
 }
-static bool sortByOrder(const GestureDistance *lhs, const GestureDistance *rhs) { 
-	if( lhs->m_sorting_weight == rhs->m_sorting_weight){
-		return lhs->m_L2NormSquared[1] < rhs->m_L2NormSquared[1];
-	}
-	return lhs->m_sorting_weight < rhs->m_sorting_weight;
-}
 static bool sortByLevelWeightSum(const GestureDistance *lhs, const GestureDistance *rhs) { 
 	return lhs->m_L2_weight < rhs->m_L2_weight;
 }
@@ -39,7 +92,7 @@ static const sortDef sortFunctions[4] = { sortByLevel0, sortByLevel1, sortByLeve
  * Requires N>1. 
  * \sum_i( (d_{i+1}+d_i)/2 ) = (d_0+d_{N-1})/2 + sum_{i=1}^{N-2} d_i
  * */
-static double quadratureSquared( double *inA, double *inB, const size_t abLen ){
+static double quadratureSquared( const double *inA, const double *inB, const size_t abLen ){
 
 	if( abLen<2 ) return 0.0;
 	
@@ -66,71 +119,84 @@ static double quadratureSquared( double *inA, double *inB, const size_t abLen ){
 
 
 
-Gesture::Gesture( cBlob &blob, size_t skipped_begin_nodes, size_t skipped_end_nodes ):
-m_n(0),m_ncoeffs(0),m_nbreak(0),
-	m_time_max(1.0),
-		//m_grid(NULL),
-		m_curvePointDistances(NULL),
-		m_debugDurationGrid(NULL),
-		m_gestureName(NULL),
-		m_gestureId(gestureIdCounter++),
-		//m_bw(NULL),
-		m_ReducedBasis(NULL)
+GestureTrack::GestureTrack(int startFrame, const GestureEngine &engine):
+	m_engine(&engine),
+	m_startFrame(startFrame),
+	m_n(0)
 {
-	m_gestureId = blob.id;
+}
 
-	// Init static variables
-#ifdef ROBUST_FIT
-	if( rw == NULL ){
-#else
-	if( mw == NULL ){
-#endif
-		initStaticGestureVariables();
+bool GestureTrack::addNode(int frame, double x, double y){
+	int step = frame - m_startFrame;
+	if( step < 0 ) return false;
+	if( m_n > 0 && step <= m_timeSteps[m_n-1] ) return false;
+
+	if( step >= MAX_DURATION_STEPS ){
+		/* Sliding window: Drop the nodes which are MAX_DURATION_STEPS
+		 * or more frames older than the new node and rebase the steps
+		 * on the oldest remaining node. */
+		size_t drop = 0;
+		while( drop < m_n && step - m_timeSteps[drop] >= MAX_DURATION_STEPS ) ++drop;
+		const int shift = (drop < m_n)?m_timeSteps[drop]:step;
+		m_n -= drop;
+		for( size_t i=0; i<m_n; ++i){
+			m_raw_values[0][i] = m_raw_values[0][i+drop];
+			m_raw_values[1][i] = m_raw_values[1][i+drop];
+			m_timeSteps[i] = m_timeSteps[i+drop] - shift;
+		}
+		m_startFrame += shift;
+		step -= shift;
 	}
 
-	m_raw_values[0]= NULL;
-	m_raw_values[1]= NULL;
-	m_splineCurve[0] = NULL;
-	m_splineCurve[1] = NULL;
+	m_raw_values[0][m_n] = x;
+	m_raw_values[1][m_n] = y;
+	m_timeSteps[m_n] = step;
+	++m_n;
+	return true;
+}
 
-#ifdef STORE_IN_MEMBER_VARIABLE
-	m_c[0]= NULL;
-	m_c[1]= NULL;
-	m_cov[0]= NULL;
-	m_cov[1]= NULL;
-#endif
+size_t GestureTrack::size() const{
+	return m_n;
+}
+
+int GestureTrack::getStartFrame() const{
+	return m_startFrame;
+}
+
+Gesture::Gesture( cBlob &blob, const Tracker &tracker, size_t skipped_begin_nodes, size_t skipped_end_nodes, const GestureEngine &engine ):
+m_n(0),m_ncoeffs(0),m_nbreak(0),
+	m_time_max(1.0),
+		m_engine(&engine),
+		m_gestureName(NULL),
+		m_gestureId(engine.nextGestureId()),
+		m_splineEvaluated(false)
+{
+	m_gestureId = blob.id;
 
 #ifdef WITH_HISTORY
 
-	if( blob.history.get() != nullptr ){
+	const HistoryRing *history = tracker.getHistory(blob);
+	if( history != NULL ){
 		/* 0. Count number of useful elements of history.
-		 * Blobs with .event = BLOB_PENDING should be ignored.*/
+		 * Pending blobs are stored with their last position.
+		 * The knots are the frame differences to the current blob.
+		 * (If the blob itself is pending the last frame is the reference.) */
 		size_t n(0);
 		int globKnot(0);
-		int duration(-1);
-		std::deque<cBlob>::iterator it = blob.history.get()->begin();
-		const std::deque<cBlob>::iterator itEnd = blob.history.get()->end();
+		const int frame = (blob.event != BLOB_PENDING)?tracker.getFrameId():tracker.getFrameId()-1;
+		unsigned int k;
 		if( blob.event != BLOB_PENDING ){
-			duration = blob.duration+1; //TODO check if +1 is ness.?
 			++n;
 		}
-		for ( ; it != itEnd ; ++it){
-			if( (*it).event == BLOB_UP ){
-					fprintf(stderr,"%s:Chain contain blob with BLOB_UP event.\n",__FILE__);
-			}
-			if( (*it).event != BLOB_PENDING ){ 
-				if( duration == -1 ){
-					duration = blob.duration;
-				}
-				globKnot = duration - (*it).duration;// + 1; /* TODO Remove +1 shift here but increase/decrease(?) duration value in history. */
-
-				if( globKnot >= MAX_DURATION_STEPS ){
-					fprintf(stderr,"%s:Excess max duration for gestures.\n",__FILE__);
-					/* The tracked data is to far in the past. Ignore all older nodes. */
-					break;
-				}else{
-					++n;
-				}
+		for ( k=0; k<history->size; ++k){
+			globKnot = frame - history_at(history, k).frame;
+
+			if( globKnot >= MAX_DURATION_STEPS ){
+				fprintf(stderr,"%s:Excess max duration for gestures.\n",__FILE__);
+				/* The tracked data is to far in the past. Ignore all older nodes. */
+				break;
+			}else{
+				++n;
 			}
 		}
 
@@ -143,6 +209,7 @@ m_n(0),m_ncoeffs(0),m_nbreak(0),
 		m_n = n - skipped_begin_nodes - skipped_end_nodes;
 		assert( m_n < 1000000 ); //underflow check
 		assert( m_n > 0 );
+		if( m_n > MAX_DURATION_STEPS ) m_n = MAX_DURATION_STEPS;
 
 		m_ncoeffs = NCOEFFS_FUNC(m_n);
 		m_nbreak = m_ncoeffs + 2 - SPLINE_DEG;
@@ -156,73 +223,39 @@ m_n(0),m_ncoeffs(0),m_nbreak(0),
 		{
 			printf("n,nc,nb=%lu,%lu,%lu \n", m_n, m_ncoeffs, m_nbreak);
 
-			//m_grid = gsl_vector_alloc( m_nbreak/*+2*(SPLINE_DEG-1)*/ );
-			m_ReducedBasis = gsl_matrix_alloc(m_n, m_ncoeffs);
-
-			m_raw_values[0] = gsl_vector_alloc(m_n);
-			m_raw_values[1] = gsl_vector_alloc(m_n);
-			m_debugDurationGrid = gsl_vector_alloc(m_n);
-
-#ifdef STORE_IN_MEMBER_VARIABLE
-			m_c[0] = gsl_vector_alloc(m_ncoeffs);
-			m_c[1] = gsl_vector_alloc(m_ncoeffs);
-			m_cov[0] = gsl_matrix_alloc(m_ncoeffs, m_ncoeffs);
-			m_cov[1] = gsl_matrix_alloc(m_ncoeffs, m_ncoeffs);
-#endif
-
-			//m_bw = gsl_bspline_alloc(SPLINE_DEG, m_nbreak);
-			const size_t basisIndex = m_ncoeffs-NCOEFFS_MIN;
-
 			/* 2. Filling vectors. Note that values are backward aligned. [current value,..., oldest value] */
-			int knot(0);
+			size_t knot(0);
 			globKnot = 0;
-			//gsl_vector_set(m_grid, 0, 0.0); // unknown behaviour for skipped_*_nodes>0
 			if( blob.event != BLOB_PENDING ){
 				if( skipped_end_nodes == 0 
 					){
-					const gsl_vector_const_view subrow = gsl_matrix_const_subrow ( FullBasis[basisIndex], globKnot, 0, m_ncoeffs);
-					gsl_matrix_set_row( m_ReducedBasis, knot, &subrow.vector );
-
-					gsl_vector_set_fast(m_raw_values[0], knot, blob.location.x);
-					gsl_vector_set_fast(m_raw_values[1], knot, blob.location.y);
-					gsl_vector_set_fast(m_debugDurationGrid, 0, 0.0);
+					m_raw_values[0][knot] = blob.location.x;
+					m_raw_values[1][knot] = blob.location.y;
+					m_timeSteps[knot] = globKnot;
 					++knot;
 				}else{
 					--skipped_end_nodes;
 				}
 			}
 
-			std::deque<cBlob>::iterator it = blob.history.get()->begin();
-			const std::deque<cBlob>::iterator itEnd = blob.history.get()->end();
-
-			for ( ; it != itEnd ; ++it){
-				if( (*it).event == BLOB_PENDING ) continue;
+			for ( k=0; k<history->size; ++k){
+				const HistorySample &sample = history_at(history, k);
 				if( skipped_end_nodes > 0 ){
 					--skipped_end_nodes;
 					continue;
 				}
 
 				//Global knot of uniform grid
-				globKnot = duration - (*it).duration;// + 1;
-
-				gsl_vector_set_fast(m_raw_values[0], knot, (*it).location.x);
-				gsl_vector_set_fast(m_raw_values[1], knot, (*it).location.y);
-				gsl_vector_set_fast(m_debugDurationGrid, knot, ((double)globKnot)/MAX_DURATION_STEPS);
-				//gsl_vector_set_fast( m_grid, knot, gsl_vector_get( FullGrid, globKnot ) );
+				globKnot = frame - sample.frame;
 
-				const gsl_vector_const_view subrow2 = gsl_matrix_const_subrow( FullBasis[basisIndex], globKnot, 0, m_ncoeffs);
-				gsl_matrix_set_row( m_ReducedBasis, knot, &subrow2.vector );
+				m_raw_values[0][knot] = sample.location.x;
+				m_raw_values[1][knot] = sample.location.y;
+				m_timeSteps[knot] = globKnot;
 
 				++knot;
 				if( knot >= m_n ) break; // just ness. if skipped_begin_nodes>0
 			}
 
-			//printf("Matrix:\n");
-			//gsl_matrix_fprintf(stdout,m_ReducedBasis, "%f");
-			//gsl_vector_fprintf(stdout,m_debugDurationGrid, "%f");
-
-			//gsl_bspline_knots(m_grid, m_bw);//internally, m_grid data will be copied, which is omitable
-
 			m_time_max = ((double)globKnot)/MAX_DURATION_STEPS;
 		}else{
 			// To less points
@@ -240,36 +273,14 @@ m_n(0),m_ncoeffs(0),m_nbreak(0),
 	construct();
 }
 
-Gesture::Gesture(int *inTimestamp, double *inX, double *inY, size_t xy_Len, size_t stride, bool reversedTime ):
+Gesture::Gesture(int *inTimestamp, double *inX, double *inY, size_t xy_Len, size_t stride, bool reversedTime, const GestureEngine &engine ):
 m_n(xy_Len),m_ncoeffs(0),m_nbreak(0),
 	m_time_max(1.0),
-		m_curvePointDistances(NULL),
+		m_engine(&engine),
 		m_gestureName(NULL),
-		m_gestureId(gestureIdCounter++),
-		m_debugDurationGrid(NULL),
-		m_ReducedBasis(NULL)
+		m_gestureId(engine.nextGestureId()),
+		m_splineEvaluated(false)
 {
-	//init static variables
-#ifdef ROBUST_FIT
-	if( rw == NULL ){
-#else
-	if( mw == NULL ){
-#endif
-		initStaticGestureVariables();
-	}
-
-	m_raw_values[0]= NULL;
-	m_raw_values[1]= NULL;
-	m_splineCurve[0] = NULL;
-	m_splineCurve[1] = NULL;
-
-#ifdef STORE_IN_MEMBER_VARIABLE
-	m_c[0]= NULL;
-	m_c[1]= NULL;
-	m_cov[0]= NULL;
-	m_cov[1]= NULL;
-#endif
-
 	if( m_n > MAX_DURATION_STEPS ) m_n = MAX_DURATION_STEPS;
 	m_ncoeffs = NCOEFFS_FUNC(m_n);
 	m_nbreak = m_ncoeffs + 2 - SPLINE_DEG;
@@ -281,89 +292,51 @@ m_n(xy_Len),m_ncoeffs(0),m_nbreak(0),
 	//if( m_nbreak-2 < 1000000 )
 	if( m_n > 10 )	
 	{
-		//m_grid = gsl_vector_alloc( m_nbreak/*+2*(SPLINE_DEG-1)*/ );
-		m_ReducedBasis = gsl_matrix_alloc(m_n, m_ncoeffs);
-
-		m_raw_values[0] = gsl_vector_alloc(m_n);
-		m_raw_values[1] = gsl_vector_alloc(m_n);
-		m_debugDurationGrid = gsl_vector_alloc(m_n);
-
-#ifdef STORE_IN_MEMBER_VARIABLE
-		m_c[0] = gsl_vector_alloc(m_ncoeffs);
-		m_c[1] = gsl_vector_alloc(m_ncoeffs);
-		m_cov[0] = gsl_matrix_alloc(m_ncoeffs, m_ncoeffs);
-		m_cov[1] = gsl_matrix_alloc(m_ncoeffs, m_ncoeffs);
-#endif
-
-		//m_bw = gsl_bspline_alloc(SPLINE_DEG, m_nbreak);
-		const size_t basisIndex = m_ncoeffs-NCOEFFS_MIN;
-
 		/* 1. Filling vectors */
-		//gsl_vector_set(m_grid, 0, 0.0);
+		const size_t len = m_n;
 		if( reversedTime ){
 			int endTime(inTimestamp[xy_Len-1]);
-			inTimestamp += xy_Len;
+			inTimestamp += xy_Len-1;
 			inX += (xy_Len-1)*stride;
 			inY += (xy_Len-1)*stride;
 
-			for (size_t i=0; i<xy_Len; ++i, inX-=stride, inY-=stride, --inTimestamp ){
+			for (size_t i=0; i<len; ++i, inX-=stride, inY-=stride, --inTimestamp ){
 
 				int curTime(endTime - *inTimestamp);
 				if( curTime >= MAX_DURATION_STEPS ){
 					fprintf(stderr,"%s:Excess max duration for gestures.\n",__FILE__);
-					/* The tracked data is to far in the past. Cut of at this position and short
-					 * the dimension of the basis matrix.
+					/* The tracked data is to far in the past. Cut of at this position.
 					 * Note: The selection of m_ncoeffs could be to high for the new m_n.
 					 */
 					m_n = i;
-					m_ReducedBasis->size1 = m_n;
-					m_raw_values[0]->size = m_n;
-					m_raw_values[1]->size = m_n;
-					--inTimestamp;
 					break;
 				}
 
-				gsl_vector_set_fast(m_raw_values[0], i, *inX);
-				gsl_vector_set_fast(m_raw_values[1], i, *inY);
-				gsl_vector_set_fast(m_debugDurationGrid, i, curTime);
-
-				const gsl_vector_const_view subrow2 = gsl_matrix_const_subrow( FullBasis[basisIndex], curTime, 0, m_ncoeffs);
-				gsl_matrix_set_row( m_ReducedBasis, i, &subrow2.vector );
+				m_raw_values[0][i] = *inX;
+				m_raw_values[1][i] = *inY;
+				m_timeSteps[i] = curTime;
 			}
 
 			m_time_max = ((double)(endTime-*(inTimestamp+1)))/MAX_DURATION_STEPS;
 
 		}else{ // time not reversed
-			for (size_t i=0; i<xy_Len; ++i, inX+=stride, inY+=stride, ++inTimestamp ){
+			for (size_t i=0; i<len; ++i, inX+=stride, inY+=stride, ++inTimestamp ){
 
 				if( *inTimestamp >= MAX_DURATION_STEPS ){
 					fprintf(stderr,"%s:Excess max duration for gestures.\n",__FILE__);
-					/* The tracked data is to far in the past. Cut of at this position and short
-					 * the dimension of the basis matrix.
+					/* The tracked data is to far in the past. Cut of at this position.
 					 * Note: The selection of m_ncoeffs could be to high for the new m_n.
 					 */
 					m_n = i;
-					m_ReducedBasis->size1 = m_n;
-					m_raw_values[0]->size = m_n;
-					m_raw_values[1]->size = m_n;
-					++inTimestamp;
 					break;
 				}
 
-				gsl_vector_set_fast(m_raw_values[0], i, *inX);
-				gsl_vector_set_fast(m_raw_values[1], i, *inY);
-				gsl_vector_set_fast(m_debugDurationGrid, i, *inTimestamp);
-
-				const gsl_vector_const_view subrow2 = gsl_matrix_const_subrow( FullBasis[basisIndex], *inTimestamp, 0, m_ncoeffs);
-				gsl_matrix_set_row( m_ReducedBasis, i, &subrow2.vector );
+				m_raw_values[0][i] = *inX;
+				m_raw_values[1][i] = *inY;
+				m_timeSteps[i] = *inTimestamp;
 			}
 
-		//printf("Matrix:\n");
-		//gsl_matrix_fprintf(stdout,m_ReducedBasis, "%f");
-
-		//gsl_bspline_knots(m_grid, m_bw);//internally, m_grid data will be copied, which is omitable
-
-		m_time_max = ((double)*(inTimestamp-1))/MAX_DURATION_STEPS;
+			m_time_max = ((double)*(inTimestamp-1))/MAX_DURATION_STEPS;
 		}
 	}else{
 		// To less points
@@ -373,160 +346,77 @@ m_n(xy_Len),m_ncoeffs(0),m_nbreak(0),
 	construct();
 }
 
-size_t Gesture::getNumberOfRawSupportNodes() const {
-	return m_n;
+Gesture::Gesture(int *inTimestamp, double *inXY, size_t xy_Len, bool reversedTime, const GestureEngine &engine ):
+	Gesture(inTimestamp, inXY, inXY+1, xy_Len, 2, reversedTime, engine)
+{
 }
 
-Gesture::Gesture(int *inTimestamp, double *inXY, size_t xy_Len, bool reversedTime ):
-m_n(xy_Len),m_ncoeffs(0),m_nbreak(0),
+Gesture::Gesture(const GestureTrack &track):
+	m_n(track.m_n),m_ncoeffs(0),m_nbreak(0),
 	m_time_max(1.0),
-		m_curvePointDistances(NULL),
+		m_engine(track.m_engine),
 		m_gestureName(NULL),
-		m_gestureId(gestureIdCounter++),
-		m_debugDurationGrid(NULL),
-		m_ReducedBasis(NULL)
-//:Gesture(inTimestamp, inXY, inXY+1, xy_Len, 2)
+		m_gestureId(track.m_engine->nextGestureId()),
+		m_splineEvaluated(false)
 {
-	// new(this) Gesture(inTimestamp, inXY, inXY+1, xy_Len, 2, reversedTime);
-	
-	//init static variables
-#ifdef ROBUST_FIT
-	if( rw == NULL ){
-#else
-	if( mw == NULL ){
-#endif
-		initStaticGestureVariables();
+	if( m_n <= 10 ){
+		// To less points
+		m_n = 0;
+		return;
 	}
 
-	m_raw_values[0]= NULL;
-	m_raw_values[1]= NULL;
-	m_splineCurve[0] = NULL;
-	m_splineCurve[1] = NULL;
-
-#ifdef STORE_IN_MEMBER_VARIABLE
-	m_c[0]= NULL;
-	m_c[1]= NULL;
-	m_cov[0]= NULL;
-	m_cov[1]= NULL;
-#endif
-
-	if( m_n > MAX_DURATION_STEPS ) m_n = MAX_DURATION_STEPS;
 	m_ncoeffs = NCOEFFS_FUNC(m_n);
 	m_nbreak = m_ncoeffs + 2 - SPLINE_DEG;
 
-	if( m_n > 10 )	
-	{
-		m_ReducedBasis = gsl_matrix_alloc(m_n, m_ncoeffs);
-
-		m_raw_values[0] = gsl_vector_alloc(m_n);
-		m_raw_values[1] = gsl_vector_alloc(m_n);
-		m_debugDurationGrid = gsl_vector_alloc(m_n);
-
-#ifdef STORE_IN_MEMBER_VARIABLE
-		m_c[0] = gsl_vector_alloc(m_ncoeffs);
-		m_c[1] = gsl_vector_alloc(m_ncoeffs);
-		m_cov[0] = gsl_matrix_alloc(m_ncoeffs, m_ncoeffs);
-		m_cov[1] = gsl_matrix_alloc(m_ncoeffs, m_ncoeffs);
-#endif
-
-		const size_t basisIndex = m_ncoeffs-NCOEFFS_MIN;
-
-		/* 1. Filling vectors */
-		if( reversedTime ){
-			int endTime(inTimestamp[xy_Len-1]);
-			inTimestamp += xy_Len-1;
-			inXY += (xy_Len-1)*2;
-			for (size_t i=0; i<xy_Len; ++i, inXY-=2, --inTimestamp ){
-
-				int curTime(endTime - *inTimestamp);
-				if( curTime >= MAX_DURATION_STEPS ){
-					fprintf(stderr,"%s:Excess max duration for gestures.\n",__FILE__);
-					/* The tracked data is to far in the past. Cut of at this position and short
-					 * the dimension of the basis matrix.
-					 * Note: The selection of m_ncoeffs could be to high for the new m_n.
-					 */
-					m_n = i;
-					m_ReducedBasis->size1 = m_n;
-					m_raw_values[0]->size = m_n;
-					m_raw_values[1]->size = m_n;
-					--inTimestamp;
-					break;
-				}
-
-				gsl_vector_set_fast(m_raw_values[0], i, inXY[0]);
-				gsl_vector_set_fast(m_raw_values[1], i, inXY[1]);
-				gsl_vector_set_fast(m_debugDurationGrid, i, curTime);
-
-				const gsl_vector_const_view subrow2 = gsl_matrix_const_subrow( FullBasis[basisIndex], curTime, 0, m_ncoeffs);
-				gsl_matrix_set_row( m_ReducedBasis, i, &subrow2.vector );
-			}
-
-			m_time_max = ((double)(endTime-*(inTimestamp+1)))/MAX_DURATION_STEPS;
-
-		}else{ // time not reversed
-
-			for (size_t i=0; i<xy_Len; ++i, inXY+=2, ++inTimestamp ){
-				if( *inTimestamp >= MAX_DURATION_STEPS ){
-					fprintf(stderr,"%s:Excess max duration for gestures.\n",__FILE__);
-					/* The tracked data is to far in the past. Cut of at this position and short
-					 * the dimension of the basis matrix.
-					 * Note: The selection of m_ncoeffs could be to high for the new m_n.
-					 */
-					m_n = i;
-					m_ReducedBasis->size1 = m_n;
-					m_raw_values[0]->size = m_n;
-					m_raw_values[1]->size = m_n;
-					++inTimestamp;
-					break;
-				}
-
-				gsl_vector_set_fast(m_raw_values[0], i, inXY[0]);
-				gsl_vector_set_fast(m_raw_values[1], i, inXY[1]);
-				gsl_vector_set_fast(m_debugDurationGrid, i, *inTimestamp);
+	// Backward aligned, like the tracker constructor.
+	const int lastStep = track.m_timeSteps[m_n-1];
+	for( size_t i=0; i<m_n; ++i){
+		const size_t k = m_n-1-i;
+		m_raw_values[0][i] = track.m_raw_values[0][k];
+		m_raw_values[1][i] = track.m_raw_values[1][k];
+		m_timeSteps[i] = lastStep - track.m_timeSteps[k];
+	}
+	m_time_max = ((double)lastStep)/MAX_DURATION_STEPS;
 
-				const gsl_vector_const_view subrow2 = gsl_matrix_const_subrow( FullBasis[basisIndex], *inTimestamp, 0, m_ncoeffs);
-				gsl_matrix_set_row( m_ReducedBasis, i, &subrow2.vector );
-			}
+	construct();
+}
 
-			m_time_max = ((double)*(inTimestamp-1))/MAX_DURATION_STEPS;
-		}
-	}else{
+Gesture::Gesture(const Gesture &gesture, size_t nodes):
+	m_n(std::min(nodes, gesture.m_n)),m_ncoeffs(0),m_nbreak(0),
+	m_time_max(1.0),
+		m_engine(gesture.m_engine),
+		m_gestureName(NULL),
+		m_gestureId(gesture.m_engine->nextGestureId()),
+		m_splineEvaluated(false)
+{
+	setGestureName(gesture.m_gestureName);
+	if( m_n <= 10 ){
 		// To less points
 		m_n = 0;
+		return;
 	}
-	
-	construct();
-}
-
 
-Gesture::~Gesture(){
-
-	//gsl_vector_free(m_grid);
-	gsl_matrix_free(m_ReducedBasis);
-
-	gsl_vector_free(m_debugDurationGrid);
+	m_ncoeffs = NCOEFFS_FUNC(m_n);
+	m_nbreak = m_ncoeffs + 2 - SPLINE_DEG;
 
-	if( m_curvePointDistances != NULL ){
-		for( size_t i=0; i<CompareDistancesNum; ++i){
-			gsl_vector_free(m_curvePointDistances[i]);
-		}
-		free(m_curvePointDistances);
+	// The oldest nodes, shifted to the newest of them.
+	const size_t first = gesture.m_n - m_n;
+	const int firstStep = gesture.m_timeSteps[first];
+	for( size_t i=0; i<m_n; ++i){
+		m_raw_values[0][i] = gesture.m_raw_values[0][first+i];
+		m_raw_values[1][i] = gesture.m_raw_values[1][first+i];
+		m_timeSteps[i] = gesture.m_timeSteps[first+i] - firstStep;
 	}
+	m_time_max = ((double)m_timeSteps[m_n-1])/MAX_DURATION_STEPS;
 
-	gsl_vector_free(m_splineCurve[0]);
-	gsl_vector_free(m_splineCurve[1]);
+	construct();
+}
 
-	gsl_vector_free(m_raw_values[0]);
-	gsl_vector_free(m_raw_values[1]);
+size_t Gesture::getNumberOfRawSupportNodes() const {
+	return m_n;
+}
 
-#ifdef STORE_IN_MEMBER_VARIABLE
-	gsl_vector_free(m_c[0]);
-	gsl_vector_free(m_c[1]);
-	gsl_matrix_free(m_cov[0]);
-	gsl_matrix_free(m_cov[1]);
-#endif	
-	//gsl_bspline_free(m_bw);
-	
+Gesture::~Gesture(){
 	free(m_gestureName);
 }
 
@@ -544,135 +434,48 @@ void Gesture::construct(){
 }
 
 
-#ifdef ROBUST_FIT
+/* Least squares fit on the GestureEngine::fullBasis rows of the nodes, see BSplineFit.h */
 void Gesture::evalSplineCoefficients(){
 	if( m_n == 0 ) return;
 
-	/* Shrink workspace on reduced dimension.
-	*/
-#if 1
-	gsl_multifit_robust_realloc(rw, m_n, m_ncoeffs);
-#else
-	gsl_multifit_robust_free(rw); rw = NULL;
-	rw = gsl_multifit_robust_alloc(m_n, m_ncoeffs);
-#endif
-
 	const size_t basisIndex = m_ncoeffs-NCOEFFS_MIN;
-	for( size_t d=0; d<DIM; ++d){
-#ifdef STORE_IN_MEMBER_VARIABLE
-		gsl_multifit_robust(m_ReducedBasis, m_raw_values[d], m_c[d], m_cov[d], rw);
-#else
-		gsl_multifit_robust(m_ReducedBasis, m_raw_values[d], Global_c[basisIndex][d], Global_cov[basisIndex][d], rw);
-#endif
-	}
-
+	SplineFuncs[basisIndex].fit(m_engine->fullBasis(m_ncoeffs), NCOEFFS_MAX, m_timeSteps, m_n,
+			m_raw_values[0], MAX_DURATION_STEPS, m_c[0], NCOEFFS_MAX);
 }
-#else
-void Gesture::evalSplineCoefficients(){
-	if( m_n == 0 ) return;
-
-	/* Shrink workspace on reduced dimension.
-	 */
-#if 1
-	gsl_multifit_linear_realloc(mw, m_n, m_ncoeffs);
-#else
-	gsl_multifit_linear_free(mw); mw = NULL;
-	mw = gsl_multifit_linear_alloc(m_n, m_ncoeffs);
-#endif
-
-	const size_t basisIndex = m_ncoeffs-NCOEFFS_MIN;
-	for( size_t d=0; d<DIM; ++d){
-		double chisq;
-#ifdef STORE_IN_MEMBER_VARIABLE
-		gsl_multifit_linear(m_ReducedBasis, m_raw_values[d], m_c[d], m_cov[d], &chisq, mw);
-		//gsl_vector_fprintf(stdout, m_c[d], "%f ");
-		//printf("====\n");
-#else
-		gsl_multifit_linear(m_ReducedBasis, m_raw_values[d], Global_c[basisIndex][d], Global_cov[basisIndex][d], &chisq, mw);
-#endif
-	}
-
-}
-#endif
 
 void Gesture::evalSpline(double **outX, double **outY, size_t *outLen ){
 	if( m_n == 0 ) return;
 
 	size_t j;
 
-	if( m_splineCurve[0] == NULL ){
-		m_splineCurve[0] = gsl_vector_alloc(NUM_EVALUATION_POINTS);
-		m_splineCurve[1] = gsl_vector_alloc(NUM_EVALUATION_POINTS);
-	}else{
+	*outX = m_splineCurve[0];
+	*outY = m_splineCurve[1];
+	*outLen = NUM_EVALUATION_POINTS;
+	if( m_splineEvaluated ){
 		//values are already evaluated
-		*outX = m_splineCurve[0]->data;
-		*outY = m_splineCurve[1]->data;
-		*outLen = NUM_EVALUATION_POINTS;
 		return;
 	}
-
-	*outX = m_splineCurve[0]->data;
-	*outY = m_splineCurve[1]->data;
-	*outLen = NUM_EVALUATION_POINTS;
-	//*outX = new double[NUM_EVALUATION_POINTS]; 
-	//*outY = new double[NUM_EVALUATION_POINTS]; 
+	m_splineEvaluated = true;
 
 	const size_t basisIndex = m_ncoeffs-NCOEFFS_MIN;
 	
-	// Eval basis on [0, m_time_max]
+	/* Eval basis on [0, m_time_max]. Note that EvalGrid-like preevaluated
+	 * values can not be used because the interval depends on the gesture. */
 	double t_step = m_time_max/(NUM_EVALUATION_POINTS-1) - 1E-10;
 	double t_pos = 0.0;
-	gsl_vector *tmpB = gsl_vector_alloc(m_ncoeffs);
 	for ( j=0; j<NUM_EVALUATION_POINTS; ++j, t_pos+=t_step )
 	{
-		double x_j,y_j, xerr, yerr;
-		//Nun berechne ich die Basiswerte ja doch in jedem Objekt...
-		gsl_bspline_eval(t_pos, tmpB, bw[basisIndex]);
-#ifdef STORE_IN_MEMBER_VARIABLE
-#ifdef ROBUST_FIT
-		//gsl_multifit_robust_est(tmpB, Global_c[basisIndex][0], Global_cov[basisIndex][0], &x_j, &yerr);
-		//gsl_multifit_robust_est(tmpB, Global_c[basisIndex][1], Global_cov[basisIndex][1], &x_j, &yerr);
-#else
-		gsl_multifit_linear_est(tmpB, m_c[0], m_cov[0], &x_j, &xerr);
-		gsl_multifit_linear_est(tmpB, m_c[1], m_cov[1], &y_j, &yerr);
-#endif
-#else
-		gsl_multifit_linear_est(tmpB, Global_c[basisIndex][0], Global_cov[basisIndex][0], &x_j, &xerr);
-		gsl_multifit_linear_est(tmpB, Global_c[basisIndex][1], Global_cov[basisIndex][1], &y_j, &yerr);
-		//gsl_multifit_robust_est(tmpB, Global_c[basisIndex][0], Global_cov[basisIndex][0], &x_j, &yerr);
-		//gsl_multifit_robust_est(tmpB, Global_c[basisIndex][1], Global_cov[basisIndex][1], &x_j, &yerr);
-#endif
-		(*outX)[j] = x_j;
-		(*outY)[j] = y_j;
-		//printf("%f %f %f\n",t_pos,x_j,y_j);
-
-	}
-	gsl_vector_free(tmpB);
-
-	/*
-	// Use preevaluated basis. This does not work because basis was evaluated on
-	// interval [0,1] not [0,m_time_max].
-	for ( j=0; j<NUM_EVALUATION_POINTS; ++j)
-	{
-		double x_j,y_j, xerr, yerr;
-		const double t_pos = gsl_vector_get_fast(EvalGrid, j);
-		const gsl_vector_const_view t_basis = gsl_matrix_const_subrow ( EvalGridBasis[basisIndex], j, 0, m_ncoeffs);
-		const gsl_vector *tmpB = &t_basis.vector;
-#ifdef STORE_IN_MEMBER_VARIABLE
-		gsl_multifit_linear_est(tmpB, m_c[0], m_cov[0], &x_j, &xerr);
-		gsl_multifit_linear_est(tmpB, m_c[1], m_cov[1], &y_j, &yerr);
-#else
-		gsl_multifit_linear_est(tmpB, Global_c[basisIndex][0], Global_cov[basisIndex][0], &x_j, &xerr);
-		gsl_multifit_linear_est(tmpB, Global_c[basisIndex][1], Global_cov[basisIndex][1], &y_j, &yerr);
-		//gsl_multifit_robust_est(tmpB, Global_c[basisIndex][0], Global_cov[basisIndex][0], &x_j, &yerr);
-		//gsl_multifit_robust_est(tmpB, Global_c[basisIndex][1], Global_cov[basisIndex][1], &x_j, &yerr);
-#endif
-		(*outX)[j] = x_j;
-		(*outY)[j] = y_j;
+		double N[SPLINE_DEG];
+		const size_t first = SplineFuncs[basisIndex].evalNonzero(t_pos, N);
+		double x_j(0.0), y_j(0.0);
+		for( size_t r=0; r<SPLINE_DEG; ++r){
+			x_j += N[r]*m_c[0][first+r];
+			y_j += N[r]*m_c[1][first+r];
+		}
+		m_splineCurve[0][j] = x_j;
+		m_splineCurve[1][j] = y_j;
 		//printf("%f %f %f\n",t_pos,x_j,y_j);
 	}
-	*/
-
 }
 
 /* Interpretation of the three values in m_orientationTriangle:
@@ -689,16 +492,16 @@ void Gesture::evalOrientation(){
 
 	//assume m_n>2*NUM_END_NODES
 	for( pos=0; pos<NUM_END_NODES; ++pos){
-		m_orientationTriangle[0].x += gsl_vector_get_fast(m_raw_values[0],pos);
-		m_orientationTriangle[0].y += gsl_vector_get_fast(m_raw_values[1],pos);
+		m_orientationTriangle[0].x += m_raw_values[0][pos];
+		m_orientationTriangle[0].y += m_raw_values[1][pos];
 	}
 	for( ; pos<m_n-NUM_END_NODES; ++pos){
-		m_orientationTriangle[1].x += gsl_vector_get_fast(m_raw_values[0],pos);
-		m_orientationTriangle[1].y += gsl_vector_get_fast(m_raw_values[1],pos);
+		m_orientationTriangle[1].x += m_raw_values[0][pos];
+		m_orientationTriangle[1].y += m_raw_values[1][pos];
 	}
 	for( ; pos<m_n; ++pos){
-		m_orientationTriangle[2].x += gsl_vector_get_fast(m_raw_values[0],pos);
-		m_orientationTriangle[2].y += gsl_vector_get_fast(m_raw_values[1],pos);
+		m_orientationTriangle[2].x += m_raw_values[0][pos];
+		m_orientationTriangle[2].y += m_raw_values[1][pos];
 	}
 	m_orientationTriangle[0].x /= NUM_END_NODES;
 	m_orientationTriangle[0].y /= NUM_END_NODES;
@@ -715,8 +518,8 @@ double Gesture::evalCurveLength(){
 
 	for( pos=0; pos<NUM_EVALUATION_POINTS-1; ++pos){
 		double tmpX, tmpY;
-		tmpX = gsl_vector_get_fast(m_splineCurve[0],pos+1) - gsl_vector_get_fast(m_splineCurve[0],pos);
-		tmpY = gsl_vector_get_fast(m_splineCurve[1],pos+1) - gsl_vector_get_fast(m_splineCurve[1],pos);
+		tmpX = m_splineCurve[0][pos+1] - m_splineCurve[0][pos];
+		tmpY = m_splineCurve[1][pos+1] - m_splineCurve[1][pos];
 		curveLen += sqrt( tmpX*tmpX + tmpY*tmpY );
 	}
 	return curveLen;
@@ -724,25 +527,18 @@ double Gesture::evalCurveLength(){
 
 /* Compare spline(t_n) with spline(t_n+CompareDistances[i]) and scale with length of polygon. */
 void Gesture::evalDistances(){
-	if( m_curvePointDistances == NULL ){
-		m_curvePointDistances = (gsl_vector**) malloc( CompareDistancesNum*sizeof(gsl_vector*) );
-		for( size_t i=0; i<CompareDistancesNum; ++i){
-			m_curvePointDistances[i] = gsl_vector_alloc(NUM_EVALUATION_POINTS-CompareDistances[i]);
-		}
-	}
-
 	const double curveScale = 1/evalCurveLength();
 
 	/* 2. Eval distances for certain levels. */
 	for( size_t i=0; i<CompareDistancesNum; ++i){
-		double *out = m_curvePointDistances[i]->data;
+		double *out = m_curvePointDistances[i];
 		size_t start = 0;
 		size_t end = CompareDistances[i];
 
 		for( start=0 ; end < NUM_EVALUATION_POINTS ; ++start, ++end ){
 			double tmpX, tmpY;
-			tmpX = gsl_vector_get_fast(m_splineCurve[0],end) - gsl_vector_get_fast(m_splineCurve[0],start);
-			tmpY = gsl_vector_get_fast(m_splineCurve[1],end) - gsl_vector_get_fast(m_splineCurve[1],start);
+			tmpX = m_splineCurve[0][end] - m_splineCurve[0][start];
+			tmpY = m_splineCurve[1][end] - m_splineCurve[1][start];
 			*out++ = sqrt( tmpX*tmpX + tmpY*tmpY )*curveScale;
 		}
 
@@ -803,7 +599,10 @@ size_t Gesture::getGestureId() const{
 //=======================================================
 
 GestureStore::GestureStore():
-gestures()
+gestures(),
+	m_batch(),
+	m_index(),
+	m_indexDirty(true)
 {
 
 }
@@ -820,9 +619,15 @@ GestureStore::~GestureStore(){
 /* All patters will be deleted in the destrutor. */
 void GestureStore::addPattern(Gesture *pGesture){
 	gestures.push_back(pGesture);
+	m_indexDirty = true;
 }
 
 std::vector<Gesture*> & GestureStore::getPatterns() {
+	m_indexDirty = true;
+	return gestures;
+}
+
+const std::vector<Gesture*> & GestureStore::getPatterns() const {
 	return gestures;
 }
 
@@ -831,46 +636,86 @@ std::vector<Gesture*> & GestureStore::getPatterns() {
  * the distance between the input spline S and the
  * stored splines G_i.
  *
- * TODO:
- * Use triangle inequality
- * dist(D_i,S) - dist(D_i,D_j) <= dist(D_j,S)
- * or other inequalities to 
- * to cut of some integrations.
+ * The first level will be compared by the GestureIndex,
+ * which cuts off most patterns by the triangle inequality.
+ * It returns the same candidates as the linear scan over all
+ * patterns.
  */
-void GestureStore::compateWithPatterns(Gesture *pGesture, GesturePatternCompareResult &gpcr ){
+void GestureStore::compateWithPatterns(Gesture *pGesture, GesturePatternCompareResult &gpcr,
+		GestureCompareWorkspace *workspace ){
 	gpcr.minDist = FLT_MAX;
 	gpcr.minGest = NULL;
 
 	if( pGesture->getNumberOfRawSupportNodes() == 0 ) return;
 
-	std::vector<Gesture*>::iterator it = gestures.begin();
-	const std::vector<Gesture*>::iterator itEnd = gestures.end();
+	{
+		std::lock_guard<std::mutex> lock(m_indexMutex);
+		if( m_indexDirty ){
+			m_batch.build(gestures, 0);
+			if( m_batch.size() > GESTURE_BATCH_MAX_PATTERNS ){
+				m_index.build(gestures);
+			}else{
+				m_index.clear();
+			}
+			m_indexDirty = false;
+		}
+	}
 
-	double avgDist = 0.0;
-	//Number of dist, which will be used for averaging
-	int countDist = 0;
-	size_t level = 0;
+	GestureCompareWorkspace tmpWorkspace;
+	GestureCompareWorkspace &ws = (workspace != NULL)?*workspace:tmpWorkspace;
 
-	std::vector<GestureDistance> distObjects; 
-	std::vector<GestureDistance*> distPointers; //for sorting
-	for( ; it != itEnd ; ++it ){
-		distObjects.emplace_back( GestureDistance(pGesture, (*it)) );
-	}
-	for( auto& x: distObjects){
-		distPointers.push_back(&x);
-	}
+	size_t iMin = 5;//minimal number of gestures for next level
 
 	/* Compare on stage 1. This compare
 	 * by the L2 norm (linear quadrature) on the v=m_curvePointDistances[0] vectors.
+	 *
+	 * Only the patterns which pass the filter of the first level below
+	 * will be fetched: If c patterns are below the limit 10*best, the
+	 * c+1 nearest patterns are needed (at least iMin+1).
+	 * Small stores will be compared by a single pass over all patterns
+	 * (GestureBatch), bigger ones by the GestureIndex.
 	 */
+	std::vector<GestureIndex::Neighbour> &nearest = ws.nearest;
+	std::vector<double> &cache = ws.cache;
+	const bool streaming = (m_batch.size() <= GESTURE_BATCH_MAX_PATTERNS);
+	const size_t numPatterns = m_batch.size();
+	if( streaming ){
+		m_batch.distances(pGesture, ws.dists);
+		m_batch.nearest(ws.dists, iMin+1, nearest);
+	}else{
+		cache.assign(m_index.size(), -1.0);
+		m_index.nearest(pGesture, iMin+1, nearest, cache);
+	}
+	if( nearest.empty() ) return;
+
+	if( nearest.size() > iMin && nearest[iMin].dist2 < 10 * nearest[0].dist2 ){
+		const double l2Limit = 10 * nearest[0].dist2;
+		const size_t c = streaming?m_batch.count(ws.dists, l2Limit):
+			m_index.count(pGesture, l2Limit, cache);
+		// No pattern is above the limit => iMin patterns.
+		const size_t k = (c<numPatterns)?c+1:iMin;
+		if( streaming ){
+			m_batch.nearest(ws.dists, k, nearest);
+		}else{
+			m_index.nearest(pGesture, k, nearest, cache);
+		}
+	}
+
+	std::vector<GestureDistance> &distObjects = ws.distObjects; 
+	std::vector<GestureDistance*> &distPointers = ws.distPointers; //for sorting, already sorted by level 0
+	distObjects.clear();
+	distPointers.clear();
+	distObjects.reserve(nearest.size());
+	for( const auto& x: nearest ){
+		distObjects.emplace_back( GestureDistance(pGesture, x.gesture) );
+		distObjects.back().evalL2Dist(0);
+	}
 	for( auto& x: distObjects){
-		x.evalL2Dist(0);
+		distPointers.push_back(&x);
 	}
-	std::sort(distPointers.begin(), distPointers.end(), sortFunctions[0]);
 
 	/* Filtering out high distances and sort nearby gestures for other levels*/	
 	size_t i = 0;
-	size_t iMin = 5;//minimal number of gestures for next level
 	size_t iCut;
 	for( size_t iL = 1; iL<CompareDistancesNum; ++iL){
 		double l2Limit = 10 * distPointers[0]->m_L2NormSquared[iL-1];
@@ -883,7 +728,9 @@ void GestureStore::compateWithPatterns(Gesture *pGesture, GesturePatternCompareR
 			iCut = i;
 			break;
 		}
-		distPointers.erase(distPointers.begin()+iCut, distPointers.end());
+		if( iCut < distPointers.size() ){
+			distPointers.erase(distPointers.begin()+iCut, distPointers.end());
+		}
 
 		for( auto& x: distPointers){
 			x->evalL2Dist(iL);
@@ -896,12 +743,12 @@ void GestureStore::compateWithPatterns(Gesture *pGesture, GesturePatternCompareR
 		++i;
 		x->m_sorting_weight += i;
 	}
-	//std::sort(distPointers.begin(), distPointers.end(), sortByOrder);
 	std::sort(distPointers.begin(), distPointers.end(), sortByLevelWeightSum);
 
 	i = 0;
 	for( const auto& x: distPointers){
-		printf("%i %i %1.5f %1.5f %1.5f %1.5f %s\n", i,
+		if( !ws.verbose ) break;
+		printf("%zu %i %1.5f %1.5f %1.5f %1.5f %s\n", i,
 				x->m_sorting_weight,
 				x->m_L2NormSquared[0],
 				x->m_L2NormSquared[1],
@@ -914,26 +761,164 @@ void GestureStore::compateWithPatterns(Gesture *pGesture, GesturePatternCompareR
 	gpcr.minGest = distPointers[0]->m_to;
 	gpcr.minDist = distPointers[0]->m_L2_weight;
 	gpcr.avgDist = gpcr.minDist;// TODO: Remove this stuff.
-  printf("Curve distance to %s: %f\n", gpcr.minGest->getGestureName(), gpcr.minDist);
-
-	/* //old
-		 for( ; it != itEnd ; ++it ){
-		 double dist = quadratureSquared( 
-		 pGesture->m_curvePointDistances[level]->data,
-		 (*it)->m_curvePointDistances[level]->data, 
-		 pGesture->m_curvePointDistances[level]->size );
-		 if( dist < gpcr.minDist ){
-		 gpcr.minDist = dist;
-		 gpcr.minGest = (*it);
-		 }
-		 ++countDist;
-		 avgDist += dist;
-
-		 printf("Curve distance: %f\n", dist);
-		 }
-		 gpcr.avgDist = avgDist/countDist;
-		 */
+	if( ws.verbose ){
+		printf("Curve distance to %s: %f\n", gpcr.minGest->getGestureName(), gpcr.minDist);
+	}
+}
+
+GestureRecognizer::GestureRecognizer(const GestureStore &store, const GestureEngine &engine):
+	m_store(store),
+	m_engine(engine),
+	m_prefixes(NULL),
+	m_minNodes(GESTURE_ONLINE_MIN_NODES),
+	m_maxDist(GESTURE_ONLINE_MAX_DIST),
+	m_minConfidence(GESTURE_ONLINE_MIN_CONFIDENCE),
+	m_stableFrames(GESTURE_ONLINE_STABLE_FRAMES)
+{
+	m_workspace.verbose = false;
+}
+
+GestureRecognizer::~GestureRecognizer(){
+	for( auto& x: m_tracks ){
+		delete x.second;
+	}
+	delete m_prefixes;
+}
+
+void GestureRecognizer::setThresholds(size_t minNodes, float maxDist, float minConfidence, size_t stableFrames){
+	m_minNodes = std::max(minNodes, (size_t) 11); // Gesture needs more than 10 nodes
+	m_maxDist = maxDist;
+	m_minConfidence = minConfidence;
+	m_stableFrames = std::max(stableFrames, (size_t) 1);
+}
+
+void GestureRecognizer::patternsChanged(){
+	delete m_prefixes;
+	m_prefixes = NULL;
+	m_patternOf.clear();
+	for( auto& x: m_tracks ){
+		x.second->candidate = NULL;
+		x.second->stableFrames = 0;
+		x.second->lastMatch = NULL;
+	}
+}
 
+void GestureRecognizer::buildPrefixes(){
+	m_prefixes = new GestureStore();
+	for( const auto& pattern: m_store.getPatterns() ){
+		const size_t n = pattern->getNumberOfRawSupportNodes();
+		size_t lastLen = 0;
+		for( size_t k=1; k<=GESTURE_ONLINE_PREFIXES; ++k){
+			const size_t len = (n*k)/GESTURE_ONLINE_PREFIXES;
+			if( len <= 10 || len == lastLen ) continue;
+			lastLen = len;
+			Gesture *prefix = new Gesture(*pattern, len);
+			m_prefixes->addPattern(prefix);
+			m_patternOf[prefix] = pattern;
+		}
+	}
+}
+
+void GestureRecognizer::update(const Tracker &tracker, const std::vector<cBlob> &blobs,
+		std::vector<GestureProvisionalMatch> &out){
+	const int frame = tracker.getFrameId();
+	if( m_prefixes == NULL ) buildPrefixes();
+
+	for( const auto& blob: blobs ){
+		auto it = m_tracks.find(blob.id);
+		if( blob.event == BLOB_UP ){
+			if( it != m_tracks.end() ){
+				delete it->second;
+				m_tracks.erase(it);
+			}
+			continue;
+		}
+		if( blob.event == BLOB_PENDING ) continue;
+
+		TrackState *state;
+		if( it == m_tracks.end() ){
+			/* Start with the positions of the previous frames,
+			 * but not more than MAX_DURATION_STEPS frames. */
+			int startFrame = frame;
+#ifdef WITH_HISTORY
+			const HistoryRing *history = tracker.getHistory(blob);
+			size_t k = (history != NULL)?history->size:0;
+			while( k > 0 && frame - history_at(history, k-1).frame >= MAX_DURATION_STEPS ) --k;
+			if( k > 0 ) startFrame = history_at(history, k-1).frame;
+#endif
+			state = new TrackState(startFrame, m_engine);
+			m_tracks[blob.id] = state;
+#ifdef WITH_HISTORY
+			while( k-- > 0 ){
+				const HistorySample &sample = history_at(history, k);
+				state->track.addNode(sample.frame, sample.location.x, sample.location.y);
+			}
+#endif
+		}else{
+			state = it->second;
+		}
+		state->lastFrame = frame;
+
+		if( !state->track.addNode(frame, blob.location.x, blob.location.y) ) continue;
+		if( state->track.size() < m_minNodes ) continue;
+		compare(state, blob, out);
+	}
+
+	/* Remove the tracks of finished blobs. Missing blobs could be
+	 * pending for getMaxMissingDuration() frames and return in the
+	 * next frame. Their state will be kept until then. */
+	const int maxGap = tracker.getMaxMissingDuration() + 1;
+	for( auto it = m_tracks.begin(); it != m_tracks.end(); ){
+		if( frame - it->second->lastFrame > maxGap ){
+			delete it->second;
+			it = m_tracks.erase(it);
+		}else{
+			++it;
+		}
+	}
+}
+
+void GestureRecognizer::compare(TrackState *state, const cBlob &blob,
+		std::vector<GestureProvisionalMatch> &out){
+	Gesture prefix(state->track);
+	GesturePatternCompareResult res;
+	m_prefixes->compateWithPatterns(&prefix, res, &m_workspace);
+	if( res.minGest == NULL ) return;
+
+	const Gesture *pattern = m_patternOf[res.minGest];
+	if( pattern == state->candidate ){
+		++state->stableFrames;
+	}else{
+		state->candidate = pattern;
+		state->stableFrames = 1;
+	}
+	if( state->stableFrames < m_stableFrames
+			|| pattern == state->lastMatch
+			|| res.minDist >= m_maxDist ) return;
+
+	/* Other prefixes of the same pattern are close, too.
+	 * Thus, compare with the best prefix of another pattern. */
+	float otherDist = FLT_MAX;
+	for( const auto& x: m_workspace.distPointers ){
+		if( m_patternOf[x->m_to] != pattern ){
+			otherDist = x->m_L2_weight;
+			break;
+		}
+	}
+	float confidence = 1.0f;
+	if( otherDist < FLT_MAX && otherDist > 0.0f ){
+		confidence = std::max(0.0f, 1.0f - res.minDist/otherDist);
+	}
+	if( confidence < m_minConfidence ) return;
+
+	state->lastMatch = pattern;
+	GestureProvisionalMatch match;
+	match.blobId = blob.id;
+	match.pattern = pattern;
+	match.dist = res.minDist;
+	match.confidence = confidence;
+	match.nodes = state->track.size();
+	out.push_back(match);
 }
 
 double GestureDistance::evalL2Dist( size_t level){
@@ -942,14 +927,323 @@ double GestureDistance::evalL2Dist( size_t level){
 			m_L2_weight -= m_L2NormSquared[level];
 	}
 	m_L2NormSquared[level] = quadratureSquared( 
-			m_from->m_curvePointDistances[level]->data,
-			m_to->m_curvePointDistances[level]->data, 
-			m_from->m_curvePointDistances[level]->size );
+			m_from->m_curvePointDistances[level],
+			m_to->m_curvePointDistances[level], 
+			CURVE_POINT_DISTANCES_LEN(level) );
 
 	m_L2_weight += m_L2NormSquared[level];
 	return m_L2NormSquared[level];
 }
 
+//=======================================================
+
+/* Relative tolerance for the triangle inequality. Rounding errors
+ * should not cut off a valid subtree. */
+#define INDEX_EPS 1E-9
+
+static double level0Dist2(const Gesture *a, const Gesture *b){
+	return quadratureSquared( 
+			a->m_curvePointDistances[0],
+			b->m_curvePointDistances[0], 
+			CURVE_POINT_DISTANCES_LEN(0) );
+}
+
+static bool neighbourCmp(const GestureIndex::Neighbour &lhs, const GestureIndex::Neighbour &rhs){
+	return lhs.dist2 < rhs.dist2;
+}
+
+GestureIndex::GestureIndex():
+	m_nodes()
+{
+}
+
+void GestureIndex::clear(){
+	m_nodes.clear();
+}
+
+size_t GestureIndex::size() const{
+	return m_nodes.size();
+}
+
+void GestureIndex::build(const std::vector<Gesture*> &gestures){
+	m_nodes.clear();
+
+	std::vector<std::pair<double, const Gesture*> > items;
+	for( const auto& x: gestures ){
+		if( x->getNumberOfRawSupportNodes() == 0 ) continue;
+		items.push_back( std::make_pair(0.0, x) );
+	}
+	m_nodes.reserve(items.size());
+	buildNode(items, 0, items.size());
+}
+
+/* The first element of [begin, end) is the vantage point. The others will be
+ * split at the median of their distances to it. */
+int GestureIndex::buildNode(std::vector<std::pair<double, const Gesture*> > &items,
+		size_t begin, size_t end){
+	if( begin >= end ) return -1;
+
+	const int id = m_nodes.size();
+	m_nodes.push_back(Node());
+	Node node;
+	node.vp = items[begin].second;
+	node.mu = 0.0;
+	node.child[0] = node.child[1] = -1;
+	node.range[0][0] = node.range[1][0] = DBL_MAX;
+	node.range[0][1] = node.range[1][1] = 0.0;
+
+	const size_t first = begin + 1;
+	if( first < end ){
+		for( size_t i=first; i<end; ++i){
+			items[i].first = sqrt(level0Dist2(node.vp, items[i].second));
+		}
+		const size_t mid = first + (end-first)/2;
+		std::nth_element(items.begin()+first, items.begin()+mid, items.begin()+end);
+		node.mu = items[mid].first;
+
+		for( size_t i=first; i<end; ++i){
+			const int side = (i<mid)?0:1;
+			node.range[side][0] = std::min(node.range[side][0], items[i].first);
+			node.range[side][1] = std::max(node.range[side][1], items[i].first);
+		}
+
+		node.child[0] = buildNode(items, first, mid);
+		node.child[1] = buildNode(items, mid, end);
+	}
+	m_nodes[id] = node;
+	return id;
+}
+
+double GestureIndex::vpDist2(int node, const Gesture *pGesture, std::vector<double> &cache) const{
+	if( cache[node] < 0.0 ){
+		cache[node] = level0Dist2(pGesture, m_nodes[node].vp);
+	}
+	return cache[node];
+}
+
+void GestureIndex::nearest(const Gesture *pGesture, size_t k,
+		std::vector<Neighbour> &out, std::vector<double> &cache) const{
+	out.clear();
+	if( k == 0 || m_nodes.empty() || pGesture->getNumberOfRawSupportNodes() == 0 ) return;
+	if( cache.size() != m_nodes.size() ){
+		cache.assign(m_nodes.size(), -1.0);
+	}
+
+	// Max heap of the k best matches
+	out.reserve(k);
+	searchNearest(0, pGesture, k, out, cache);
+	std::sort_heap(out.begin(), out.end(), neighbourCmp);
+}
+
+void GestureIndex::searchNearest(int node, const Gesture *pGesture, size_t k,
+		std::vector<Neighbour> &heap, std::vector<double> &cache) const{
+	const Node &n = m_nodes[node];
+	const double d2 = vpDist2(node, pGesture, cache);
+
+	if( heap.size() < k ){
+		Neighbour nb = { n.vp, d2 };
+		heap.push_back(nb);
+		std::push_heap(heap.begin(), heap.end(), neighbourCmp);
+	}else if( d2 < heap.front().dist2 ){
+		std::pop_heap(heap.begin(), heap.end(), neighbourCmp);
+		heap.back().gesture = n.vp;
+		heap.back().dist2 = d2;
+		std::push_heap(heap.begin(), heap.end(), neighbourCmp);
+	}
+
+	// Visit the subtree of the query first.
+	const double d = sqrt(d2);
+	const int first = (d < n.mu)?0:1;
+	for( int j=0; j<2; ++j){
+		const int side = (j==0)?first:1-first;
+		if( n.child[side] < 0 ) continue;
+		if( heap.size() >= k ){
+			const double tau = sqrt(heap.front().dist2)*(1.0+INDEX_EPS) + INDEX_EPS;
+			if( d + tau < n.range[side][0] || d - tau > n.range[side][1] ) continue;
+		}
+		searchNearest(n.child[side], pGesture, k, heap, cache);
+	}
+}
+
+size_t GestureIndex::count(const Gesture *pGesture, double limit2,
+		std::vector<double> &cache) const{
+	if( m_nodes.empty() || pGesture->getNumberOfRawSupportNodes() == 0 ) return 0;
+	if( cache.size() != m_nodes.size() ){
+		cache.assign(m_nodes.size(), -1.0);
+	}
+	const double limit = sqrt(limit2)*(1.0+INDEX_EPS) + INDEX_EPS;
+	return searchCount(0, pGesture, limit2, limit, cache);
+}
+
+size_t GestureIndex::searchCount(int node, const Gesture *pGesture, double limit2,
+		double limit, std::vector<double> &cache) const{
+	const Node &n = m_nodes[node];
+	const double d2 = vpDist2(node, pGesture, cache);
+	const double d = sqrt(d2);
+	size_t c = (d2 < limit2)?1:0;
+
+	for( int side=0; side<2; ++side){
+		if( n.child[side] < 0 ) continue;
+		if( d + limit < n.range[side][0] || d - limit > n.range[side][1] ) continue;
+		c += searchCount(n.child[side], pGesture, limit2, limit, cache);
+	}
+	return c;
+}
+
+//=======================================================
+
+GestureBatch::GestureBatch():
+	m_level(0),
+	m_stride(0),
+	m_rows(),
+	m_patterns()
+{
+}
+
+size_t GestureBatch::size() const{
+	return m_patterns.size();
+}
+
+void GestureBatch::packRow(const Gesture *pGesture, float *row) const{
+	const size_t len = CURVE_POINT_DISTANCES_LEN(m_level);
+	/* quadratureSquared = \sum_i w_i d_i^2 / (len-1) with w_0 = w_{len-1} = 1/2 */
+	const double scale = 1.0/sqrt((double)(len-1));
+	const double *in = pGesture->m_curvePointDistances[m_level];
+	for( size_t i=0; i<len; ++i){
+		row[i] = in[i]*scale*((i==0 || i==len-1)?M_SQRT1_2:1.0);
+	}
+	for( size_t i=len; i<m_stride; ++i){
+		row[i] = 0.0f;
+	}
+}
+
+void GestureBatch::build(const std::vector<Gesture*> &gestures, size_t level){
+	assert(level<CompareDistancesNum);
+	m_level = level;
+	m_stride = (CURVE_POINT_DISTANCES_LEN(level) + GESTURE_BATCH_WIDTH-1)
+		/GESTURE_BATCH_WIDTH*GESTURE_BATCH_WIDTH;
+	m_patterns.clear();
+	for( const auto& x: gestures ){
+		if( x->getNumberOfRawSupportNodes() == 0 ) continue;
+		m_patterns.push_back(x);
+	}
+	m_rows.resize(m_patterns.size()*m_stride);
+	for( size_t i=0; i<m_patterns.size(); ++i){
+		packRow(m_patterns[i], &m_rows[i*m_stride]);
+	}
+}
+
+/* Squared distances of q to n rows. */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+static inline float32x4_t batchAcc(const float *q, const float *p, size_t stride){
+	float32x4_t acc = vdupq_n_f32(0.0f);
+	for( size_t j=0; j<stride; j+=4){
+		const float32x4_t d = vsubq_f32(vld1q_f32(q+j), vld1q_f32(p+j));
+		acc = vmlaq_f32(acc, d, d);
+	}
+	return acc;
+}
+
+static void batchDist2(const float *q, const float *rows, size_t stride, size_t n, float *out){
+	size_t i;
+	for( i=0; i+4<=n; i+=4, rows+=4*stride, out+=4){
+		// Four rows at once. Pairwise additions give the four sums in one vector.
+		const float32x4_t a0 = batchAcc(q, rows, stride);
+		const float32x4_t a1 = batchAcc(q, rows+stride, stride);
+		const float32x4_t a2 = batchAcc(q, rows+2*stride, stride);
+		const float32x4_t a3 = batchAcc(q, rows+3*stride, stride);
+		const float32x2_t s01 = vpadd_f32(vpadd_f32(vget_low_f32(a0), vget_high_f32(a0)),
+				vpadd_f32(vget_low_f32(a1), vget_high_f32(a1)));
+		const float32x2_t s23 = vpadd_f32(vpadd_f32(vget_low_f32(a2), vget_high_f32(a2)),
+				vpadd_f32(vget_low_f32(a3), vget_high_f32(a3)));
+		vst1q_f32(out, vcombine_f32(s01, s23));
+	}
+	for( ; i<n; ++i, rows+=stride, ++out){
+		const float32x4_t a = batchAcc(q, rows, stride);
+		const float32x2_t s = vadd_f32(vget_low_f32(a), vget_high_f32(a));
+		*out = vget_lane_f32(vpadd_f32(s, s), 0);
+	}
+}
+#elif defined(__SSE2__)
+static inline __m128 batchAcc(const float *q, const float *p, size_t stride){
+	__m128 acc = _mm_setzero_ps();
+	for( size_t j=0; j<stride; j+=4){
+		const __m128 d = _mm_sub_ps(_mm_loadu_ps(q+j), _mm_loadu_ps(p+j));
+		acc = _mm_add_ps(acc, _mm_mul_ps(d, d));
+	}
+	return acc;
+}
+
+static void batchDist2(const float *q, const float *rows, size_t stride, size_t n, float *out){
+	size_t i;
+	for( i=0; i+4<=n; i+=4, rows+=4*stride, out+=4){
+		// Four rows at once. Transpose and add gives the four sums in one vector.
+		__m128 a0 = batchAcc(q, rows, stride);
+		__m128 a1 = batchAcc(q, rows+stride, stride);
+		__m128 a2 = batchAcc(q, rows+2*stride, stride);
+		__m128 a3 = batchAcc(q, rows+3*stride, stride);
+		_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+		_mm_storeu_ps(out, _mm_add_ps(_mm_add_ps(a0, a1), _mm_add_ps(a2, a3)));
+	}
+	for( ; i<n; ++i, rows+=stride, ++out){
+		__m128 a = batchAcc(q, rows, stride);
+		a = _mm_add_ps(a, _mm_movehl_ps(a, a));
+		a = _mm_add_ss(a, _mm_shuffle_ps(a, a, 1));
+		*out = _mm_cvtss_f32(a);
+	}
+}
+#else
+static void batchDist2(const float *q, const float *rows, size_t stride, size_t n, float *out){
+	for( size_t i=0; i<n; ++i, rows+=stride){
+		float acc = 0.0f;
+		for( size_t j=0; j<stride; ++j){
+			const float d = q[j]-rows[j];
+			acc += d*d;
+		}
+		out[i] = acc;
+	}
+}
+#endif
+
+void GestureBatch::distances(const Gesture *pGesture, std::vector<float> &out) const{
+	out.resize(m_patterns.size());
+	if( m_patterns.empty() || pGesture->getNumberOfRawSupportNodes() == 0 ) return;
+
+	float query[NUM_EVALUATION_POINTS+GESTURE_BATCH_WIDTH];
+	packRow(pGesture, query);
+	batchDist2(query, m_rows.data(), m_stride, m_patterns.size(), out.data());
+}
+
+size_t GestureBatch::count(const std::vector<float> &dists, double limit2) const{
+	size_t c = 0;
+	for( const auto& d: dists ){
+		if( d < limit2 ) ++c;
+	}
+	return c;
+}
+
+void GestureBatch::nearest(const std::vector<float> &dists, size_t k,
+		std::vector<GestureIndex::Neighbour> &out) const{
+	out.clear();
+	if( k == 0 ) return;
+	out.reserve(k);
+
+	// Max heap of the k best matches
+	for( size_t i=0; i<dists.size(); ++i){
+		if( out.size() < k ){
+			GestureIndex::Neighbour nb = { m_patterns[i], dists[i] };
+			out.push_back(nb);
+			std::push_heap(out.begin(), out.end(), neighbourCmp);
+		}else if( dists[i] < out.front().dist2 ){
+			std::pop_heap(out.begin(), out.end(), neighbourCmp);
+			out.back().gesture = m_patterns[i];
+			out.back().dist2 = dists[i];
+			std::push_heap(out.begin(), out.end(), neighbourCmp);
+		}
+	}
+	std::sort_heap(out.begin(), out.end(), neighbourCmp);
+}
+
 void addGestureTestPattern(GestureStore &gestureStore){
 	size_t n = 30;
 	double xy[2*n];
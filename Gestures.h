@@ -31,18 +31,16 @@
  */
 
 #include <cmath>
+#include <cfloat>
 #include <vector>
 #include <map>
 #include <deque>
 #include <cstring>
+#include <atomic>
+#include <mutex>
 //#include <string>
 
-#include <gsl/gsl_blas.h>
-#include <gsl/gsl_bspline.h>
-#include <gsl/gsl_multifit.h>
-#include <gsl/gsl_statistics.h>
-
-#include "gsl_helper.h"
+#include "BSplineFit.h"
 
 #include "Blob.h"
 #include "Tracker.h"
@@ -91,24 +89,6 @@ struct fpoint2 {
 #define NCOEFFS_FUNC(n) (std::max(NCOEFFS_MIN,std::min((int)(n/4),NCOEFFS_MAX-1)))
 //#define NBREAK   (NCOEFFS + 2 - SPLINE_DEG) //Should be at least 2
 
-/*
- * Uncomment ROBUST_FIT to gsl_multifit_robust_est() for approximation.
- * Otherwise, gsl_multifit_linear_est() will be used.
- * Robust version does not work. The algorithm is probably misunderstand by the author...
- */
-//#define ROBUST_FIT
-
-/* Uniform grid on [0,1] with NUM_EVALUATION_POINTS. (Currently) all further 
- * evaluatationn base on values of this positions.
- */
-static gsl_vector *EvalGrid;
-/* Store basis function values for EvalGrid */
-static gsl_matrix *EvalGridBasis[NCOEFFS_MAX-NCOEFFS_MIN]; 
-
-/* Flag to indicate if the spline estimation should be saved in 
- * the gesture objects or a global variable */
-#define STORE_IN_MEMBER_VARIABLE
-
 /* Number of nodes which are used for the mean value of start and
  * end of a gesture. */
 #define NUM_END_NODES 3
@@ -131,147 +111,85 @@ static const size_t CompareDistances[] = {
 	(NUM_EVALUATION_POINTS/3),
 };
 
-/* Basisfunction on all knots of the FullGrid
- */
-static gsl_matrix *FullBasis[NCOEFFS_MAX-NCOEFFS_MIN]; 
-static gsl_vector *Global_c[NCOEFFS_MAX-NCOEFFS_MIN][DIM];
-static gsl_matrix *Global_cov[NCOEFFS_MAX-NCOEFFS_MIN][DIM];
-
-static gsl_bspline_workspace *bw[NCOEFFS_MAX-NCOEFFS_MIN];
-#ifdef ROBUST_FIT
-static gsl_multifit_robust_workspace *rw = NULL;//more stable agains outliners
-#else
-static gsl_multifit_linear_workspace *mw = NULL;
-#endif
-
-static size_t gestureIdCounter = 0;
+/* Number of evaluated values of the invariance function for each level. */
+#define CURVE_POINT_DISTANCES_LEN(level) (NUM_EVALUATION_POINTS-CompareDistances[level])
 
-static void initStaticGestureVariables(){
-	size_t i,j, ncoeffs;
+/* Shared state of the gesture recognition. The basis tables will be
+ * evaluated in the constructor and are immutable afterwards, thus
+ * one engine can be used by several threads at once. All scratch
+ * memory of the Gesture construction is on the stack of the calling
+ * thread. For comparisons, see GestureCompareWorkspace.
+ */
+class GestureEngine{
+	public:
+		GestureEngine();
 
-#ifdef ROBUST_FIT
-	rw = gsl_multifit_robust_alloc(gsl_multifit_robust_default, MAX_DURATION_STEPS, NCOEFFS_MAX-1);
-#else
-	mw = gsl_multifit_linear_alloc(MAX_DURATION_STEPS, NCOEFFS_MAX-1);
-#endif
+		/* Default engine of the Gesture constructors. Created on first use. */
+		static const GestureEngine &shared();
 
-	/* Evaluate the basisvalues for MAX_DURATION_STEPS points in [0,1] and different
-	 * values of ncoeffs. */
-	for ( i=0, ncoeffs = NCOEFFS_MIN; ncoeffs < NCOEFFS_MAX; ++ncoeffs, ++i ){
-		size_t nbreak = ncoeffs + 2 - SPLINE_DEG;
-		bw[i] = gsl_bspline_alloc(SPLINE_DEG, nbreak);
-		gsl_bspline_knots_uniform(0.0, 1.0, bw[i]);
-
-		FullBasis[i] = gsl_matrix_alloc(MAX_DURATION_STEPS, ncoeffs);
-		//gsl_vector *tmpB = gsl_vector_alloc(ncoeffs);
-		double step = 1.0/(MAX_DURATION_STEPS-1);
-		double t = 0;
-		for (j = 0; j < MAX_DURATION_STEPS; ++j, t+=step )
-		{
-			//gsl_bspline_eval(t, tmpB, bw[i]);
-			//gsl_matrix_set_row( FullBasis[i], j, tmpB);
-			gsl_vector_view subrow = gsl_matrix_subrow( FullBasis[i], j, 0, ncoeffs);
-			gsl_bspline_eval(t, &subrow.vector, bw[i]);
-		}
-		//gsl_vector_free(tmpB);
+		/* Basisfunction on all knots of the FullGrid for nc coefficients.
+		 * Row j contains the values at t=j/(MAX_DURATION_STEPS-1) with
+		 * stride NCOEFFS_MAX.
+		 */
+		const double *fullBasis(size_t ncoeffs) const;
 
-	}
+		/* Unique id for new gestures. */
+		size_t nextGestureId() const;
 
-	//Extract grid. (The bspline knots array is slightly bigger at both ends...)
-	//FullGrid = gsl_vector_alloc(NBREAK);//NBREAK + 2*(SPLINE_DEG-1)
-	//gsl_vector_const_view _grid = gsl_vector_const_subvector (bw->knots, SPLINE_DEG-1, NBREAK);
-	//gsl_blas_dcopy(&_grid.vector,FullGrid);
+	private:
+		double m_fullBasis[NCOEFFS_MAX-NCOEFFS_MIN][MAX_DURATION_STEPS*NCOEFFS_MAX];
+		mutable std::atomic<size_t> m_gestureIdCounter;
 
-	for ( i=0, ncoeffs = NCOEFFS_MIN; ncoeffs < NCOEFFS_MAX; ++ncoeffs, ++i ){
-		for ( j=0; j<DIM; ++j ){
-			Global_c[i][j] = gsl_vector_alloc(ncoeffs);
-			Global_cov[i][j] = gsl_matrix_alloc(ncoeffs, ncoeffs);
-		}
-	}
-
-	// Eval values of basis function for evaluation points
-	EvalGrid = gsl_vector_alloc(NUM_EVALUATION_POINTS);
-	for ( i=0, ncoeffs = NCOEFFS_MIN; ncoeffs < NCOEFFS_MAX; ++ncoeffs, ++i ){
-		EvalGridBasis[i] = gsl_matrix_alloc(NUM_EVALUATION_POINTS, ncoeffs);
-		double step = 1.0/(NUM_EVALUATION_POINTS-1);
-		double t = 0.0;
-		for (j = 0; j < NUM_EVALUATION_POINTS; ++j, t+=step )
-		{
-			if( t>1.0 ) t -= 1E-10; //Omit leaving of interval due rounding errors.
-			gsl_vector_set(EvalGrid, j, t);
-			gsl_vector_view subrow = gsl_matrix_subrow( EvalGridBasis[i], j, 0, ncoeffs);
-			gsl_bspline_eval(t, &subrow.vector, bw[i]);
-		}
-	}
-}
-
-static void uninitStaticGestureVariables(){
-	//gsl_vector_free(FullGrid);
-
-	size_t i,j;
-	for(i = 0;  i < NCOEFFS_MAX - NCOEFFS_MAX; ++i){
-		gsl_bspline_free(bw[i]);
-		bw[i] = NULL;
-		gsl_matrix_free(FullBasis[i]);
-		FullBasis[i] = NULL;
-	}
-
-#ifdef ROBUST_FIT
-	if( rw != NULL ){
-		gsl_multifit_robust_free(rw); rw = NULL;
-		gsl_multifit_robust_realloc(rw, MAX_DURATION_STEPS, NCOEFFS_MAX-1);
-	}
-#else
-	if( mw != NULL ){
-		/* reset internal mw vector/matrix values to original values
-		 * (just to be on the save side on following freeing) */
-		gsl_multifit_linear_realloc(mw, MAX_DURATION_STEPS, NCOEFFS_MAX-1);
-		gsl_multifit_linear_free(mw); mw = NULL;
-	}
-#endif
+		GestureEngine(const GestureEngine&);
+		GestureEngine &operator=(const GestureEngine&);
+};
 
-	for(i = 0;  i < NCOEFFS_MAX - NCOEFFS_MAX; ++i){
-		for ( j=0; j<DIM; ++j ){
-			gsl_vector_free(Global_c[i][j]);
-			gsl_matrix_free(Global_cov[i][j]);
-		}
-	}
+/* Nodes of an active track, see GestureRecognizer. The nodes will
+ * be appended for each frame, thus the history of the tracker will
+ * only be read once. Gesture(const GestureTrack &track) fits the
+ * current nodes like Gesture( cBlob &blob, const Tracker &tracker ).
+ */
+class GestureTrack{
+	public:
+		GestureTrack(int startFrame, const GestureEngine &engine = GestureEngine::shared());
 
-	//Evaluation grid points/basis.
-	for(i = 0;  i < NCOEFFS_MAX - NCOEFFS_MAX; ++i){
-		gsl_matrix_free(EvalGridBasis[i]);
-	}
-	gsl_vector_free(EvalGrid);
-}
+		/* Returns false if the node is not newer than the last node.
+		 * Nodes which are MAX_DURATION_STEPS or more frames older than
+		 * the new node will be dropped (sliding window). */
+		bool addNode(int frame, double x, double y);
+		size_t size() const;
+		int getStartFrame() const;
 
+	private:
+		friend class Gesture;
+		const GestureEngine *m_engine;
+		int m_startFrame;
+		size_t m_n;
+		double m_raw_values[DIM][MAX_DURATION_STEPS];
+		unsigned short m_timeSteps[MAX_DURATION_STEPS]; // Frames since m_startFrame
+};
 
 class Gesture{
 	private:
-		gsl_vector *m_raw_values[DIM]; //input data
+		/* Input data. The time step of each node is the row of GestureEngine::fullBasis. */
+		double m_raw_values[DIM][MAX_DURATION_STEPS];
+		unsigned short m_timeSteps[MAX_DURATION_STEPS];
 		//matching dimensions for raw_values
 		size_t m_n;
 		size_t m_ncoeffs;
 		size_t m_nbreak;
 		double m_time_max;
-		// Subset of Grid and FullBasis.
-		//gsl_vector *m_grid;
-		gsl_matrix *m_ReducedBasis;
-		gsl_vector *m_debugDurationGrid;
+		const GestureEngine *m_engine;
 
 		char *m_gestureName;
 		size_t m_gestureId;
 
-#ifdef STORE_IN_MEMBER_VARIABLE
-		gsl_vector *m_c[DIM];
-		gsl_matrix *m_cov[DIM];
-#endif
-
+		double m_c[DIM][NCOEFFS_MAX];
 
 		/* Stores the result of evalSpline */
-		gsl_vector *m_splineCurve[DIM];
+		double m_splineCurve[DIM][NUM_EVALUATION_POINTS];
+		bool m_splineEvaluated;
 
-		//gsl_bspline_workspace *m_bw;
-	
 		/* Derive spline coefficients and all metadata.
 		 * Called in all Constructors. */
 		void construct();
@@ -279,21 +197,32 @@ class Gesture{
 	public:
 		fpoint2 m_orientationTriangle[3];
 
-		/* Stores result of evalDistances() */
-		//gsl_vector *m_curvePointDistances;
-		gsl_vector **m_curvePointDistances;
+		/* Stores result of evalDistances(). Level i contains
+		 * CURVE_POINT_DISTANCES_LEN(i) values. */
+		double m_curvePointDistances[CompareDistancesNum][NUM_EVALUATION_POINTS];
 
 
-		Gesture( cBlob &blob,
+		/* Spline of the track of blob. The positions will be read from
+		 * the history of the tracker (see Tracker::getHistory).
+		 * The construction is thread safe as long as the tracker
+		 * is not modified. */
+		Gesture( cBlob &blob, const Tracker &tracker,
 				size_t skipped_begin_nodes = DEFAULT_SKIPPED_BEGIN_NODES,
-				size_t skipped_end_nodes = DEFAULT_SKIPPED_END_NODES );
+				size_t skipped_end_nodes = DEFAULT_SKIPPED_END_NODES,
+				const GestureEngine &engine = GestureEngine::shared() );
 		/* reversedTime flip's the order of the input values.
 		 * Note that the history/values of the tracker 
 		 * are ordered als
 		 * [actual value, previous value, ...., oldes value ]
 		 */
-		Gesture(int *inTimestamp, double *inX, double *inY, size_t xy_Len, size_t stride = 1, bool reversedTime = true );
-		Gesture(int *inTimestamp, double *inXY, size_t xy_Len, bool reversedTime = true );
+		Gesture(int *inTimestamp, double *inX, double *inY, size_t xy_Len, size_t stride = 1, bool reversedTime = true,
+				const GestureEngine &engine = GestureEngine::shared() );
+		Gesture(int *inTimestamp, double *inXY, size_t xy_Len, bool reversedTime = true,
+				const GestureEngine &engine = GestureEngine::shared() );
+		/* Current nodes of an active track. */
+		Gesture(const GestureTrack &track);
+		/* The oldest nodes of gesture, i.e. the gesture while it was drawn. */
+		Gesture(const Gesture &gesture, size_t nodes);
 		~Gesture();
 
 		size_t getNumberOfRawSupportNodes() const;
@@ -313,8 +242,8 @@ class Gesture{
 
 		void printDistances() const{
 
-			double *out = m_curvePointDistances[0]->data;
-			for( int i=0; i<NUM_EVALUATION_POINTS-CompareDistances[0]; ++i){
+			const double *out = m_curvePointDistances[0];
+			for( int i=0; i<CURVE_POINT_DISTANCES_LEN(0); ++i){
 				printf("%d %f\n", i, *out++);
 			}
 		}
@@ -334,6 +263,96 @@ class GestureDistance{
 
 
 
+/* Vantage point tree over the first level of the invariance functions
+ * (m_curvePointDistances[0]) of the patterns. The square root of
+ * quadratureSquared is a metric, thus the triangle inequality
+ *   |dist(Q,V) - dist(V,P)| <= dist(Q,P)
+ * cuts off whole subtrees for a query Q. The distances between each vantage
+ * point V and the patterns P of its subtrees are evaluated by build() and
+ * stored as [min, max] range for both children.
+ *
+ * Patterns without support nodes will be ignored.
+ * The queries are const. The distances to the vantage points will be
+ * cached in the (per query) array 'cache', which allows multiple queries
+ * for the same gesture. Clear it before the queries of another gesture.
+ */
+class GestureIndex{
+	public:
+		struct Neighbour{
+			const Gesture *gesture;
+			double dist2; // Squared distance, like GestureDistance::m_L2NormSquared[0]
+		};
+
+		GestureIndex();
+		void build(const std::vector<Gesture*> &gestures);
+		void clear();
+		/* Number of indexed patterns. */
+		size_t size() const;
+
+		/* k nearest patterns of pGesture, sorted by distance. */
+		void nearest(const Gesture *pGesture, size_t k,
+				std::vector<Neighbour> &out, std::vector<double> &cache) const;
+		/* Number of patterns with dist2 < limit2. */
+		size_t count(const Gesture *pGesture, double limit2,
+				std::vector<double> &cache) const;
+
+	private:
+		struct Node{
+			const Gesture *vp; // vantage point
+			double mu; // Patterns with dist < mu are stored in the inner subtree.
+			double range[2][2]; // [min,max] distance of inner and outer subtree to vp.
+			int child[2]; // inner, outer. -1 for empty subtrees.
+		};
+		std::vector<Node> m_nodes;
+
+		int buildNode(std::vector<std::pair<double, const Gesture*> > &items,
+				size_t begin, size_t end);
+		void searchNearest(int node, const Gesture *pGesture, size_t k,
+				std::vector<Neighbour> &heap, std::vector<double> &cache) const;
+		size_t searchCount(int node, const Gesture *pGesture, double limit2,
+				double limit, std::vector<double> &cache) const;
+		double vpDist2(int node, const Gesture *pGesture, std::vector<double> &cache) const;
+};
+
+/* Signatures of all patterns for one level as float matrix (pattern-major).
+ * Each row is padded with zeros to a multiple of GESTURE_BATCH_WIDTH.
+ * The trapezoid weights of quadratureSquared are folded into the
+ * values (sqrt(1/2) at both ends), thus the distance of the query to all
+ * patterns is a single streaming pass with NEON (ARM) or SSE2 (x86).
+ *
+ * The distances are approximations of GestureDistance::evalL2Dist
+ * (float instead of double).
+ */
+#define GESTURE_BATCH_WIDTH 4
+/* Up to this number of patterns the first level will be compared with
+ * GestureBatch. The GestureIndex will be used for bigger stores. */
+#define GESTURE_BATCH_MAX_PATTERNS 512
+class GestureBatch{
+	public:
+		GestureBatch();
+		/* Patterns without support nodes will be ignored. */
+		void build(const std::vector<Gesture*> &gestures, size_t level);
+		/* Number of patterns. */
+		size_t size() const;
+
+		/* Squared distances of pGesture to all patterns. */
+		void distances(const Gesture *pGesture, std::vector<float> &out) const;
+		/* k nearest patterns for the output of distances(), sorted by distance. */
+		void nearest(const std::vector<float> &dists, size_t k,
+				std::vector<GestureIndex::Neighbour> &out) const;
+		/* Number of patterns with dist2 < limit2. */
+		size_t count(const std::vector<float> &dists, double limit2) const;
+
+	private:
+		size_t m_level;
+		size_t m_stride; // padded row length
+		std::vector<float> m_rows;
+		std::vector<const Gesture*> m_patterns;
+
+		/* Row of a signature with folded weights. */
+		void packRow(const Gesture *pGesture, float *row) const;
+};
+
 /* Store the result for gesture analyse. */
 struct GesturePatternCompareResult{
 	float minDist; 
@@ -342,22 +361,125 @@ struct GesturePatternCompareResult{
 	//std::map<Gesture*, float[> d
 };
 
+/* Scratch memory of GestureStore::compateWithPatterns. Use one
+ * workspace per thread to avoid allocations on each comparison. */
+struct GestureCompareWorkspace{
+	std::vector<GestureIndex::Neighbour> nearest;
+	std::vector<double> cache; //distances to the vantage points
+	std::vector<float> dists; //distances of GestureBatch
+	std::vector<GestureDistance> distObjects; 
+	std::vector<GestureDistance*> distPointers;
+	bool verbose = true; // Print the ranking of each comparison
+};
+
+/* Comparisons are thread safe, but the patterns should not be
+ * changed (addPattern, getPatterns) during comparisons. */
 class GestureStore{
 	private:
-		/* Use pointers because Gesture objects contains many memory allocations (gsv_vector_*, etc.) */
+		/* Use pointers because Gesture objects are big (fixed size arrays)
+		 * and the index and GestureRecognizer refer to the patterns by address. */
 			std::vector<Gesture*> gestures;
+			/* Index over the patterns. It will be rebuild on the next comparison
+			 * if the patterns were changed (addPattern, getPatterns). */
+			GestureBatch m_batch;
+			GestureIndex m_index;
+			bool m_indexDirty;
+			std::mutex m_indexMutex;
 
 	public:
 			GestureStore();
 			~GestureStore();
 			/* All patters will be deleted in the destructor. */
 			void addPattern(Gesture *pGesture);
+			/* Non-const access, thus the index will be rebuild. */
 			std::vector<Gesture*> & getPatterns();
+			/* Read-only access, the index stays valid. */
+			const std::vector<Gesture*> & getPatterns() const;
+
+			/* workspace: Scratch memory of the calling thread. Use NULL for temporary memory. */
+			void compateWithPatterns(Gesture *pGesture, GesturePatternCompareResult &gpcr,
+					GestureCompareWorkspace *workspace = NULL );
+
+};
 
-			void compateWithPatterns(Gesture *pGesture, GesturePatternCompareResult &gpcr );
 
+/* Provisional result of GestureRecognizer for an active track. */
+struct GestureProvisionalMatch{
+	unsigned int blobId; // cBlob::id of the track
+	const Gesture *pattern; // best pattern of the store
+	float dist; // like GesturePatternCompareResult::minDist
+	float confidence; // 1 - dist/(dist of the best other pattern), in [0,1]
+	size_t nodes; // length of the prefix
 };
 
+/* Default thresholds of GestureRecognizer */
+#define GESTURE_ONLINE_MIN_NODES 15
+#define GESTURE_ONLINE_MAX_DIST 0.08f
+#define GESTURE_ONLINE_MIN_CONFIDENCE 0.5f
+#define GESTURE_ONLINE_STABLE_FRAMES 5
+/* Number of prefixes of each pattern (1/n, 2/n, …, n/n of the nodes). */
+#define GESTURE_ONLINE_PREFIXES 10
+
+/* Online recognition of the active tracks before the tracker marks them
+ * as finished (TRACK_UP). Call update() once per frame with the blobs of
+ * getFilteredBlobs(TRACK_ALL_ACTIVE, …). Each track gets a GestureTrack,
+ * which starts with the history of the blob and holds the nodes of the
+ * last MAX_DURATION_STEPS frames. The track of a missing (pending) blob
+ * will be kept until the tracker would mark the blob as BLOB_UP, thus a
+ * returning blob continues its track. Blobs with BLOB_UP will be removed
+ * immediately.
+ *
+ * The track will be compared with the prefixes of the patterns, because
+ * an unfinished gesture looks different to the whole pattern. The
+ * prefixes will be created on the first update(). Call
+ * patternsChanged() if the patterns of the store were changed later.
+ *
+ * A match will be emitted if the prefix has at least minNodes nodes, the
+ * best pattern is below maxDist for stableFrames frames and its confidence
+ * is at least minConfidence. Each track emits a pattern once (until it
+ * changes). The final result should still be evaluated on TRACK_UP.
+ */
+class GestureRecognizer{
+	public:
+		GestureRecognizer(const GestureStore &store, const GestureEngine &engine = GestureEngine::shared());
+		~GestureRecognizer();
+
+		void setThresholds(size_t minNodes, float maxDist, float minConfidence, size_t stableFrames);
+		void patternsChanged();
+
+		/* New matches will be appended to out. */
+		void update(const Tracker &tracker, const std::vector<cBlob> &blobs,
+				std::vector<GestureProvisionalMatch> &out);
+
+	private:
+		struct TrackState{
+			GestureTrack track;
+			const Gesture *candidate; // best pattern of the last frames
+			size_t stableFrames; // number of frames with this candidate
+			const Gesture *lastMatch; // last emitted pattern
+			int lastFrame;
+			TrackState(int startFrame, const GestureEngine &engine):
+				track(startFrame, engine), candidate(NULL), stableFrames(0),
+				lastMatch(NULL), lastFrame(startFrame){}
+		};
+
+		const GestureStore &m_store;
+		const GestureEngine &m_engine;
+		GestureStore *m_prefixes;
+		std::map<const Gesture*, const Gesture*> m_patternOf; // prefix => pattern
+		GestureCompareWorkspace m_workspace;
+		std::map<unsigned int, TrackState*> m_tracks;
+		size_t m_minNodes;
+		float m_maxDist;
+		float m_minConfidence;
+		size_t m_stableFrames;
+
+		void buildPrefixes();
+		void compare(TrackState *state, const cBlob &blob, std::vector<GestureProvisionalMatch> &out);
+
+		GestureRecognizer(const GestureRecognizer&);
+		GestureRecognizer &operator=(const GestureRecognizer&);
+};
 
 /* Create test gesture by function and store it. */
 void addGestureTestPattern(GestureStore &gestureStore);
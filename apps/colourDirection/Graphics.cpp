@@ -174,7 +174,7 @@ void RedrawTextures()
 	DrawTextureRect(&imvTexture,0.4, 1.0f,-1.0f,-1.0f,1.0f,NULL);
 
 	blobCache.clear();
-	tracker.getFilteredBlobs(TRACK_ALL_ACTIVE|LIMIT_ON_N_OLDEST, blobCache);
+	tracker.getFilteredBlobs(TRACK_ALL_ACTIVE|LIMIT_ON_N_OLDEST, blobCache, &tracker.acquireSnapshot().blobs);
 	tracker.drawBlobsGL(motion_data.width, motion_data.height, true, &blobCache);
 	//tracker.drawBlobsGL(motion_data.width, motion_data.height);
 
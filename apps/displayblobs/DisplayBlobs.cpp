@@ -11,7 +11,7 @@
 #include "Tracker2.h"
 #include "TrackerDrawingOpenCV.h"
 
-#ifdef WITH_GSL
+#ifdef WITH_GESTURES
 #include "../../Gestures.h"
 #endif
 
@@ -88,6 +88,7 @@ static bool display_bounding_boxes = true;
 static int algorithm = 1;
 static int gridwidth = 1;
 static int gridheight = gridwidth;
+static int num_threads = 1; // >1 enables strip-parallel threshtree
 static int of_area_min = 40;
 static int of_area_max = 40;
 static int of_tree_depth_min = 1;
@@ -111,9 +112,11 @@ static Blobtree *frameblobs = NULL;
 
 static Tracker2 tracker;
 
-#ifdef WITH_GSL
+#ifdef WITH_GESTURES
 static GestureStore gestureStore;
 static std::vector<Gesture*> gestures = std::vector<Gesture*>();
+static GestureRecognizer gestureRecognizer(gestureStore);
+static std::vector<GestureProvisionalMatch> provisionalMatches;
 #endif
 
 /* Init id array:
@@ -301,15 +304,22 @@ int detection_loop(std::string filename ){
 	tracker.setMaxRadius( max((H+W)/10,7) );
 	tracker.trackBlobs( frameblobs, true );
 
-#ifdef WITH_GSL
+#ifdef WITH_GESTURES
 	/* Gesture analyser for tracking output */
 	blobCache.clear();
 
+	//Provisional results of all active blobs.
+	tracker.getFilteredBlobs(TRACK_ALL_ACTIVE, blobCache);
+	provisionalMatches.clear();
+	gestureRecognizer.update(tracker, blobCache, provisionalMatches);
+	for( const auto& m: provisionalMatches ){
+		printf("Gesture %u probably %s (confidence %.2f, %zu nodes)\n",
+				m.blobId, m.pattern->getGestureName(), m.confidence, m.nodes);
+	}
+
 	//Get blobs which are marked as 'finished'.
-	//Minimize computatation but increase detection delay.
+	blobCache.clear();
 	tracker.getFilteredBlobs(TRACK_UP, blobCache);
-	//Alternative: Fetch all active blobs
-	//tracker.getFilteredBlobs(TRACK_ALL_ACTIVE, blobCache);
 
 	// Clear shown gesture splines of previous frame
 	gestures.clear();
@@ -321,7 +331,7 @@ int detection_loop(std::string filename ){
 		if( (*it).duration < 10 ) continue; 
 
 		// Convert list of coordinates into spline approximation
-		Gesture *gest = new Gesture( (*it) );
+		Gesture *gest = new Gesture( (*it), tracker );
 		//gest->evalSplineCoefficients();
 		
 		// This objects stores some metadata/results.
@@ -382,9 +392,9 @@ int fpsTest(std::string filename ){
 	while( ++N<100000 ){
 		//printf("N = %i\n", N);
 		if( algorithm == 0 ){
-			threshtree_find_blobs(frameblobs, ptr, W, H, input_roi, thresh, tworkspace);
+			threshtree_find_blobs_parallel(frameblobs, ptr, W, H, input_roi, thresh, num_threads, tworkspace);
 		}else{
-			depthtree_find_blobs(frameblobs, ptr, W, H, input_roi, depth_map, dworkspace);
+			depthtree_find_blobs_parallel(frameblobs, ptr, W, H, input_roi, depth_map, num_threads, dworkspace);
 		}
 
 		//Update Tracker
@@ -565,7 +575,7 @@ static void redraw(){
 
 	}
 
-#ifdef WITH_GSL
+#ifdef WITH_GESTURES
 	std::vector<Gesture*> gestures2 = gestureStore.getPatterns();
 
 	std::vector<Gesture*>::iterator it = gestures2.begin();
@@ -658,7 +668,7 @@ int main(int argc, char** argv )
 	//Input handling
 	if ( argc < 2 )
 	{
-		printf("usage: DisplayImage.out [Number of algorithm] [image path] [thresh] [grid width]\n"
+		printf("usage: DisplayImage.out [Number of algorithm] [image path] [thresh] [grid width] [grid height] [threads]\n"
 				"Available Algorithms:\n"
 				"0 - Thresh value split image in 'black' and 'white' areas. The areas\n"
 				"    can be nested.\n"
@@ -690,6 +700,10 @@ int main(int argc, char** argv )
 		gridheight = atoi(argv[5]);
 	}
 
+	if ( argc >= 7){
+		num_threads = atoi(argv[6]);
+	}
+
 
 //Just test speed
 	bool fpsTesting = (argc>=6);
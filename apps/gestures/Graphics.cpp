@@ -18,6 +18,7 @@
 #include "DrawingFunctions.h"
 
 #include "Tracker2.h"
+#include "profiler.h"
 #include "TrackerDrawingOpenGL.h"
 extern Tracker2 tracker;
 
@@ -214,15 +215,17 @@ void RedrawGui()
  */
 void RedrawTextures()
 {
+	PROFILE_BEGIN(PROFILER_GL);
 
 	imvTexture.setPixels(motion_data.imv_norm);
 	//DrawTextureRect(&imvTexture,0.4, 1.0f,-1.0f,-1.0f,1.0f,NULL);
 
 	blobCache.clear();
-	tracker.getFilteredBlobs(TRACK_ALL_ACTIVE|LIMIT_ON_N_OLDEST, blobCache);
+	tracker.getFilteredBlobs(TRACK_ALL_ACTIVE|LIMIT_ON_N_OLDEST, blobCache, &tracker.acquireSnapshot().blobs);
 	//tracker.getFilteredBlobs(TRACK_UP|LIMIT_ON_N_OLDEST, blobCache);
 	tracker_drawBlobsGL(tracker, motion_data.width, motion_data.height, true, &blobCache);
 	check();
+	PROFILE_END(PROFILER_GL);
 
 #if 0
 	static int savecounter=0;
@@ -7,6 +7,7 @@
 #include "depthtree.h"
 #include "Tracker2.h"
 #include "Graphics.h"
+#include "profiler.h"
 
 #include "FontManager.h"
 #include "Gestures.h"
@@ -16,12 +17,16 @@ static DepthtreeWorkspace *dworkspace = NULL;
 static Blobtree *frameblobs = NULL;
 Tracker2 tracker;
 unsigned char depth_map[256];
+static unsigned char imv_map[DEPTHTREE_IMV_MAP_LEN]; // depth of the raw vectors
 pthread_t blob_tid;
 
 FontManager fontManager;
 static std::vector<cBlob> blobCache; //for gestures
 
 static GestureStore gestureStore;
+static GestureCompareWorkspace gestureWorkspace; // scratch of the blob thread
+static GestureRecognizer gestureRecognizer(gestureStore); // unfinished gestures
+static std::vector<GestureProvisionalMatch> provisionalMatches;
 std::vector<Gesture*> gestures = std::vector<Gesture*>();
 static const vec2 gest_pen_headline = {0,160};
 static vec2 gest_pen = {0,0};
@@ -41,61 +46,59 @@ void setup_fonts(FontManager *fontManager){
 	fontManager->add_text( font1, L"Last Gestures: α", &gest_color, &pen );
 }
 
-static void eval_ids(DepthtreeWorkspace *dworkspace, unsigned char *out, int len ){
-	unsigned int *ids, *cm, *cs;
-	ids = dworkspace->ids;
-	cm = dworkspace->comp_same;
-	cs = dworkspace->comp_size;
-	while(--len){
-		if( *(cs + *ids) > 8 ){
-			*out = *(cm + *ids);
-		}else{
-			*out = 1;
-		}
-		++out;++ids;
+//Append line to the list of last gestures.
+static void add_gesture_text(const char *text){
+	gest_pen.x = 0;
+	if( ++gest_pos > 3 ){
+		gest_pos = 0;	
+		fontManager.clear_text();
+		vec2 pen = {gest_pen_headline.x, gest_pen_headline.y};
+		fontManager.add_text( fontManager.getFonts()->at(0),
+				L"Last Gestures:", &gest_color, &pen );
 	}
+	gest_pen.y = gest_pen_headline.y - 80*(1+gest_pos);
+	fontManager.add_text( fontManager.getFonts()->at(0),
+			text, &gest_color, &gest_pen );
 }
 
 void* blob_detection(void *argn){
 
       while (1){
-				if( motion_data.available ){
+				if( motion_data_wait(&motion_data, 100) ){
 
-					//swap pointers if possible
-					while(motion_data.mutex){
-						usleep(1000);
-					}
-					motion_data.mutex = 1;
-					char *tmp = motion_data.imv_array_in;
-					motion_data.imv_array_in = motion_data.imv_array_buffer;
-					motion_data.imv_array_buffer = tmp;
-					motion_data.available = 0;
-					motion_data.mutex = 0;
-
-					//1. Convert imv vector to norm.
-					//Note: Some uness. operations if gridwidth>1.
-					//imv_eval_norm(&motion_data);
-					imv_eval_norm2(&motion_data);
-
-					//1.5 (optional) OpenGl Output
-					if( false ){
-						/* Problem: This texture update is outside
-						 * of the gl context thread and will be
-						 * ignored. Solution?!"
-						 * */
-						imvTexture.setPixels(motion_data.imv_norm);
-					}
+					PROFILE_BEGIN(PROFILER_FRAME);
 
-					//2. Blob detection
+					//1.+2. Blob detection on the raw vectors. The norm will be
+					//evaluated by imv_map for the grid pixels only.
 					BlobtreeRect input_roi = {0,0, motion_data.width, motion_data.height - 0 }; // Noise in lowest row removed by raspivid update. Shrinking of height not ness anymore 
-					depthtree_find_blobs(frameblobs, motion_data.imv_norm,
+					PROFILE_BEGIN(PROFILER_BLOBS);
+					depthtree_find_blobs_imv(frameblobs, motion_data.imv_array_buffer,
 							motion_data.width, motion_data.height,
-							input_roi, depth_map, dworkspace);
+							input_roi, imv_map, NULL, dworkspace);
+					PROFILE_END(PROFILER_BLOBS);
 
 					//3. Tracker
+					PROFILE_BEGIN(PROFILER_TRACKER);
 					tracker.trackBlobs( frameblobs, true );
+					PROFILE_END(PROFILER_TRACKER);
 
 					//3.5 Gestures
+					PROFILE_BEGIN(PROFILER_GESTURES);
+
+					//Provisional results for the unfinished gestures
+					blobCache.clear();
+					tracker.getFilteredBlobs(TRACK_ALL_ACTIVE, blobCache);
+					provisionalMatches.clear();
+					gestureRecognizer.update(tracker, blobCache, provisionalMatches);
+					for( const auto& m: provisionalMatches ){
+						printf("Gesture %u probably %s (confidence %.2f, %zu nodes)\n",
+								m.blobId, m.pattern->getGestureName(), m.confidence, m.nodes);
+						char tmpText[100];
+						snprintf(tmpText, 100, "%s?  %u", m.pattern->getGestureName(), m.blobId);
+						add_gesture_text(tmpText);
+					}
+
+					//Final results
 					blobCache.clear();
 					tracker.getFilteredBlobs(TRACK_UP|LIMIT_ON_N_OLDEST, blobCache);
 					//tracker.getFilteredBlobs(TRACK_UP, blobCache);
@@ -129,30 +132,19 @@ void* blob_detection(void *argn){
 						printf("===\n");
 
 						// Convert list of coordinates into spline approximation
-						Gesture *gest = new Gesture( (*it), 0, 0 );
+						Gesture *gest = new Gesture( (*it), tracker, 0, 0 );
 
 						// This objects stores some metadata/results.
 						GesturePatternCompareResult res;
-						gestureStore.compateWithPatterns(gest, res);
+						gestureStore.compateWithPatterns(gest, res, &gestureWorkspace);
 						if( res.minGest != NULL && res.minDist < 0.08 ){
 							printf("Gesture similar to %s\n", res.minGest->getGestureName() );
 							gestures.emplace_back(gest);
 
 							// Draw gesture name
-							gest_pen.x = 0;
-							if( ++gest_pos > 3 ){
-								gest_pos = 0;	
-								fontManager.clear_text();
-								vec2 pen = {gest_pen_headline.x, gest_pen_headline.y};
-								fontManager.add_text( fontManager.getFonts()->at(0),
-										L"Last Gestures:", &gest_color, &pen );
-							}
-							gest_pen.y = gest_pen_headline.y - 80*(1+gest_pos);
 							char tmpText[100];
 							snprintf(tmpText, 100, "%s   %i", res.minGest->getGestureName(), gest->getGestureId());
-							fontManager.add_text( fontManager.getFonts()->at(0),
-									tmpText /*res.minGest->getGestureName()*/,
-									&gest_color, &gest_pen );
+							add_gesture_text(tmpText);
 
 						}else{
 							//delete gest;
@@ -166,17 +158,21 @@ void* blob_detection(void *argn){
 						}
 					}
 
+					PROFILE_END(PROFILER_GESTURES);
+
 					//4. Opengl Output
 					// see gl_scenes/motion.c
 
-					// Debug: Replace imv_norm with ids, roi has to start in (0,0) and with full width.
-					//eval_ids(dworkspace, motion_data.imv_norm, input_roi.width* input_roi.height);
+					// Debug: Pass motion_data.imv_norm as id_image of
+					// depthtree_find_blobs_imv to display the ids.
 
+					PROFILE_END(PROFILER_FRAME);
+					PROFILE_NEXT_FRAME();
 
 				}else{
 					//printf("No new imv data\n");
 					//vcos_sleep(100);
-					usleep(100000);
+					// motion_data_wait already waited 100ms.
 				}
 			}
 }
@@ -238,6 +234,11 @@ int main(int argc, const char **argv){
 	for( int i=0; i<256; i++){
 		depth_map[i] = (i<7?0:i/4+1);
 	}
+	depthtree_create_imv_map(depth_map, 2, imv_map);
+	//Print timings of the blob detection stages, see profiler.h
+	profiler_init(stderr, 500,
+			getenv("PROFILER_JSON")?PROFILER_OUTPUT_JSON:PROFILER_OUTPUT_TEXT);
+
 	//Create thread for blob detection.
 	int err = pthread_create(&blob_tid, NULL, &blob_detection, NULL);
 	if (err != 0){
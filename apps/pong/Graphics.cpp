@@ -18,6 +18,7 @@
 #include "GraphicsPong.h"
 #include "DrawingFunctions.h"
 #include "Tracker2.h"
+#include "profiler.h"
 #include "TrackerDrawingOpenGL.h"
 extern Tracker2 tracker;
 
@@ -217,7 +218,7 @@ void InitTextures(uint32_t glWinWidth, uint32_t glWinHeight)
 void RedrawGui()
 {
 	blobCache.clear();
-	tracker.getFilteredBlobs(TRACK_ALL_ACTIVE, blobCache);
+	tracker.getFilteredBlobs(TRACK_ALL_ACTIVE, blobCache, &tracker.acquireSnapshot().blobs);
 	tracker_drawBlobsGL(tracker, motion_data.width, motion_data.height, false, &blobCache, &blobsTexture);
 
 	guiNeedRedraw = guiNeedRedraw || fontManager.render_required();
@@ -238,6 +239,7 @@ void RedrawGui()
  */
 void RedrawTextures()
 {
+	PROFILE_BEGIN(PROFILER_GL);
 
 	//imvTexture.setPixels(motion_data.imv_norm);
 	//DrawTextureRect(&imvTexture,-1.0,1.0f,-1.0f,-1.0f,1.0f,NULL);
@@ -266,6 +268,7 @@ void RedrawTextures()
 	// Draw pong ball
 	pong.drawBall();
 
+	PROFILE_END(PROFILER_GL);
 }
 
 void InitShaders()
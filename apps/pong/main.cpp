@@ -6,6 +6,7 @@
 #include "depthtree.h"
 #include "Tracker2.h"
 #include "Graphics.h"
+#include "profiler.h"
 
 #include "FontManager.h"
 
@@ -18,70 +19,41 @@ FontManager fontManager;
 //Pong pong(0.06, 800.0/600.0);
 Pong pong(0.06, 16.0/9);
 unsigned char depth_map[256];
+static unsigned char imv_map[DEPTHTREE_IMV_MAP_LEN]; // depth of the raw vectors
 pthread_t blob_tid;
 
-static void eval_ids(DepthtreeWorkspace *dworkspace, unsigned char *out, int len ){
-	unsigned int *ids, *cm, *cs;
-	ids = dworkspace->ids;
-	cm = dworkspace->comp_same;
-	cs = dworkspace->comp_size;
-	while(--len){
-		if( *(cs + *ids) > 8 ){
-			*out = *(cm + *ids);
-		}else{
-			*out = 1;
-		}
-		++out;++ids;
-	}
-}
-
 void* blob_detection(void *argn){
 
       while (1){
-				if( motion_data.available ){
-
-					//swap pointers if possible
-					while(motion_data.mutex){
-						usleep(1000);
-					}
-					motion_data.mutex = 1;
-					char *tmp = motion_data.imv_array_in;
-					motion_data.imv_array_in = motion_data.imv_array_buffer;
-					motion_data.imv_array_buffer = tmp;
-					motion_data.available = 0;
-					motion_data.mutex = 0;
-
-					//1. Convert imv vector to norm.
-					//Note: Some uness. operations if gridwidth>1.
-					imv_eval_norm2(&motion_data);
-
-					//1.5 (optional) OpenGl Output
-					if( false ){
-						/* Problem: This texture update is outside
-						 * of the gl context thread and will be
-						 * ignored. Solution?!"
-						 * */
-						imvTexture.setPixels(motion_data.imv_norm);
-					}
-
-					//2. Blob detection
+				if( motion_data_wait(&motion_data, 100) ){
+
+					PROFILE_BEGIN(PROFILER_FRAME);
+
+					//1.+2. Blob detection on the raw vectors. The norm will be
+					//evaluated by imv_map for the grid pixels only.
 					BlobtreeRect input_roi = {0,0, motion_data.width, motion_data.height - 0 }; // Noise in lowest row removed by raspivid update. Shrinking of height not ness anymore 
-					depthtree_find_blobs(frameblobs, motion_data.imv_norm,
+					PROFILE_BEGIN(PROFILER_BLOBS);
+					depthtree_find_blobs_imv(frameblobs, motion_data.imv_array_buffer,
 							motion_data.width, motion_data.height,
-							input_roi, depth_map, dworkspace);
+							input_roi, imv_map, NULL, dworkspace);
+					PROFILE_END(PROFILER_BLOBS);
 
 					//3. Tracker, track without history generation
+					PROFILE_BEGIN(PROFILER_TRACKER);
 					tracker.trackBlobs( frameblobs, false );
+					PROFILE_END(PROFILER_TRACKER);
 					
 					//4. Opengl Output
 
-					// Debug: Replace imv_norm with ids, roi has to start in (0,0) and with full width.
-					//eval_ids(dworkspace, motion_data.imv_norm, input_roi.width* input_roi.height);
+					// Debug: Pass motion_data.imv_norm as id_image of
+					// depthtree_find_blobs_imv to display the ids.
 
+					PROFILE_END(PROFILER_FRAME);
+					PROFILE_NEXT_FRAME();
 				}else{
 					//printf("No new imv data\n");
 					//vcos_sleep(100);
-					usleep(100000);
+					// motion_data_wait already waited 100ms.
 				}
 			}
 }
@@ -182,6 +154,11 @@ int main(int argc, const char **argv){
 				depth_map[i] = 100;
 		}
 	}
+	depthtree_create_imv_map(depth_map, 2, imv_map);
+	//Print timings of the blob detection stages, see profiler.h
+	profiler_init(stderr, 500,
+			getenv("PROFILER_JSON")?PROFILER_OUTPUT_JSON:PROFILER_OUTPUT_TEXT);
+
 	//Create thread for blob detection.
 	int err = pthread_create(&blob_tid, NULL, &blob_detection, NULL);
 	if (err != 0){
@@ -18,13 +18,14 @@
 #include "DrawingFunctions.h"
 
 #include "Tracker2.h"
+#include "profiler.h"
 extern Tracker2 tracker;
 
 #define check() assert(glGetError() == 0)
 
 // Header for drawing function. Definition in libs/tracker/DrawingOpenGL.cpp
-void tracker_drawBlobsGL(Tracker &tracker, int screenWidth, int screenHeight, bool drawHistoryLines = false, std::vector<cBlob> *toDraw = NULL, GfxTexture *target = NULL);
-void tracker_drawHistory( Tracker &tracker, int screenWidth, int screenHeight, cBlob &blob, GfxTexture *target);
+void tracker_drawBlobsGL(Tracker &tracker, int screenWidth, int screenHeight, bool drawHistoryLines = false, const std::vector<cBlob> *toDraw = NULL, GfxTexture *target = NULL);
+void tracker_drawHistory( Tracker &tracker, int screenWidth, int screenHeight, const cBlob &blob, GfxTexture *target);
 
 //List of Gfx*Objects which will be used in this app.
 uint32_t GScreenWidth;
@@ -169,6 +170,7 @@ void RedrawGui()
 
 void RedrawTextures()
 {
+	PROFILE_BEGIN(PROFILER_GL);
 
 	imvTexture.setPixels(motion_data.imv_norm);
 	//DrawTextureRect(&imvTexture,-1.0, -1.f,-1.f,1.f,1.f,NULL);
@@ -177,9 +179,10 @@ void RedrawTextures()
 	DrawTextureRect(&imvTexture,0.4, 1.0f,-1.0f,-1.0f,1.0f,NULL);
 
 	blobCache.clear();
-	tracker.getFilteredBlobs(TRACK_ALL_ACTIVE|LIMIT_ON_N_OLDEST, blobCache);
+	tracker.getFilteredBlobs(TRACK_ALL_ACTIVE|LIMIT_ON_N_OLDEST, blobCache, &tracker.acquireSnapshot().blobs);
 	//tracker.drawBlobsGL(motion_data.width, motion_data.height);
 	tracker_drawBlobsGL(tracker, motion_data.width, motion_data.height, true, &blobCache);
+	PROFILE_END(PROFILER_GL);
 
 #if 0
 	static int savecounter=0;
@@ -6,78 +6,47 @@
 #include "depthtree.h"
 #include "Tracker2.h"
 #include "Graphics.h"
+#include "profiler.h"
 
 static DepthtreeWorkspace *dworkspace = NULL;
 static Blobtree *frameblobs = NULL;
 Tracker2 tracker;
 unsigned char depth_map[256];
+static unsigned char imv_map[DEPTHTREE_IMV_MAP_LEN]; // depth of the raw vectors
 pthread_t blob_tid;
 
-static void eval_ids(DepthtreeWorkspace *dworkspace, unsigned char *out, int len ){
-	unsigned int *ids, *cm, *cs;
-	ids = dworkspace->ids;
-	cm = dworkspace->comp_same;
-	cs = dworkspace->comp_size;
-	while(--len){
-		if( *(cs + *ids) > 8 ){
-			*out = *(cm + *ids);
-		}else{
-			*out = 1;
-		}
-		++out;++ids;
-	}
-}
-
 void* blob_detection(void *argn){
 
       while (1){
-				if( motion_data.available ){
-
-					//swap pointers if possible
-					while(motion_data.mutex){
-						usleep(1000);
-					}
-					motion_data.mutex = 1;
-					char *tmp = motion_data.imv_array_in;
-					motion_data.imv_array_in = motion_data.imv_array_buffer;
-					motion_data.imv_array_buffer = tmp;
-					motion_data.available = 0;
-					motion_data.mutex = 0;
-
-					//1. Convert imv vector to norm.
-					//Note: Some uness. operations if gridwidth>1.
-					//imv_eval_norm(&motion_data);
-					imv_eval_norm2(&motion_data);
-
-					//1.5 (optional) OpenGl Output
-					if( true ){
-						/* Problem: This texture update is outside
-						 * of the gl context thread and will be
-						 * ignored. Solution?!"
-						 * */
-						//imvTexture.setPixels(motion_data.imv_norm);
-					}
-
-					//2. Blob detection
+				if( motion_data_wait(&motion_data, 100) ){
+
+					PROFILE_BEGIN(PROFILER_FRAME);
+
+					//1.+2. Blob detection on the raw vectors. The norm will be
+					//evaluated by imv_map for the grid pixels only.
+					//Debug: The ids will be written into imv_norm, see RedrawTextures.
 					BlobtreeRect input_roi = {0,0, motion_data.width, motion_data.height -0 };//shrink height because lowest rows contains noise.
-					depthtree_find_blobs(frameblobs, motion_data.imv_norm,
+					PROFILE_BEGIN(PROFILER_BLOBS);
+					depthtree_find_blobs_imv(frameblobs, motion_data.imv_array_buffer,
 							motion_data.width, motion_data.height,
-							input_roi, depth_map, dworkspace);
+							input_roi, imv_map, motion_data.imv_norm, dworkspace);
+					PROFILE_END(PROFILER_BLOBS);
 
 					//3. Tracker
+					PROFILE_BEGIN(PROFILER_TRACKER);
 					tracker.trackBlobs( frameblobs, true );
+					PROFILE_END(PROFILER_TRACKER);
 					
 					//4. Opengl Output
 					// see gl_scenes/motion.c
 
-					// Debug: Replace imv_norm with ids, roi has to start in (0,0) and with full width.
-					eval_ids(dworkspace, motion_data.imv_norm, input_roi.width* input_roi.height);
-
+					PROFILE_END(PROFILER_FRAME);
+					PROFILE_NEXT_FRAME();
 
 				}else{
 					//printf("No new imv data\n");
 					//vcos_sleep(100);
-					usleep(100000);
+					// motion_data_wait already waited 100ms.
 				}
 			}
 }
@@ -137,6 +106,11 @@ int main(int argc, const char **argv){
 	for( int i=0; i<256; i++){
 		depth_map[i] = (i<10?0:i/4+1);
 	}
+	depthtree_create_imv_map(depth_map, 2, imv_map);
+	//Print timings of the blob detection stages, see profiler.h
+	profiler_init(stderr, 500,
+			getenv("PROFILER_JSON")?PROFILER_OUTPUT_JSON:PROFILER_OUTPUT_TEXT);
+
 	//Create thread for blob detection.
 	int err = pthread_create(&blob_tid, NULL, &blob_detection, NULL);
 	if (err != 0){
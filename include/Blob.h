@@ -5,12 +5,6 @@
 #define MAX_HISTORY_LEN 100
 
 
-#ifdef WITH_HISTORY
-#include <deque>
-#include <cassert>
-#include <memory>
-#endif
- 
 
 // event types
 enum { BLOB_NULL = 0, // ?
@@ -26,6 +20,8 @@ struct point {
  	int  x, y;
 };
 
+#include "Kalman.h"
+
 static unsigned int CBlob_Id = 0;
 
 class cBlob {
@@ -51,47 +47,64 @@ class cBlob {
 		int duration; //blob exists for duration frames.
 		int missing_duration; //blob is missed for missing_duration frames.
 		unsigned int id; // shared id with blobs of history chain.
-
-#ifdef WITH_HISTORY
-		//std::deque<cBlob> *history;
-		std::shared_ptr< std::deque<cBlob> > history;//;
-		void transfer_history(cBlob &previousBlob){
-			//assert( history == NULL );
-			history = previousBlob.history;
-			//previousBlob.history = NULL;
-			id = previousBlob.id;
-		}
-
-		/*Note: Only add (old) blob b to history container
-		 * with the property b.history==NULL;
-		 * Otherwise, the destruction of b will delete the
-		 * container.
-		 */
-		void update_history(cBlob &b){
-			if( history.get() == nullptr ){
-				//history = std::shared_ptr<std::deque<cBlob>>(new std::deque<cBlob>(10)); 
-				history = std::shared_ptr<std::deque<cBlob>>(new std::deque<cBlob>(0)); 
-			}else if( history.get()->size() >= MAX_HISTORY_LEN ){
-				history.get()->pop_back();
-			}
-			history.get()->push_front(b);//copy b, thus increases the occuring of the pointer.
-		}
-#endif
+		KalmanState kalman; // motion model, only used if the tracker predicts positions.
 
 		cBlob()
-#ifdef WITH_HISTORY
-			:history(nullptr)
-#endif
 		{
 			id = ++CBlob_Id;
 		};
 		~cBlob()
 		{
-#ifdef WITH_HISTORY
-			//delete history;
-#endif
 		};
 
 };
 
+#ifdef WITH_HISTORY
+/* Position of a blob in an earlier frame. */
+struct HistorySample {
+	int frame; // frame id of the tracker
+	point location;
+	point min, max;
+};
+
+/* Fixed ring buffer of the last MAX_HISTORY_LEN positions of a track.
+ * The tracker holds one ring per handid (see Tracker::getHistory),
+ * thus, copying blobs does not touch the history. 
+ *
+ * Usage:
+ * 	for( unsigned int k=0; k<ring.size; k++){
+ * 		const HistorySample &s = history_at(&ring, k); // k=0 is the newest sample
+ * 		...
+ * 	}
+ */
+struct HistoryRing {
+	HistorySample samples[MAX_HISTORY_LEN];
+	unsigned int head; // position of newest sample
+	unsigned int size;
+	unsigned int id; // cBlob::id of the track
+};
+
+static inline void history_clear(HistoryRing *ring, unsigned int id){
+	ring->head = MAX_HISTORY_LEN-1;
+	ring->size = 0;
+	ring->id = id;
+}
+
+/* Overwrites the oldest sample if the ring is full. */
+static inline void history_push(HistoryRing *ring, const cBlob &b, int frame){
+	if( ++ring->head == MAX_HISTORY_LEN ) ring->head = 0;
+	if( ring->size < MAX_HISTORY_LEN ) ++ring->size;
+	HistorySample &s = ring->samples[ring->head];
+	s.frame = frame;
+	s.location = b.location;
+	s.min = b.min;
+	s.max = b.max;
+}
+
+/* k-th newest sample, k < ring->size */
+static inline const HistorySample &history_at(const HistoryRing *ring, unsigned int k){
+	return ring->samples[ (ring->head + MAX_HISTORY_LEN - k) % MAX_HISTORY_LEN ];
+}
+#endif
+
 #endif
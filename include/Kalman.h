@@ -0,0 +1,92 @@
+/*
+ * Constant velocity Kalman filter in fixed point arithmetic.
+ *
+ * State per axis: position and velocity (pixels, pixels/frame).
+ * Both axes are independent and share the same noise parameters,
+ * thus one covariance matrix P = [p00 p01; p01 p11] is enough.
+ *
+ * Positions, velocities and covariances are stored with
+ * KALMAN_SHIFT fractional bits. The noise parameters are
+ * given in pixels^2 (process noise: variance of the
+ * acceleration per frame, measurement noise: variance of
+ * the detected blob location).
+ */
+
+#ifndef KALMAN_H
+#define KALMAN_H
+
+#define KALMAN_SHIFT 8
+#define KALMAN_ONE (1<<KALMAN_SHIFT)
+
+/* Default noise parameters [px^2] */
+#define KALMAN_PROCESS_NOISE 8
+#define KALMAN_MEASUREMENT_NOISE 2
+
+/* Gate of the squared distance between measured and predicted
+ * position in multiples of the innovation variance.
+ * 9.21 is the 99% quantile of the chi^2 distribution with 2 dofs. */
+#define KALMAN_GATE 9
+
+struct KalmanState {
+	int x[2]; // position
+	int v[2]; // velocity
+	int p00, p01, p11; // covariance of (position, velocity)
+};
+
+static inline int kalman_round(const int a){
+	return (a + KALMAN_ONE/2) >> KALMAN_SHIFT;
+}
+
+/* Start at measured position with unknown velocity.
+ * velocity_var - Variance of the initial velocity [px^2]. */
+static inline void kalman_init(KalmanState *k, const int x, const int y,
+		const int measurement_noise, const int velocity_var){
+	k->x[0] = x << KALMAN_SHIFT;
+	k->x[1] = y << KALMAN_SHIFT;
+	k->v[0] = k->v[1] = 0;
+	k->p00 = measurement_noise << KALMAN_SHIFT;
+	k->p01 = 0;
+	k->p11 = velocity_var << KALMAN_SHIFT;
+}
+
+/* Time step of one frame.
+ * Q = q * [1/4 1/2; 1/2 1] (white noise acceleration) */
+static inline void kalman_predict(KalmanState *k, const int process_noise){
+	const int q = process_noise << KALMAN_SHIFT;
+	k->x[0] += k->v[0];
+	k->x[1] += k->v[1];
+	k->p00 += 2*k->p01 + k->p11 + q/4;
+	k->p01 += k->p11 + q/2;
+	k->p11 += q;
+}
+
+/* Variance of the difference between predicted and
+ * measured position [px^2], rounded up. */
+static inline int kalman_innovation_var(const KalmanState *k, const int measurement_noise){
+	return ((k->p00 + KALMAN_ONE - 1) >> KALMAN_SHIFT) + measurement_noise;
+}
+
+/* Correct state by measured position. */
+static inline void kalman_update(KalmanState *k, const int x, const int y,
+		const int measurement_noise){
+	const long long r = measurement_noise << KALMAN_SHIFT;
+	const long long s = k->p00 + r;
+	// Gains with 16 fractional bits
+	const long long k0 = ((long long)k->p00 << 16) / s;
+	const long long k1 = ((long long)k->p01 << 16) / s;
+	const int y0 = (x << KALMAN_SHIFT) - k->x[0];
+	const int y1 = (y << KALMAN_SHIFT) - k->x[1];
+
+	k->x[0] += (int)((k0 * y0) >> 16);
+	k->x[1] += (int)((k0 * y1) >> 16);
+	k->v[0] += (int)((k1 * y0) >> 16);
+	k->v[1] += (int)((k1 * y1) >> 16);
+
+	// P = (I - K H) P
+	const long long p01 = k->p01;
+	k->p11 -= (int)((p01 * p01) / s);
+	k->p00 = (int)((k->p00 * r) / s);
+	k->p01 = (int)((p01 * r) / s);
+}
+
+#endif
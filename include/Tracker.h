@@ -7,6 +7,7 @@
 
 #include <stdlib.h>
 #include <vector>
+#include <atomic>
 
 #include "Blob.h"
 
@@ -26,6 +27,19 @@ enum Trackfilter{
 	LIMIT_ON_N_OLDEST = 32 ,
 };
 
+/* Published state of the tracker for other threads, see Tracker::acquireSnapshot. */
+struct TrackerSnapshot {
+	std::vector<cBlob> blobs;
+	int frameId;
+#ifdef WITH_HISTORY
+	/* Copies of the rings of the blobs in this snapshot. */
+	HistoryRing history[MAXHANDS];
+
+	/* Like Tracker::getHistory, but for the blobs of the snapshot. */
+	const HistoryRing *getHistory(const cBlob &b) const;
+#endif
+};
+
 class Tracker {
 	protected:
 		int m_frameId; //Increase id for each frame.
@@ -40,9 +54,26 @@ class Tracker {
 		bool handids[MAXHANDS];
 		int last_handid;
 
-	public:
-		int m_swap_mutex;
+#ifdef WITH_HISTORY
+		/* Positions of the tracks, indexed by handid.
+		 * The ring of a handid will be cleared if the handid
+		 * is given to a new blob. */
+		HistoryRing m_history[MAXHANDS];
+#endif
 
+		/* Triple buffer of snapshots. The tracker thread writes into
+		 * m_snapshot_write, the reader holds m_snapshot_read and
+		 * m_snapshot_ready contains the index of the third buffer
+		 * (and the flag SNAPSHOT_FRESH if it was not read yet). */
+		TrackerSnapshot m_snapshots[3];
+		std::atomic<unsigned int> m_snapshot_ready;
+		unsigned int m_snapshot_write, m_snapshot_read;
+
+		/* Copy blobs (and their history) into the write buffer and
+		 * swap it with the ready buffer. Called at the end of trackBlobs. */
+		void publish();
+
+	public:
 #ifdef WITH_HISTORY
 		float *m_phistory_line_colors;
 #endif
@@ -50,8 +81,29 @@ class Tracker {
 	public:
 		Tracker();
 		virtual ~Tracker() = 0;
+		/* Blobs of the last frame. Only use this in the thread
+		 * which calls trackBlobs. Other threads should use acquireSnapshot. */
 		std::vector<cBlob>& getBlobs();
-		void getFilteredBlobs(int /*Trackfilter*/ filter, std::vector<cBlob> &output);
+		int getFrameId() const;
+		int getMaxMissingDuration() const;
+
+#ifdef WITH_HISTORY
+		/* Previous positions of blob b (without the current position),
+		 * NULL if the tracker holds no history for b. */
+		const HistoryRing *getHistory(const cBlob &b) const;
+#endif
+
+		/* Newest published state of the tracker. The snapshot will not be
+		 * changed until the next call of acquireSnapshot. Never blocks.
+		 * Note that only one thread can be the reader. */
+		const TrackerSnapshot &acquireSnapshot();
+		/* Snapshot of the last acquireSnapshot call. */
+		const TrackerSnapshot &getSnapshot() const;
+
+		/* Filter blobs of input (default: getBlobs()) into output.
+		 * Use &acquireSnapshot().blobs as input outside of the tracker thread. */
+		void getFilteredBlobs(int /*Trackfilter*/ filter, std::vector<cBlob> &output,
+				const std::vector<cBlob> *input = NULL);
 
 		virtual void trackBlobs(
 				Blobtree *frameblobs,
@@ -8,15 +8,66 @@
 #include "Tracker.h"
 
 
+/* Candidate pair of a current and a previous blob. */
+struct TrackerMatch {
+	int dist2; // squared distance of locations
+	unsigned int current, previous; // indizes in blobsTmp and blobs_previous
+};
+
 class Tracker2: public Tracker {
 
+	protected:
+		/* Uniform grid over the locations of blobs_previous.
+		 * The cell size is the maximal radius. Thus, all
+		 * candidates of a blob are in the 3x3 neighbourhood of its cell.
+		 * The previous blobs are sorted by cell (counting sort):
+		 * m_grid_items[ m_grid_start[c], ..., m_grid_start[c+1]-1 ] are
+		 * the indizes of the blobs in cell c.
+		 * The vectors will be reused for every frame.
+		 */
+		std::vector<unsigned int> m_grid_start, m_grid_items;
+		std::vector<TrackerMatch> m_matches;
+
+		/* Motion prediction, see setMotionPrediction. */
+		bool m_prediction;
+		int m_process_noise, m_measurement_noise;
+
+		/* Expected positions and squared gating radius of blobs_previous.
+		 * Without prediction these are the locations and the max radius. */
+		std::vector<point> m_previous_positions;
+		std::vector<int> m_previous_gates;
+
+		/* Fills m_previous_positions and m_previous_gates. */
+		void predictPrevious();
+
+		/* Fills m_matches with all pairs in the gating radius
+		 * of the previous blobs, sorted by distance. */
+		void findMatches(int cell_size);
+
+		/* Continue the track of previousBlob with currentBlob. */
+		void applyMatch(cBlob &currentBlob, cBlob &previousBlob, bool history);
+
+		/* Select pairs of m_matches and call applyMatch for them.
+		 * Matches are assigned greedy in order of their distance,
+		 * nearest pair first. */
+		virtual void assignMatches(bool history);
+
 	public:
 		Tracker2();
-		~Tracker2();
+		virtual ~Tracker2();
 
 		void trackBlobs(
 				Blobtree *frameblobs,
 				bool history ) ;
+
+		/* Match blobs against the predicted positions of a constant
+		 * velocity Kalman filter (see Kalman.h) instead of their
+		 * last locations. The gating radius adapts to the uncertainty
+		 * of the prediction and is bounded by the max radius.
+		 * Noise parameters in pixels^2. */
+		void setMotionPrediction(bool enable,
+				int process_noise = KALMAN_PROCESS_NOISE,
+				int measurement_noise = KALMAN_MEASUREMENT_NOISE);
 };
 
 
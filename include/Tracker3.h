@@ -0,0 +1,53 @@
+/*
+ * Tracker with optimal assignment of blobs between two frames.
+ */
+
+#ifndef TRACKER3_H
+#define TRACKER3_H
+
+#include "Tracker2.h"
+
+
+/* Same as Tracker2, but the pairs of current and previous blobs
+ * minimize the sum of squared distances (Hungarian algorithm).
+ * Blobs without partner in the max radius remain unassigned.
+ * Thus, crossing hands keep their ids more often.
+ *
+ * The candidate pairs (see Tracker2::findMatches) form a sparse
+ * bipartite graph. Each connected component of this graph will be
+ * solved on its own, most of them consists of a single pair.
+ *
+ * Warm start: The augmentation starts with the greedy solution,
+ * i.e. every current blob is assigned to its nearest previous blob
+ * if this one is not taken. Between two frames most of these
+ * pairs are already optimal.
+ */
+class Tracker3: public Tracker2 {
+
+	private:
+		/* Storage for the union find over the rows (current blobs)
+		 * and columns (previous blobs) and the cost matrices. */
+		std::vector<unsigned int> m_comp_same, m_comp_order, m_comp_start;
+		std::vector<unsigned int> m_rows, m_cols;
+		std::vector<unsigned int> m_local; // node index to row/column index of component.
+		std::vector<int> m_cost, m_u, m_v, m_minv;
+		std::vector<unsigned int> m_p, m_way, m_free_rows;
+		std::vector<char> m_used;
+
+		/* Solves the assignment problem of the n x m matrix m_cost (n<=m).
+		 * The result is stored in m_p (m_p[j] = row of column j, 1-based, 0 if unassigned). */
+		void hungarian(unsigned int n, unsigned int m);
+
+		void solveComponent(const unsigned int *pair_begin,
+				const unsigned int *pair_end, bool history);
+
+	protected:
+		void assignMatches(bool history);
+
+	public:
+		Tracker3();
+		~Tracker3();
+};
+
+
+#endif
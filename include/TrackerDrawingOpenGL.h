@@ -11,11 +11,13 @@
 #ifdef WITH_OPENGL
 class GfxTexture; 
 
-/* Helper function to draw blobs for debugging */
-void tracker_drawBlobsGL(Tracker &tracker, int screenWidth, int screenHeight, bool drawHistoryLines =     false, std::vector<cBlob> *toDraw = NULL, GfxTexture *target = NULL);
+/* Helper function to draw blobs for debugging.
+ * Without toDraw, the blobs of tracker.acquireSnapshot() will be drawn.
+ * The history lines are taken from the last acquired snapshot. */
+void tracker_drawBlobsGL(Tracker &tracker, int screenWidth, int screenHeight, bool drawHistoryLines =     false, const std::vector<cBlob> *toDraw = NULL, GfxTexture *target = NULL);
 
 #ifdef WITH_HISTORY
-void tracker_drawHistory( Tracker &tracker, int screenWidth, int screenHeight, cBlob &blob, GfxTexture     *target);
+void tracker_drawHistory( Tracker &tracker, int screenWidth, int screenHeight, const cBlob &blob, GfxTexture     *target);
 #endif
 
 #endif
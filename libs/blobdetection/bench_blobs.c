@@ -0,0 +1,463 @@
+/* Benchmark of the blob detection algorithms.
+ *
+ * Sweeps over all combinations of
+ * - input sources: Synthetic images of example.h and recorded frames,
+ * - algorithms: threshtree, runtree, depthtree (serial and parallel),
+ * - grid sizes and roi sizes.
+ * The feature flags of settings.h are fixed at compile time. They will
+ * be printed in the last column. Build one binary per setting
+ * to compare them (see CMakeLists.txt).
+ *
+ * Output is one CSV row per combination. All times are averages per
+ * frame in milliseconds. The phase times require BLOB_PHASE_TIMING
+ * (see phases.h), otherwise they are zero.
+ * Allocations will be counted if the binary is linked with
+ * -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc and
+ * BENCH_COUNT_ALLOCS is defined. Otherwise the column is empty.
+ * The warm up frame of each combination is not measured, thus
+ * the allocation columns should be zero for a steady state.
+ *
+ * Usage: bench_blobs [-n frames] [-t threads] [-o out.csv]
+ *                    [-p image.pgm]... [-i motion.imv -W cols -H rows]
+ *
+ * -p Binary (P5) grayscale image. Can be given multiple times.
+ * -i Recorded inline motion vectors (raspivid -x). cols x rows is the
+ *    size of the vector grid, i.e. (width/16+1) x (height/16).
+ *    The vectors will be converted by the 1-norm, see imv_eval_norm.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "threshtree.h"
+#include "depthtree.h"
+#include "runtree.h"
+
+#include "example.h"
+
+#ifndef BLOB_PHASE_TIMING
+#warning "Compile with -DBLOB_PHASE_TIMING to measure the phases."
+#endif
+
+static const unsigned int SYNTHETIC_SIZE = 512;
+
+//+++++++++++++++++++++++++++++
+// Allocation counter
+//+++++++++++++++++++++++++++++
+
+#ifdef BENCH_COUNT_ALLOCS
+static unsigned long num_allocs = 0;
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__wrap_malloc(size_t size){
+	__sync_fetch_and_add(&num_allocs, 1);
+	return __real_malloc(size);
+}
+void *__wrap_calloc(size_t n, size_t size){
+	__sync_fetch_and_add(&num_allocs, 1);
+	return __real_calloc(n, size);
+}
+void *__wrap_realloc(void *ptr, size_t size){
+	__sync_fetch_and_add(&num_allocs, 1);
+	return __real_realloc(ptr, size);
+}
+#endif
+
+//+++++++++++++++++++++++++++++
+// Input sources
+//+++++++++++++++++++++++++++++
+
+typedef struct {
+	char name[64];
+	unsigned int w, h;
+	unsigned int num_frames;
+	unsigned char *frames; // num_frames*w*h values
+	unsigned char thresh; // for threshtree and runtree
+	unsigned char depth_map[256]; // for depthtree
+} Source;
+
+static bool source_alloc(Source *s, const char *name,
+		const unsigned int w, const unsigned int h, const unsigned int num_frames){
+	snprintf(s->name, sizeof(s->name), "%s", name);
+	s->w = w;
+	s->h = h;
+	s->num_frames = num_frames;
+	s->frames = (unsigned char*) calloc( num_frames*w*h, sizeof(unsigned char) );
+	return s->frames != NULL;
+}
+
+/* Synthetic images. gen_image_data2/3 require w=h. */
+static bool source_synthetic(Source *s, const unsigned int type,
+		const unsigned int num_frames){
+	const char *names[] = {"noise", "blocks", "nested"};
+	const unsigned int S = SYNTHETIC_SIZE;
+	unsigned int f, i;
+	if( !source_alloc(s, names[type], S, S, num_frames) ) return false;
+
+	for( f=0; f<num_frames; f++){
+		unsigned char *frame = s->frames + f*S*S;
+		srandom(f);
+		switch( type ){
+			case 0: gen_image_data(frame, S, S); break;
+			case 1: gen_image_data2(frame, S, S, 4); break;
+			default: gen_image_data3(frame, S, S, 4); break;
+		}
+	}
+
+	switch( type ){
+		case 0: /* values 0, 1 */
+			s->thresh = 0;
+			for( i=0; i<256; i++) s->depth_map[i] = (i>0?1:0);
+			break;
+		case 1: /* values 0, 200 */
+			s->thresh = 128;
+			for( i=0; i<256; i++) s->depth_map[i] = i/64;
+			break;
+		default: /* values 0,...,4 */
+			s->thresh = 2;
+			for( i=0; i<256; i++) s->depth_map[i] = (i<5?i:4);
+			break;
+	}
+	return true;
+}
+
+static bool source_pgm(Source *s, const char *filename){
+	FILE *f = fopen(filename, "rb");
+	unsigned int w, h, maxval, i;
+	int c;
+	if( f == NULL ){
+		fprintf(stderr, "Can not open %s.\n", filename);
+		return false;
+	}
+	if( fgetc(f) != 'P' || fgetc(f) != '5' ){
+		fprintf(stderr, "%s is no binary pgm file.\n", filename);
+		fclose(f);
+		return false;
+	}
+	//skip comments
+	while( (c = fgetc(f)) != EOF ){
+		if( c == '#' ){
+			while( (c = fgetc(f)) != EOF && c != '\n' ){}
+		}else if( c > ' ' ){
+			ungetc(c, f);
+			break;
+		}
+	}
+	if( fscanf(f, "%u %u %u", &w, &h, &maxval) != 3 || maxval > 255 ){
+		fprintf(stderr, "Unsupported pgm header in %s.\n", filename);
+		fclose(f);
+		return false;
+	}
+	fgetc(f); //single whitespace after header
+
+	const char *basename = strrchr(filename, '/');
+	char name[64];
+	snprintf(name, sizeof(name), "pgm:%s", basename?basename+1:filename);
+	if( !source_alloc(s, name, w, h, 1) ||
+			fread(s->frames, sizeof(unsigned char), w*h, f) != w*h ){
+		fprintf(stderr, "Can not read %s.\n", filename);
+		fclose(f);
+		return false;
+	}
+	fclose(f);
+
+	s->thresh = 128;
+	for( i=0; i<256; i++) s->depth_map[i] = i/32;
+	return true;
+}
+
+/* Same layout as INLINE_MOTION_VECTOR in RaspiImv.h */
+typedef struct {
+	signed char x_vector;
+	signed char y_vector;
+	short sad;
+} BenchImv;
+
+static bool source_imv(Source *s, const char *filename,
+		const unsigned int cols, const unsigned int rows){
+	FILE *f = fopen(filename, "rb");
+	unsigned int k, i;
+	if( f == NULL || cols == 0 || rows == 0 ){
+		fprintf(stderr, "Can not open %s or grid size missing.\n", filename);
+		if( f != NULL ) fclose(f);
+		return false;
+	}
+	fseek(f, 0, SEEK_END);
+	const unsigned int num_frames = ftell(f)/(cols*rows*sizeof(BenchImv));
+	fseek(f, 0, SEEK_SET);
+
+	const char *basename = strrchr(filename, '/');
+	char name[64];
+	snprintf(name, sizeof(name), "imv:%s", basename?basename+1:filename);
+	BenchImv *imv = (BenchImv*) malloc( cols*rows*sizeof(BenchImv) );
+	if( num_frames == 0 || imv == NULL ||
+			!source_alloc(s, name, cols, rows, num_frames) ){
+		fprintf(stderr, "Can not read %s.\n", filename);
+		free(imv);
+		fclose(f);
+		return false;
+	}
+
+	for( k=0; k<num_frames; k++){
+		if( fread(imv, sizeof(BenchImv), cols*rows, f) != cols*rows ) break;
+		unsigned char *norm = s->frames + k*cols*rows;
+		for( i=0; i<cols*rows; i++){
+			const unsigned int n = abs(imv[i].x_vector) + abs(imv[i].y_vector);
+			norm[i] = (n>255?255:n);
+		}
+	}
+	free(imv);
+	fclose(f);
+
+	//Same mapping as apps/raspicam
+	s->thresh = 10;
+	for( i=0; i<256; i++) s->depth_map[i] = (i<10?0:i/4+1);
+	return true;
+}
+
+//+++++++++++++++++++++++++++++
+// Benchmark loop
+//+++++++++++++++++++++++++++++
+
+typedef enum {
+	ALGO_THRESHTREE=0,
+	ALGO_THRESHTREE_PARALLEL,
+	ALGO_RUNTREE,
+	ALGO_DEPTHTREE,
+	ALGO_DEPTHTREE_PARALLEL,
+	NUM_ALGOS
+} Algorithm;
+
+static const char *algo_names[NUM_ALGOS] = {
+	"threshtree", "threshtree_parallel", "runtree",
+	"depthtree", "depthtree_parallel" };
+
+typedef struct {
+	ThreshtreeWorkspace *tworkspace;
+	RuntreeWorkspace *rworkspace;
+	DepthtreeWorkspace *dworkspace;
+} Workspaces;
+
+static void run_algo(const Algorithm algo, Blobtree *blob, Workspaces *ws,
+		const Source *s, const unsigned char *frame,
+		const BlobtreeRect roi, const unsigned int threads){
+	switch( algo ){
+		case ALGO_THRESHTREE:
+			threshtree_find_blobs(blob, frame, s->w, s->h, roi, s->thresh,
+					ws->tworkspace);
+			break;
+		case ALGO_THRESHTREE_PARALLEL:
+			threshtree_find_blobs_parallel(blob, frame, s->w, s->h, roi, s->thresh,
+					threads, ws->tworkspace);
+			break;
+		case ALGO_RUNTREE:
+			runtree_find_blobs(blob, frame, s->w, s->h, roi, s->thresh,
+					ws->rworkspace);
+			break;
+		case ALGO_DEPTHTREE:
+			depthtree_find_blobs(blob, frame, s->w, s->h, roi, s->depth_map,
+					ws->dworkspace);
+			break;
+		default:
+			depthtree_find_blobs_parallel(blob, frame, s->w, s->h, roi, s->depth_map,
+					threads, ws->dworkspace);
+			break;
+	}
+}
+
+static const char *feature_flags(){
+	return ""
+#ifdef BLOB_DIAGONAL_CHECK
+		"diagonal "
+#endif
+#ifdef BLOB_DIMENSION
+		"dimension "
+#endif
+#ifdef BLOB_COUNT_PIXEL
+		"count_pixel "
+#endif
+#ifdef BLOB_BARYCENTER
+		"barycenter "
+#endif
+#ifdef EXTEND_BOUNDING_BOXES
+		"extend_bounding_boxes "
+#endif
+#ifdef SAVE_DEPTH_MAP_VALUE
+		"save_depth_map_value "
+#endif
+#ifdef BLOB_SORT_TREE
+		"sort_tree "
+#endif
+#ifdef BLOB_SUBGRID_CHECK
+		"subgrid_check "
+#endif
+#ifdef BLOB_COMPONENT_RECORDS
+		"component_records "
+#endif
+#ifdef THRESHTREE_RUN_LENGTH
+		"run_length "
+#endif
+#ifdef NO_DEPTH_MAP
+		"no_depth_map "
+#endif
+		;
+}
+
+static void bench(FILE *out, const Source *s, const Algorithm algo,
+		const unsigned int grid, const unsigned int roi_div,
+		const unsigned int frames, const unsigned int threads,
+		Workspaces *ws){
+	BlobtreeRect roi;
+	roi.width = s->w/roi_div;
+	roi.height = s->h/roi_div;
+	roi.x = (s->w - roi.width)/2;
+	roi.y = (s->h - roi.height)/2;
+	if( roi.width < 2*grid || roi.height < 2*grid ) return;
+
+	Blobtree *blob = NULL;
+	blobtree_create(&blob);
+	blobtree_set_grid(blob, grid, grid);
+	blobtree_set_filter(blob, F_TREE_DEPTH_MIN, 1);
+	blobtree_set_filter(blob, F_AREA_MIN, 20);
+	blobtree_set_filter(blob, F_ONLY_LEAFS, 1);
+
+	//warm up, fills the workspace and the tree arena.
+	run_algo(algo, blob, ws, s, s->frames, roi, threads);
+
+	unsigned int arena_allocs0, arena_allocs1, nodes = 0, k;
+	unsigned long blobs = 0;
+	unsigned long long t_total = 0, t_filter = 0;
+	blobtree_arena_stats(blob, NULL, NULL, &arena_allocs0);
+#ifdef BENCH_COUNT_ALLOCS
+	const unsigned long allocs0 = num_allocs;
+#endif
+	blob_phases_reset();
+
+	for( k=0; k<frames; k++){
+		const unsigned char *frame = s->frames + (k%s->num_frames)*s->w*s->h;
+		const unsigned long long t0 = blob_phases_clock();
+		run_algo(algo, blob, ws, s, frame, roi, threads);
+		const unsigned long long t1 = blob_phases_clock();
+
+		if( blob->tree != NULL ){
+			nodes += blob->tree->size;
+			Node *cur = blobtree_first(blob);
+			while( cur != NULL ){
+				blobs++;
+				cur = blobtree_next(blob);
+			}
+		}
+		const unsigned long long t2 = blob_phases_clock();
+		t_total += t1-t0;
+		t_filter += t2-t1;
+	}
+
+#ifdef BENCH_COUNT_ALLOCS
+	const unsigned long allocs = num_allocs - allocs0;
+#endif
+	blobtree_arena_stats(blob, NULL, NULL, &arena_allocs1);
+	BlobPhaseTimes times;
+	blob_phases_get(&times);
+
+	const double ms = 1.0/(1000000.0*frames);
+	fprintf(out, "%s,%s,%u,%u,%u,%u,%u,%u,%u,%.1f,%.1f",
+			s->name, algo_names[algo], s->w, s->h, roi.width, roi.height,
+			grid, (algo==ALGO_THRESHTREE_PARALLEL || algo==ALGO_DEPTHTREE_PARALLEL)?threads:1,
+			frames, nodes/(double)frames, blobs/(double)frames );
+	for( k=0; k<BLOB_NUM_PHASES; k++){
+		fprintf(out, ",%.4f", times.ns[k]*ms);
+	}
+	fprintf(out, ",%.4f,%.4f,", t_filter*ms, t_total*ms);
+#ifdef BENCH_COUNT_ALLOCS
+	fprintf(out, "%lu", allocs);
+#endif
+	//omit trailing space of flags
+	const char *flags = feature_flags();
+	const int flags_len = strlen(flags);
+	fprintf(out, ",%u,%.*s\n", arena_allocs1-arena_allocs0,
+			(flags_len>0?flags_len-1:0), flags);
+	fflush(out);
+
+	blobtree_destroy(&blob);
+}
+
+int main(int argc, char **argv) {
+	const unsigned int grids[] = {1, 2, 4};
+	const unsigned int roi_divs[] = {1, 2, 4};
+	unsigned int frames = 20, threads = 4;
+	unsigned int imv_cols = 0, imv_rows = 0;
+	const char *imv_file = NULL;
+	const char *pgm_files[16];
+	unsigned int num_pgm = 0;
+	FILE *out = stdout;
+	int opt;
+
+	while( (opt = getopt(argc, argv, "n:t:o:p:i:W:H:")) != -1 ){
+		switch( opt ){
+			case 'n': frames = atoi(optarg); break;
+			case 't': threads = atoi(optarg); break;
+			case 'o':
+								out = fopen(optarg, "w");
+								if( out == NULL ){
+									fprintf(stderr, "Can not open %s.\n", optarg);
+									return -1;
+								}
+								break;
+			case 'p': if( num_pgm < 16 ) pgm_files[num_pgm++] = optarg; break;
+			case 'i': imv_file = optarg; break;
+			case 'W': imv_cols = atoi(optarg); break;
+			case 'H': imv_rows = atoi(optarg); break;
+			default:
+								fprintf(stderr, "Usage: %s [-n frames] [-t threads] [-o out.csv] "
+										"[-p image.pgm]... [-i motion.imv -W cols -H rows]\n", argv[0]);
+								return -1;
+		}
+	}
+	if( frames == 0 ) frames = 1;
+
+	Source sources[3+16+1];
+	unsigned int num_sources = 0, k, a, g, r;
+	for( k=0; k<3; k++){
+		if( source_synthetic(&sources[num_sources], k, 4) ) num_sources++;
+	}
+	for( k=0; k<num_pgm; k++){
+		if( source_pgm(&sources[num_sources], pgm_files[k]) ) num_sources++;
+	}
+	if( imv_file != NULL ){
+		if( source_imv(&sources[num_sources], imv_file, imv_cols, imv_rows) ) num_sources++;
+	}
+
+	fprintf(out, "source,algorithm,width,height,roi_width,roi_height,grid,threads,"
+			"frames,nodes,blobs,label_ms,merge_ms,tree_ms,areas_ms,filter_ms,total_ms,"
+			"allocs,arena_allocs,flags\n");
+
+	for( k=0; k<num_sources; k++){
+		const Source *s = &sources[k];
+		Workspaces ws = {NULL, NULL, NULL};
+		if( !threshtree_create_workspace(s->w, s->h, &ws.tworkspace) ||
+				!runtree_create_workspace(s->w, s->h, &ws.rworkspace) ||
+				!depthtree_create_workspace(s->w, s->h, &ws.dworkspace) ){
+			fprintf(stderr, "Can not create workspaces for %s.\n", s->name);
+			return -1;
+		}
+
+		for( a=0; a<NUM_ALGOS; a++){
+			for( g=0; g<sizeof(grids)/sizeof(grids[0]); g++){
+				for( r=0; r<sizeof(roi_divs)/sizeof(roi_divs[0]); r++){
+					bench(out, s, (Algorithm) a, grids[g], roi_divs[r], frames, threads, &ws);
+				}
+			}
+		}
+
+		threshtree_destroy_workspace(&ws.tworkspace);
+		runtree_destroy_workspace(&ws.rworkspace);
+		depthtree_destroy_workspace(&ws.dworkspace);
+		free(sources[k].frames);
+	}
+
+	if( out != stdout ) fclose(out);
+	return 0;
+}
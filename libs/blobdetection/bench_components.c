@@ -0,0 +1,123 @@
+/* Benchmark of the layout of the component arrays
+ * (see BLOB_COMPONENT_RECORDS in settings.h).
+ *
+ * Compile this file twice, with and without -DBLOB_COMPONENT_RECORDS,
+ * and compare the output. Add -DBENCH_DEPTHTREE to measure the
+ * depthtree algorithm instead of threshtree.
+ *
+ * The test images consists of random blocks. Smaller blocks
+ * increase the number of components.
+ * For each block size the labeling and the tree build (merge of
+ * the ids and construction of the tree) will be measured separately.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#ifdef BENCH_DEPTHTREE
+#include "depthtree.h"
+#else
+#include "threshtree.h"
+#endif
+
+static const unsigned int W=1280;
+static const unsigned int H=720;
+static const unsigned int FRAMES=20;
+
+static long long time_us(){
+	struct timeval te;
+	gettimeofday(&te, NULL);
+	return te.tv_sec * 1000000LL + te.tv_usec;
+}
+
+static void gen_blocks(unsigned char *data, const unsigned int block, unsigned int seed){
+	unsigned int x,y;
+	srand(seed);
+	for( y=0; y<H; y+=block ){
+		for( x=0; x<W; x+=block ){
+			const unsigned char v = rand()%256;
+			unsigned int i,j;
+			for( j=y; j<y+block && j<H; j++ ){
+				for( i=x; i<x+block && i<W; i++ ){
+					data[j*W+i] = v;
+				}
+			}
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	const unsigned int blocks[] = {32, 16, 8, 4, 2, 1};
+	const unsigned int stepwidth = (argc > 1)?atoi(argv[1]):1;
+	const BlobtreeRect roi = {0,0,W,H};
+	unsigned int b, f;
+
+	unsigned char *data = malloc( W*H*sizeof(unsigned char) );
+	if( data == NULL ) return -1;
+
+#ifdef BLOB_COMPONENT_RECORDS
+	printf("Layout: records (%u bytes per id)\n", (unsigned int) sizeof(BlobComponent));
+#else
+	printf("Layout: arrays\n");
+#endif
+
+#ifdef BENCH_DEPTHTREE
+	printf("Algorithm: depthtree, stepwidth %u\n", stepwidth);
+	unsigned char depth_map[256];
+	for( f=0; f<256; f++) depth_map[f] = f/32;
+	DepthtreeWorkspace *workspace = NULL;
+	depthtree_create_workspace( W, H, &workspace );
+#else
+	printf("Algorithm: threshtree, stepwidth %u\n", stepwidth);
+	ThreshtreeWorkspace *workspace = NULL;
+	threshtree_create_workspace( W, H, &workspace );
+#endif
+	if( workspace == NULL ) return -1;
+
+	TreeArena arena;
+	tree_arena_init(&arena);
+
+	printf("%6s %8s %8s %12s %12s\n", "block", "ids", "nodes", "label[ms]", "build[ms]");
+	for( b=0; b<sizeof(blocks)/sizeof(blocks[0]); b++ ){
+		long long t_label = 0, t_build = 0;
+		unsigned int nids = 0, nodes = 0;
+		for( f=0; f<FRAMES; f++ ){
+			gen_blocks(data, blocks[b], f);
+			Blob *blobs;
+
+			long long t0 = time_us();
+#ifdef BENCH_DEPTHTREE
+			nids = depthtree_label(data, W, H, roi, depth_map, stepwidth, workspace);
+#else
+			nids = THRESHTREE_LABEL(data, W, H, roi, 128, stepwidth, stepwidth, workspace);
+#endif
+			long long t1 = time_us();
+#ifdef BENCH_DEPTHTREE
+			Tree *tree = depthtree_build_tree(roi, nids, &blobs, workspace, &arena);
+#else
+			Tree *tree = threshtree_build_tree(roi, stepwidth, stepwidth, nids,
+					&blobs, workspace, &arena);
+#endif
+			long long t2 = time_us();
+
+			if( tree == NULL ) return -1;
+			nodes = tree->size;
+			t_label += t1-t0;
+			t_build += t2-t1;
+		}
+		printf("%6u %8u %8u %12.3f %12.3f\n", blocks[b], nids, nodes,
+				t_label/(1000.0*FRAMES), t_build/(1000.0*FRAMES) );
+	}
+
+	tree_arena_destroy(&arena);
+#ifdef BENCH_DEPTHTREE
+	depthtree_destroy_workspace( &workspace );
+#else
+	threshtree_destroy_workspace( &workspace );
+#endif
+	free(data);
+
+	return 0;
+}
@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "tree.h"
 #include "blob.h"
 
@@ -16,6 +18,7 @@ void blobtree_create(Blobtree **pblob){
 	blob->filter = filter;
 	Grid grid = {1,1};
 	blob->grid = grid;
+	tree_arena_init(&blob->arena);
 
 	*pblob = blob;
 }
@@ -23,17 +26,57 @@ void blobtree_create(Blobtree **pblob){
 void blobtree_destroy(Blobtree **pblob){
 	if( *pblob == NULL ) return;
 	Blobtree *blob = *pblob;
-	if( blob->tree != NULL ){
-        tree_destroy(&blob->tree);
-	}
-    if( blob->tree_data != NULL) {
-        free(blob->tree_data);
-        blob->tree_data = NULL;
-    }
+	blobtree_clear_tree(blob);
+	tree_arena_destroy(&blob->arena);
 	free(blob);
 	*pblob = NULL;
 }
 
+void blobtree_clear_tree(Blobtree *blob){
+	if( blob->tree == &blob->arena.tree ){
+		//storage is owned by the arena.
+		blob->tree = NULL;
+		blob->tree_data = NULL;
+		return;
+	}
+	if( blob->tree != NULL ){
+		tree_destroy(&blob->tree);
+		blob->tree = NULL;
+	}
+	if( blob->tree_data != NULL){
+		free(blob->tree_data);
+		blob->tree_data = NULL;
+	}
+}
+
+void blobtree_arena_stats(const Blobtree *blob,
+		unsigned int *nodes_high_water,
+		unsigned int *scratch_high_water,
+		unsigned int *heap_allocs){
+	if( nodes_high_water != NULL ) *nodes_high_water = blob->arena.nodes_high_water;
+	if( scratch_high_water != NULL ) *scratch_high_water = blob->arena.scratch_high_water;
+	if( heap_allocs != NULL ) *heap_allocs = blob->arena.heap_allocs;
+}
+
+//+++++++++++++++++++++++++++++
+// Phase timing, see phases.h
+//+++++++++++++++++++++++++++++
+
+static __thread BlobPhaseTimes blob_phase_times;
+
+void blob_phases_reset(){
+	memset(&blob_phase_times, 0, sizeof(BlobPhaseTimes));
+}
+
+void blob_phases_get(BlobPhaseTimes *times){
+	memcpy(times, &blob_phase_times, sizeof(BlobPhaseTimes));
+}
+
+void blob_phases_add(const BlobPhase phase, const unsigned long long ns){
+	blob_phase_times.ns[phase] += ns;
+	blob_phase_times.calls[phase]++;
+}
+
 void blobtree_set_filter(Blobtree *blob, const FILTER f, const unsigned int val){
 	switch(f){
 		case F_TREE_DEPTH_MIN: blob->filter.tree_depth_min=val;
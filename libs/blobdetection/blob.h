@@ -27,6 +27,7 @@
  * */
 
 #include "tree.h"
+#include "phases.h"
 
 typedef struct {
 	unsigned int width;
@@ -77,6 +78,7 @@ typedef struct {
 	Grid grid; // width between compared pixels (Could leave small blobs undetected.)
 	Iterator it; //node itarator for intern usage
 	Iterator it_next; //node itarator for intern usage
+	TreeArena arena; //storage of tree and tree_data, reused for every image.
 } Blobtree;
 
 
@@ -84,6 +86,23 @@ typedef struct {
 void blobtree_create(Blobtree **blob);
 void blobtree_destroy(Blobtree **blob );
 
+/* Drop the tree of the last image. Called by the *_find_blobs functions.
+ * The storage of the arena will not be free'd. */
+void blobtree_clear_tree(Blobtree *blob);
+
+/* Statistics of the tree arena. The arena grows
+ * only if the number of blobs exceeds the high water mark.
+ * All pointers are optional.
+ *
+ * nodes_high_water - Maximal number of nodes of a tree.
+ * scratch_high_water - Maximal length of temporary arrays.
+ * heap_allocs - Number of (re)allocations since blobtree_create.
+ * */
+void blobtree_arena_stats(const Blobtree *blob,
+		unsigned int *nodes_high_water,
+		unsigned int *scratch_high_water,
+		unsigned int *heap_allocs);
+
 /* Set one of the default filter values */
 void blobtree_set_filter( Blobtree *blob,const FILTER f,const unsigned int val);
 /* Add own node filter function */
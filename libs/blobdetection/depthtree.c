@@ -5,12 +5,20 @@
 #include <stdio.h>
 #include <time.h>
 #include <string.h> //for memset
+#include <limits.h>
 
 #include "blob.h"
 #include "depthtree.h"
 
 #include "depthtree_macros.h"
 
+static void depthtree_destroy_strips(
+		DepthtreeWorkspace *workspace
+		);
+static void depthtree_destroy_tiles(
+		DepthtreeWorkspace *workspace
+		);
+
 bool depthtree_create_workspace(
 		const unsigned int w, const unsigned int h,
 		DepthtreeWorkspace **pworkspace
@@ -29,6 +37,26 @@ bool depthtree_create_workspace(
 	const unsigned int max_comp = (w+h)*100U;
 	r->max_comp = max_comp;
 	r->used_comp = 0;
+	r->num_strips = 0;
+	r->strips = NULL;
+	r->workers = NULL;
+	r->incremental_valid = false;
+	r->prev_data = NULL;
+	r->num_tiles = 0;
+	r->tiles_x = 0;
+	r->tiles_y = 0;
+	r->tiles = NULL;
+	r->comp_len = 0;
+	r->comp_first = NULL;
+	r->comp_node = NULL;
+	r->comp_list = NULL;
+	r->comp_changed = NULL;
+	r->node_len = 0;
+	r->node_comp = NULL;
+	tree_patch_init(&r->patch);
+	r->real_ids = NULL;
+	r->real_ids_inv = NULL;
+	r->blob_id_filtered = NULL;
 
 	if(
 			( r->ids = (unsigned int*) malloc( w*h*sizeof(unsigned int) ) ) == NULL ||
@@ -37,8 +65,13 @@ bool depthtree_create_workspace(
 			( r->depths = (unsigned char*) calloc( w*h,sizeof(unsigned char) ) ) == NULL ||
 #endif
 			( r->id_depth = (unsigned int*) malloc( max_comp*sizeof(unsigned int) ) ) == NULL ||
+			( r->real_ids = (unsigned int*) malloc( max_comp*sizeof(unsigned int) ) ) == NULL ||
+			( r->real_ids_inv = (unsigned int*) malloc( max_comp*sizeof(unsigned int) ) ) == NULL ||
 			( r->comp_same = (unsigned int*) malloc( max_comp*sizeof(unsigned int) ) ) == NULL ||
 			( r->prob_parent = (unsigned int*) malloc( max_comp*sizeof(unsigned int) ) ) == NULL ||
+#ifdef BLOB_COMPONENT_RECORDS
+			( r->components = (BlobComponent*) malloc( max_comp*sizeof(BlobComponent) ) ) == NULL ||
+#else
 #ifdef BLOB_COUNT_PIXEL
 			( r->comp_size = (unsigned int*) malloc( max_comp*sizeof(unsigned int) ) ) == NULL ||
 #endif
@@ -51,6 +84,7 @@ bool depthtree_create_workspace(
 #ifdef BLOB_BARYCENTER
 			( r->pixel_sum_X = (BLOB_BARYCENTER_TYPE*) malloc( max_comp*sizeof(BLOB_BARYCENTER_TYPE) ) ) == NULL ||
 			( r->pixel_sum_Y = (BLOB_BARYCENTER_TYPE*) malloc( max_comp*sizeof(BLOB_BARYCENTER_TYPE) ) ) == NULL ||
+#endif
 #endif
 			( r->a_ids = (unsigned int*) malloc( 255*sizeof(unsigned int) ) ) == NULL || 
 			( r->b_ids = (unsigned int*) malloc( 255*sizeof(unsigned int) ) ) == NULL || 
@@ -65,6 +99,9 @@ bool depthtree_create_workspace(
 				depthtree_destroy_workspace( &r );
 				return false;
 			}
+#ifdef BLOB_COMPONENT_RECORDS
+	BLOB_COMP_LINK(r)
+#endif
 
 	/* setup first entry of *_ids and *_dep to 0->255. (0 is dummy entry with
 	 * depth 255).
@@ -75,11 +112,6 @@ bool depthtree_create_workspace(
 	r->c_ids[0] = 0; r->c_dep[0] = 255;
 	r->d_ids[0] = 0; r->d_dep[0] = 255;
 
-	r->real_ids = NULL;
-	r->real_ids_inv = NULL;
-
-	r->blob_id_filtered = NULL;
-
 	*pworkspace=r;
 	return true;
 }
@@ -93,8 +125,13 @@ bool depthtree_realloc_workspace(
 	r->max_comp = max_comp;
 	if( 
 			( r->id_depth = (unsigned int*) realloc(r->id_depth, max_comp*sizeof(unsigned int) ) ) == NULL ||
+			( r->real_ids = (unsigned int*) realloc(r->real_ids, max_comp*sizeof(unsigned int) ) ) == NULL ||
+			( r->real_ids_inv = (unsigned int*) realloc(r->real_ids_inv, max_comp*sizeof(unsigned int) ) ) == NULL ||
 			( r->comp_same = (unsigned int*) realloc(r->comp_same, max_comp*sizeof(unsigned int) ) ) == NULL ||
 			( r->prob_parent = (unsigned int*) realloc(r->prob_parent, max_comp*sizeof(unsigned int) ) ) == NULL ||
+#ifdef BLOB_COMPONENT_RECORDS
+			( r->components = (BlobComponent*) realloc(r->components, max_comp*sizeof(BlobComponent) ) ) == NULL ||
+#else
 #ifdef BLOB_COUNT_PIXEL
 			( r->comp_size = (unsigned int*) realloc(r->comp_size, max_comp*sizeof(unsigned int) ) ) == NULL ||
 #endif
@@ -107,6 +144,7 @@ bool depthtree_realloc_workspace(
 #ifdef BLOB_BARYCENTER_TYPE
 			( r->pixel_sum_X = (BLOB_BARYCENTER_TYPE*) realloc(r->pixel_sum_X, max_comp*sizeof(BLOB_BARYCENTER_TYPE) ) ) == NULL ||
 			( r->pixel_sum_Y = (BLOB_BARYCENTER_TYPE*) realloc(r->pixel_sum_Y, max_comp*sizeof(BLOB_BARYCENTER_TYPE) ) ) == NULL ||
+#endif
 #endif
 			0 ){
 		// realloc failed
@@ -114,6 +152,9 @@ bool depthtree_realloc_workspace(
 		depthtree_destroy_workspace( pworkspace );
 		return false;
 	}
+#ifdef BLOB_COMPONENT_RECORDS
+	BLOB_COMP_LINK(r)
+#endif
 
 	free(r->blob_id_filtered);//omit unnessecary reallocation and omit wrong/low size
 	r->blob_id_filtered = NULL;//should be allocated later if needed.
@@ -134,6 +175,9 @@ void depthtree_destroy_workspace(
 	free(r->id_depth);
 	free(r->comp_same);
 	free(r->prob_parent);
+#ifdef BLOB_COMPONENT_RECORDS
+	free(r->components);
+#else
 #ifdef BLOB_COUNT_PIXEL
 	free(r->comp_size);
 #endif
@@ -146,6 +190,7 @@ void depthtree_destroy_workspace(
 #ifdef BLOB_BARYCENTER
 	free(r->pixel_sum_X);
 	free(r->pixel_sum_Y);
+#endif
 #endif
 	free(r->a_ids);
 	free(r->b_ids);
@@ -161,19 +206,30 @@ void depthtree_destroy_workspace(
 
 	free(r->blob_id_filtered);
 
+	depthtree_destroy_strips(r);
+	blob_workers_destroy(&r->workers);
+	depthtree_destroy_tiles(r);
+	free(r->prev_data);
+	free(r->comp_first);
+	free(r->comp_node);
+	free(r->comp_list);
+	free(r->comp_changed);
+	free(r->node_comp);
+	tree_patch_destroy(&r->patch);
+
 	free(r);
 	*pworkspace = NULL;
 }
 
-	FORCEINLINE
-Tree* find_depthtree(
+static inline __attribute__((always_inline))
+unsigned int depthtree_label2(
 		const unsigned char *data,
 		const unsigned int w, const unsigned int h,
 		const BlobtreeRect roi,
 		const unsigned char *depth_map,
+		const unsigned char *imv_map,
 		const unsigned int stepwidth,
-		DepthtreeWorkspace *workspace,
-		Blob** tree_data )
+		DepthtreeWorkspace *workspace )
 {
 
 	//#define stepwidth 7 //speed up due faster addition for fixed stepwidth?!
@@ -209,8 +265,7 @@ Tree* find_depthtree(
 	unsigned int const b=h-roi.y-roi.height; //bottom border
 	if( r<0 || b<0 ){
 		fprintf(stderr,"[blob.c] BlobtreeRect not matching.\n");
-		*tree_data = NULL;
-		return NULL;
+		return 0;
 	}
 
 	unsigned int const swr = (roi.width-1)%stepwidth; // remainder of width/stepwidth;
@@ -220,7 +275,6 @@ Tree* find_depthtree(
 	unsigned int const sh2 = shr*w;
 
 	unsigned int id=-1;//id for last component, attention, unsigned variable!!
-	unsigned int k; //loop variable
 	unsigned int max_comp = workspace->max_comp; 
 	unsigned int idA, idB; 
 	unsigned char depX; 
@@ -273,20 +327,26 @@ Tree* find_depthtree(
 
 
 	/* Eval depth(roi) aka  *(depth_map+i) for i∈roi 
+	 * If imv_map is set, data contains 4 bytes per pixel (motion vectors)
+	 * and the depth will be looked up by the first two bytes,
+	 * see depthtree_create_imv_map.
 	 * */
 #ifndef NO_DEPTH_MAP
 	const unsigned char* dPi = dS; // Pointer to data+i 
+#define IMV_AT(P) (data + 4*((P)-data))
+#define DEPTH_OF(P) ( imv_map==NULL ? *(depth_map + *(P)) : \
+		*(imv_map + ( *IMV_AT(P) | (*(IMV_AT(P)+1) << 8) )) )
 
 	for( ; depPi<depE2 ;  ){
 		for( ; depPi<depR2 ; dPi += stepwidth, depPi += stepwidth ){
-			*depPi = *(depth_map + *dPi);
+			*depPi = DEPTH_OF(dPi);
 		} 
 
 		//handle last index of current line
 		dPi -= stepwidth-swr;
 		depPi -= stepwidth-swr;
 		if( swr ){
-			*depPi = *(depth_map + *dPi);
+			*depPi = DEPTH_OF(dPi);
 		}
 
 		//move pointer to 'next' row
@@ -304,17 +364,20 @@ Tree* find_depthtree(
 		depR2 -= sh-sh2;
 
 		for( ; depPi<depR2 ; dPi += stepwidth, depPi += stepwidth ){
-			*depPi = *(depth_map + *dPi);
+			*depPi = DEPTH_OF(dPi);
 		} 
 
 		//handle last index of current line
 		dPi -= stepwidth-swr;
 		depPi -= stepwidth-swr;
 		if( swr ){
-			*depPi = *(depth_map + *dPi);
+			*depPi = DEPTH_OF(dPi);
 		}
 	}
 
+#undef DEPTH_OF
+#undef IMV_AT
+
 	//reset pointer;
 	depPi = depths+(dS-data);
 	depR = depS+roi.width; 
@@ -335,12 +398,12 @@ Tree* find_depthtree(
 
 #ifdef BLOB_COUNT_PIXEL
 	/* Set size of dummy foreground component to 0. */
-	*(comp_size+0) = 0;
+	BLOB_COMP(comp_size, 0) = 0;
 #endif
 #ifdef BLOB_BARYCENTER
 	/* Dummy foreground should not influence the barycenter. */
-	*(pixel_sum_X+0) = 0;
-	*(pixel_sum_Y+0) = 0;
+	BLOB_COMP(pixel_sum_X, 0) = 0;
+	BLOB_COMP(pixel_sum_Y, 0) = 0;
 #endif
 
 
@@ -351,12 +414,12 @@ Tree* find_depthtree(
 	if( depX>0 ){
 #ifdef BLOB_COUNT_PIXEL
 		/* Set size of background dummy component to 0. */
-		*(comp_size+1) = 0;
+		BLOB_COMP(comp_size, 1) = 0;
 #endif
 #ifdef BLOB_BARYCENTER
 		/* Dummy background should not influence the barycenter. */
-		*(pixel_sum_X+1) = 0;
-		*(pixel_sum_Y+1) = 0;
+		BLOB_COMP(pixel_sum_X, 1) = 0;
+		BLOB_COMP(pixel_sum_Y, 1) = 0;
 #endif
 		NEW_COMPONENT(1, depX );
 	}else{
@@ -580,23 +643,48 @@ Tree* find_depthtree(
 	debug_print_matrix2( ids, comp_same, w, h, roi, 1, 1, true);
 #endif
 
+	return id+1; //number of ids
+#undef stepheight
+}
+
+Tree* depthtree_build_tree(
+		const BlobtreeRect roi,
+		const unsigned int nids,
+		Blob** tree_data,
+		DepthtreeWorkspace *workspace,
+		TreeArena *arena )
+{
+	const unsigned int id = nids-1; //last used id
+	unsigned int k; //loop variable
+
+	unsigned int* comp_same = workspace->comp_same; 
+	unsigned int* prob_parent = workspace->prob_parent; 
+	unsigned int* id_depth = workspace->id_depth; 
+#ifdef BLOB_COUNT_PIXEL
+	unsigned int* comp_size = workspace->comp_size; 
+#endif
+#ifdef BLOB_DIMENSION
+	unsigned int* top_index = workspace->top_index;
+	unsigned int* left_index = workspace->left_index;
+	unsigned int* right_index = workspace->right_index;
+	unsigned int* bottom_index = workspace->bottom_index;
+#endif
+#ifdef BLOB_BARYCENTER
+	BLOB_BARYCENTER_TYPE *pixel_sum_X = workspace->pixel_sum_X; 
+	BLOB_BARYCENTER_TYPE *pixel_sum_Y = workspace->pixel_sum_Y; 
+#endif
+
+	BLOB_PHASE_BEGIN(t_merge)
 	/* Postprocessing.
 	 * Sum up all areas with connecteted ids.
 	 * Then create nodes and connect them. 
 	 * If BLOB_DIMENSION is set, detect
 	 * extremal limits in [left|right|bottom]_index(*(real_ids+X)).
 	 * */
-	unsigned int nids = id+1; //number of ids
 	unsigned int tmp_id,/*tmp_id2,*/ real_ids_size=0,l;
-	//int* real_ids = calloc( nids,sizeof(int) ); //store join of ids.
-	//int* real_ids_inv = calloc( nids,sizeof(int) ); //store for every id with position in real_id link to it's position.
-	free(workspace->real_ids);
-	workspace->real_ids = calloc( nids, sizeof(int) ); //store join of ids.
-	unsigned int* const real_ids = workspace->real_ids;
-
-	free(workspace->real_ids_inv);
-	workspace->real_ids_inv = calloc( nids, sizeof(unsigned int) ); //store for every id with position in real_id link to it's position.
-	unsigned int* const real_ids_inv = workspace->real_ids_inv;
+	unsigned int* const real_ids = workspace->real_ids; //store join of ids.
+	unsigned int* const real_ids_inv = workspace->real_ids_inv; //store for every id with position in real_id link to it's position.
+	*real_ids_inv = 0; //the dummy component id=0 is not part of the loop.
 
 	for(k=1;k<nids;k++){ // k=1 skips the foreground dummy component id=0
 
@@ -624,28 +712,28 @@ Tree* find_depthtree(
 
 #ifdef BLOB_COUNT_PIXEL
 			//move area size to other id.
-			*(comp_size+tmp_id) += *(comp_size+k); 
-			*(comp_size+k) = 0;
+			BLOB_COMP(comp_size, tmp_id) += BLOB_COMP(comp_size, k); 
+			BLOB_COMP(comp_size, k) = 0;
 #endif
 
 #ifdef BLOB_DIMENSION
 			//update dimension
-			if( *( top_index+tmp_id ) > *( top_index+k ) )
-				*( top_index+tmp_id ) = *( top_index+k );
-			if( *( left_index+tmp_id ) > *( left_index+k ) )
-				*( left_index+tmp_id ) = *( left_index+k );
-			if( *( right_index+tmp_id ) < *( right_index+k ) )
-				*( right_index+tmp_id ) = *( right_index+k );
-			if( *( bottom_index+tmp_id ) < *( bottom_index+k ) )
-				*( bottom_index+tmp_id ) = *( bottom_index+k );
+			if( BLOB_COMP(top_index, tmp_id) > BLOB_COMP(top_index, k) )
+				BLOB_COMP(top_index, tmp_id) = BLOB_COMP(top_index, k);
+			if( BLOB_COMP(left_index, tmp_id) > BLOB_COMP(left_index, k) )
+				BLOB_COMP(left_index, tmp_id) = BLOB_COMP(left_index, k);
+			if( BLOB_COMP(right_index, tmp_id) < BLOB_COMP(right_index, k) )
+				BLOB_COMP(right_index, tmp_id) = BLOB_COMP(right_index, k);
+			if( BLOB_COMP(bottom_index, tmp_id) < BLOB_COMP(bottom_index, k) )
+				BLOB_COMP(bottom_index, tmp_id) = BLOB_COMP(bottom_index, k);
 #endif
 
 #ifdef BLOB_BARYCENTER
 			//shift values to other id
-			*(pixel_sum_X+tmp_id) += *(pixel_sum_X+k); 
-			*(pixel_sum_X+k) = 0;
-			*(pixel_sum_Y+tmp_id) += *(pixel_sum_Y+k); 
-			*(pixel_sum_Y+k) = 0;
+			BLOB_COMP(pixel_sum_X, tmp_id) += BLOB_COMP(pixel_sum_X, k); 
+			BLOB_COMP(pixel_sum_X, k) = 0;
+			BLOB_COMP(pixel_sum_Y, tmp_id) += BLOB_COMP(pixel_sum_Y, k); 
+			BLOB_COMP(pixel_sum_Y, k) = 0;
 #endif
 
 		}else{
@@ -657,21 +745,36 @@ Tree* find_depthtree(
 
 	}
 
+	BLOB_PHASE_END(BLOB_PHASE_MERGE, t_merge)
+	BLOB_PHASE_BEGIN(t_tree)
 	/*
 	 * Generate tree structure
 	 */
 
-	/* store for real_ids the index of the node in the tree array */
-	unsigned int *tree_id_relation = malloc( (real_ids_size+1)*sizeof(unsigned int) );
-
-	Node *nodes = malloc( (real_ids_size+1)*sizeof(Node) );
-	Blob *blobs = malloc( (real_ids_size+1)*sizeof(Blob) );
-	Tree *tree = malloc( sizeof(Tree) );
-	tree->root = nodes;
-	tree->size = real_ids_size + 1;
-
-	//init all node as leafs
-	for(l=0;l<real_ids_size+1;l++) *(nodes+l)=Leaf;
+	Node *nodes;
+	Blob *blobs;
+	Tree *tree;
+	/* store for every node the index of its last child */
+	unsigned int *last_child;
+	if( arena != NULL ){
+		tree = tree_arena_alloc(arena, real_ids_size+1, &blobs);
+		last_child = tree_arena_scratch(arena, real_ids_size+1);
+		if( tree == NULL || last_child == NULL ){
+			*tree_data = NULL;
+			return NULL;
+		}
+		nodes = tree->root;
+	}else{
+		nodes = malloc( (real_ids_size+1)*sizeof(Node) );
+		blobs = malloc( (real_ids_size+1)*sizeof(Blob) );
+		tree = malloc( sizeof(Tree) );
+		tree->root = nodes;
+		tree->size = real_ids_size + 1;
+		last_child = calloc( real_ids_size+1, sizeof(unsigned int) );
+
+		//init all node as leafs
+		for(l=0;l<real_ids_size+1;l++) *(nodes+l)=Leaf;
+	}
 
 	//set root node (the desired output are the child(ren) of this node.)
 	Node * const root = nodes;
@@ -702,15 +805,15 @@ Tree* find_depthtree(
 		curdata->id = rid;	//Set id of this blob.
 #ifdef BLOB_DIMENSION
 		rect = &curdata->roi;
-		rect->y = *(top_index + rid);
-		rect->height = *(bottom_index + rid) - rect->y + 1;
-		rect->x = *(left_index + rid);
-		rect->width = *(right_index + rid) - rect->x + 1;
+		rect->y = BLOB_COMP(top_index, rid);
+		rect->height = BLOB_COMP(bottom_index, rid) - rect->y + 1;
+		rect->x = BLOB_COMP(left_index, rid);
+		rect->width = BLOB_COMP(right_index, rid) - rect->x + 1;
 #endif
 #ifdef BLOB_BARYCENTER
 		/* The barycenter will not set here, but in eval_barycenters(...) */
-		//curdata->barycenter[0] = *(pixel_sum_X + rid) / *(comp_same + rid);
-		//curdata->barycenter[1] = *(pixel_sum_Y + rid) / *(comp_same + rid);
+		//curdata->barycenter[0] = BLOB_COMP(pixel_sum_X, rid) / *(comp_same + rid);
+		//curdata->barycenter[1] = BLOB_COMP(pixel_sum_Y, rid) / *(comp_same + rid);
 #endif
 #ifdef SAVE_DEPTH_MAP_VALUE
 		curdata->depth_level = *(id_depth + rid );
@@ -720,7 +823,7 @@ Tree* find_depthtree(
 		if( tmp_id == -1 /*=MAX_UINT*/ ){
 			/* Use root as parent node. */
 			//cur->parent = root;
-			add_child(root, cur );
+			add_child_indexed(root, root, cur, last_child);
 		}else{
 			//find real id of parent id.
 #if 1
@@ -735,13 +838,15 @@ Tree* find_depthtree(
 #endif
 
 			/*Now, tmp_id is in real_id array. And real_ids_inv is defined. */
-			add_child( root + 1/*root pos shift*/ + *(real_ids_inv+tmp_id ),
-					cur );
+			add_child_indexed(root, root + 1/*root pos shift*/ + *(real_ids_inv+tmp_id ),
+					cur, last_child);
 		}
 
 	}
 
 
+	BLOB_PHASE_END(BLOB_PHASE_TREE, t_tree)
+	BLOB_PHASE_BEGIN(t_areas)
 #ifdef BLOB_BARYCENTER
 	eval_barycenters(root->child,root, comp_size, pixel_sum_X, pixel_sum_Y);
 #define SUM_AREAS_IS_REDUNDANT
@@ -753,7 +858,7 @@ Tree* find_depthtree(
 	unsigned int ci;
 	printf("comp_size Array:\n");
 	for( ci=0 ; ci<nids; ci++){
-		printf("cs[%u]=%u\n",ci, *(comp_size + *(real_ids+ci) ) );
+		printf("cs[%u]=%u\n",ci, BLOB_COMP(comp_size, *(real_ids+ci)) );
 	}
 #endif
 #ifndef SUM_AREAS_IS_REDUNDANT
@@ -765,7 +870,7 @@ Tree* find_depthtree(
 	 * wrapping all blobs. In this case we could remove this
 	 * blob from the tree.
 	 * */
-	if( *(comp_size+1)==0 ){
+	if( BLOB_COMP(comp_size, 1)==0 ){
 		root->child = root->child->child;
 	}
 
@@ -775,6 +880,8 @@ Tree* find_depthtree(
 #endif
 #endif
 
+	BLOB_PHASE_END(BLOB_PHASE_AREAS, t_areas)
+
 #ifdef BLOB_SORT_TREE
 	//sort_tree(root->child);
 	sort_tree(root);
@@ -784,10 +891,7 @@ Tree* find_depthtree(
 	workspace->used_comp=id;
 
 	//clean up
-	free(tree_id_relation);
-
-	//free(real_ids);
-	//free(real_ids_inv);
+	if( arena == NULL ) free(last_child);
 
 	//set output parameter
 	//*tree_size = real_ids_size+1;
@@ -795,62 +899,1554 @@ Tree* find_depthtree(
 	return tree;
 }
 
+	FORCEINLINE
+Tree* find_depthtree(
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char *depth_map,
+		const unsigned int stepwidth,
+		DepthtreeWorkspace *workspace,
+		Blob** tree_data )
+{
+	const unsigned int nids = depthtree_label2(data, w, h, roi, depth_map,
+			NULL, stepwidth, workspace);
+	if( nids == 0 ){
+		*tree_data = NULL;
+		return NULL;
+	}
+	return depthtree_build_tree(roi, nids, tree_data, workspace, NULL);
+}
+
+unsigned int depthtree_label(
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char *depth_map,
+		const unsigned int stepwidth,
+		DepthtreeWorkspace *workspace )
+{
+	//constant stepwidth allows better optimization, see depthtree_find_blobs.
+	switch( stepwidth ){
+		case 1: return depthtree_label2(data, w, h, roi, depth_map, NULL, 1, workspace);
+		case 2: return depthtree_label2(data, w, h, roi, depth_map, NULL, 2, workspace);
+		case 3: return depthtree_label2(data, w, h, roi, depth_map, NULL, 3, workspace);
+		case 4: return depthtree_label2(data, w, h, roi, depth_map, NULL, 4, workspace);
+		default: return depthtree_label2(data, w, h, roi, depth_map, NULL, stepwidth, workspace);
+	}
+}
+
 
 void depthtree_find_blobs(Blobtree *blob, const unsigned char *data, const unsigned int w, const unsigned int h, const BlobtreeRect roi, const unsigned char *depth_map, DepthtreeWorkspace *workspace ){
 	//clear old tree
-	if( blob->tree != NULL){
-		tree_destroy(&blob->tree);
-		blob->tree = NULL;
+	blobtree_clear_tree(blob);
+	//get new blob tree structure.
+	//depthtree_label uses constant stepwidths for the common grids.
+	BLOB_PHASE_BEGIN(t_label)
+	const unsigned int nids = depthtree_label(data, w, h, roi, depth_map,
+			blob->grid.width, workspace);
+	BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+	if( nids > 0 ){
+		blob->tree = depthtree_build_tree(roi, nids, &blob->tree_data,
+				workspace, &blob->arena );
+	}
+}
+
+
+/* Parallel labeling
+ *
+ * The roi will be split into horizontal strips on rows of the grid.
+ * Each strip will be labeled by depthtree_label in its own workspace.
+ * Afterwards, the ids of the strips will be shifted into the id range
+ * of the parent workspace and the parent chains of all pixel pairs
+ * along the strip borders will be merged.
+ * Finally, depthtree_build_tree creates the tree as in the serial case.
+ *
+ * The ids of the strips are increasing in image order. Thus, the
+ * smallest id of each component is the id of its first pixel and
+ * the order of the nodes is the same as in the serial case.
+ */
+
+typedef struct {
+	const unsigned char *data; // data of strip begin.
+	unsigned int *ids; // ids of strip begin.
+	unsigned int w, h;
+	const unsigned char *depth_map;
+	unsigned int stepwidth;
+	DepthtreeStrip *strip;
+} DepthtreeStripJob;
+
+static void depthtree_destroy_strips(
+		DepthtreeWorkspace *workspace
+		){
+	unsigned int k;
+	if( workspace->strips == NULL ) return;
+
+	for( k=0; k<workspace->num_strips; k++){
+		DepthtreeStrip *strip = workspace->strips+k;
+		if( k>0 && strip->workspace != NULL ){
+			//owned by parent workspace
+			strip->workspace->ids = NULL;
+#ifndef NO_DEPTH_MAP
+			strip->workspace->depths = NULL;
+#endif
+			depthtree_destroy_workspace( &strip->workspace );
+		}
+		free(strip->id_map);
+	}
+	free(workspace->strips);
+	workspace->strips = NULL;
+	workspace->num_strips = 0;
+}
+
+static bool depthtree_create_strips(
+		const unsigned int num_strips,
+		DepthtreeWorkspace *workspace
+		){
+	unsigned int k;
+	if( workspace->num_strips == num_strips ) return true;
+	depthtree_destroy_strips( workspace );
+
+	workspace->strips = (DepthtreeStrip*) calloc( num_strips, sizeof(DepthtreeStrip) );
+	if( workspace->strips == NULL ) return false;
+	workspace->num_strips = num_strips;
+
+	//first strip will be labeled in the parent workspace.
+	workspace->strips->workspace = workspace;
+
+	const unsigned int max_comp = workspace->max_comp/num_strips + 1;
+	for( k=1; k<num_strips; k++){
+		DepthtreeStrip *strip = workspace->strips+k;
+		/* Only the component arrays and the chains are required. The ids
+		 * and depths arrays of the parent workspace will be shared. */
+		DepthtreeWorkspace *r = NULL;
+		if(
+				( r = strip->workspace = (DepthtreeWorkspace*) calloc( 1, sizeof(DepthtreeWorkspace) ) ) == NULL ||
+				!depthtree_realloc_workspace( max_comp, &strip->workspace ) ||
+				( r->a_ids = (unsigned int*) malloc( 255*sizeof(unsigned int) ) ) == NULL || 
+				( r->b_ids = (unsigned int*) malloc( 255*sizeof(unsigned int) ) ) == NULL || 
+				( r->c_ids = (unsigned int*) malloc( 255*sizeof(unsigned int) ) ) == NULL || 
+				( r->d_ids = (unsigned int*) malloc( 255*sizeof(unsigned int) ) ) == NULL || 
+				( r->a_dep = (unsigned char*) malloc( 255*sizeof(unsigned char) ) ) == NULL || 
+				( r->b_dep = (unsigned char*) malloc( 255*sizeof(unsigned char) ) ) == NULL || 
+				( r->c_dep = (unsigned char*) malloc( 255*sizeof(unsigned char) ) ) == NULL || 
+				( r->d_dep = (unsigned char*) malloc( 255*sizeof(unsigned char) ) ) == NULL ||
+				( strip->id_map = (unsigned int*) malloc( max_comp*sizeof(unsigned int) ) ) == NULL ||
+				0 ){
+			VPRINTF("Critical error: Allocation of strip workspace failed!\n");
+			depthtree_destroy_strips( workspace );
+			return false;
+		}
+		//dummy entries, see depthtree_create_workspace
+		r->a_ids[0] = 0; r->a_dep[0] = 255;
+		r->b_ids[0] = 0; r->b_dep[0] = 255;
+		r->c_ids[0] = 0; r->c_dep[0] = 255;
+		r->d_ids[0] = 0; r->d_dep[0] = 255;
+		strip->id_map_len = max_comp;
+	}
+	return true;
+}
+
+/* Next position of the coarse grid {0, step, 2*step, …, last}.
+ * Returns last+1 after the last position. */
+static inline unsigned int depthtree_grid_next(
+		const unsigned int pos,
+		const unsigned int step,
+		const unsigned int last
+		){
+	if( pos+step <= last ) return pos+step;
+	if( pos < last ) return last;
+	return last+1;
+}
+
+/* Merge the parent chains of two neighbouring pixels with ids a and b.
+ * This is the second step of INSERT_ELEMENT2 for two
+ * already labeled pixels. */
+static void depthtree_join_chains(
+		unsigned int * const comp_same,
+		unsigned int * const prob_parent,
+		const unsigned int * const id_depth,
+		unsigned int a, unsigned int b
+		){
+	unsigned int na, nb;
+	a = getRealId( comp_same, a);
+	b = getRealId( comp_same, b);
+
+	while( a != b ){
+		if( *(id_depth+a) > *(id_depth+b) ){
+			na = getRealParent( prob_parent, comp_same, a);
+			if( *(id_depth+na) < *(id_depth+b) ){
+				*(prob_parent+a) = b;
+			}
+			a = na;
+		}else if( *(id_depth+a) < *(id_depth+b) ){
+			nb = getRealParent( prob_parent, comp_same, b);
+			if( *(id_depth+nb) < *(id_depth+a) ){
+				*(prob_parent+b) = a;
+			}
+			b = nb;
+		}else{
+			//Map bigger id on smaller id
+			if( a < b ){
+				*(comp_same+b) = a;
+			}else{
+				*(comp_same+a) = b;
+			}
+			na = getRealParent( prob_parent, comp_same, a);
+			nb = getRealParent( prob_parent, comp_same, b);
+			if( *(id_depth+na) < *(id_depth+nb) ){
+				*(prob_parent+a) = nb;
+			}else{
+				*(prob_parent+b) = na;
+			}
+			a = na;
+			b = nb;
+		}
+	}
+}
+
+static void *depthtree_label_strip( void *arg ){
+	DepthtreeStripJob *job = (DepthtreeStripJob*) arg;
+	DepthtreeStrip *strip = job->strip;
+	strip->nids = depthtree_label( job->data, job->w, job->h,
+			strip->roi, job->depth_map, job->stepwidth,
+			strip->workspace );
+	return NULL;
+}
+
+/* Replace strip ids by the merged ids. */
+static void *depthtree_remap_strip( void *arg ){
+	DepthtreeStripJob *job = (DepthtreeStripJob*) arg;
+	const DepthtreeStrip *strip = job->strip;
+	const unsigned int * const id_map = strip->id_map;
+	const unsigned int xlast = strip->roi.x + strip->roi.width - 1;
+	const unsigned int ylast = strip->roi.y + strip->roi.height - 1;
+	unsigned int x, y;
+
+	for( y=strip->roi.y; y<=ylast; y=depthtree_grid_next(y, job->stepwidth, ylast) ){
+		unsigned int * const iRow = job->ids + y*job->w;
+		for( x=strip->roi.x; x<=xlast; x=depthtree_grid_next(x, job->stepwidth, xlast) ){
+			*(iRow+x) = *(id_map+*(iRow+x));
+		}
+	}
+	return NULL;
+}
+
+/* Move ids of all strips into the parent workspace
+ * and merge the parent chains along the strip borders.
+ *
+ * The dummy ids 0 and 1 of each strip will be mapped on the
+ * dummy ids of the parent workspace. All other ids will be
+ * appended.
+ */
+static bool depthtree_merge_strips(
+		const unsigned int w,
+		const BlobtreeRect roi,
+		const unsigned int stepwidth,
+		DepthtreeWorkspace *workspace,
+		unsigned int *pnids )
+{
+	DepthtreeStrip * const strips = workspace->strips;
+	const unsigned int xlast = roi.x + roi.width - 1;
+	unsigned int nids = strips->nids;
+	unsigned int j, k, x, xp, xn, pp;
+
+	for( k=1; k<workspace->num_strips; k++){
+		DepthtreeStrip * const strip = strips+k;
+		const DepthtreeWorkspace * const sw = strip->workspace;
+		const unsigned int snids = strip->nids;
+		const unsigned int oy = strip->offset_y;
+
+		//Last grid row of upper strip and first row of this strip
+		const unsigned int * const iU = workspace->ids + (oy-stepwidth)*w;
+		const unsigned int * const iL = workspace->ids + oy*w;
+		//ids of first strip are already final.
+		const unsigned int * const uMap = (k==1)?NULL:(strips+k-1)->id_map;
+#define UPPER_ID(X) ( uMap==NULL ? *(iU+(X)) : *(uMap+*(iU+(X))) )
+
+		if( strip->id_map_len < snids ){
+			free(strip->id_map);
+			strip->id_map = (unsigned int*) malloc( sw->max_comp*sizeof(unsigned int) );
+			if( strip->id_map == NULL ){
+				strip->id_map_len = 0;
+				return false;
+			}
+			strip->id_map_len = sw->max_comp;
+		}
+		unsigned int * const id_map = strip->id_map;
+
+		*(id_map+0) = 0;
+		*(id_map+1) = 1;
+		for( j=2; j<snids; j++){
+			*(id_map+j) = nids++;
+		}
+
+		if( nids > workspace->max_comp ){
+			if( !depthtree_realloc_workspace( nids + nids/4, &workspace ) ){
+				return false;
+			}
+		}
+
+		unsigned int * const comp_same = workspace->comp_same;
+		unsigned int * const prob_parent = workspace->prob_parent;
+		unsigned int * const id_depth = workspace->id_depth;
+#ifdef BLOB_COUNT_PIXEL
+		unsigned int * const comp_size = workspace->comp_size;
+#endif
+#ifdef BLOB_DIMENSION
+		unsigned int * const top_index = workspace->top_index;
+		unsigned int * const left_index = workspace->left_index;
+		unsigned int * const right_index = workspace->right_index;
+		unsigned int * const bottom_index = workspace->bottom_index;
+#endif
+#ifdef BLOB_BARYCENTER
+		BLOB_BARYCENTER_TYPE * const pixel_sum_X = workspace->pixel_sum_X; 
+		BLOB_BARYCENTER_TYPE * const pixel_sum_Y = workspace->pixel_sum_Y; 
+#endif
+
+		/* 1. Copy component data. The row values of the strip
+		 * are relative to oy. */
+		for( j=2; j<snids; j++){
+			const unsigned int g = *(id_map+j);
+			*(id_depth+g) = *(sw->id_depth+j);
+			//comp_same(j) <= j holds for the mapped ids, too.
+			*(comp_same+g) = *(id_map+*(sw->comp_same+j));
+			pp = *(sw->prob_parent+j);
+			*(prob_parent+g) = ( pp < snids ) ? *(id_map+pp) : pp;
+#ifdef BLOB_COUNT_PIXEL
+			BLOB_COMP(comp_size, g) = BLOB_COMP(sw->comp_size, j);
+#endif
+#ifdef BLOB_DIMENSION
+			BLOB_COMP(top_index, g) = BLOB_COMP(sw->top_index, j) + oy;
+			BLOB_COMP(left_index, g) = BLOB_COMP(sw->left_index, j);
+			BLOB_COMP(right_index, g) = BLOB_COMP(sw->right_index, j);
+			BLOB_COMP(bottom_index, g) = BLOB_COMP(sw->bottom_index, j) + oy;
+#endif
+#ifdef BLOB_BARYCENTER
+			BLOB_COMP(pixel_sum_X, g) = BLOB_COMP(sw->pixel_sum_X, j);
+			BLOB_COMP(pixel_sum_Y, g) = BLOB_COMP(sw->pixel_sum_Y, j)
+				+ (BLOB_BARYCENTER_TYPE) oy * BLOB_COMP(sw->comp_size, j);
+#endif
+		}
+
+		/* 2. Add pixels of background dummy (depth=0).
+		 * The bounding box of the dummy always contains the top, left
+		 * corner of the roi. Ignore it if no pixel has depth=0. */
+#ifdef BLOB_COUNT_PIXEL
+		if( BLOB_COMP(sw->comp_size, 1) > 0 )
+#endif
+		{
+#ifdef BLOB_COUNT_PIXEL
+			BLOB_COMP(comp_size, 1) += BLOB_COMP(sw->comp_size, 1);
+#endif
+#ifdef BLOB_DIMENSION
+			if( BLOB_COMP(left_index, 1) > BLOB_COMP(sw->left_index, 1) )
+				BLOB_COMP(left_index, 1) = BLOB_COMP(sw->left_index, 1);
+			if( BLOB_COMP(right_index, 1) < BLOB_COMP(sw->right_index, 1) )
+				BLOB_COMP(right_index, 1) = BLOB_COMP(sw->right_index, 1);
+			if( BLOB_COMP(bottom_index, 1) < BLOB_COMP(sw->bottom_index, 1) + oy )
+				BLOB_COMP(bottom_index, 1) = BLOB_COMP(sw->bottom_index, 1) + oy;
+#endif
+#ifdef BLOB_BARYCENTER
+			BLOB_COMP(pixel_sum_X, 1) += BLOB_COMP(sw->pixel_sum_X, 1);
+			BLOB_COMP(pixel_sum_Y, 1) += BLOB_COMP(sw->pixel_sum_Y, 1)
+				+ (BLOB_BARYCENTER_TYPE) oy * BLOB_COMP(sw->comp_size, 1);
+#endif
+		}
+
+		/* 3. Merge chains along the strip border. Each pixel of the first row
+		 * is connected with its three neighbours in the row above. */
+		xp = xlast+1; //no left neighbour
+		for( x=roi.x; x<=xlast; xp=x, x=xn ){
+			xn = depthtree_grid_next(x, stepwidth, xlast);
+			const unsigned int g = *(id_map+*(iL+x));
+			if( xp<=xlast ){
+				depthtree_join_chains(comp_same, prob_parent, id_depth, UPPER_ID(xp), g);
+			}
+			depthtree_join_chains(comp_same, prob_parent, id_depth, UPPER_ID(x), g);
+			if( xn<=xlast ){
+				depthtree_join_chains(comp_same, prob_parent, id_depth, UPPER_ID(xn), g);
+			}
+		}
+#undef UPPER_ID
+	}
+
+	*pnids = nids;
+	return true;
+}
+
+void depthtree_find_blobs_parallel(
+		Blobtree *blob,
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char *depth_map,
+		const unsigned int num_threads,
+		DepthtreeWorkspace *workspace
+		){
+	const unsigned int stepwidth = blob->grid.width;
+	/* Number of rows of the coarse grid. 
+	 * Every strip should contain at least two rows. */
+	const unsigned int grid_rows = (roi.height-1)/stepwidth + 1;
+	unsigned int num_strips = num_threads;
+	if( num_strips > grid_rows/2 ) num_strips = grid_rows/2;
+
+	if( num_strips < 2 || !depthtree_create_strips(num_strips, workspace) ){
+		depthtree_find_blobs(blob, data, w, h, roi, depth_map, workspace);
+		return;
+	}
+
+	//clear old tree
+	blobtree_clear_tree(blob);
+	BLOB_PHASE_BEGIN(t_label)
+
+	DepthtreeStrip * const strips = workspace->strips;
+	DepthtreeStripJob jobs[num_strips];
+	unsigned int k, nids;
+
+	/* The threads survive the call. Without them, the strips
+	 * will be labeled one after another. */
+	if( !blob_workers_create(num_strips-1, &workspace->workers) ){
+		VPRINTF("(depthtree) Start of worker threads failed. Label strips serial.\n");
 	}
-	if( blob->tree_data != NULL){
-		free(blob->tree_data);
-		blob->tree_data = NULL;
+
+	/* Split roi into strips. Each strip begins on a row of the grid. */
+	for( k=0; k<num_strips; k++){
+		DepthtreeStrip * const strip = strips+k;
+		const unsigned int g0 = k*grid_rows/num_strips;
+		const unsigned int g1 = (k+1)*grid_rows/num_strips;
+
+		strip->offset_y = roi.y + g0*stepwidth;
+		strip->roi.x = roi.x;
+		strip->roi.width = roi.width;
+		strip->roi.height = ( k+1<num_strips ) ?
+			(g1-g0-1)*stepwidth + 1 : roi.y + roi.height - strip->offset_y;
+		strip->nids = 0;
+
+		jobs[k].w = w;
+		jobs[k].depth_map = depth_map;
+		jobs[k].stepwidth = stepwidth;
+		jobs[k].strip = strip;
+		if( k == 0 ){
+			strip->roi.y = roi.y;
+			jobs[k].data = data;
+			jobs[k].ids = workspace->ids;
+			jobs[k].h = h;
+		}else{
+			/* Shift data pointer to avoid big coordinates in the strip
+			 * workspace. The row offset will be added in the merge step. */
+			strip->roi.y = 0;
+			jobs[k].data = data + strip->offset_y*w;
+			jobs[k].ids = workspace->ids + strip->offset_y*w;
+			jobs[k].h = strip->roi.height;
+			strip->workspace->ids = jobs[k].ids;
+#ifndef NO_DEPTH_MAP
+			strip->workspace->depths = workspace->depths + strip->offset_y*w;
+#endif
+		}
+	}
+
+	/* 1. Label strips */
+	blob_workers_run(workspace->workers, depthtree_label_strip,
+			jobs, sizeof(DepthtreeStripJob), 0, num_strips);
+
+	/* 2. Merge ids */
+	for( k=0; k<num_strips; k++){
+		if( (strips+k)->nids == 0 ){
+			//labeling failed. No tree for this frame.
+			blob->tree = NULL;
+			BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+			return;
+		}
 	}
+	if( !depthtree_merge_strips(w, roi, stepwidth, workspace, &nids ) ){
+		printf("(depthtree) Critical error: Merging of strips failed\n");
+		blob->tree = NULL;
+		BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+		return;
+	}
+
+	/* 3. Update ids array. The first strip already contains the merged ids. */
+	blob_workers_run(workspace->workers, depthtree_remap_strip,
+			jobs, sizeof(DepthtreeStripJob), 1, num_strips);
+
+	BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
 	//get new blob tree structure.
-	/*
-		 if( blob->grid.height == 11 ){
-		 blob->tree = find_depthtree11(data, w, h, roi, depth_map, 
-		 workspace, &blob->tree_data);
-		 }else{
-		 blob->tree = find_depthtree(data, w, h, roi, depth_map, 
-		 blob->grid.width,
-		 workspace, &blob->tree_data);
-		 }*/
-
-	if( blob->grid.width == 1 ){
-		blob->tree = find_depthtree(data, w, h, roi, depth_map, 1, workspace, &blob->tree_data);
-	}else if( blob->grid.width == 2 ){
-		blob->tree = find_depthtree(data, w, h, roi, depth_map, 2, workspace, &blob->tree_data);
-	}else if( blob->grid.width == 3 ){
-		blob->tree = find_depthtree(data, w, h, roi, depth_map, 3, workspace, &blob->tree_data);
-	}else if( blob->grid.width == 4 ){
-		blob->tree = find_depthtree(data, w, h, roi, depth_map, 4, workspace, &blob->tree_data);
-		/*
-			 }else if( blob->grid.width == 5 ){
-			 blob->tree = find_depthtree(data, w, h, roi, depth_map, 5, workspace, &blob->tree_data);
-			 }else if( blob->grid.width == 6 ){
-			 blob->tree = find_depthtree(data, w, h, roi, depth_map, 6, workspace, &blob->tree_data);
-			 }else if( blob->grid.width == 7 ){
-			 blob->tree = find_depthtree(data, w, h, roi, depth_map, 7, workspace, &blob->tree_data);
-			 }else if( blob->grid.width == 8 ){
-			 blob->tree = find_depthtree(data, w, h, roi, depth_map, 8, workspace, &blob->tree_data);
-			 }else if( blob->grid.width == 9 ){
-			 blob->tree = find_depthtree(data, w, h, roi, depth_map, 9, workspace, &blob->tree_data);
-			 }else if( blob->grid.width == 10 ){
-			 blob->tree = find_depthtree(data, w, h, roi, depth_map, 10, workspace, &blob->tree_data);
-			 }else if( blob->grid.width == 11 ){
-			 blob->tree = find_depthtree(data, w, h, roi, depth_map, 11, workspace, &blob->tree_data);
-			 */
+	blob->tree = depthtree_build_tree(roi, nids, &blob->tree_data, workspace, &blob->arena );
+}
+
+
+/* Incremental labeling.
+ *
+ * The roi will be split into tiles like in threshtree_find_blobs_incremental.
+ * Every tile will be labeled by depthtree_label on its own and keeps its
+ * labels and component data until it changes.
+ *
+ * After the labeling, the ids of a tile will be joined and the components
+ * compacted. The dummy ids 0 and 1 of the tile will be mapped on the
+ * dummy ids of the parent workspace, component j of the tile gets the
+ * id first_id+j. The parent of each component (inside of the tile) will
+ * be stored, too.
+ *
+ * For each image, the parent chains of the components will be set up
+ * from the tiles and merged along the left and upper border of each
+ * tile like in depthtree_merge_strips. The pairs of ids along the
+ * borders (seams) will be kept until one of the neighbouring tiles changes.
+ *
+ * Finally, the tree of the last image will be patched, see treepatch.h.
+ * As in the serial algorithm, the nodes are ordered by the first pixels
+ * of the components. The background (id 1) always gets node 1.
+ */
+
+static void depthtree_destroy_tiles(
+		DepthtreeWorkspace *workspace
+		){
+	unsigned int k;
+	if( workspace->tiles == NULL ) return;
+
+	for( k=0; k<workspace->num_tiles; k++){
+		DepthtreeTile *tile = workspace->tiles+k;
+		if( tile->workspace != NULL ){
+			//owned by parent workspace
+			tile->workspace->ids = NULL;
+#ifndef NO_DEPTH_MAP
+			tile->workspace->depths = NULL;
+#endif
+			depthtree_destroy_workspace( &tile->workspace );
+		}
+		free(tile->first_pixel);
+		free(tile->parent);
+		free(tile->comp_map);
+		free(tile->node);
+		free(tile->is_first);
+		free(tile->seam);
+	}
+	free(workspace->tiles);
+	workspace->tiles = NULL;
+	workspace->num_tiles = 0;
+	workspace->tiles_x = 0;
+	workspace->tiles_y = 0;
+	workspace->incremental_valid = false;
+}
+
+static bool depthtree_create_tiles(
+		const unsigned int tiles_x,
+		const unsigned int tiles_y,
+		DepthtreeWorkspace *workspace
+		){
+	unsigned int k;
+	if( workspace->tiles_x == tiles_x && workspace->tiles_y == tiles_y ){
+		return true;
+	}
+	depthtree_destroy_tiles( workspace );
+
+	const unsigned int num_tiles = tiles_x*tiles_y;
+	workspace->tiles = (DepthtreeTile*) calloc( num_tiles, sizeof(DepthtreeTile) );
+	if( workspace->tiles == NULL ) return false;
+	workspace->num_tiles = num_tiles;
+	workspace->tiles_x = tiles_x;
+	workspace->tiles_y = tiles_y;
+
+	const unsigned int max_comp = workspace->max_comp/num_tiles + 1;
+	for( k=0; k<num_tiles; k++){
+		DepthtreeTile *tile = workspace->tiles+k;
+		/* Only the component arrays and the chains are required. The ids
+		 * and depths arrays of the parent workspace will be shared. */
+		DepthtreeWorkspace *r = NULL;
+		if(
+				( r = tile->workspace = (DepthtreeWorkspace*) calloc( 1, sizeof(DepthtreeWorkspace) ) ) == NULL ||
+				!depthtree_realloc_workspace( max_comp, &tile->workspace ) ||
+				( r->a_ids = (unsigned int*) malloc( 255*sizeof(unsigned int) ) ) == NULL ||
+				( r->b_ids = (unsigned int*) malloc( 255*sizeof(unsigned int) ) ) == NULL ||
+				( r->c_ids = (unsigned int*) malloc( 255*sizeof(unsigned int) ) ) == NULL ||
+				( r->d_ids = (unsigned int*) malloc( 255*sizeof(unsigned int) ) ) == NULL ||
+				( r->a_dep = (unsigned char*) malloc( 255*sizeof(unsigned char) ) ) == NULL ||
+				( r->b_dep = (unsigned char*) malloc( 255*sizeof(unsigned char) ) ) == NULL ||
+				( r->c_dep = (unsigned char*) malloc( 255*sizeof(unsigned char) ) ) == NULL ||
+				( r->d_dep = (unsigned char*) malloc( 255*sizeof(unsigned char) ) ) == NULL ||
+				0 ){
+			VPRINTF("Critical error: Allocation of tile workspace failed!\n");
+			depthtree_destroy_tiles( workspace );
+			return false;
+		}
+		//dummy entries, see depthtree_create_workspace
+		r->a_ids[0] = 0; r->a_dep[0] = 255;
+		r->b_ids[0] = 0; r->b_dep[0] = 255;
+		r->c_ids[0] = 0; r->c_dep[0] = 255;
+		r->d_ids[0] = 0; r->d_dep[0] = 255;
+	}
+	return true;
+}
+
+/* Grow the arrays of the tile components. */
+static bool depthtree_tile_reserve(
+		DepthtreeTile *tile,
+		const unsigned int len
+		){
+	if( tile->comp_len >= len ) return true;
+	if(
+			( tile->first_pixel = (unsigned int*) realloc(tile->first_pixel, len*sizeof(unsigned int) ) ) == NULL ||
+			( tile->parent = (unsigned int*) realloc(tile->parent, len*sizeof(unsigned int) ) ) == NULL ||
+			( tile->comp_map = (unsigned int*) realloc(tile->comp_map, len*sizeof(unsigned int) ) ) == NULL ||
+			( tile->node = (unsigned int*) realloc(tile->node, len*sizeof(unsigned int) ) ) == NULL ||
+			( tile->is_first = (unsigned char*) realloc(tile->is_first, len*sizeof(unsigned char) ) ) == NULL ||
+			0 ){
+		tile->comp_len = 0;
+		return false;
+	}
+	tile->comp_len = len;
+	return true;
+}
+
+/* Returns true if a cell of dirty_tiles which overlaps the tile is marked as dirty. */
+static bool depthtree_tile_has_dirty_cell(
+		const DepthtreeTile *tile,
+		const BlobtreeRect roi,
+		const unsigned char *dirty_tiles )
+{
+	const unsigned int cells_x = (roi.width + BLOB_TILE_SIZE - 1)/BLOB_TILE_SIZE;
+	const unsigned int c0 = (tile->roi.x - roi.x)/BLOB_TILE_SIZE;
+	const unsigned int c1 = (tile->roi.x + tile->roi.width - 1 - roi.x)/BLOB_TILE_SIZE;
+	const unsigned int r0 = (tile->offset_y - roi.y)/BLOB_TILE_SIZE;
+	const unsigned int r1 = (tile->offset_y + tile->roi.height - 1 - roi.y)/BLOB_TILE_SIZE;
+	unsigned int r, c;
+	for( r=r0; r<=r1; r++){
+		const unsigned char * const row = dirty_tiles + r*cells_x;
+		for( c=c0; c<=c1; c++){
+			if( *(row+c) ) return true;
+		}
+	}
+	return false;
+}
+
+#ifdef NO_DEPTH_MAP
+#define DEPTHTREE_DEPTH(V) (V)
+#else
+#define DEPTHTREE_DEPTH(V) *(depth_map+(V))
+#endif
+
+/* Compare grid rows of the tile with the last image and update the
+ * copy of the last image. Returns true if a pixel of the grid changed its depth. */
+static bool depthtree_tile_diff(
+		const DepthtreeTile *tile,
+		const unsigned char *data,
+		const unsigned int w,
+		const unsigned char *depth_map,
+		const unsigned int stepwidth,
+		unsigned char *prev_data )
+{
+	const unsigned int xlast = tile->roi.width - 1;
+	const unsigned int ylast = tile->offset_y + tile->roi.height - 1;
+	bool dirty = false;
+	unsigned int x, y;
+
+	for( y=tile->offset_y; y<=ylast; y=depthtree_grid_next(y, stepwidth, ylast) ){
+		const unsigned char * const dRow = data + y*w + tile->roi.x;
+		unsigned char * const pRow = prev_data + y*w + tile->roi.x;
+		if( memcmp(dRow, pRow, tile->roi.width) == 0 ) continue;
+
+		for( x=0; !dirty && x<=xlast; x=depthtree_grid_next(x, stepwidth, xlast) ){
+			if( DEPTHTREE_DEPTH(*(dRow+x)) != DEPTHTREE_DEPTH(*(pRow+x)) ) dirty = true;
+		}
+		memcpy(pRow, dRow, tile->roi.width);
+	}
+	return dirty;
+}
+#undef DEPTHTREE_DEPTH
+
+/* Copy grid rows of the tile into the copy of the last image. */
+static void depthtree_tile_store(
+		const DepthtreeTile *tile,
+		const unsigned char *data,
+		const unsigned int w,
+		const unsigned int stepwidth,
+		unsigned char *prev_data )
+{
+	const unsigned int ylast = tile->offset_y + tile->roi.height - 1;
+	unsigned int y;
+	for( y=tile->offset_y; y<=ylast; y=depthtree_grid_next(y, stepwidth, ylast) ){
+		memcpy(prev_data + y*w + tile->roi.x, data + y*w + tile->roi.x, tile->roi.width);
+	}
+}
+
+/* Label the tile and compact its components.
+ *
+ * The ids of the tile will be joined like in depthtree_build_tree.
+ * Afterwards, the data of the j-th component (ordered by their first
+ * pixels) will be moved to index j+2 of the component arrays of the
+ * tile workspace and comp_map maps the joined ids on j.
+ * The dummy components 0 and 1 stay at their positions.
+ * Returns false on errors.
+ */
+static bool depthtree_label_tile(
+		DepthtreeTile *tile,
+		const unsigned char *data,
+		const unsigned int w,
+		const unsigned char *depth_map,
+		const unsigned int stepwidth )
+{
+	const unsigned int nids = depthtree_label( data + tile->offset_y*w, w,
+			tile->roi.height, tile->roi, depth_map, stepwidth, tile->workspace );
+	if( nids == 0 ) return false;
+	if( !depthtree_tile_reserve(tile, nids) ) return false;
+
+	DepthtreeWorkspace * const sw = tile->workspace;
+	unsigned int * const comp_same = sw->comp_same;
+	unsigned int * const prob_parent = sw->prob_parent;
+	unsigned int * const id_depth = sw->id_depth;
+	unsigned int * const comp_map = tile->comp_map;
+#ifdef BLOB_COUNT_PIXEL
+	unsigned int * const comp_size = sw->comp_size;
+#endif
+#ifdef BLOB_DIMENSION
+	unsigned int * const top_index = sw->top_index;
+	unsigned int * const left_index = sw->left_index;
+	unsigned int * const right_index = sw->right_index;
+	unsigned int * const bottom_index = sw->bottom_index;
+#endif
+#ifdef BLOB_BARYCENTER
+	BLOB_BARYCENTER_TYPE * const pixel_sum_X = sw->pixel_sum_X;
+	BLOB_BARYCENTER_TYPE * const pixel_sum_Y = sw->pixel_sum_Y;
+#endif
+	unsigned int k, r, j;
+
+	/* 1. Join ids. comp_same(k) <= k holds, thus one pass
+	 * in increasing order creates the projection. Only the background
+	 * has depth 0, thus no id will be joined with the dummy ids. */
+	for( k=2; k<nids; k++){
+		r = *(comp_same+*(comp_same+k));
+		*(comp_same+k) = r;
+		if( r == k ) continue;
+#ifdef BLOB_COUNT_PIXEL
+		BLOB_COMP(comp_size, r) += BLOB_COMP(comp_size, k);
+#endif
+#ifdef BLOB_DIMENSION
+		if( BLOB_COMP(top_index, r) > BLOB_COMP(top_index, k) )
+			BLOB_COMP(top_index, r) = BLOB_COMP(top_index, k);
+		if( BLOB_COMP(left_index, r) > BLOB_COMP(left_index, k) )
+			BLOB_COMP(left_index, r) = BLOB_COMP(left_index, k);
+		if( BLOB_COMP(right_index, r) < BLOB_COMP(right_index, k) )
+			BLOB_COMP(right_index, r) = BLOB_COMP(right_index, k);
+		if( BLOB_COMP(bottom_index, r) < BLOB_COMP(bottom_index, k) )
+			BLOB_COMP(bottom_index, r) = BLOB_COMP(bottom_index, k);
+#endif
+#ifdef BLOB_BARYCENTER
+		BLOB_COMP(pixel_sum_X, r) += BLOB_COMP(pixel_sum_X, k);
+		BLOB_COMP(pixel_sum_Y, r) += BLOB_COMP(pixel_sum_Y, k);
+#endif
+	}
+
+	/* 2. Compact the components. The smallest id of a component
+	 * belongs to its first pixel. Index j+2<=k was already handled. */
+	for( k=2, j=0; k<nids; k++){
+		if( *(comp_same+k) != k ) continue;
+		*(comp_map+k) = j;
+		*(id_depth+j+2) = *(id_depth+k);
+#ifdef BLOB_COUNT_PIXEL
+		BLOB_COMP(comp_size, j+2) = BLOB_COMP(comp_size, k);
+#endif
+#ifdef BLOB_DIMENSION
+		BLOB_COMP(top_index, j+2) = BLOB_COMP(top_index, k);
+		BLOB_COMP(left_index, j+2) = BLOB_COMP(left_index, k);
+		BLOB_COMP(right_index, j+2) = BLOB_COMP(right_index, k);
+		BLOB_COMP(bottom_index, j+2) = BLOB_COMP(bottom_index, k);
+#endif
+#ifdef BLOB_BARYCENTER
+		BLOB_COMP(pixel_sum_X, j+2) = BLOB_COMP(pixel_sum_X, k);
+		BLOB_COMP(pixel_sum_Y, j+2) = BLOB_COMP(pixel_sum_Y, k);
+#endif
+		j++;
+	}
+	tile->ncomp = j;
+
+	/* 3. Parents of the components. */
+	for( k=2; k<nids; k++){
+		if( *(comp_same+k) != k ) continue;
+		r = *(comp_same+*(prob_parent+k));
+		*(tile->parent+*(comp_map+k)) = ( r == 1 ) ? UINT_MAX : *(comp_map+r);
+	}
+	return true;
+}
+
+/* Replace the ids of a new labeled tile by first_id + component (or
+ * the background id 1) and store the first pixel of each component. */
+static void depthtree_remap_tile(
+		DepthtreeTile *tile,
+		const unsigned int w,
+		const unsigned int stepwidth,
+		unsigned int *ids )
+{
+	const unsigned int * const comp_same = tile->workspace->comp_same;
+	const unsigned int * const comp_map = tile->comp_map;
+	const unsigned int first_id = tile->first_id;
+	const unsigned int xlast = tile->roi.x + tile->roi.width - 1;
+	const unsigned int ylast = tile->offset_y + tile->roi.height - 1;
+	unsigned int x, y, next = 0;
+
+	for( y=tile->offset_y; y<=ylast; y=depthtree_grid_next(y, stepwidth, ylast) ){
+		unsigned int * const iRow = ids + y*w;
+		for( x=tile->roi.x; x<=xlast; x=depthtree_grid_next(x, stepwidth, xlast) ){
+			const unsigned int l = *(comp_same+*(iRow+x));
+			if( l == 1 ) continue;
+			const unsigned int c = *(comp_map+l);
+			*(iRow+x) = first_id + c;
+			if( c != next ) continue;
+
+			//first pixel of component c
+			*(tile->first_pixel+c) = y*w + x;
+			next++;
+		}
+	}
+}
+
+/* Add offset to the ids of an unchanged tile. */
+static void depthtree_shift_tile(
+		const DepthtreeTile *tile,
+		const unsigned int w,
+		const unsigned int stepwidth,
+		const unsigned int offset,
+		unsigned int *ids )
+{
+	const unsigned int xlast = tile->roi.x + tile->roi.width - 1;
+	const unsigned int ylast = tile->offset_y + tile->roi.height - 1;
+	unsigned int x, y;
+
+	for( y=tile->offset_y; y<=ylast; y=depthtree_grid_next(y, stepwidth, ylast) ){
+		unsigned int * const iRow = ids + y*w;
+		for( x=tile->roi.x; x<=xlast; x=depthtree_grid_next(x, stepwidth, xlast) ){
+			if( *(iRow+x) != 1 ) *(iRow+x) += offset;
+		}
+	}
+}
+
+/* Pairs with the background id 1 or equal ids do not change
+ * the chains, see depthtree_join_chains. */
+static inline bool depthtree_tile_add_pair(
+		DepthtreeTile *tile,
+		const unsigned int a,
+		const unsigned int b )
+{
+	if( a == b || a == 1 || b == 1 ) return true;
+	if( tile->seam_len > 0 && *(tile->seam+tile->seam_len-2) == a
+			&& *(tile->seam+tile->seam_len-1) == b ){
+		return true;
+	}
+	if( tile->seam_len+2 > tile->seam_max ){
+		const unsigned int seam_max = 2*tile->seam_max + 64;
+		unsigned int *tmp = (unsigned int*) realloc(tile->seam, seam_max*sizeof(unsigned int) );
+		if( tmp == NULL ) return false;
+		tile->seam = tmp;
+		tile->seam_max = seam_max;
+	}
+	*(tile->seam+tile->seam_len) = a;
+	*(tile->seam+tile->seam_len+1) = b;
+	tile->seam_len += 2;
+	return true;
+}
+
+/* Collect the pairs of ids of neighbouring pixels along the left and
+ * upper border of the tile. The diagonal neighbours across the corners
+ * of the tile are part of the upper border. */
+static bool depthtree_tile_seams(
+		DepthtreeTile *tile,
+		const unsigned int w,
+		const BlobtreeRect roi,
+		const unsigned int stepwidth,
+		const unsigned int *ids )
+{
+	const unsigned int xlast = tile->roi.x + tile->roi.width - 1;
+	const unsigned int ylast = tile->offset_y + tile->roi.height - 1;
+	const unsigned int roi_xlast = roi.x + roi.width - 1;
+	unsigned int x, y, xp, xn;
+	bool ok = true;
+#define ID(X, Y) *(ids + (Y)*w + (X))
+
+	tile->seam_len = 0;
+
+	//left border
+	if( tile->roi.x > roi.x ){
+		const unsigned int x0 = tile->roi.x;
+		const unsigned int xl = x0 - stepwidth;
+		unsigned int yp = ylast+1, yn;
+		for( y=tile->offset_y; ok && y<=ylast; yp=y, y=yn ){
+			yn = depthtree_grid_next(y, stepwidth, ylast);
+			const unsigned int g = ID(x0, y);
+			ok &= depthtree_tile_add_pair(tile, g, ID(xl, y));
+			if( yp<=ylast ) ok &= depthtree_tile_add_pair(tile, g, ID(xl, yp));
+			if( yn<=ylast ) ok &= depthtree_tile_add_pair(tile, g, ID(xl, yn));
+		}
+	}
+
+	//upper border
+	if( tile->offset_y > roi.y ){
+		const unsigned int y0 = tile->offset_y;
+		const unsigned int yu = y0 - stepwidth;
+		xp = ( tile->roi.x > roi.x ) ? tile->roi.x - stepwidth : roi_xlast+1;
+		for( x=tile->roi.x; ok && x<=xlast; xp=x, x=xn ){
+			xn = depthtree_grid_next(x, stepwidth, xlast);
+			const unsigned int g = ID(x, y0);
+			/* The next tile begins on the next column of the grid. */
+			const unsigned int xd = ( xn<=xlast ) ? xn :
+				( x<roi_xlast ? x+stepwidth : roi_xlast+1 );
+			ok &= depthtree_tile_add_pair(tile, g, ID(x, yu));
+			if( xp<=roi_xlast ) ok &= depthtree_tile_add_pair(tile, g, ID(xp, yu));
+			if( xd<=roi_xlast ) ok &= depthtree_tile_add_pair(tile, g, ID(xd, yu));
+		}
+	}
+#undef ID
+	return ok;
+}
+
+/* Merge the chains of all tiles and patch the tree of the last image.
+ * Only components with parts in changed tiles (or parts of nodes
+ * which lose pixels) get new data. The parents of all components
+ * will be checked because a change could insert a new level between
+ * unchanged components.
+ * Returns false if the allocation fails. */
+static bool depthtree_patch_tree_tiles(
+		const unsigned int w,
+		const BlobtreeRect roi,
+		const unsigned int nids,
+		const bool relayout,
+		DepthtreeWorkspace *workspace,
+		TreeArena *arena )
+{
+	TreePatch * const tp = &workspace->patch;
+	DepthtreeTile * const tiles = workspace->tiles;
+	const unsigned int num_tiles = workspace->num_tiles;
+	unsigned int j, k, l, t, r, n;
+
+	if( nids > workspace->max_comp ){
+		if( !depthtree_realloc_workspace( nids + nids/4, &workspace ) ){
+			return false;
+		}
+	}
+	if( workspace->comp_len < workspace->max_comp ){
+		const unsigned int len = workspace->max_comp;
+		if(
+				( workspace->comp_first = (unsigned int*) realloc(workspace->comp_first, len*sizeof(unsigned int) ) ) == NULL ||
+				( workspace->comp_node = (unsigned int*) realloc(workspace->comp_node, len*sizeof(unsigned int) ) ) == NULL ||
+				( workspace->comp_list = (unsigned int*) realloc(workspace->comp_list, len*sizeof(unsigned int) ) ) == NULL ||
+				( workspace->comp_changed = (unsigned char*) realloc(workspace->comp_changed, len*sizeof(unsigned char) ) ) == NULL ||
+				0 ){
+			workspace->comp_len = 0;
+			return false;
+		}
+		workspace->comp_len = len;
+	}
+	if( workspace->node_len < tp->capacity ){
+		const unsigned int len = tp->capacity;
+		unsigned int *tmp = (unsigned int*) realloc(workspace->node_comp, len*sizeof(unsigned int) );
+		if( tmp == NULL ) return false;
+		workspace->node_comp = tmp;
+		workspace->node_len = len;
+	}
+
+	const unsigned int * const ids = workspace->ids;
+	unsigned int * const comp_same = workspace->comp_same;
+	unsigned int * const prob_parent = workspace->prob_parent;
+	unsigned int * const id_depth = workspace->id_depth;
+#ifdef BLOB_COUNT_PIXEL
+	unsigned int * const comp_size = workspace->comp_size;
+#endif
+#ifdef BLOB_DIMENSION
+	unsigned int * const top_index = workspace->top_index;
+	unsigned int * const left_index = workspace->left_index;
+	unsigned int * const right_index = workspace->right_index;
+	unsigned int * const bottom_index = workspace->bottom_index;
+#endif
+#ifdef BLOB_BARYCENTER
+	BLOB_BARYCENTER_TYPE * const pixel_sum_X = workspace->pixel_sum_X;
+	BLOB_BARYCENTER_TYPE * const pixel_sum_Y = workspace->pixel_sum_Y;
+#endif
+	unsigned int * const comp_first = workspace->comp_first;
+	unsigned int * const comp_node = workspace->comp_node;
+	unsigned int * const comp_list = workspace->comp_list;
+	unsigned char * const comp_changed = workspace->comp_changed;
+	unsigned int * const real_ids_inv = workspace->real_ids_inv;
+	unsigned int num_changed = 0;
+
+	BLOB_PHASE_BEGIN(t_merge)
+	/* 1. Set up the chains of the tiles. Dummy ids as in depthtree_label. */
+	*(comp_same+0) = 0;
+	*(id_depth+0) = 255;
+	*(prob_parent+0) = 1;
+	*(comp_same+1) = 1;
+	*(id_depth+1) = 0;
+	*(prob_parent+1) = -1;
+	for( t=0; t<num_tiles; t++){
+		const DepthtreeTile * const tile = tiles+t;
+		const DepthtreeWorkspace * const sw = tile->workspace;
+		for( j=0; j<tile->ncomp; j++){
+			const unsigned int g = tile->first_id + j;
+			const unsigned int p = *(tile->parent+j);
+			*(comp_same+g) = g;
+			*(id_depth+g) = *(sw->id_depth+j+2);
+			*(prob_parent+g) = ( p == UINT_MAX ) ? 1 : tile->first_id + p;
+		}
+	}
+
+	/* 2. Merge chains along the seams. */
+	for( t=0; t<num_tiles; t++){
+		const DepthtreeTile * const tile = tiles+t;
+		for( j=0; j<tile->seam_len; j+=2){
+			depthtree_join_chains(comp_same, prob_parent, id_depth,
+					*(tile->seam+j), *(tile->seam+j+1));
+		}
+	}
+
+	/* 3. The joins keep comp_same(x) <= x, thus one pass in increasing
+	 * order creates the projection. A component has changed if a part
+	 * belongs to a changed tile or to a flagged node or if its parts
+	 * belonged to different nodes. */
+	*(comp_node+1) = 1;
+	*(comp_changed+1) = 0;
+	for( t=0; t<num_tiles; t++){
+		const DepthtreeTile * const tile = tiles+t;
+		for( j=0; j<tile->ncomp; j++){
+			const unsigned int g = tile->first_id + j;
+			r = *(comp_same+*(comp_same+g));
+			*(comp_same+g) = r;
+			n = tile->dirty ? UINT_MAX : *(tile->node+j);
+			if( r == g ){
+				*(comp_node+r) = n;
+				*(comp_changed+r) = ( n == UINT_MAX || tree_patch_is_flagged(tp, n) );
+			}else if( n != *(comp_node+r) ){
+				*(comp_changed+r) = 1;
+			}
+		}
+	}
+
+	/* A component could lose the pixels which connected its parts
+	 * without any change of the parts, e.g. if they were joined by
+	 * deeper pixels of a changed tile. Then, the parts in unchanged
+	 * tiles belong to different components but still refer to the
+	 * same node. All of these components have changed. */
+	unsigned int * const node_comp = workspace->node_comp;
+	for( t=0; t<num_tiles; t++){
+		const DepthtreeTile * const tile = tiles+t;
+		if( tile->dirty ) continue;
+		for( j=0; j<tile->ncomp; j++){
+			*(node_comp+*(tile->node+j)) = UINT_MAX;
+		}
+	}
+	for( t=0; t<num_tiles; t++){
+		const DepthtreeTile * const tile = tiles+t;
+		if( tile->dirty ) continue;
+		for( j=0; j<tile->ncomp; j++){
+			n = *(tile->node+j);
+			r = *(comp_same+tile->first_id+j);
+			l = *(node_comp+n);
+			if( l == UINT_MAX ){
+				*(node_comp+n) = r;
+			}else if( l != r ){
+				*(comp_changed+l) = 1;
+				*(comp_changed+r) = 1;
+			}
+		}
+	}
+
+	/* 4. Sum up the data of changed components. The row values of
+	 * the tiles are relative to offset_y. The old nodes of the parts
+	 * will be flagged. */
+	for( t=0; t<num_tiles; t++){
+		const DepthtreeTile * const tile = tiles+t;
+		const DepthtreeWorkspace * const sw = tile->workspace;
+		const unsigned int oy = tile->offset_y;
+		for( j=0; j<tile->ncomp; j++){
+			const unsigned int g = tile->first_id + j;
+			const unsigned int c = j+2;
+			r = *(comp_same+g);
+			if( !*(comp_changed+r) ) continue;
+			if( !tile->dirty ) tree_patch_flag(tp, *(tile->node+j));
+
+			if( r == g ){
+				*(comp_list+num_changed) = r;
+				num_changed++;
+				*(comp_node+r) = UINT_MAX;
+				*(comp_first+r) = *(tile->first_pixel+j);
+#ifdef BLOB_COUNT_PIXEL
+				BLOB_COMP(comp_size, r) = BLOB_COMP(sw->comp_size, c);
+#endif
+#ifdef BLOB_DIMENSION
+				BLOB_COMP(top_index, r) = BLOB_COMP(sw->top_index, c) + oy;
+				BLOB_COMP(left_index, r) = BLOB_COMP(sw->left_index, c);
+				BLOB_COMP(right_index, r) = BLOB_COMP(sw->right_index, c);
+				BLOB_COMP(bottom_index, r) = BLOB_COMP(sw->bottom_index, c) + oy;
+#endif
+#ifdef BLOB_BARYCENTER
+				BLOB_COMP(pixel_sum_X, r) = BLOB_COMP(sw->pixel_sum_X, c);
+				BLOB_COMP(pixel_sum_Y, r) = BLOB_COMP(sw->pixel_sum_Y, c)
+					+ (BLOB_BARYCENTER_TYPE) oy * BLOB_COMP(sw->comp_size, c);
+#endif
+				continue;
+			}
+
+#ifdef BLOB_COUNT_PIXEL
+			BLOB_COMP(comp_size, r) += BLOB_COMP(sw->comp_size, c);
+#endif
+#ifdef BLOB_DIMENSION
+			if( BLOB_COMP(top_index, r) > BLOB_COMP(sw->top_index, c) + oy )
+				BLOB_COMP(top_index, r) = BLOB_COMP(sw->top_index, c) + oy;
+			if( BLOB_COMP(left_index, r) > BLOB_COMP(sw->left_index, c) )
+				BLOB_COMP(left_index, r) = BLOB_COMP(sw->left_index, c);
+			if( BLOB_COMP(right_index, r) < BLOB_COMP(sw->right_index, c) )
+				BLOB_COMP(right_index, r) = BLOB_COMP(sw->right_index, c);
+			if( BLOB_COMP(bottom_index, r) < BLOB_COMP(sw->bottom_index, c) + oy )
+				BLOB_COMP(bottom_index, r) = BLOB_COMP(sw->bottom_index, c) + oy;
+#endif
+#ifdef BLOB_BARYCENTER
+			BLOB_COMP(pixel_sum_X, r) += BLOB_COMP(sw->pixel_sum_X, c);
+			BLOB_COMP(pixel_sum_Y, r) += BLOB_COMP(sw->pixel_sum_Y, c)
+				+ (BLOB_BARYCENTER_TYPE) oy * BLOB_COMP(sw->comp_size, c);
+#endif
+			if( *(tile->first_pixel+j) < *(comp_first+r) ){
+				*(comp_first+r) = *(tile->first_pixel+j);
+			}
+		}
+	}
+
+	/* 5. A flagged node will be reused if its first pixel is
+	 * still the first pixel of a component. */
+	for( l=0; l<tp->num_flagged; l++){
+		n = *(tp->flagged+l);
+		const unsigned int key = (tp->nodes+n)->key;
+		r = *(comp_same+*(ids+key));
+		if( *(comp_changed+r) && *(comp_first+r) == key && *(comp_node+r) == UINT_MAX ){
+			*(comp_node+r) = n;
+		}
+	}
+
+	/* 6. Set data of changed components. */
+	for( l=0; l<num_changed; l++){
+		r = *(comp_list+l);
+		n = *(comp_node+r);
+		if( n == UINT_MAX ){
+			n = tree_patch_new_node(tp, arena);
+			if( n == UINT_MAX ) return false;
+			*(comp_node+r) = n;
+		}
+		TreePatchNode * const pn = tree_patch_set_data(tp, n, *(comp_first+r));
+#ifdef BLOB_COUNT_PIXEL
+		pn->size = BLOB_COMP(comp_size, r);
+#endif
+#ifdef BLOB_BARYCENTER
+		pn->sum_x = BLOB_COMP(pixel_sum_X, r);
+		pn->sum_y = BLOB_COMP(pixel_sum_Y, r);
+#endif
+#ifdef BLOB_DIMENSION
+		pn->rect.y = BLOB_COMP(top_index, r);
+		pn->rect.height = BLOB_COMP(bottom_index, r) - pn->rect.y + 1;
+		pn->rect.x = BLOB_COMP(left_index, r);
+		pn->rect.width = BLOB_COMP(right_index, r) - pn->rect.x + 1;
+#endif
+#ifdef SAVE_DEPTH_MAP_VALUE
+		(arena->blobs+n)->depth_level = *(id_depth+r);
+#endif
+	}
+
+	/* 7. The background contains the pixels with depth 0 of all tiles.
+	 * Its bounding box always contains the top, left corner of the roi. */
+	TreePatchNode * const pb = tree_patch_set_data(tp, 1, roi.y*w + roi.x);
+#ifdef BLOB_COUNT_PIXEL
+	pb->size = 0;
+#endif
+#ifdef BLOB_BARYCENTER
+	pb->sum_x = 0;
+	pb->sum_y = 0;
+#endif
+#ifdef BLOB_DIMENSION
+	unsigned int bx2 = roi.x, by2 = roi.y;
+#endif
+	for( t=0; t<num_tiles; t++){
+		const DepthtreeTile * const tile = tiles+t;
+		const DepthtreeWorkspace * const sw = tile->workspace;
+		const unsigned int oy = tile->offset_y;
+#ifdef BLOB_COUNT_PIXEL
+		if( BLOB_COMP(sw->comp_size, 1) == 0 ) continue;
+		pb->size += BLOB_COMP(sw->comp_size, 1);
+#endif
+#ifdef BLOB_DIMENSION
+		if( bx2 < BLOB_COMP(sw->right_index, 1) ) bx2 = BLOB_COMP(sw->right_index, 1);
+		if( by2 < BLOB_COMP(sw->bottom_index, 1) + oy ) by2 = BLOB_COMP(sw->bottom_index, 1) + oy;
+#endif
+#ifdef BLOB_BARYCENTER
+		pb->sum_x += BLOB_COMP(sw->pixel_sum_X, 1);
+		pb->sum_y += BLOB_COMP(sw->pixel_sum_Y, 1)
+			+ (BLOB_BARYCENTER_TYPE) oy * BLOB_COMP(sw->comp_size, 1);
+#endif
+	}
+#ifdef BLOB_DIMENSION
+	pb->rect.x = roi.x;
+	pb->rect.y = roi.y;
+	pb->rect.width = bx2 - roi.x + 1;
+	pb->rect.height = by2 - roi.y + 1;
+#endif
+
+	/* 8. Set parents of the nodes. */
+	Tree * const tree = &arena->tree;
+	for( t=0; t<num_tiles; t++){
+		DepthtreeTile * const tile = tiles+t;
+		for( j=0; j<tile->ncomp; j++){
+			r = *(comp_same+tile->first_id+j);
+			if( *(comp_changed+r) ){
+				n = *(comp_node+r);
+				*(tile->node+j) = n;
+				*(tile->is_first+j) = ( *(tile->first_pixel+j) == *(comp_first+r) );
+			}else{
+				n = *(tile->node+j);
+				if( tree_patch_is_flagged(tp, n) ) return false;
+			}
+			if( !*(tile->is_first+j) ) continue;
+
+			tree_patch_set_parent(tp, tree, n,
+					*(comp_node+*(comp_same+*(prob_parent+r))) );
+			(arena->blobs+n)->id = r;
+			*(real_ids_inv+r) = n-1; //root pos shift
+		}
+	}
+
+	/* Unused ids of the ranges belong to no pixel. Map them on
+	 * the background to get valid values in depthtree_filter_blob_ids. */
+	for( t=0; t<num_tiles; t++){
+		const DepthtreeTile * const tile = tiles+t;
+		if( !relayout && !tile->dirty ) continue;
+		for( k=tile->first_id+tile->ncomp; k<tile->first_id+tile->id_range; k++){
+			*(comp_same+k) = 1;
+		}
+	}
+	*(real_ids_inv+0) = 0;
+	*(real_ids_inv+1) = 0;
+	workspace->used_comp = nids-1;
+	BLOB_PHASE_END(BLOB_PHASE_MERGE, t_merge)
+
+	BLOB_PHASE_BEGIN(t_tree)
+	unsigned int options = 0;
+#if defined(BLOB_DIMENSION) && defined(EXTEND_BOUNDING_BOXES)
+	options |= TREE_PATCH_EXTEND_BOXES;
+#endif
+	/* Undo the removal of the background node, see below. */
+	if( (tree->root+1)->parent == tree->root ){
+		tree->root->child = tree->root+1;
+	}
+	const bool ok = tree_patch_apply(tp, tree, 1, 1, options);
+
+	/* If no pixel has depth=0, the background node wraps all blobs.
+	 * Remove it like depthtree_build_tree. */
+#ifdef BLOB_COUNT_PIXEL
+	if( ok && pb->size == 0 ){
+		tree->root->child = (tree->root+1)->child;
+	}
+#endif
+	BLOB_PHASE_END(BLOB_PHASE_TREE, t_tree)
+	return ok;
+}
+
+void depthtree_find_blobs_incremental(
+		Blobtree *blob,
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char *depth_map,
+		const unsigned char *dirty_tiles,
+		DepthtreeWorkspace *workspace
+		){
+#ifndef BLOB_SORT_TREE
+	const unsigned int stepwidth = blob->grid.width;
+	/* Number of columns and rows of the coarse grid without the
+	 * remainder. Every tile should contain at least two of them. */
+	const unsigned int grid_cols = (roi.width-1)/stepwidth + 1;
+	const unsigned int grid_rows = (roi.height-1)/stepwidth + 1;
+	unsigned int cells_per_tile = BLOB_TILE_SIZE/stepwidth;
+	if( cells_per_tile < 2 ) cells_per_tile = 2;
+	const unsigned int tiles_x = grid_cols/cells_per_tile;
+	const unsigned int tiles_y = grid_rows/cells_per_tile;
+
+	if( workspace->prev_data == NULL ){
+		workspace->prev_data = (unsigned char*) malloc( w*h*sizeof(unsigned char) );
+	}
+
+	if( tiles_x < 1 || tiles_y < 1 || workspace->prev_data == NULL ||
+			!depthtree_create_tiles(tiles_x, tiles_y, workspace) )
+#endif
+	{
+		depthtree_find_blobs(blob, data, w, h, roi, depth_map, workspace);
+		return;
+	}
+
+#ifndef BLOB_SORT_TREE
+	BLOB_PHASE_BEGIN(t_label)
+	/* Labels of the last image are only usable for the same settings. */
+	const bool valid = workspace->incremental_valid &&
+		blob->tree == &blob->arena.tree &&
+		tree_patch_valid(&workspace->patch, &blob->arena) &&
+		0 == memcmp( &workspace->prev_roi, &roi, sizeof(BlobtreeRect) ) &&
+#ifndef NO_DEPTH_MAP
+		0 == memcmp( workspace->prev_depth_map, depth_map, 256 ) &&
+#endif
+		workspace->prev_grid.width == stepwidth;
+	workspace->incremental_valid = false;
+
+	const unsigned int num_tiles = tiles_x*tiles_y;
+	DepthtreeTile * const tiles = workspace->tiles;
+	bool any_dirty = false;
+	bool relayout = !valid;
+	unsigned int j, k, tx, ty, nids;
+
+	/* 1. Split roi into tiles and find tiles with changes. */
+	for( ty=0, k=0; ty<tiles_y; ty++){
+		for( tx=0; tx<tiles_x; tx++, k++){
+			DepthtreeTile * const tile = tiles+k;
+			const unsigned int c0 = tx*cells_per_tile;
+			const unsigned int r0 = ty*cells_per_tile;
+
+			tile->roi.x = roi.x + c0*stepwidth;
+			tile->roi.y = 0;
+			tile->roi.width = ( tx+1<tiles_x ) ?
+				(cells_per_tile-1)*stepwidth + 1 : roi.x + roi.width - tile->roi.x;
+			tile->offset_y = roi.y + r0*stepwidth;
+			tile->roi.height = ( ty+1<tiles_y ) ?
+				(cells_per_tile-1)*stepwidth + 1 : roi.y + roi.height - tile->offset_y;
+			tile->workspace->ids = workspace->ids + tile->offset_y*w;
+#ifndef NO_DEPTH_MAP
+			tile->workspace->depths = workspace->depths + tile->offset_y*w;
+#endif
+
+			if( !valid ){
+				tile->dirty = true;
+				depthtree_tile_store(tile, data, w, stepwidth, workspace->prev_data);
+			}else if( dirty_tiles != NULL ){
+				tile->dirty = depthtree_tile_has_dirty_cell(tile, roi, dirty_tiles);
+				if( tile->dirty ){
+					depthtree_tile_store(tile, data, w, stepwidth, workspace->prev_data);
+				}
+			}else{
+				tile->dirty = depthtree_tile_diff(tile, data, w, depth_map,
+						stepwidth, workspace->prev_data);
+			}
+			any_dirty |= tile->dirty;
+		}
+	}
+
+	if( !any_dirty ){
+		//Nothing changed. Ids and tree of last image are still valid.
+		workspace->incremental_valid = true;
+		BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+		return;
+	}
+
+	/* The nodes of the components in changed tiles lose pixels.
+	 * Without valid labels, the tree starts from scratch. The
+	 * background gets node 1. */
+	if( valid ){
+		for( k=0; k<num_tiles; k++){
+			const DepthtreeTile * const tile = tiles+k;
+			if( !tile->dirty ) continue;
+			for( j=0; j<tile->ncomp; j++){
+				tree_patch_flag(&workspace->patch, *(tile->node+j));
+			}
+		}
 	}else{
-		blob->tree = find_depthtree(data, w, h, roi, depth_map, blob->grid.width, workspace, &blob->tree_data);
+		blobtree_clear_tree(blob);
+		blob->tree = tree_patch_reset(&workspace->patch, &blob->arena, roi);
+		if( blob->tree == NULL ||
+				tree_patch_new_node(&workspace->patch, &blob->arena) != 1 ){
+			printf("(depthtree) Critical error: Allocation of tree failed\n");
+			blobtree_clear_tree(blob);
+			BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+			return;
+		}
+		(blob->arena.blobs+1)->id = 1;
+#ifdef SAVE_DEPTH_MAP_VALUE
+		(blob->arena.blobs+1)->depth_level = 0;
+#endif
+		tree_patch_set_parent(&workspace->patch, blob->tree, 1, 0);
 	}
 
+	/* 2. Label changed tiles */
+	for( k=0; k<num_tiles; k++){
+		DepthtreeTile * const tile = tiles+k;
+		if( !tile->dirty ) continue;
+		if( !depthtree_label_tile(tile, data, w, depth_map, stepwidth) ){
+			printf("(depthtree) Critical error: Labeling of tile failed\n");
+			blobtree_clear_tree(blob);
+			BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+			return;
+		}
+		if( tile->ncomp > tile->id_range ) relayout = true;
+	}
 
+	/* 3. Assign id ranges to the tiles. The ids 0 and 1 are
+	 * reserved for the dummy components. The ids of unchanged
+	 * tiles will be shifted. */
+	if( relayout ){
+		nids = 2;
+		for( k=0; k<num_tiles; k++){
+			DepthtreeTile * const tile = tiles+k;
+			const unsigned int first_id = nids;
+			if( !tile->dirty && first_id != tile->first_id ){
+				depthtree_shift_tile(tile, w, stepwidth,
+						first_id - tile->first_id, workspace->ids);
+			}
+			tile->first_id = first_id;
+			tile->id_range = tile->ncomp + tile->ncomp/2 + 16;
+			nids += tile->id_range;
+		}
+	}else{
+		nids = (tiles+num_tiles-1)->first_id + (tiles+num_tiles-1)->id_range;
+	}
 
+	/* 4. Write ids of changed tiles */
+	for( k=0; k<num_tiles; k++){
+		if( (tiles+k)->dirty ){
+			depthtree_remap_tile(tiles+k, w, stepwidth, workspace->ids);
+		}
+	}
 
+	/* 5. Update seams next to changed tiles. The upper border of
+	 * a tile touches the three upper tiles. */
+	for( ty=0, k=0; ty<tiles_y; ty++){
+		for( tx=0; tx<tiles_x; tx++, k++){
+			bool update = relayout || (tiles+k)->dirty || ( tx>0 && (tiles+k-1)->dirty );
+			if( ty>0 ){
+				update |= (tiles+k-tiles_x)->dirty
+					|| ( tx>0 && (tiles+k-tiles_x-1)->dirty )
+					|| ( tx+1<tiles_x && (tiles+k-tiles_x+1)->dirty );
+			}
+			if( update && !depthtree_tile_seams(tiles+k, w, roi, stepwidth, workspace->ids) ){
+				printf("(depthtree) Critical error: Merging of tiles failed\n");
+				blobtree_clear_tree(blob);
+				BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+				return;
+			}
+		}
+	}
+	BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+
+	//update blob tree structure.
+	if( !depthtree_patch_tree_tiles(w, roi, nids, relayout, workspace, &blob->arena) ){
+		printf("(depthtree) Critical error: Merging of tiles failed\n");
+		blobtree_clear_tree(blob);
+		return;
+	}
+	blob->tree = &blob->arena.tree;
+	blob->tree_data = blob->arena.blobs;
+
+	workspace->incremental_valid = true;
+	workspace->prev_roi = roi;
+	workspace->prev_grid = blob->grid;
+#ifndef NO_DEPTH_MAP
+	memcpy( workspace->prev_depth_map, depth_map, 256 );
+#endif
+#endif
+}
+
+
+/* Motion vector input
+ *
+ * The depth of a vector only depends on its first two bytes (x,y).
+ * Thus, the norm and the depth map can be combined into one lookup
+ * table and the labeling evaluates it only for the grid pixels.
+ */
+void depthtree_create_imv_map(
+		const unsigned char *depth_map,
+		const unsigned int norm,
+		unsigned char *imv_map
+		){
+	unsigned int key, r=0;
+	for( key=0; key<DEPTHTREE_IMV_MAP_LEN; key++){
+		const int x = (signed char)(key & 0xFF);
+		const int y = (signed char)(key >> 8);
+		unsigned int n;
+		if( norm == 1 ){
+			n = abs(x) + abs(y);
+			if( n > 255 ) n = 255;
+		}else{
+			/* floor(sqrt(x*x+y*y)). r changes slowly with key. */
+			const unsigned int s = x*x + y*y;
+			while( r*r > s ) --r;
+			while( (r+1)*(r+1) <= s ) ++r;
+			n = r;
+		}
+		imv_map[key] = depth_map[n];
+	}
+}
 
+unsigned int depthtree_label_imv(
+		const char *imv,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char *imv_map,
+		const unsigned int stepwidth,
+		DepthtreeWorkspace *workspace )
+{
+#ifdef NO_DEPTH_MAP
+	fprintf(stderr, "(depthtree) Motion vector input requires depth map.\n");
+	return 0;
+#else
+	const unsigned char *data = (const unsigned char*) imv;
+	switch( stepwidth ){
+		case 1: return depthtree_label2(data, w, h, roi, NULL, imv_map, 1, workspace);
+		case 2: return depthtree_label2(data, w, h, roi, NULL, imv_map, 2, workspace);
+		case 3: return depthtree_label2(data, w, h, roi, NULL, imv_map, 3, workspace);
+		case 4: return depthtree_label2(data, w, h, roi, NULL, imv_map, 4, workspace);
+		default: return depthtree_label2(data, w, h, roi, NULL, imv_map, stepwidth, workspace);
+	}
+#endif
+}
 
+/* Write root id of each grid pixel. Pixels of small
+ * components get the background id 1. */
+static void depthtree_eval_id_image(
+		const unsigned int w,
+		const BlobtreeRect roi,
+		const unsigned int stepwidth,
+		DepthtreeWorkspace *workspace,
+		unsigned char *id_image
+		){
+	const unsigned int * const ids = workspace->ids;
+	const unsigned int * const comp_same = workspace->comp_same;
+#ifdef BLOB_COUNT_PIXEL
+	const unsigned int * const comp_size = workspace->comp_size;
+#endif
+	unsigned int x, y;
+	for( y=0; y<roi.height; y=depthtree_grid_next(y, stepwidth, roi.height-1) ){
+		const unsigned int row = (roi.y+y)*w + roi.x;
+		for( x=0; x<roi.width; x=depthtree_grid_next(x, stepwidth, roi.width-1) ){
+			const unsigned int id = *(comp_same + *(ids+row+x));
+#ifdef BLOB_COUNT_PIXEL
+			if( BLOB_COMP(comp_size, id) < DEPTHTREE_ID_IMAGE_MIN_SIZE ){
+				*(id_image+row+x) = 1;
+				continue;
+			}
+#endif
+			*(id_image+row+x) = (unsigned char) id;
+		}
+	}
+}
 
+void depthtree_find_blobs_imv(
+		Blobtree *blob,
+		const char *imv,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char *imv_map,
+		unsigned char *id_image,
+		DepthtreeWorkspace *workspace
+		){
+	//clear old tree
+	blobtree_clear_tree(blob);
+	BLOB_PHASE_BEGIN(t_label)
+	const unsigned int nids = depthtree_label_imv(imv, w, h, roi, imv_map,
+			blob->grid.width, workspace);
+	BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+	if( nids > 0 ){
+		blob->tree = depthtree_build_tree(roi, nids, &blob->tree_data,
+				workspace, &blob->arena );
+		if( id_image != NULL ){
+			depthtree_eval_id_image(w, roi, blob->grid.width, workspace, id_image);
+		}
+	}
 }
 
 
@@ -10,6 +10,9 @@ extern "C" {
 #include "settings.h"
 #include "tree.h"
 #include "blob.h"
+#include "workers.h"
+#include "unionfind.h"
+#include "treepatch.h"
 
 /* Workspace struct for array storage */
 typedef struct {
@@ -20,6 +23,9 @@ typedef struct {
 	unsigned int *id_depth; //store depth (group) of id anchor.
 	unsigned int *comp_same; //map ids to unique ids g:{0,...,}->{0,....}
 	unsigned int *prob_parent; //store ⊂-Relation.
+#ifdef BLOB_COMPONENT_RECORDS
+	BlobComponent *components; //storage of the following arrays, see settings.h
+#endif
 #ifdef BLOB_COUNT_PIXEL
 	unsigned int *comp_size;
 #endif
@@ -49,8 +55,64 @@ typedef struct {
 	//extra data
 	unsigned int *blob_id_filtered; //like comp_same, but respect blob tree filter.
 
+	//parallel labeling, see depthtree_find_blobs_parallel
+	unsigned int num_strips;
+	struct DepthtreeStrip *strips;
+	BlobWorkers *workers; // threads for the strips 1, …, num_strips-1. Reused for all frames.
+
+	//incremental labeling, see depthtree_find_blobs_incremental
+	bool incremental_valid; // ids and tiles contain labels of the last image.
+	unsigned char *prev_data; // last image (grid rows of roi). Used to detect changes.
+	BlobtreeRect prev_roi;
+	Grid prev_grid;
+	unsigned char prev_depth_map[256];
+	unsigned int num_tiles, tiles_x, tiles_y;
+	struct DepthtreeTile *tiles;
+	unsigned int comp_len; // length of the following four arrays.
+	unsigned int *comp_first; // position of first pixel of component.
+	unsigned int *comp_node; // tree node of component.
+	unsigned int *comp_list; // changed components.
+	unsigned char *comp_changed;
+	unsigned int node_len; // length of node_comp.
+	unsigned int *node_comp; // component of tree node.
+	TreePatch patch; // nodes of the tree of the last image.
+
 } DepthtreeWorkspace;
 
+/* Slice of the workspace for one horizontal strip of the roi.
+ * The first strip will be labeled in the parent workspace,
+ * all other strips use their own component arrays and id chains.
+ */
+typedef struct DepthtreeStrip {
+	DepthtreeWorkspace *workspace; // ids and depths point into arrays of parent workspace while labeling.
+	BlobtreeRect roi; // roi of strip. Relative to offset_y for all strips except the first.
+	unsigned int offset_y; // image row of the strip begin.
+	unsigned int nids; // number of ids found in this strip.
+	unsigned int *id_map; // map strip ids on ids of the parent workspace.
+	unsigned int id_map_len;
+} DepthtreeStrip;
+
+/* Tile of the roi for the incremental labeling.
+ * The component data of the tile survives until the tile changes.
+ */
+typedef struct DepthtreeTile {
+	DepthtreeWorkspace *workspace; // component j of the tile is stored at index j+2, the background (depth 0) at index 1.
+	BlobtreeRect roi; // roi of tile. Relative to offset_y.
+	unsigned int offset_y; // image row of the tile begin.
+	bool dirty; // tile changed in the current image.
+	unsigned int ncomp; // number of components in this tile without the dummy components.
+	unsigned int first_id; // ids of the components are first_id, …, first_id+ncomp-1.
+	unsigned int id_range; // number of reserved ids, >= ncomp.
+	unsigned int *first_pixel; // position of first pixel of component.
+	unsigned int *parent; // parent component in the tile, UINT_MAX for the background.
+	unsigned int *comp_map; // map tile-local ids on components.
+	unsigned int *node; // tree node of component.
+	unsigned char *is_first; // component contains the first pixel of the node.
+	unsigned int comp_len; // length of the six arrays above.
+	unsigned int *seam; // pairs of ids of neighbouring pixels along left and upper border.
+	unsigned int seam_len, seam_max;
+} DepthtreeTile;
+
 
 bool depthtree_create_workspace(
 		const unsigned int w, const unsigned int h,
@@ -92,44 +154,44 @@ Tree* find_depthtree(
 		DepthtreeWorkspace *workspace,
 		Blob** tree_data );
 
+/* Building blocks of find_depthtree.
+ *
+ * depthtree_label evaluates the depth map, fills the ids array and
+ * the component arrays of the workspace and returns the number
+ * of used ids (0 on error).
+ * depthtree_build_tree joins the ids and creates the tree.
+ *
+ * If arena is NULL, the tree and *tree_data will be allocated on the heap.
+ * Otherwise, the storage of the arena will be reused, see blobtree_clear_tree.
+ */
+unsigned int depthtree_label(
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char *depth_map,
+		const unsigned int stepwidth,
+		DepthtreeWorkspace *workspace );
+
+Tree* depthtree_build_tree(
+		const BlobtreeRect roi,
+		const unsigned int nids,
+		Blob** tree_data,
+		DepthtreeWorkspace *workspace,
+		TreeArena *arena );
+
 
-unsigned int inline getRealId( unsigned int * const comp_same, unsigned int const id ){
-	unsigned int rid1, rid2;
-	rid1 = *(comp_same + id);
-	if( (rid2 = *(comp_same + rid1)) != rid1 ){
-		VPRINTF("Map %i from %i ", id, rid1);
-		rid1 = rid2;
-		while( (rid2 = *(comp_same + rid1)) != rid1 ){
-			rid1 = rid2;
-		}
-		*(comp_same + id) = rid2;
-		/* Attention, only the mapping of id are changed to rid2.
-		 * Other elements of the while loop not. Thus,
-		 * the calling of comp_same for all Ids does in general not
-		 * transform comp_same to a projection.
-		 *
-		 */
-
-		/*unsigned int rid0 = id;
-		rid1 = *(comp_same + rid0);
-		while( rid2 != rid1 ){
-		 *(comp_same + rid0) = rid2;
-			rid0 = rid1;
-			rid1 = *(comp_same + rid1);
-		}*/
-		/* This approach would be more correct, but comp_same
-		 * is still no projection because there is no guarantee
-		 * that getRealId will be called for all ids!
-		 * => Do not lay on the projection property here.
-		 * comp_same will be modified during postprocessing.
-		 */
-
-		VPRINTF("to %i\n", rid2);
-	}
-	return rid1;
+/* Returns root (smallest id) of the component of id.
+ * All ids of the path will be mapped on the root. Nevertheless,
+ * comp_same is no projection because there is no guarantee
+ * that getRealId will be called for all ids!
+ * => Do not lay on the projection property here.
+ * comp_same will be modified during postprocessing (or use uf_flatten).
+ */
+static inline unsigned int getRealId( unsigned int * const comp_same, unsigned int const id ){
+	return uf_find_compress(comp_same, id);
 }
 
-unsigned int inline getRealParent( unsigned int * const prob_parent, unsigned int * const comp_same, unsigned int const id ){
+static inline unsigned int getRealParent( unsigned int * const prob_parent, unsigned int * const comp_same, unsigned int const id ){
 			return getRealId( comp_same, *(prob_parent + id) );
 }
 
@@ -145,6 +207,110 @@ void depthtree_find_blobs(
 		DepthtreeWorkspace *workspace
 		);
 
+/* Multi-threaded variant of depthtree_find_blobs.
+ *
+ * The roi will be split into num_threads horizontal strips.
+ * Each strip is labeled by its own thread. Afterwards, the
+ * parent chains of neighbouring pixels along the strip borders
+ * will be merged like in the serial algorithm.
+ * The resulting tree (structure, node order and blob properties)
+ * is the same as for depthtree_find_blobs. Only the values of
+ * Blob.id (the internal ids of the ids array) could differ.
+ *
+ * The threads will be started on the first call and kept in the
+ * workspace (workspace->workers) until depthtree_destroy_workspace.
+ *
+ * Falls back on the serial algorithm if num_threads<2 or
+ * the roi is too small.
+ */
+void depthtree_find_blobs_parallel(
+		Blobtree *blob,
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char *depth_map,
+		const unsigned int num_threads,
+		DepthtreeWorkspace *workspace
+		);
+
+/* Incremental variant of depthtree_find_blobs for image sequences.
+ *
+ * Like threshtree_find_blobs_incremental, the roi will be split into tiles
+ * of about BLOB_TILE_SIZE x BLOB_TILE_SIZE pixels and only changed tiles
+ * will be labeled again. The parent chains of the tile components will be
+ * merged along the tile borders like in depthtree_find_blobs_parallel.
+ * Finally, the tree of the last call will be patched: Only the nodes of
+ * components with parts in changed tiles will be created or removed and
+ * only moved nodes and their ancestors will be evaluated again.
+ * The tree is the same as for depthtree_find_blobs, only the ids of
+ * the blobs differ. If nothing has changed, the tree of the last call
+ * will be kept.
+ *
+ * The merge of the chains needs one pass over the components and the
+ * borders of all tiles (not over the pixels).
+ *
+ * dirty_tiles - NULL or one byte per cell of BLOB_TILE_SIZE x BLOB_TILE_SIZE
+ *   pixels of the roi, see threshtree_find_blobs_incremental. If NULL,
+ *   the depths of the image will be compared with the last image.
+ *
+ * Use the same Blobtree for all calls. The workspace requires
+ * w*h bytes of additional memory.
+ * With BLOB_SORT_TREE, depthtree_find_blobs will be used.
+ */
+void depthtree_find_blobs_incremental(
+		Blobtree *blob,
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char *depth_map,
+		const unsigned char *dirty_tiles,
+		DepthtreeWorkspace *workspace
+		);
+
+/* Motion vector input.
+ *
+ * imv contains 4 bytes per pixel: signed char x, signed char y and
+ * two bytes which will be ignored (sad of the encoder).
+ * Instead of converting the vectors into a norm image first, the
+ * labeling looks up the depth of the grid pixels in imv_map.
+ * This saves the pass over the whole image and the norm buffer.
+ *
+ * imv_map combines the norm and depth_map:
+ * 	imv_map[(unsigned char)x | (unsigned char)y<<8] = depth_map[norm(x,y)]
+ * with norm=1: min(|x|+|y|, 255) or norm=2: floor(sqrt(x*x+y*y)).
+ * Create it once with depthtree_create_imv_map.
+ *
+ * If id_image is not NULL, it will be filled with the (root) ids of
+ * the grid pixels for debugging. Ids of components with less than
+ * DEPTHTREE_ID_IMAGE_MIN_SIZE pixels will be replaced by 1.
+ */
+#define DEPTHTREE_IMV_MAP_LEN 65536
+#define DEPTHTREE_ID_IMAGE_MIN_SIZE 8
+
+void depthtree_create_imv_map(
+		const unsigned char *depth_map,
+		const unsigned int norm,
+		unsigned char *imv_map
+		);
+
+unsigned int depthtree_label_imv(
+		const char *imv,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char *imv_map,
+		const unsigned int stepwidth,
+		DepthtreeWorkspace *workspace );
+
+void depthtree_find_blobs_imv(
+		Blobtree *blob,
+		const char *imv,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char *imv_map,
+		unsigned char *id_image,
+		DepthtreeWorkspace *workspace
+		);
+
 
 #ifdef EXTEND_BOUNDING_BOXES
 void extend_bounding_boxes( Tree * const tree);
@@ -42,22 +42,24 @@
 
 /*
  * Map bigger (real) id on smaller id
+ *
+ * Note: The parent of the previous chain element (pA-1 or pB-1)
+ * will not be changed. It could be already remapped on a deeper
+ * element of the other chain. getRealId resolves the old parent.
  * */
 #define JOIN_IDS_B( pA, pB) \
 	if( *(pA) < *(pB) ){ \
 		*(comp_same	+ *(pB)) = *(pA); \
-		*(prob_parent + *(pB-1)) = *(pA); \
 	}else{  \
 		*(comp_same	+ *(pA)) = *(pB); \
-		*(prob_parent + *(pA-1)) = *(pB); \
 	}
 
 
 #ifdef BLOB_COUNT_PIXEL
 #define COUNT(X) X;
 #define BLOB_REALLOC_COMP_SIZE comp_size = realloc(comp_size, max_comp*sizeof(int) );
-#define BLOB_INIT_COMP_SIZE *(comp_size+id) = 1;
-#define BLOB_INC_COMP_SIZE(ID) *(comp_size+ID) += 1; 
+#define BLOB_INIT_COMP_SIZE BLOB_COMP(comp_size, id) = 1;
+#define BLOB_INC_COMP_SIZE(ID) BLOB_COMP(comp_size, ID) += 1; 
 #else
 /* empty definitions */
 #define COUNT(X) ;
@@ -76,16 +78,16 @@
 #define BD(X) X;
 
 #define BLOB_DIMENSION_LEFT(ID, STEPWIDTH) \
-	/*if( *( left_index+ID ) > s ) *( left_index+ID ) -= STEPWIDTH; */ \
-	if( *( left_index+ID ) > s ) *( left_index+ID ) = s; /* Is this correct for STEPWITDTH>1?! */
+	/*if( BLOB_COMP(left_index, ID) > s ) BLOB_COMP(left_index, ID) -= STEPWIDTH; */ \
+	if( BLOB_COMP(left_index, ID) > s ) BLOB_COMP(left_index, ID) = s; /* Is this correct for STEPWITDTH>1?! */
 
 #define BLOB_DIMENSION_RIGHT(ID, STEPWIDTH) \
-	/*if( *( right_index+(ID) ) < s ) *( right_index+(ID) ) += STEPWIDTH; */ \
-	if( *( right_index+(ID) ) < s ) *( right_index+(ID) ) = s; 
+	/*if( BLOB_COMP(right_index, (ID)) < s ) BLOB_COMP(right_index, (ID)) += STEPWIDTH; */ \
+	if( BLOB_COMP(right_index, (ID)) < s ) BLOB_COMP(right_index, (ID)) = s; 
 
 #define BLOB_DIMENSION_BOTTOM(ID, STEPHEIGHT) \
-	/*if( *( bottom_index+(ID) ) < z ) *( bottom_index+(ID) ) += STEPHEIGHT; */ \
-	if( *( bottom_index+(ID) ) < z ) *( bottom_index+(ID) ) = z;
+	/*if( BLOB_COMP(bottom_index, (ID)) < z ) BLOB_COMP(bottom_index, (ID)) += STEPHEIGHT; */ \
+	if( BLOB_COMP(bottom_index, (ID)) < z ) BLOB_COMP(bottom_index, (ID)) = z;
 
 #else
 /* empty definitions */
@@ -101,8 +103,8 @@
 	pixel_sum_X = realloc(pixel_sum_X, max_comp*sizeof(BLOB_BARYCENTER_TYPE) ); \
 pixel_sum_X = realloc(pixel_sum_X, max_comp*sizeof(BLOB_BARYCENTER_TYPE) );
 
-#define BLOB_INIT_BARY *(pixel_sum_X+id) = s; *(pixel_sum_Y+id) = z;
-#define BLOB_INC_BARY(ID) *(pixel_sum_X+ID) += s;  *(pixel_sum_Y+ID) += z;
+#define BLOB_INIT_BARY BLOB_COMP(pixel_sum_X, id) = s; BLOB_COMP(pixel_sum_Y, id) = z;
+#define BLOB_INC_BARY(ID) BLOB_COMP(pixel_sum_X, ID) += s;  BLOB_COMP(pixel_sum_Y, ID) += z;
 #else
 /* empty definitions */
 #define BARY(X) ;
@@ -118,10 +120,10 @@ pixel_sum_X = realloc(pixel_sum_X, max_comp*sizeof(BLOB_BARYCENTER_TYPE) );
 *(comp_same+id) = id; \
 BLOB_INIT_COMP_SIZE; \
 BD( \
-*(left_index+id) = s; \
-*(right_index+id) = s; \
-*(top_index+id) = z; \
-*(bottom_index+id) = z; \
+BLOB_COMP(left_index, id) = s; \
+BLOB_COMP(right_index, id) = s; \
+BLOB_COMP(top_index, id) = z; \
+BLOB_COMP(bottom_index, id) = z; \
 	) \
 BLOB_INIT_BARY; \
 if( id>=max_comp ){ \
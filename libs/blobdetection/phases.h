@@ -0,0 +1,57 @@
+#ifndef PHASES_H
+#define PHASES_H
+
+/* Duration of the phases of the blob search.
+ *
+ * If BLOB_PHASE_TIMING is set (see settings.h), the *_find_blobs
+ * and *_build_tree functions add the elapsed time of each phase
+ * to a thread local counter. Without the flag the hooks are empty
+ * and the counters stay zero.
+ *
+ * Phases:
+ * BLOB_PHASE_LABEL - Labeling of the pixels (or runs) and merge of strips.
+ * BLOB_PHASE_MERGE - Join of equivalent ids and their component properties.
+ * BLOB_PHASE_TREE - Creation of the nodes and the parent relation.
+ * BLOB_PHASE_AREAS - Barycenters, areas and bounding box extension.
+ * */
+
+#include <time.h>
+
+#include "settings.h"
+
+typedef enum {
+	BLOB_PHASE_LABEL=0,
+	BLOB_PHASE_MERGE=1,
+	BLOB_PHASE_TREE=2,
+	BLOB_PHASE_AREAS=3,
+	BLOB_NUM_PHASES=4
+} BlobPhase;
+
+typedef struct {
+	unsigned long long ns[BLOB_NUM_PHASES]; // summed up duration in nanoseconds.
+	unsigned int calls[BLOB_NUM_PHASES]; // number of measurements.
+} BlobPhaseTimes;
+
+/* Reset the counters of the calling thread. */
+void blob_phases_reset();
+
+/* Copy the counters of the calling thread. */
+void blob_phases_get(BlobPhaseTimes *times);
+
+void blob_phases_add(const BlobPhase phase, const unsigned long long ns);
+
+static inline unsigned long long blob_phases_clock(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#ifdef BLOB_PHASE_TIMING
+#define BLOB_PHASE_BEGIN(T) const unsigned long long T = blob_phases_clock();
+#define BLOB_PHASE_END(P, T) blob_phases_add(P, blob_phases_clock() - T);
+#else
+#define BLOB_PHASE_BEGIN(T)
+#define BLOB_PHASE_END(P, T)
+#endif
+
+#endif
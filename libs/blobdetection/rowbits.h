@@ -0,0 +1,133 @@
+#ifndef ROWBITS_H
+#define ROWBITS_H
+
+/* Helper functions for the run based algorithms
+ * (threshtree_label_runs and runtree).
+ *
+ * A row of the grid will be binarized into a bit mask
+ * (bit i = data of column i > thresh) and the
+ * bit mask splitted into runs of equal bits.
+ */
+
+#include <stdint.h>
+#include <string.h> //for memset
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ROWBITS_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define ROWBITS_SSE2
+#endif
+
+/* Number of 64 bit words for a row with ncols columns.
+ * One extra word allows the unconditional write of the last bits. */
+#define ROWBITS_WORDS(ncols) ( ((ncols)>>6)+1 )
+
+/* Bit of column x */
+#define ROWBITS_GET(bits, x) ( (unsigned int) ( *((bits)+((x)>>6)) >> ((x)&63) ) & 1 )
+
+/* Binarize 16 pixels. Returns bit mask of (*p > thresh). */
+#if defined(ROWBITS_SSE2)
+static inline unsigned int rowbits_binarize16(
+		const unsigned char *p,
+		const __m128i bias,
+		const __m128i vthresh )
+{
+	/* No unsigned comparison in SSE2. Shift values into signed range. */
+	const __m128i v = _mm_xor_si128( _mm_loadu_si128( (const __m128i*) p ), bias );
+	return (unsigned int) _mm_movemask_epi8( _mm_cmpgt_epi8( v, vthresh ) );
+}
+#elif defined(ROWBITS_NEON)
+static inline unsigned int rowbits_binarize16(
+		const unsigned char *p,
+		const uint8x16_t weights,
+		const uint8x16_t vthresh )
+{
+	/* Weight the lanes with 1,2,…,128 and sum up each half. */
+	const uint8x16_t m = vandq_u8( vcgtq_u8( vld1q_u8(p), vthresh ), weights );
+	uint8x8_t s = vpadd_u8( vget_low_u8(m), vget_high_u8(m) );
+	s = vpadd_u8( s, s );
+	s = vpadd_u8( s, s );
+	return vget_lane_u8(s, 0) | ( vget_lane_u8(s, 1) << 8 );
+}
+#endif
+
+/* Write bit mask of one row of the grid into bits.
+ *
+ * row - Pointer to the left border of the roi in the current row.
+ * ncols - Number of grid columns. The column i is at min(i*stepwidth, last).
+ * bits - Array with ROWBITS_WORDS(ncols) elements.
+ * */
+static inline void rowbits_binarize_row(
+		const unsigned char *row,
+		const unsigned int ncols,
+		const unsigned int stepwidth,
+		const unsigned int last,
+		const unsigned char thresh,
+		uint64_t *bits )
+{
+	unsigned int i=0;
+	memset( bits, 0, ROWBITS_WORDS(ncols)*sizeof(uint64_t) );
+
+	if( stepwidth == 1 ){
+#if defined(ROWBITS_SSE2)
+		const __m128i bias = _mm_set1_epi8( (char) 0x80 );
+		const __m128i vthresh = _mm_set1_epi8( (char) (thresh ^ 0x80) );
+		for( ; i+16<=ncols; i+=16 ){
+			*(bits+(i>>6)) |= (uint64_t) rowbits_binarize16(row+i, bias, vthresh) << (i&63);
+		}
+#elif defined(ROWBITS_NEON)
+		static const uint8_t w[16] = {1,2,4,8,16,32,64,128,1,2,4,8,16,32,64,128};
+		const uint8x16_t weights = vld1q_u8(w);
+		const uint8x16_t vthresh = vdupq_n_u8(thresh);
+		for( ; i+16<=ncols; i+=16 ){
+			*(bits+(i>>6)) |= (uint64_t) rowbits_binarize16(row+i, weights, vthresh) << (i&63);
+		}
+#endif
+		for( ; i<ncols; i++ ){
+			*(bits+(i>>6)) |= (uint64_t) ( *(row+i) > thresh ) << (i&63);
+		}
+	}else{
+		for( ; i<ncols-1; i++ ){
+			*(bits+(i>>6)) |= (uint64_t) ( *(row+i*stepwidth) > thresh ) << (i&63);
+		}
+		*(bits+(i>>6)) |= (uint64_t) ( *(row+last) > thresh ) << (i&63);
+	}
+}
+
+/* Split bit mask into runs. The classes of the runs alternate,
+ * beginning with the class of column 0.
+ * Returns number of runs n and set starts[n] = ncols.
+ * starts requires ncols+1 elements. */
+static inline unsigned int rowbits_to_runs(
+		const uint64_t *bits,
+		const unsigned int ncols,
+		unsigned int *starts )
+{
+	const unsigned int nwords = ((ncols-1)>>6)+1;
+	uint64_t carry = *bits & 1; //no transition at position 0
+	unsigned int k, n=0;
+
+	for( k=0; k<nwords; k++){
+		const uint64_t b = *(bits+k);
+		/* Set bit i if the class changes between i-1 and i. */
+		uint64_t t = b ^ ( (b<<1) | carry );
+		carry = b>>63;
+		if( k == nwords-1 && (ncols&63) ){
+			t &= ( ((uint64_t)1) << (ncols&63) ) - 1;
+		}
+		if( k == 0 ){
+			t |= 1;
+		}
+		while( t ){
+			*(starts+n) = (k<<6) + __builtin_ctzll(t);
+			++n;
+			t &= t-1;
+		}
+	}
+	*(starts+n) = ncols;
+	return n;
+}
+
+#endif
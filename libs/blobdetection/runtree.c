@@ -0,0 +1,628 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h> //for memset
+
+#include "runtree.h"
+#include "rowbits.h"
+#include "unionfind.h"
+
+#define DUMMY_ID -1 //id virtual parent of first element (id=0)
+
+bool runtree_create_workspace(
+		const unsigned int w, const unsigned int h,
+		RuntreeWorkspace **pworkspace
+		){
+
+	if( *pworkspace != NULL ){
+		//destroy old struct.
+		runtree_destroy_workspace( pworkspace );
+	}
+	//Now, *pworkspace is NULL
+
+	if( w*h == 0 ) return false;
+
+	/* All pointers are NULL. Thus, the workspace can
+	 * be destroyed on partial allocation. */
+	RuntreeWorkspace *r = calloc( 1, sizeof(RuntreeWorkspace) );
+	if( r == NULL ) return false;
+
+	/* Start values. Both arrays grow on demand. */
+	const unsigned int max_comp = w+h;
+	const unsigned int max_runs = 2*(w+h);
+	r->max_runs = max_runs;
+	if(
+			!runtree_realloc_workspace( max_comp, &r ) ||
+			( r->runs = (RuntreeRun*) malloc( max_runs*sizeof(RuntreeRun) ) ) == NULL ||
+			( r->row_bits = (uint64_t*) malloc( 2*ROWBITS_WORDS(w)*sizeof(uint64_t) ) ) == NULL ||
+			( r->row_runs = (unsigned int*) malloc( 4*(w+1)*sizeof(unsigned int) ) ) == NULL ||
+			0 ){
+		// alloc failed
+		runtree_destroy_workspace( &r );
+		return false;
+	}
+	r->runs_width = w;
+
+	*pworkspace=r;
+	return true;
+}
+
+bool runtree_realloc_workspace(
+		const unsigned int max_comp,
+		RuntreeWorkspace **pworkspace
+		){
+
+	RuntreeWorkspace *r = *pworkspace;
+	r->max_comp = max_comp;
+	if(
+			( r->comp_same = (unsigned int*) realloc(r->comp_same, max_comp*sizeof(unsigned int) ) ) == NULL ||
+			( r->prob_parent = (unsigned int*) realloc(r->prob_parent, max_comp*sizeof(unsigned int) ) ) == NULL ||
+#ifdef BLOB_COMPONENT_RECORDS
+			( r->components = (BlobComponent*) realloc(r->components, max_comp*sizeof(BlobComponent) ) ) == NULL ||
+#else
+#ifdef BLOB_COUNT_PIXEL
+			( r->comp_size = (unsigned int*) realloc(r->comp_size, max_comp*sizeof(unsigned int) ) ) == NULL ||
+#endif
+#ifdef BLOB_DIMENSION
+			( r->top_index = (unsigned int*) realloc(r->top_index, max_comp*sizeof(unsigned int) ) ) == NULL ||
+			( r->left_index = (unsigned int*) realloc(r->left_index, max_comp*sizeof(unsigned int) ) ) == NULL ||
+			( r->right_index = (unsigned int*) realloc(r->right_index, max_comp*sizeof(unsigned int) ) ) == NULL ||
+			( r->bottom_index = (unsigned int*) realloc(r->bottom_index, max_comp*sizeof(unsigned int) ) ) == NULL ||
+#endif
+#ifdef BLOB_BARYCENTER
+			( r->pixel_sum_X = (BLOB_BARYCENTER_TYPE*) realloc(r->pixel_sum_X, max_comp*sizeof(BLOB_BARYCENTER_TYPE) ) ) == NULL ||
+			( r->pixel_sum_Y = (BLOB_BARYCENTER_TYPE*) realloc(r->pixel_sum_Y, max_comp*sizeof(BLOB_BARYCENTER_TYPE) ) ) == NULL ||
+#endif
+#endif
+			( r->real_ids = (unsigned int*) realloc(r->real_ids, max_comp*sizeof(unsigned int) ) ) == NULL ||
+			( r->real_ids_inv = (unsigned int*) realloc(r->real_ids_inv, max_comp*sizeof(unsigned int) ) ) == NULL ||
+			0 ){
+		// realloc failed
+		VPRINTF("Critical error: Reallocation of workspace failed!\n");
+		runtree_destroy_workspace( pworkspace );
+		return false;
+	}
+#ifdef BLOB_COMPONENT_RECORDS
+	BLOB_COMP_LINK(r)
+#endif
+
+	return true;
+}
+
+void runtree_destroy_workspace(
+		RuntreeWorkspace **pworkspace
+		){
+	if( *pworkspace == NULL ) return;
+
+	RuntreeWorkspace *r = *pworkspace ;
+	free(r->comp_same);
+	free(r->prob_parent);
+#ifdef BLOB_COMPONENT_RECORDS
+	free(r->components);
+#else
+#ifdef BLOB_COUNT_PIXEL
+	free(r->comp_size);
+#endif
+#ifdef BLOB_DIMENSION
+	free(r->top_index);
+	free(r->left_index);
+	free(r->right_index);
+	free(r->bottom_index);
+#endif
+#ifdef BLOB_BARYCENTER
+	free(r->pixel_sum_X);
+	free(r->pixel_sum_Y);
+#endif
+#endif
+
+	free(r->real_ids);
+	free(r->real_ids_inv);
+
+	free(r->row_bits);
+	free(r->row_runs);
+	free(r->runs);
+
+	free(r);
+	*pworkspace = NULL;
+}
+
+/* New size of the runs or component arrays if 'used' entries are
+ * required after row r of nrows. Doubling alone would reach the size
+ * of a frame in several steps and the next, slightly busier frame would
+ * grow the arrays again. Thus, the usage is extrapolated to the whole
+ * roi and twice of it is reserved. Limited by the worst case of one
+ * entry per grid point (limit). */
+static unsigned int runtree_grow_size(
+		const unsigned int max,
+		const unsigned int used,
+		const unsigned int r, const unsigned int nrows,
+		const unsigned int limit )
+{
+	unsigned long long m = 2ULL*used*nrows/(r+1);
+	if( m < 2ULL*max ) m = 2ULL*max;
+	if( m > limit ) m = limit;
+	if( m < used ) m = used;
+	return (unsigned int) m;
+}
+
+static bool runtree_realloc_rows(
+		const unsigned int ncols,
+		RuntreeWorkspace *workspace )
+{
+	if( workspace->runs_width >= ncols ) return true;
+
+	free(workspace->row_bits);
+	free(workspace->row_runs);
+	workspace->row_runs = NULL;
+	workspace->runs_width = 0;
+	if(
+			( workspace->row_bits = (uint64_t*) malloc( 2*ROWBITS_WORDS(ncols)*sizeof(uint64_t) ) ) == NULL ||
+			( workspace->row_runs = (unsigned int*) malloc( 4*(ncols+1)*sizeof(unsigned int) ) ) == NULL ||
+			0 ){
+		return false;
+	}
+	workspace->runs_width = ncols;
+	return true;
+}
+
+#ifdef BLOB_COUNT_PIXEL
+#define COUNT(X) X
+#else
+#define COUNT(X)
+#endif
+#ifdef BLOB_DIMENSION
+#define BD(X) X
+#else
+#define BD(X)
+#endif
+#ifdef BLOB_BARYCENTER
+#define BARY(X) X
+#else
+#define BARY(X)
+#endif
+
+#define RUN_NEW_COMPONENT(PARENTID) \
+	id++; \
+	if( id>=max_comp ){ \
+		max_comp = runtree_grow_size(max_comp, id+1, r, nrows, nrows*ncols+1); \
+		VPRINTF("Extend max_comp=%i\n", max_comp); \
+		if( !runtree_realloc_workspace(max_comp, &workspace) ) return 0; \
+		/* Reallocation requires update of pointers */ \
+		comp_same = workspace->comp_same; \
+		prob_parent = workspace->prob_parent; \
+		COUNT( comp_size = workspace->comp_size; ) \
+		BD( \
+		top_index = workspace->top_index; \
+		left_index = workspace->left_index; \
+		right_index = workspace->right_index; \
+		bottom_index = workspace->bottom_index; \
+		) \
+		BARY( pixel_sum_X = workspace->pixel_sum_X; pixel_sum_Y = workspace->pixel_sum_Y; ) \
+	} \
+	*(prob_parent+id) = PARENTID; \
+	*(comp_same+id) = id; \
+	COUNT( BLOB_COMP(comp_size, id) = 0; ) \
+	BD( \
+	BLOB_COMP(top_index, id) = y; \
+	BLOB_COMP(left_index, id) = xs; \
+	BLOB_COMP(right_index, id) = xe; \
+	BLOB_COMP(bottom_index, id) = y; \
+	) \
+	BARY( BLOB_COMP(pixel_sum_X, id) = 0; BLOB_COMP(pixel_sum_Y, id) = 0; )
+
+/* Labeling of the runs. See threshtree_label_runs for a description.
+ * The ids are equal to the ids of threshtree_label_coarse. Instead of
+ * the ids array, the runs will be stored in workspace->runs.
+ */
+unsigned int runtree_label(
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char thresh,
+		const unsigned int stepwidth,
+		const unsigned int stepheight,
+		RuntreeWorkspace *workspace )
+{
+	if( roi.x+roi.width > w || roi.y+roi.height > h ){
+		fprintf(stderr,"[runtree.c] BlobtreeRect not matching.\n");
+		return 0;
+	}
+
+	const unsigned int lastx = roi.width-1;
+	const unsigned int lasty = roi.height-1;
+	const unsigned int ncols = lastx/stepwidth + 1 + ( lastx%stepwidth ? 1 : 0 );
+	const unsigned int nrows = lasty/stepheight + 1 + ( lasty%stepheight ? 1 : 0 );
+	const unsigned int nwords = ROWBITS_WORDS(ncols);
+
+	if( !runtree_realloc_rows(ncols, workspace) ){
+		fprintf(stderr,"(runtree) Critical error: Mem allocation failed\n");
+		return 0;
+	}
+
+	unsigned int id=-1;//id for next component would be ++id
+	unsigned int max_comp = workspace->max_comp;
+	unsigned int num_runs = 0;
+	unsigned int max_runs = workspace->max_runs;
+	RuntreeRun *runs = workspace->runs;
+
+	unsigned int* comp_same = workspace->comp_same;
+	unsigned int* prob_parent = workspace->prob_parent;
+#ifdef BLOB_COUNT_PIXEL
+	unsigned int* comp_size = workspace->comp_size;
+#endif
+#ifdef BLOB_DIMENSION
+	unsigned int* top_index = workspace->top_index;
+	unsigned int* left_index = workspace->left_index;
+	unsigned int* right_index = workspace->right_index;
+	unsigned int* bottom_index = workspace->bottom_index;
+#endif
+#ifdef BLOB_BARYCENTER
+	BLOB_BARYCENTER_TYPE *pixel_sum_X = workspace->pixel_sum_X;
+	BLOB_BARYCENTER_TYPE *pixel_sum_Y = workspace->pixel_sum_Y;
+#endif
+
+	/* Double buffer for rows. *_start[n] is the start column of run n,
+	 * *_id[n] its id. */
+	uint64_t *cur_bits = workspace->row_bits;
+	uint64_t *up_bits = cur_bits + nwords;
+	unsigned int *cur_start = workspace->row_runs;
+	unsigned int *cur_id = cur_start + ncols+1;
+	unsigned int *up_start = cur_id + ncols+1;
+	unsigned int *up_id = up_start + ncols+1;
+	unsigned int up_n = 0, up_c = 0;
+
+	unsigned int r, k, j, jj;
+	for( r=0; r<nrows; r++ ){
+		const unsigned int y = roi.y + ( r*stepheight < lasty ? r*stepheight : lasty );
+		const unsigned char * const row = data + y*w + roi.x;
+
+		rowbits_binarize_row(row, ncols, stepwidth, lastx, thresh, cur_bits);
+		const unsigned int n = rowbits_to_runs(cur_bits, ncols, cur_start);
+		const unsigned int c0 = *cur_bits & 1;
+
+		if( num_runs+n > max_runs ){
+			max_runs = runtree_grow_size(max_runs, num_runs+n, r, nrows, nrows*ncols);
+			VPRINTF("Extend max_runs=%i\n", max_runs);
+			RuntreeRun *tmp = (RuntreeRun*) realloc(runs, max_runs*sizeof(RuntreeRun) );
+			if( tmp == NULL ){
+				fprintf(stderr,"(runtree) Critical error: Mem allocation failed\n");
+				return 0;
+			}
+			runs = tmp;
+			workspace->runs = runs;
+			workspace->max_runs = max_runs;
+		}
+
+		j = 0;
+		for( k=0; k<n; k++ ){
+			const unsigned int s = *(cur_start+k);
+			const unsigned int e = *(cur_start+k+1)-1;
+			const unsigned int c = c0 ^ (k&1);
+			const unsigned int xs = roi.x + ( s*stepwidth < lastx ? s*stepwidth : lastx );
+			const unsigned int xe = roi.x + ( e*stepwidth < lastx ? e*stepwidth : lastx );
+			unsigned int rid;
+
+			if( r == 0 ){
+				RUN_NEW_COMPONENT( k==0 ? DUMMY_ID : *(cur_id+k-1) );
+				rid = id;
+			}else{
+#define UP_CLASS(X) ROWBITS_GET(up_bits, X)
+#ifdef BLOB_DIAGONAL_CHECK
+				const unsigned int lo = s>0 ? s-1 : 0;
+				const unsigned int hi = e+1<ncols ? e+1 : e;
+				const int is_new = UP_CLASS(s) != c
+					&& ( s==0 || UP_CLASS(s-1) != c )
+					&& ( s+1>=ncols || UP_CLASS(s+1) != c );
+#else
+				const unsigned int lo = s;
+				const unsigned int hi = e;
+				const int is_new = UP_CLASS(s) != c;
+#endif
+#undef UP_CLASS
+				//first run of upper row which overlaps [lo, hi].
+				while( *(up_start+j+1) <= lo ) j++;
+
+				if( is_new ){
+					/* Parent is the left neighbour or the top neighbour
+					 * on the left border. */
+					RUN_NEW_COMPONENT( k==0 ? *(up_id+j) : *(cur_id+k-1) );
+					rid = id;
+				}else{
+					rid = -1;
+				}
+
+				for( jj=j; jj<up_n && *(up_start+jj)<=hi; jj++ ){
+					if( (up_c ^ (jj&1)) == c ){
+						if( rid == (unsigned int) -1 ){
+							rid = *(up_id+jj);
+						}else{
+							uf_union(comp_same, rid, *(up_id+jj));
+						}
+					}
+				}
+			}
+			*(cur_id+k) = rid;
+
+			RuntreeRun * const run = runs + num_runs;
+			run->x0 = xs;
+			run->x1 = xe;
+			run->y = y;
+			run->id = rid;
+			++num_runs;
+
+			/* Add pixels of run to rid. */
+			const unsigned int len = e-s+1;
+#ifdef BLOB_COUNT_PIXEL
+			BLOB_COMP(comp_size, rid) += len;
+#endif
+#ifdef BLOB_DIMENSION
+			if( BLOB_COMP(left_index, rid) > xs ) BLOB_COMP(left_index, rid) = xs;
+			if( BLOB_COMP(right_index, rid) < xe ) BLOB_COMP(right_index, rid) = xe;
+			BLOB_COMP(bottom_index, rid) = y;
+#endif
+#ifdef BLOB_BARYCENTER
+			BLOB_BARYCENTER_TYPE sum_x;
+			if( xe == roi.x+e*stepwidth ){
+				sum_x = (BLOB_BARYCENTER_TYPE) len*roi.x + (BLOB_BARYCENTER_TYPE) stepwidth*(s+e)*len/2;
+			}else{
+				//last column with remainder
+				sum_x = xe + (BLOB_BARYCENTER_TYPE) (len-1)*roi.x + (BLOB_BARYCENTER_TYPE) stepwidth*(s+e-1)*(len-1)/2;
+			}
+			BLOB_COMP(pixel_sum_X, rid) += sum_x;
+			BLOB_COMP(pixel_sum_Y, rid) += (BLOB_BARYCENTER_TYPE) y*len;
+#endif
+		}
+
+		//swap row buffers
+		uint64_t *tb = up_bits; up_bits = cur_bits; cur_bits = tb;
+		unsigned int *ts = up_start; up_start = cur_start; cur_start = ts;
+		unsigned int *ti = up_id; up_id = cur_id; cur_id = ti;
+		up_n = n;
+		up_c = c0;
+	}
+
+	workspace->num_runs = num_runs;
+	return id+1;
+}
+
+#undef COUNT
+#undef BD
+#undef BARY
+
+Tree* runtree_build_tree(
+		const BlobtreeRect roi,
+		const unsigned int stepwidth,
+		const unsigned int stepheight,
+		const unsigned int nids,
+		Blob **tree_data,
+		RuntreeWorkspace *workspace,
+		TreeArena *arena )
+{
+	unsigned int k; //loop variable
+
+	unsigned int* comp_same = workspace->comp_same;
+	unsigned int* prob_parent = workspace->prob_parent;
+#ifdef BLOB_COUNT_PIXEL
+	unsigned int* comp_size = workspace->comp_size;
+#endif
+#ifdef BLOB_DIMENSION
+	unsigned int* top_index = workspace->top_index;
+	unsigned int* left_index = workspace->left_index;
+	unsigned int* right_index = workspace->right_index;
+	unsigned int* bottom_index = workspace->bottom_index;
+#endif
+#ifdef BLOB_BARYCENTER
+	BLOB_BARYCENTER_TYPE *pixel_sum_X = workspace->pixel_sum_X;
+	BLOB_BARYCENTER_TYPE *pixel_sum_Y = workspace->pixel_sum_Y;
+#endif
+	unsigned int* const real_ids = workspace->real_ids;
+	unsigned int* const real_ids_inv = workspace->real_ids_inv;
+
+	BLOB_PHASE_BEGIN(t_merge)
+	/* Postprocessing.
+	 * Sum up all areas with connecteted ids.
+	 * Then create nodes and connect them.
+	 * See threshtree_build_tree.
+	 * */
+	unsigned int tmp_id, real_ids_size=0,l;
+
+	for(k=0;k<nids;k++){
+		/* comp_same(x) <= x holds. Thus, comp_same of the
+		 * smaller ids is already a projection. */
+		tmp_id = *(comp_same+k);
+		if( tmp_id != k ){
+			tmp_id = *(comp_same+tmp_id);
+			*(comp_same+k) = tmp_id;
+
+#ifdef BLOB_COUNT_PIXEL
+			//move area size to other id.
+			BLOB_COMP(comp_size, tmp_id) += BLOB_COMP(comp_size, k);
+			BLOB_COMP(comp_size, k) = 0;
+#endif
+
+#ifdef BLOB_DIMENSION
+			//update dimension
+			if( BLOB_COMP(top_index, tmp_id) > BLOB_COMP(top_index, k) )
+				BLOB_COMP(top_index, tmp_id) = BLOB_COMP(top_index, k);
+			if( BLOB_COMP(left_index, tmp_id) > BLOB_COMP(left_index, k) )
+				BLOB_COMP(left_index, tmp_id) = BLOB_COMP(left_index, k);
+			if( BLOB_COMP(right_index, tmp_id) < BLOB_COMP(right_index, k) )
+				BLOB_COMP(right_index, tmp_id) = BLOB_COMP(right_index, k);
+			if( BLOB_COMP(bottom_index, tmp_id) < BLOB_COMP(bottom_index, k) )
+				BLOB_COMP(bottom_index, tmp_id) = BLOB_COMP(bottom_index, k);
+#endif
+
+#ifdef BLOB_BARYCENTER
+			//shift values to other id
+			BLOB_COMP(pixel_sum_X, tmp_id) += BLOB_COMP(pixel_sum_X, k);
+			BLOB_COMP(pixel_sum_X, k) = 0;
+			BLOB_COMP(pixel_sum_Y, tmp_id) += BLOB_COMP(pixel_sum_Y, k);
+			BLOB_COMP(pixel_sum_Y, k) = 0;
+#endif
+
+		}else{
+			//Its a component id of a new area
+			*(real_ids+real_ids_size) = tmp_id;
+			*(real_ids_inv+tmp_id) = real_ids_size;//inverse function
+			real_ids_size++;
+		}
+	}
+
+	//Replace run ids by blob ids
+	RuntreeRun *run = workspace->runs;
+	const RuntreeRun * const runEnd = run + workspace->num_runs;
+	for( ; run<runEnd; ++run ){
+		run->id = *(comp_same + run->id);
+	}
+
+	BLOB_PHASE_END(BLOB_PHASE_MERGE, t_merge)
+	BLOB_PHASE_BEGIN(t_tree)
+	/*
+	 * Generate tree structure
+	 */
+	Node *nodes;
+	Blob *blobs;
+	Tree *tree;
+	/* store for every node the index of its last child */
+	unsigned int *last_child;
+	if( arena != NULL ){
+		tree = tree_arena_alloc(arena, real_ids_size+1, &blobs);
+		last_child = tree_arena_scratch(arena, real_ids_size+1);
+		if( tree == NULL || last_child == NULL ){
+			*tree_data = NULL;
+			return NULL;
+		}
+		nodes = tree->root;
+	}else{
+		nodes = malloc( (real_ids_size+1)*sizeof(Node) );
+		blobs = malloc( (real_ids_size+1)*sizeof(Blob) );
+		tree = malloc( sizeof(Tree) );
+		tree->root = nodes;
+		tree->size = real_ids_size + 1;
+		last_child = calloc( real_ids_size+1, sizeof(unsigned int) );
+
+		//init all node as leafs
+		for(l=0;l<real_ids_size+1;l++) *(nodes+l)=Leaf;
+	}
+
+	//set root node (the desired output are the child(ren) of this node.)
+	Node * const root = nodes;
+	Node *cur  = nodes;
+	Blob *curdata  = blobs;
+
+	curdata->id = -1; /* = MAX_UINT */
+	memcpy( &curdata->roi, &roi, sizeof(BlobtreeRect) );
+	curdata->area = roi.width * roi.height;
+#ifdef SAVE_DEPTH_MAP_VALUE
+	curdata->depth_level = 0;
+#endif
+	cur->data = curdata; // link to the data array.
+
+	BlobtreeRect *rect;
+
+	for(l=0;l<real_ids_size;l++){
+		cur++;
+		curdata++;
+		cur->data = curdata; // link to the data array.
+
+		const unsigned int rid = *(real_ids+l);
+		curdata->id = rid;	//Set id of this blob.
+#ifdef BLOB_DIMENSION
+		rect = &curdata->roi;
+		rect->y = BLOB_COMP(top_index, rid);
+		rect->height = BLOB_COMP(bottom_index, rid) - rect->y + 1;
+		rect->x = BLOB_COMP(left_index, rid);
+		rect->width = BLOB_COMP(right_index, rid) - rect->x + 1;
+#endif
+#ifdef SAVE_DEPTH_MAP_VALUE
+		curdata->depth_level = 0;
+#endif
+
+		tmp_id = *(prob_parent+rid); //get id of parent (or child) area.
+		if( tmp_id == DUMMY_ID ){
+			/* Use root as parent node. */
+			add_child_indexed(root, root, cur, last_child);
+		}else{
+			//find real id of parent id.
+			tmp_id = *(comp_same+tmp_id);
+			add_child_indexed(root, root + 1/*root pos shift*/ + *(real_ids_inv+tmp_id ),
+					cur, last_child);
+		}
+	}
+
+	BLOB_PHASE_END(BLOB_PHASE_TREE, t_tree)
+	BLOB_PHASE_BEGIN(t_areas)
+#ifdef BLOB_BARYCENTER
+	eval_barycenters(root->child, root, comp_size, pixel_sum_X, pixel_sum_Y);
+#define SUM_AREAS_IS_REDUNDANT
+#endif
+
+	/* Evaluate exact areas of blobs for stepwidth==1
+	 * and try to approximate for stepwith>1. The
+	 * approximation requires a bounding box.
+	 * */
+#ifdef BLOB_DIMENSION
+	#ifdef BLOB_COUNT_PIXEL
+	if(stepwidth == 1){
+#ifndef SUM_AREAS_IS_REDUNDANT
+		sum_areas(root->child, comp_size);
+#endif
+	}else{
+		approx_areas(tree, root->child, comp_size, stepwidth, stepheight, arena);
+		//replace estimation with exact value for full image area
+		Blob* img = (Blob*)root->child->data;
+		img->area = img->roi.width * img->roi.height;
+	}
+	#else
+	set_area_prop(root->child);
+	#endif
+#else
+	#ifdef BLOB_COUNT_PIXEL
+#ifndef SUM_AREAS_IS_REDUNDANT
+	sum_areas(root->child, comp_size);
+#endif
+	if(stepwidth > 1){
+		//Be aware, this values scales by stepwidth.
+		fprintf(stderr,"(runtree) Warning: Eval areas for stepwidth>1.\n");
+	}
+	#endif
+#endif
+
+	BLOB_PHASE_END(BLOB_PHASE_AREAS, t_areas)
+
+#ifdef BLOB_SORT_TREE
+	sort_tree(root);
+#endif
+
+	workspace->used_comp=nids-1;
+
+	//clean up
+	if( arena == NULL ) free(last_child);
+
+	//set output parameter
+	*tree_data = blobs;
+	return tree;
+}
+
+void runtree_find_blobs( Blobtree *blob,
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char thresh,
+		RuntreeWorkspace *workspace )
+{
+	//clear old tree
+	blobtree_clear_tree(blob);
+
+	//get new blob tree structure.
+	BLOB_PHASE_BEGIN(t_label)
+	const unsigned int nids = runtree_label(
+			data, w, h, roi, thresh,
+			blob->grid.width, blob->grid.height,
+			workspace );
+	BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+	if( nids > 0 ){
+		blob->tree = runtree_build_tree( roi,
+				blob->grid.width, blob->grid.height,
+				nids, &blob->tree_data, workspace, &blob->arena );
+	}
+}
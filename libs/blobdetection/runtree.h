@@ -0,0 +1,126 @@
+#ifndef RUNTREE_H
+#define RUNTREE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "settings.h"
+#include "tree.h"
+#include "blob.h"
+
+/* Third algorithm. Same output as threshtree, but
+ * the labeling operates on runs of equal pixels (in each grid row)
+ * instead of single pixels. There is no ids array of size w*h.
+ * The memory usage scales with the number of runs. The workspace
+ * arrays grow on demand and keep their size for the following frames,
+ * thus a reused workspace does not allocate after the first frames.
+ */
+
+/* Run of pixels of one blob in a grid row.
+ * All coordinates are image coordinates. For stepwidth>1 only
+ * the grid columns between x0 and x1 are part of the run.
+ */
+typedef struct {
+	unsigned int x0; // column of first pixel.
+	unsigned int x1; // column of last pixel.
+	unsigned int y; // row.
+	unsigned int id; // id of blob (Blob.id) after runtree_find_blobs.
+} RuntreeRun;
+
+/* Workspace struct for array storage */
+typedef struct {
+	unsigned int max_comp; //maximal number of components. If the value is reached some arrays will reallocate.
+	unsigned int used_comp; // number of used ids ; will be set after the main algorithm finishes ; <=max_comp
+	unsigned int *comp_same; //map ids to unique ids g:{0,...,}->{0,....}
+	unsigned int *prob_parent; //store ⊂-Relation.
+#ifdef BLOB_COMPONENT_RECORDS
+	BlobComponent *components; //storage of the following arrays, see settings.h
+#endif
+#ifdef BLOB_COUNT_PIXEL
+	unsigned int *comp_size;
+#endif
+#ifdef BLOB_DIMENSION
+	unsigned int *top_index; //save row number of most top element of area.
+	unsigned int *left_index; //save column number of most left element of area.
+	unsigned int *right_index; //save column number of most right element.
+	unsigned int *bottom_index; //save row number of most bottom element.
+#endif
+	unsigned int *real_ids;
+	unsigned int *real_ids_inv;
+
+#ifdef BLOB_BARYCENTER
+	BLOB_BARYCENTER_TYPE *pixel_sum_X; //summation of all x coordinates for an id.
+	BLOB_BARYCENTER_TYPE *pixel_sum_Y; //summation of all x coordinates for an id.
+#endif
+
+	//row buffers
+	unsigned int runs_width; // number of grid columns the row buffers can hold.
+	uint64_t *row_bits; // bit masks of current and previous row.
+	unsigned int *row_runs; // start columns and ids of runs in current and previous row.
+
+	//run length encoding of the last image
+	unsigned int num_runs;
+	unsigned int max_runs; //If the value is reached the array will reallocate.
+	RuntreeRun *runs;
+} RuntreeWorkspace;
+
+
+bool runtree_create_workspace(
+		const unsigned int w, const unsigned int h,
+		RuntreeWorkspace **pworkspace
+		);
+bool runtree_realloc_workspace(
+		const unsigned int max_comp,
+		RuntreeWorkspace **pworkspace
+		);
+void runtree_destroy_workspace(
+		RuntreeWorkspace **pworkspace
+		);
+
+/* Main function to eval blobs.
+ * Same arguments and same result as threshtree_find_blobs.
+ * Afterwards, workspace->runs contains all runs of the roi.
+ * */
+void runtree_find_blobs( Blobtree *blob,
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char thresh,
+		RuntreeWorkspace *workspace );
+
+/* Building blocks of runtree_find_blobs.
+ *
+ * runtree_label fills the run list and the component
+ * arrays of the workspace and returns the number of used ids (0 on error).
+ * runtree_build_tree joins the ids and creates the tree.
+ *
+ * If arena is NULL, the tree and *tree_data will be allocated on the heap.
+ * Otherwise, the storage of the arena will be reused, see blobtree_clear_tree.
+ */
+unsigned int runtree_label(
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char thresh,
+		const unsigned int stepwidth,
+		const unsigned int stepheight,
+		RuntreeWorkspace *workspace );
+
+Tree* runtree_build_tree(
+		const BlobtreeRect roi,
+		const unsigned int stepwidth,
+		const unsigned int stepheight,
+		const unsigned int nids,
+		Blob **tree_data,
+		RuntreeWorkspace *workspace,
+		TreeArena *arena );
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
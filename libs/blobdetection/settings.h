@@ -47,11 +47,45 @@
 #define BLOB_BARYCENTER_TYPE unsigned long
 #endif
 
+/* Memory layout of the component properties (pixel count,
+ * bounding box and barycenter sums) in the workspaces.
+ * Without this flag every property is stored in its own array.
+ * With this flag the properties of an id are packed into one
+ * record (BlobComponent, see tree.h). Joining two ids touches
+ * two records instead of up to 14 cache lines.
+ * Use bench_components.c to compare both layouts (cmake flag
+ * -DBUILD_BENCHMARKS=1, targets bench_components_*).
+ * Disabled because the records were not faster: On x86-64 both
+ * layouts are within the noise for the labeling and the tree build
+ * of threshtree is up to 15% slower for many ids (1x1 and 2x2 blocks,
+ * 1280x720). The depthtree build is 5-15% slower, too.
+ * */
+//#define BLOB_COMPONENT_RECORDS
+
+/* Measure the duration of the phases of the blob search
+ * (labeling, merge of ids, tree construction, areas).
+ * See phases.h and bench_blobs.c.
+ * */
+//#define BLOB_PHASE_TIMING
+
 
 /* See README
  */
 //#define BLOB_SUBGRID_CHECK 
 
+/* For threshtree algorithm.
+ * Binarize each row into a bit mask (SSE2/NEON if available)
+ * and label runs of equal pixels instead of single pixels.
+ * The result is equal to the pixelwise labeling.
+ * Not used if BLOB_SUBGRID_CHECK is set.
+ * */
+#define THRESHTREE_RUN_LENGTH
+
+/* For threshtree_find_blobs_incremental and depthtree_find_blobs_incremental.
+ * Edge length of the tiles (in pixels). Each tile will be labeled on its own.
+ * */
+#define BLOB_TILE_SIZE 64
+
 /* For depthtree algorithm.
  * Use identity function to distict the pixel values into
  * different depth ranges. This saves a small amount of time,
@@ -5,12 +5,21 @@
 #include <stdio.h>
 #include <time.h>
 #include <string.h> //for memset
+#include <limits.h>
 
 #include "threshtree.h"
 
 #include "threshtree_macros.h"
+#include "unionfind.h"
 //#include "threshtree_macros_old.h"
 
+static void threshtree_destroy_strips(
+		ThreshtreeWorkspace *workspace
+		);
+static void threshtree_destroy_tiles(
+		ThreshtreeWorkspace *workspace
+		);
+
 
 bool threshtree_create_workspace(
 		const unsigned int w, const unsigned int h,
@@ -30,10 +39,38 @@ bool threshtree_create_workspace(
 	const unsigned int max_comp = (w+h)*100;
 	r->max_comp = max_comp;
 	r->used_comp = 0;
+	r->num_strips = 0;
+	r->strips = NULL;
+	r->workers = NULL;
+	r->incremental_valid = false;
+	r->prev_data = NULL;
+	r->num_tiles = 0;
+	r->tiles_x = 0;
+	r->tiles_y = 0;
+	r->tiles = NULL;
+	r->comp_len = 0;
+	r->comp_first = NULL;
+	r->comp_node = NULL;
+	r->comp_list = NULL;
+	r->comp_changed = NULL;
+	tree_patch_init(&r->patch);
+#ifdef THRESHTREE_RUN_LENGTH
+	r->runs_width = 0;
+	r->row_bits = NULL;
+	r->runs = NULL;
+#endif
+	r->real_ids = NULL;
+	r->real_ids_inv = NULL;
+	r->blob_id_filtered = NULL;
 	if(
 			( r->ids = (unsigned int*) malloc( w*h*sizeof(unsigned int) ) ) == NULL ||
 			( r->comp_same = (unsigned int*) malloc( max_comp*sizeof(unsigned int) ) ) == NULL ||
 			( r->prob_parent = (unsigned int*) malloc( max_comp*sizeof(unsigned int) ) ) == NULL ||
+			( r->real_ids = (unsigned int*) malloc( max_comp*sizeof(unsigned int) ) ) == NULL ||
+			( r->real_ids_inv = (unsigned int*) malloc( max_comp*sizeof(unsigned int) ) ) == NULL ||
+#ifdef BLOB_COMPONENT_RECORDS
+			( r->components = (BlobComponent*) malloc( max_comp*sizeof(BlobComponent) ) ) == NULL ||
+#else
 #ifdef BLOB_COUNT_PIXEL
 			( r->comp_size = (unsigned int*) malloc( max_comp*sizeof(unsigned int) ) ) == NULL ||
 #endif
@@ -47,23 +84,22 @@ bool threshtree_create_workspace(
 #ifdef BLOB_BARYCENTER
 			( r->pixel_sum_X = (BLOB_BARYCENTER_TYPE*) malloc( max_comp*sizeof(BLOB_BARYCENTER_TYPE) ) ) == NULL ||
 			( r->pixel_sum_Y = (BLOB_BARYCENTER_TYPE*) malloc( max_comp*sizeof(BLOB_BARYCENTER_TYPE) ) ) == NULL ||
+#endif
 #endif
 			0 ){
 		// alloc failed
 		threshtree_destroy_workspace( &r );
 		return false;
 	}
+#ifdef BLOB_COMPONENT_RECORDS
+	BLOB_COMP_LINK(r)
+#endif
 
 #ifdef BLOB_SUBGRID_CHECK
 	r->triangle = NULL;
 	r->triangle_len = 0;
 #endif
 
-	r->real_ids = NULL;
-	r->real_ids_inv = NULL;
-
-	r->blob_id_filtered = NULL;
-
 	*pworkspace=r;
 	return true;
 }
@@ -78,6 +114,11 @@ bool threshtree_realloc_workspace(
 	if(
 			( r->comp_same = (unsigned int*) realloc(r->comp_same, max_comp*sizeof(unsigned int) ) ) == NULL ||
 			( r->prob_parent = (unsigned int*) realloc(r->prob_parent, max_comp*sizeof(unsigned int) ) ) == NULL ||
+			( r->real_ids = (unsigned int*) realloc(r->real_ids, max_comp*sizeof(unsigned int) ) ) == NULL ||
+			( r->real_ids_inv = (unsigned int*) realloc(r->real_ids_inv, max_comp*sizeof(unsigned int) ) ) == NULL ||
+#ifdef BLOB_COMPONENT_RECORDS
+			( r->components = (BlobComponent*) realloc(r->components, max_comp*sizeof(BlobComponent) ) ) == NULL ||
+#else
 #ifdef BLOB_COUNT_PIXEL
 			( r->comp_size = (unsigned int*) realloc(r->comp_size, max_comp*sizeof(unsigned int) ) ) == NULL ||
 #endif
@@ -90,6 +131,7 @@ bool threshtree_realloc_workspace(
 #ifdef BLOB_BARYCENTER_TYPE
 			( r->pixel_sum_X = (BLOB_BARYCENTER_TYPE*) realloc(r->pixel_sum_X, max_comp*sizeof(BLOB_BARYCENTER_TYPE) ) ) == NULL ||
 			( r->pixel_sum_Y = (BLOB_BARYCENTER_TYPE*) realloc(r->pixel_sum_Y, max_comp*sizeof(BLOB_BARYCENTER_TYPE) ) ) == NULL ||
+#endif
 #endif
 			0 ){
 		// realloc failed
@@ -97,6 +139,9 @@ bool threshtree_realloc_workspace(
 		threshtree_destroy_workspace( pworkspace );
 		return false;
 	}
+#ifdef BLOB_COMPONENT_RECORDS
+	BLOB_COMP_LINK(r)
+#endif
 
 	free(r->blob_id_filtered);//omit unnessecary reallocation and omit wrong/low size
 	r->blob_id_filtered = NULL;//should be allocated later if needed.
@@ -113,6 +158,9 @@ void threshtree_destroy_workspace(
 	free(r->ids);
 	free(r->comp_same);
 	free(r->prob_parent);
+#ifdef BLOB_COMPONENT_RECORDS
+	free(r->components);
+#else
 #ifdef BLOB_COUNT_PIXEL
 	free(r->comp_size);
 #endif
@@ -126,6 +174,7 @@ void threshtree_destroy_workspace(
 	free(r->pixel_sum_X);
 	free(r->pixel_sum_Y);
 #endif
+#endif
 
 #ifdef BLOB_SUBGRID_CHECK
 	free(r->triangle);
@@ -138,6 +187,21 @@ void threshtree_destroy_workspace(
 
 	free(r->blob_id_filtered);
 
+#ifdef THRESHTREE_RUN_LENGTH
+	free(r->row_bits);
+	free(r->runs);
+#endif
+
+	threshtree_destroy_strips(r);
+	blob_workers_destroy(&r->workers);
+	threshtree_destroy_tiles(r);
+	free(r->prev_data);
+	free(r->comp_first);
+	free(r->comp_node);
+	free(r->comp_list);
+	free(r->comp_changed);
+	tree_patch_destroy(&r->patch);
+
 	free(r);
 	*pworkspace = NULL;
 }
@@ -378,11 +442,11 @@ Tree* find_connection_components_subcheck(
 	/* Pointer is swr behind currrent element.*/
 	//BLOB_INC_COMP_SIZE; would increase wrong element, omit macro
 #ifdef BLOB_COUNT_PIXEL
-	*(comp_size+*(iPi-swr)) += 1;
+	BLOB_COMP(comp_size, *(iPi-swr)) += 1;
 #endif
 #ifdef BLOB_BARYCENTER
-	*(pixel_sum_X+*(iPi-swr)) += s;
-	*(pixel_sum_Y+*(iPi-swr)) += z;
+	BLOB_COMP(pixel_sum_X, *(iPi-swr)) += s;
+	BLOB_COMP(pixel_sum_Y, *(iPi-swr)) += z;
 #endif
 
 	/* Move pointer to 'next' row.*/
@@ -898,13 +962,8 @@ Tree* find_connection_components_subcheck(
 	 * */
 	unsigned int nids = id+1; //number of ids
 	unsigned int tmp_id,/*tmp_id2,*/ real_ids_size=0,l;
-	free(workspace->real_ids);
-	workspace->real_ids = calloc( nids, sizeof(unsigned int) ); //store join of ids.
-	unsigned int* const real_ids = workspace->real_ids;
-
-	free(workspace->real_ids_inv);
-	workspace->real_ids_inv = calloc( nids, sizeof(unsigned int) ); //store for every id with position in real_id link to it's position.
-	unsigned int* const real_ids_inv = workspace->real_ids_inv;
+	unsigned int* const real_ids = workspace->real_ids; //store join of ids.
+	unsigned int* const real_ids_inv = workspace->real_ids_inv; //store for every id with position in real_id link to it's position.
 
 #if 1
 	for(k=0;k<nids;k++){
@@ -933,28 +992,28 @@ Tree* find_connection_components_subcheck(
 
 #ifdef BLOB_COUNT_PIXEL
 			//move area size to other id.
-			*(comp_size+tmp_id) += *(comp_size+k);
-			*(comp_size+k) = 0;
+			BLOB_COMP(comp_size, tmp_id) += BLOB_COMP(comp_size, k);
+			BLOB_COMP(comp_size, k) = 0;
 #endif
 
 #ifdef BLOB_DIMENSION
 			//update dimension
-			if( *( top_index+tmp_id ) > *( top_index+k ) )
-				*( top_index+tmp_id ) = *( top_index+k );
-			if( *( left_index+tmp_id ) > *( left_index+k ) )
-				*( left_index+tmp_id ) = *( left_index+k );
-			if( *( right_index+tmp_id ) < *( right_index+k ) )
-				*( right_index+tmp_id ) = *( right_index+k );
-			if( *( bottom_index+tmp_id ) < *( bottom_index+k ) )
-				*( bottom_index+tmp_id ) = *( bottom_index+k );
+			if( BLOB_COMP(top_index, tmp_id) > BLOB_COMP(top_index, k) )
+				BLOB_COMP(top_index, tmp_id) = BLOB_COMP(top_index, k);
+			if( BLOB_COMP(left_index, tmp_id) > BLOB_COMP(left_index, k) )
+				BLOB_COMP(left_index, tmp_id) = BLOB_COMP(left_index, k);
+			if( BLOB_COMP(right_index, tmp_id) < BLOB_COMP(right_index, k) )
+				BLOB_COMP(right_index, tmp_id) = BLOB_COMP(right_index, k);
+			if( BLOB_COMP(bottom_index, tmp_id) < BLOB_COMP(bottom_index, k) )
+				BLOB_COMP(bottom_index, tmp_id) = BLOB_COMP(bottom_index, k);
 #endif
 
 #ifdef BLOB_BARYCENTER
 			//shift values to other id
-			*(pixel_sum_X+tmp_id) += *(pixel_sum_X+k); 
-			*(pixel_sum_X+k) = 0;
-			*(pixel_sum_Y+tmp_id) += *(pixel_sum_Y+k); 
-			*(pixel_sum_Y+k) = 0;
+			BLOB_COMP(pixel_sum_X, tmp_id) += BLOB_COMP(pixel_sum_X, k); 
+			BLOB_COMP(pixel_sum_X, k) = 0;
+			BLOB_COMP(pixel_sum_Y, tmp_id) += BLOB_COMP(pixel_sum_Y, k); 
+			BLOB_COMP(pixel_sum_Y, k) = 0;
 #endif
 
 		}else{
@@ -965,7 +1024,7 @@ Tree* find_connection_components_subcheck(
 			 * this provoke the division by 0 due the barycenter evaluation.
 			 * Thus, it's probably the best decision
 			 * to ignore these nodes. */
-			if( *(comp_size+tmp_id ) ){
+			if( BLOB_COMP(comp_size, tmp_id) ){
 				*(real_ids+real_ids_size) = tmp_id;
 				*(real_ids_inv+tmp_id) = real_ids_size;//inverse function
 				real_ids_size++;
@@ -1004,28 +1063,28 @@ Tree* find_connection_components_subcheck(
 
 #ifdef BLOB_COUNT_PIXEL
 		//move area size to other id.
-		*(comp_size+tmp_id2) += *(comp_size+k);
-		*(comp_size+k) = 0;
+		BLOB_COMP(comp_size, tmp_id2) += BLOB_COMP(comp_size, k);
+		BLOB_COMP(comp_size, k) = 0;
 #endif
 
 #ifdef BLOB_DIMENSION
 		//update dimension
-		if( *( top_index+tmp_id2 ) > *( top_index+k ) )
-			*( top_index+tmp_id2 ) = *( top_index+k );
-		if( *( left_index+tmp_id2 ) > *( left_index+k ) )
-			*( left_index+tmp_id2 ) = *( left_index+k );
-		if( *( right_index+tmp_id2 ) < *( right_index+k ) )
-			*( right_index+tmp_id2 ) = *( right_index+k );
-		if( *( bottom_index+tmp_id2 ) < *( bottom_index+k ) )
-			*( bottom_index+tmp_id2 ) = *( bottom_index+k );
+		if( BLOB_COMP(top_index, tmp_id2) > BLOB_COMP(top_index, k) )
+			BLOB_COMP(top_index, tmp_id2) = BLOB_COMP(top_index, k);
+		if( BLOB_COMP(left_index, tmp_id2) > BLOB_COMP(left_index, k) )
+			BLOB_COMP(left_index, tmp_id2) = BLOB_COMP(left_index, k);
+		if( BLOB_COMP(right_index, tmp_id2) < BLOB_COMP(right_index, k) )
+			BLOB_COMP(right_index, tmp_id2) = BLOB_COMP(right_index, k);
+		if( BLOB_COMP(bottom_index, tmp_id2) < BLOB_COMP(bottom_index, k) )
+			BLOB_COMP(bottom_index, tmp_id2) = BLOB_COMP(bottom_index, k);
 #endif
 
 #ifdef BLOB_BARYCENTER
 		//shift values to other id
-		*(pixel_sum_X+tmp_id) += *(pixel_sum_X+k); 
-		*(pixel_sum_X+k) = 0;
-		*(pixel_sum_Y+tmp_id) += *(pixel_sum_Y+k); 
-		*(pixel_sum_Y+k) = 0;
+		BLOB_COMP(pixel_sum_X, tmp_id) += BLOB_COMP(pixel_sum_X, k); 
+		BLOB_COMP(pixel_sum_X, k) = 0;
+		BLOB_COMP(pixel_sum_Y, tmp_id) += BLOB_COMP(pixel_sum_Y, k); 
+		BLOB_COMP(pixel_sum_Y, k) = 0;
 #endif
 
 		//check if area id already identified as real id
@@ -1084,15 +1143,15 @@ Tree* find_connection_components_subcheck(
 		curdata->id = rid;	//Set id of this blob.
 #ifdef BLOB_DIMENSION
 		rect = &curdata->roi;
-		rect->y = *(top_index + rid);
-		rect->height = *(bottom_index + rid) - rect->y + 1;
-		rect->x = *(left_index + rid);
-		rect->width = *(right_index + rid) - rect->x + 1;
+		rect->y = BLOB_COMP(top_index, rid);
+		rect->height = BLOB_COMP(bottom_index, rid) - rect->y + 1;
+		rect->x = BLOB_COMP(left_index, rid);
+		rect->width = BLOB_COMP(right_index, rid) - rect->x + 1;
 #endif
 #ifdef BLOB_BARYCENTER
 		/* The barycenter will not set here, but in eval_barycenters(...) */
-		//curdata->barycenter[0] = *(pixel_sum_X + rid) / *(comp_same + rid);
-		//curdata->barycenter[1] = *(pixel_sum_Y + rid) / *(comp_same + rid);
+		//curdata->barycenter[0] = BLOB_COMP(pixel_sum_X, rid) / *(comp_same + rid);
+		//curdata->barycenter[1] = BLOB_COMP(pixel_sum_Y, rid) / *(comp_same + rid);
 #endif
 #ifdef SAVE_DEPTH_MAP_VALUE
 		curdata->depth_level = 0; /* ??? without anchor not trivial.*/
@@ -1140,7 +1199,7 @@ Tree* find_connection_components_subcheck(
 		sum_areas(root->child, comp_size);
 #endif
 	}else{
-		approx_areas(tree, root->child, comp_size, stepwidth, stepheight);
+		approx_areas(tree, root->child, comp_size, stepwidth, stepheight, NULL);
 		//replace estimation with exact value for full image area
 		Blob* img = (Blob*)root->child->data;
 		img->area = img->roi.width * img->roi.height;
@@ -1193,14 +1252,10 @@ void threshtree_find_blobs( Blobtree *blob,
 		ThreshtreeWorkspace *workspace )
 {
 	//clear old tree
-	if( blob->tree != NULL){
-		tree_destroy(&blob->tree);
-		blob->tree = NULL;
-	}
-	if( blob->tree_data != NULL){
-		free(blob->tree_data);
-		blob->tree_data = NULL;
-	}
+	blobtree_clear_tree(blob);
+	//ids array will be overwritten.
+	workspace->incremental_valid = false;
+
 	//get new blob tree structure.
 #ifdef BLOB_SUBGRID_CHECK
 	blob->tree = find_connection_components_subcheck(
@@ -1209,11 +1264,1296 @@ void threshtree_find_blobs( Blobtree *blob,
 			&blob->tree_data,
 			workspace );
 #else
-	blob->tree = find_connection_components_coarse(
+	BLOB_PHASE_BEGIN(t_label)
+	const unsigned int nids = THRESHTREE_LABEL(
 			data, w, h, roi, thresh,
 			blob->grid.width, blob->grid.height,
-			&blob->tree_data,
 			workspace );
+	BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+	if( nids > 0 ){
+		blob->tree = threshtree_build_tree( roi,
+				blob->grid.width, blob->grid.height,
+				nids, &blob->tree_data, workspace, &blob->arena );
+	}
+#endif
+}
+
+
+/* Parallel labeling of horizontal strips.
+ *
+ * Every strip will be labeled by find_connection_components_coarse
+ * on its own. The first row of a strip is handled like the top border
+ * of the roi, thus some of its ids are superfluous. The merge step
+ * maps all ids of a strip on the ids of the serial algorithm.
+ * Finally, threshtree_build_tree creates the tree as in the serial case.
+ */
+
+#ifndef DUMMY_ID
+#define DUMMY_ID -1 //id virtual parent of first element (id=0)
+#endif
+
+typedef struct {
+	const unsigned char *data; // data of strip begin.
+	unsigned int *ids; // ids of strip begin.
+	unsigned int w, h;
+	unsigned char thresh;
+	unsigned int stepwidth, stepheight;
+	ThreshtreeStrip *strip;
+} ThreshtreeStripJob;
+
+static void threshtree_destroy_strips(
+		ThreshtreeWorkspace *workspace
+		){
+	unsigned int k;
+	if( workspace->strips == NULL ) return;
+
+	for( k=0; k<workspace->num_strips; k++){
+		ThreshtreeStrip *strip = workspace->strips+k;
+		if( k>0 && strip->workspace != NULL ){
+			strip->workspace->ids = NULL; //owned by parent workspace
+			threshtree_destroy_workspace( &strip->workspace );
+		}
+		free(strip->id_map);
+	}
+	free(workspace->strips);
+	workspace->strips = NULL;
+	workspace->num_strips = 0;
+}
+
+static bool threshtree_create_strips(
+		const unsigned int num_strips,
+		ThreshtreeWorkspace *workspace
+		){
+	unsigned int k;
+	if( workspace->num_strips == num_strips ) return true;
+	threshtree_destroy_strips( workspace );
+
+	workspace->strips = (ThreshtreeStrip*) calloc( num_strips, sizeof(ThreshtreeStrip) );
+	if( workspace->strips == NULL ) return false;
+	workspace->num_strips = num_strips;
+
+	//first strip will be labeled in the parent workspace.
+	workspace->strips->workspace = workspace;
+
+	const unsigned int max_comp = workspace->max_comp/num_strips + 1;
+	for( k=1; k<num_strips; k++){
+		ThreshtreeStrip *strip = workspace->strips+k;
+		/* Only the component arrays are required. The ids array
+		 * of the parent workspace will be shared. */
+		if(
+				( strip->workspace = (ThreshtreeWorkspace*) calloc( 1, sizeof(ThreshtreeWorkspace) ) ) == NULL ||
+				!threshtree_realloc_workspace( max_comp, &strip->workspace ) ||
+				( strip->id_map = (unsigned int*) malloc( max_comp*sizeof(unsigned int) ) ) == NULL ||
+				0 ){
+			VPRINTF("Critical error: Allocation of strip workspace failed!\n");
+			threshtree_destroy_strips( workspace );
+			return false;
+		}
+		strip->id_map_len = max_comp;
+	}
+	return true;
+}
+
+/* Next position of the coarse grid {0, step, 2*step, …, last}.
+ * Returns last+1 after the last position. */
+static inline unsigned int threshtree_grid_next(
+		const unsigned int pos,
+		const unsigned int step,
+		const unsigned int last
+		){
+	if( pos+step <= last ) return pos+step;
+	if( pos < last ) return last;
+	return last+1;
+}
+
+static void *threshtree_label_strip( void *arg ){
+	ThreshtreeStripJob *job = (ThreshtreeStripJob*) arg;
+	ThreshtreeStrip *strip = job->strip;
+	strip->nids = THRESHTREE_LABEL( job->data, job->w, job->h,
+			strip->roi, job->thresh,
+			job->stepwidth, job->stepheight,
+			strip->workspace );
+	return NULL;
+}
+
+/* Replace strip ids by the merged ids.
+ * The strip ids will be read from the strip workspace and written
+ * into job->ids. Both arrays are equal for the parallel labeling.
+ */
+static void *threshtree_remap_strip( void *arg ){
+	ThreshtreeStripJob *job = (ThreshtreeStripJob*) arg;
+	const ThreshtreeStrip *strip = job->strip;
+	const unsigned int * const id_map = strip->id_map;
+	const unsigned int xlast = strip->roi.x + strip->roi.width - 1;
+	const unsigned int ylast = strip->roi.y + strip->roi.height - 1;
+	unsigned int x, y;
+
+	for( y=strip->roi.y; y<=ylast; y=threshtree_grid_next(y, job->stepheight, ylast) ){
+		const unsigned int * const sRow = strip->workspace->ids + y*job->w;
+		unsigned int * const iRow = job->ids + y*job->w;
+		for( x=strip->roi.x; x<=xlast; x=threshtree_grid_next(x, job->stepwidth, xlast) ){
+			*(iRow+x) = *(id_map+*(sRow+x));
+		}
+	}
+	return NULL;
+}
+
+/* Map ids of all strips on the ids of the serial algorithm
+ * and join the ids along the strip borders.
+ *
+ * The serial algorithm creates a new id on the first row of
+ * a strip only if no neighbour in the row above has the same class.
+ * All other strip ids of this row will be mapped on an id of the upper strip.
+ * Ids of the following rows are new in both cases.
+ */
+static bool threshtree_merge_strips(
+		const unsigned char *data,
+		const unsigned int w,
+		const BlobtreeRect roi,
+		const unsigned char thresh,
+		const unsigned int stepwidth,
+		const unsigned int stepheight,
+		ThreshtreeWorkspace *workspace,
+		unsigned int *pnids )
+{
+	ThreshtreeStrip * const strips = workspace->strips;
+	const unsigned int xlast = roi.x + roi.width - 1;
+	unsigned int nids = strips->nids;
+	unsigned int j, k, x, xp, xn, pp;
+
+	for( k=1; k<workspace->num_strips; k++){
+		ThreshtreeStrip * const strip = strips+k;
+		const ThreshtreeWorkspace * const sw = strip->workspace;
+		const unsigned int snids = strip->nids;
+		const unsigned int base = nids;
+		const unsigned int oy = strip->offset_y;
+
+		/* Last grid row of upper strip and first row of this strip */
+		const unsigned char * const dU = data + (oy-stepheight)*w;
+		const unsigned char * const dL = data + oy*w;
+		const unsigned int * const iU = workspace->ids + (oy-stepheight)*w;
+		const unsigned int * const iL = workspace->ids + oy*w;
+		//ids of first strip are already final.
+		const unsigned int * const uMap = (k==1)?NULL:(strips+k-1)->id_map;
+#define UPPER_ID(X) ( uMap==NULL ? *(iU+(X)) : *(uMap+*(iU+(X))) )
+
+		if( strip->id_map_len < snids ){
+			free(strip->id_map);
+			strip->id_map = (unsigned int*) malloc( sw->max_comp*sizeof(unsigned int) );
+			if( strip->id_map == NULL ){
+				strip->id_map_len = 0;
+				return false;
+			}
+			strip->id_map_len = sw->max_comp;
+		}
+		unsigned int * const id_map = strip->id_map;
+
+		/* 1. Ids of first row. Each run of pixels got one id
+		 * and the ids are increasing. */
+		xp = xlast+1; //no left neighbour
+		for( x=roi.x; x<=xlast; xp=x, x=xn ){
+			xn = threshtree_grid_next(x, stepwidth, xlast);
+			j = *(iL+x);
+			if( xp<=xlast && j == *(iL+xp) ) continue;
+
+			const int c = ( *(dL+x) > thresh );
+			if( ( *(dU+x) > thresh ) == c ){
+				*(id_map+j) = UPPER_ID(x);
+#ifdef BLOB_DIAGONAL_CHECK
+			}else if( xp<=xlast && ( *(dU+xp) > thresh ) == c ){
+				*(id_map+j) = UPPER_ID(xp);
+			}else if( xn<=xlast && ( *(dU+xn) > thresh ) == c ){
+				*(id_map+j) = UPPER_ID(xn);
+#endif
+			}else{
+				*(id_map+j) = nids++;
+			}
+		}
+
+		/* 2. Ids of all other rows */
+		for( j=*(iL+xlast)+1; j<snids; j++){
+			*(id_map+j) = nids++;
+		}
+
+		if( nids > workspace->max_comp ){
+			if( !threshtree_realloc_workspace( nids + nids/4, &workspace ) ){
+				return false;
+			}
+		}
+
+		unsigned int * const comp_same = workspace->comp_same;
+		unsigned int * const prob_parent = workspace->prob_parent;
+#ifdef BLOB_COUNT_PIXEL
+		unsigned int * const comp_size = workspace->comp_size;
+#endif
+#ifdef BLOB_DIMENSION
+		unsigned int * const top_index = workspace->top_index;
+		unsigned int * const left_index = workspace->left_index;
+		unsigned int * const right_index = workspace->right_index;
+		unsigned int * const bottom_index = workspace->bottom_index;
+#endif
+#ifdef BLOB_BARYCENTER
+		BLOB_BARYCENTER_TYPE * const pixel_sum_X = workspace->pixel_sum_X; 
+		BLOB_BARYCENTER_TYPE * const pixel_sum_Y = workspace->pixel_sum_Y; 
+#endif
+
+		/* 3. Copy component data. The row values of the strip
+		 * are relative to oy. */
+		for( j=0; j<snids; j++){
+			const unsigned int g = *(id_map+j);
+			if( g >= base ){
+				*(comp_same+g) = g;
+
+				pp = *(sw->prob_parent+j);
+				if( pp == DUMMY_ID ){
+					//left border of first row. Serial algorithm uses top neighbour.
+					pp = UPPER_ID(roi.x);
+				}else if( pp < snids ){
+					pp = *(id_map+pp);
+				}else{
+					pp = DUMMY_ID;
+				}
+				*(prob_parent+g) = pp;
+
+#ifdef BLOB_COUNT_PIXEL
+				BLOB_COMP(comp_size, g) = BLOB_COMP(sw->comp_size, j);
+#endif
+#ifdef BLOB_DIMENSION
+				BLOB_COMP(top_index, g) = BLOB_COMP(sw->top_index, j) + oy;
+				BLOB_COMP(left_index, g) = BLOB_COMP(sw->left_index, j);
+				BLOB_COMP(right_index, g) = BLOB_COMP(sw->right_index, j);
+				BLOB_COMP(bottom_index, g) = BLOB_COMP(sw->bottom_index, j) + oy;
+#endif
+#ifdef BLOB_BARYCENTER
+				BLOB_COMP(pixel_sum_X, g) = BLOB_COMP(sw->pixel_sum_X, j);
+				BLOB_COMP(pixel_sum_Y, g) = BLOB_COMP(sw->pixel_sum_Y, j)
+					+ (BLOB_BARYCENTER_TYPE) oy * BLOB_COMP(sw->comp_size, j);
+#endif
+			}else{
+				//Id was mapped on id of upper strip.
+#ifdef BLOB_COUNT_PIXEL
+				BLOB_COMP(comp_size, g) += BLOB_COMP(sw->comp_size, j);
+#endif
+#ifdef BLOB_DIMENSION
+				if( BLOB_COMP(left_index, g) > BLOB_COMP(sw->left_index, j) )
+					BLOB_COMP(left_index, g) = BLOB_COMP(sw->left_index, j);
+				if( BLOB_COMP(right_index, g) < BLOB_COMP(sw->right_index, j) )
+					BLOB_COMP(right_index, g) = BLOB_COMP(sw->right_index, j);
+				if( BLOB_COMP(bottom_index, g) < BLOB_COMP(sw->bottom_index, j) + oy )
+					BLOB_COMP(bottom_index, g) = BLOB_COMP(sw->bottom_index, j) + oy;
+#endif
+#ifdef BLOB_BARYCENTER
+				BLOB_COMP(pixel_sum_X, g) += BLOB_COMP(sw->pixel_sum_X, j);
+				BLOB_COMP(pixel_sum_Y, g) += BLOB_COMP(sw->pixel_sum_Y, j)
+					+ (BLOB_BARYCENTER_TYPE) oy * BLOB_COMP(sw->comp_size, j);
+#endif
+			}
+		}
+
+		/* 4. Transfer relations of strip ids */
+		for( j=0; j<snids; j++){
+			const unsigned int c = *(sw->comp_same+j);
+			if( c != j ){
+				uf_union(comp_same, *(id_map+j), *(id_map+c) );
+			}
+		}
+
+		/* 5. Join ids along the strip border */
+		xp = xlast+1;
+		for( x=roi.x; x<=xlast; xp=x, x=xn ){
+			xn = threshtree_grid_next(x, stepwidth, xlast);
+			const int c = ( *(dL+x) > thresh );
+			const unsigned int g = *(id_map+*(iL+x));
+			if( ( *(dU+x) > thresh ) == c ){
+				uf_union(comp_same, g, UPPER_ID(x) );
+			}
+#ifdef BLOB_DIAGONAL_CHECK
+			if( xp<=xlast && ( *(dU+xp) > thresh ) == c ){
+				uf_union(comp_same, g, UPPER_ID(xp) );
+			}
+			if( xn<=xlast && ( *(dU+xn) > thresh ) == c ){
+				uf_union(comp_same, g, UPPER_ID(xn) );
+			}
+#endif
+		}
+#undef UPPER_ID
+	}
+
+	/* Make comp_same to a projection. Due comp_same(x) <= x
+	 * one pass in increasing order is sufficient. */
+	unsigned int * const comp_same = workspace->comp_same;
+	for( j=0; j<nids; j++){
+		*(comp_same+j) = *(comp_same+*(comp_same+j));
+	}
+
+	*pnids = nids;
+	return true;
+}
+
+void threshtree_find_blobs_parallel( Blobtree *blob,
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char thresh,
+		const unsigned int num_threads,
+		ThreshtreeWorkspace *workspace )
+{
+#ifndef BLOB_SUBGRID_CHECK
+	const unsigned int stepwidth = blob->grid.width;
+	const unsigned int stepheight = blob->grid.height;
+	/* Number of rows of the coarse grid without the remainder row.
+	 * Every strip should contain at least two rows. */
+	const unsigned int grid_rows = (roi.height-1)/stepheight + 1;
+	unsigned int num_strips = num_threads;
+	if( num_strips > grid_rows/2 ) num_strips = grid_rows/2;
+
+	if( num_strips < 2 || !threshtree_create_strips(num_strips, workspace) )
+#endif
+	{
+		threshtree_find_blobs(blob, data, w, h, roi, thresh, workspace);
+		return;
+	}
+
+#ifndef BLOB_SUBGRID_CHECK
+	//clear old tree
+	blobtree_clear_tree(blob);
+	//ids array will be overwritten.
+	workspace->incremental_valid = false;
+	BLOB_PHASE_BEGIN(t_label)
+
+	ThreshtreeStrip * const strips = workspace->strips;
+	ThreshtreeStripJob jobs[num_strips];
+	unsigned int k, nids;
+
+	/* The threads survive the call. Without them, the strips
+	 * will be labeled one after another. */
+	if( !blob_workers_create(num_strips-1, &workspace->workers) ){
+		VPRINTF("(threshtree) Start of worker threads failed. Label strips serial.\n");
+	}
+
+	/* Split roi into strips. Each strip begins on a row of the grid. */
+	for( k=0; k<num_strips; k++){
+		ThreshtreeStrip * const strip = strips+k;
+		const unsigned int g0 = k*grid_rows/num_strips;
+		const unsigned int g1 = (k+1)*grid_rows/num_strips;
+
+		strip->offset_y = roi.y + g0*stepheight;
+		strip->roi.x = roi.x;
+		strip->roi.width = roi.width;
+		strip->roi.height = ( k+1<num_strips ) ?
+			(g1-g0-1)*stepheight + 1 : roi.y + roi.height - strip->offset_y;
+		strip->nids = 0;
+
+		jobs[k].w = w;
+		jobs[k].thresh = thresh;
+		jobs[k].stepwidth = stepwidth;
+		jobs[k].stepheight = stepheight;
+		jobs[k].strip = strip;
+		if( k == 0 ){
+			strip->roi.y = roi.y;
+			jobs[k].data = data;
+			jobs[k].ids = workspace->ids;
+			jobs[k].h = h;
+		}else{
+			/* Shift data pointer to avoid big coordinates in the strip
+			 * workspace. The row offset will be added in the merge step. */
+			strip->roi.y = 0;
+			jobs[k].data = data + strip->offset_y*w;
+			jobs[k].ids = workspace->ids + strip->offset_y*w;
+			jobs[k].h = strip->roi.height;
+			strip->workspace->ids = jobs[k].ids;
+		}
+	}
+
+	/* 1. Label strips */
+	blob_workers_run(workspace->workers, threshtree_label_strip,
+			jobs, sizeof(ThreshtreeStripJob), 0, num_strips);
+
+	/* 2. Merge ids */
+	for( k=0; k<num_strips; k++){
+		if( (strips+k)->nids == 0 ){
+			//labeling failed. No tree for this frame.
+			blob->tree = NULL;
+			BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+			return;
+		}
+	}
+	if( !threshtree_merge_strips(data, w, roi, thresh, stepwidth, stepheight,
+				workspace, &nids ) ){
+		printf("(threshtree) Critical error: Merging of strips failed\n");
+		blob->tree = NULL;
+		BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+		return;
+	}
+
+	/* 3. Update ids array. The first strip already contains the merged ids. */
+	blob_workers_run(workspace->workers, threshtree_remap_strip,
+			jobs, sizeof(ThreshtreeStripJob), 1, num_strips);
+
+	BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+	//get new blob tree structure.
+	blob->tree = threshtree_build_tree(roi, stepwidth, stepheight,
+			nids, &blob->tree_data, workspace, &blob->arena );
+#endif
+}
+
+
+/* Incremental labeling.
+ *
+ * The roi will be split into tiles of about BLOB_TILE_SIZE x BLOB_TILE_SIZE
+ * pixels (on the rows and columns of the grid). Like the strips of the
+ * parallel labeling, every tile will be labeled on its own, but each tile
+ * keeps its labels and component data. Thus, only changed tiles have to
+ * be labeled again.
+ *
+ * After the labeling, the ids of a tile will be joined and the
+ * components compacted. Component j of the tile gets the id first_id+j.
+ * Every tile owns a fixed range of ids, thus the ids array of unchanged
+ * tiles remains valid.
+ *
+ * The tiles will be joined by the pairs of ids along the left and
+ * upper border of each tile (seams). The pairs of a seam will be kept
+ * until one of the neighbouring tiles changes.
+ *
+ * Finally, the tree of the last image will be patched with the
+ * component data of the tiles, without access to the pixels. Each tile
+ * stores the tree node of its components. Components with parts in
+ * changed tiles get new data (and maybe a new node), the other nodes
+ * will be kept, see treepatch.h. As in the serial algorithm, the parent
+ * of a component is the component left of its first pixel (or above it
+ * on the left border of the roi) and the nodes are ordered by their
+ * first pixels. Thus, the tree equals the tree of threshtree_find_blobs,
+ * only the ids of the blobs differ.
+ */
+
+static void threshtree_destroy_tiles(
+		ThreshtreeWorkspace *workspace
+		){
+	unsigned int k;
+	if( workspace->tiles == NULL ) return;
+
+	for( k=0; k<workspace->num_tiles; k++){
+		ThreshtreeTile *tile = workspace->tiles+k;
+		if( tile->workspace != NULL ){
+			tile->workspace->ids = NULL; //owned by parent workspace
+			threshtree_destroy_workspace( &tile->workspace );
+		}
+		free(tile->first_pixel);
+		free(tile->ref_pixel);
+		free(tile->ref_id);
+		free(tile->comp_map);
+		free(tile->node);
+		free(tile->is_first);
+		free(tile->seam);
+	}
+	free(workspace->tiles);
+	workspace->tiles = NULL;
+	workspace->num_tiles = 0;
+	workspace->tiles_x = 0;
+	workspace->tiles_y = 0;
+	workspace->incremental_valid = false;
+}
+
+static bool threshtree_create_tiles(
+		const unsigned int tiles_x,
+		const unsigned int tiles_y,
+		ThreshtreeWorkspace *workspace
+		){
+	unsigned int k;
+	if( workspace->tiles_x == tiles_x && workspace->tiles_y == tiles_y ){
+		return true;
+	}
+	threshtree_destroy_tiles( workspace );
+
+	const unsigned int num_tiles = tiles_x*tiles_y;
+	workspace->tiles = (ThreshtreeTile*) calloc( num_tiles, sizeof(ThreshtreeTile) );
+	if( workspace->tiles == NULL ) return false;
+	workspace->num_tiles = num_tiles;
+	workspace->tiles_x = tiles_x;
+	workspace->tiles_y = tiles_y;
+
+	const unsigned int max_comp = workspace->max_comp/num_tiles + 1;
+	for( k=0; k<num_tiles; k++){
+		ThreshtreeTile *tile = workspace->tiles+k;
+		/* Only the component arrays are required. The ids array
+		 * of the parent workspace will be shared. */
+		if(
+				( tile->workspace = (ThreshtreeWorkspace*) calloc( 1, sizeof(ThreshtreeWorkspace) ) ) == NULL ||
+				!threshtree_realloc_workspace( max_comp, &tile->workspace ) ||
+				0 ){
+			VPRINTF("Critical error: Allocation of tile workspace failed!\n");
+			threshtree_destroy_tiles( workspace );
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Grow the arrays of the tile components. */
+static bool threshtree_tile_reserve(
+		ThreshtreeTile *tile,
+		const unsigned int len
+		){
+	if( tile->comp_len >= len ) return true;
+	if(
+			( tile->first_pixel = (unsigned int*) realloc(tile->first_pixel, len*sizeof(unsigned int) ) ) == NULL ||
+			( tile->ref_pixel = (unsigned int*) realloc(tile->ref_pixel, len*sizeof(unsigned int) ) ) == NULL ||
+			( tile->ref_id = (unsigned int*) realloc(tile->ref_id, len*sizeof(unsigned int) ) ) == NULL ||
+			( tile->comp_map = (unsigned int*) realloc(tile->comp_map, len*sizeof(unsigned int) ) ) == NULL ||
+			( tile->node = (unsigned int*) realloc(tile->node, len*sizeof(unsigned int) ) ) == NULL ||
+			( tile->is_first = (unsigned char*) realloc(tile->is_first, len*sizeof(unsigned char) ) ) == NULL ||
+			0 ){
+		tile->comp_len = 0;
+		return false;
+	}
+	tile->comp_len = len;
+	return true;
+}
+
+/* Returns true if a cell of dirty_tiles which overlaps the tile is marked as dirty. */
+static bool threshtree_tile_has_dirty_cell(
+		const ThreshtreeTile *tile,
+		const BlobtreeRect roi,
+		const unsigned char *dirty_tiles )
+{
+	const unsigned int cells_x = (roi.width + BLOB_TILE_SIZE - 1)/BLOB_TILE_SIZE;
+	const unsigned int c0 = (tile->roi.x - roi.x)/BLOB_TILE_SIZE;
+	const unsigned int c1 = (tile->roi.x + tile->roi.width - 1 - roi.x)/BLOB_TILE_SIZE;
+	const unsigned int r0 = (tile->offset_y - roi.y)/BLOB_TILE_SIZE;
+	const unsigned int r1 = (tile->offset_y + tile->roi.height - 1 - roi.y)/BLOB_TILE_SIZE;
+	unsigned int r, c;
+	for( r=r0; r<=r1; r++){
+		const unsigned char * const row = dirty_tiles + r*cells_x;
+		for( c=c0; c<=c1; c++){
+			if( *(row+c) ) return true;
+		}
+	}
+	return false;
+}
+
+/* Compare grid rows of the tile with the last image and update the
+ * copy of the last image. Returns true if a pixel of the grid changed its class. */
+static bool threshtree_tile_diff(
+		const ThreshtreeTile *tile,
+		const unsigned char *data,
+		const unsigned int w,
+		const unsigned char thresh,
+		const unsigned int stepwidth,
+		const unsigned int stepheight,
+		unsigned char *prev_data )
+{
+	const unsigned int xlast = tile->roi.width - 1;
+	const unsigned int ylast = tile->offset_y + tile->roi.height - 1;
+	bool dirty = false;
+	unsigned int x, y;
+
+	for( y=tile->offset_y; y<=ylast; y=threshtree_grid_next(y, stepheight, ylast) ){
+		const unsigned char * const dRow = data + y*w + tile->roi.x;
+		unsigned char * const pRow = prev_data + y*w + tile->roi.x;
+		if( memcmp(dRow, pRow, tile->roi.width) == 0 ) continue;
+
+		for( x=0; !dirty && x<=xlast; x=threshtree_grid_next(x, stepwidth, xlast) ){
+			if( ( *(dRow+x) > thresh ) != ( *(pRow+x) > thresh ) ) dirty = true;
+		}
+		memcpy(pRow, dRow, tile->roi.width);
+	}
+	return dirty;
+}
+
+/* Copy grid rows of the tile into the copy of the last image. */
+static void threshtree_tile_store(
+		const ThreshtreeTile *tile,
+		const unsigned char *data,
+		const unsigned int w,
+		const unsigned int stepheight,
+		unsigned char *prev_data )
+{
+	const unsigned int ylast = tile->offset_y + tile->roi.height - 1;
+	unsigned int y;
+	for( y=tile->offset_y; y<=ylast; y=threshtree_grid_next(y, stepheight, ylast) ){
+		memcpy(prev_data + y*w + tile->roi.x, data + y*w + tile->roi.x, tile->roi.width);
+	}
+}
+
+/* Label the tile and compact its components.
+ *
+ * The ids of the tile will be joined like in threshtree_build_tree.
+ * Afterwards, the data of the j-th component (ordered by their first
+ * pixels) will be moved to index j of the component arrays of the
+ * tile workspace and comp_map maps the joined ids on j.
+ * Returns false on errors.
+ */
+static bool threshtree_label_tile(
+		ThreshtreeTile *tile,
+		const unsigned char *data,
+		const unsigned int w,
+		const unsigned char thresh,
+		const unsigned int stepwidth,
+		const unsigned int stepheight )
+{
+	const unsigned int nids = THRESHTREE_LABEL( data + tile->offset_y*w, w,
+			tile->roi.height, tile->roi, thresh,
+			stepwidth, stepheight, tile->workspace );
+	if( nids == 0 ) return false;
+	if( !threshtree_tile_reserve(tile, nids) ) return false;
+
+	ThreshtreeWorkspace * const sw = tile->workspace;
+	unsigned int * const comp_same = sw->comp_same;
+	unsigned int * const comp_map = tile->comp_map;
+#ifdef BLOB_COUNT_PIXEL
+	unsigned int * const comp_size = sw->comp_size;
+#endif
+#ifdef BLOB_DIMENSION
+	unsigned int * const top_index = sw->top_index;
+	unsigned int * const left_index = sw->left_index;
+	unsigned int * const right_index = sw->right_index;
+	unsigned int * const bottom_index = sw->bottom_index;
+#endif
+#ifdef BLOB_BARYCENTER
+	BLOB_BARYCENTER_TYPE * const pixel_sum_X = sw->pixel_sum_X;
+	BLOB_BARYCENTER_TYPE * const pixel_sum_Y = sw->pixel_sum_Y;
+#endif
+	unsigned int k, r, j;
+
+	/* 1. Join ids. comp_same(k) <= k holds, thus one pass
+	 * in increasing order creates the projection. */
+	for( k=0; k<nids; k++){
+		r = *(comp_same+*(comp_same+k));
+		*(comp_same+k) = r;
+		if( r == k ) continue;
+#ifdef BLOB_COUNT_PIXEL
+		BLOB_COMP(comp_size, r) += BLOB_COMP(comp_size, k);
+#endif
+#ifdef BLOB_DIMENSION
+		if( BLOB_COMP(top_index, r) > BLOB_COMP(top_index, k) )
+			BLOB_COMP(top_index, r) = BLOB_COMP(top_index, k);
+		if( BLOB_COMP(left_index, r) > BLOB_COMP(left_index, k) )
+			BLOB_COMP(left_index, r) = BLOB_COMP(left_index, k);
+		if( BLOB_COMP(right_index, r) < BLOB_COMP(right_index, k) )
+			BLOB_COMP(right_index, r) = BLOB_COMP(right_index, k);
+		if( BLOB_COMP(bottom_index, r) < BLOB_COMP(bottom_index, k) )
+			BLOB_COMP(bottom_index, r) = BLOB_COMP(bottom_index, k);
+#endif
+#ifdef BLOB_BARYCENTER
+		BLOB_COMP(pixel_sum_X, r) += BLOB_COMP(pixel_sum_X, k);
+		BLOB_COMP(pixel_sum_Y, r) += BLOB_COMP(pixel_sum_Y, k);
+#endif
+	}
+
+	/* 2. Compact the components. The smallest id of a component
+	 * belongs to its first pixel. Index j<=k was already handled. */
+	for( k=0, j=0; k<nids; k++){
+		if( *(comp_same+k) != k ) continue;
+		*(comp_map+k) = j;
+#ifdef BLOB_COUNT_PIXEL
+		BLOB_COMP(comp_size, j) = BLOB_COMP(comp_size, k);
+#endif
+#ifdef BLOB_DIMENSION
+		BLOB_COMP(top_index, j) = BLOB_COMP(top_index, k);
+		BLOB_COMP(left_index, j) = BLOB_COMP(left_index, k);
+		BLOB_COMP(right_index, j) = BLOB_COMP(right_index, k);
+		BLOB_COMP(bottom_index, j) = BLOB_COMP(bottom_index, k);
+#endif
+#ifdef BLOB_BARYCENTER
+		BLOB_COMP(pixel_sum_X, j) = BLOB_COMP(pixel_sum_X, k);
+		BLOB_COMP(pixel_sum_Y, j) = BLOB_COMP(pixel_sum_Y, k);
+#endif
+		j++;
+	}
+	tile->ncomp = j;
+	return true;
+}
+
+/* Replace the ids of a new labeled tile by first_id + component and
+ * store the first pixel of each component and its left (or upper)
+ * neighbour. */
+static void threshtree_remap_tile(
+		ThreshtreeTile *tile,
+		const BlobtreeRect roi,
+		const unsigned int w,
+		const unsigned int stepwidth,
+		const unsigned int stepheight,
+		unsigned int *ids )
+{
+	const unsigned int * const comp_same = tile->workspace->comp_same;
+	const unsigned int * const comp_map = tile->comp_map;
+	const unsigned int first_id = tile->first_id;
+	const unsigned int xlast = tile->roi.x + tile->roi.width - 1;
+	const unsigned int ylast = tile->offset_y + tile->roi.height - 1;
+	unsigned int x, y, xp, yp, next = 0;
+
+	yp = tile->offset_y - stepheight; //only used if offset_y > roi.y
+	for( y=tile->offset_y; y<=ylast; yp=y, y=threshtree_grid_next(y, stepheight, ylast) ){
+		unsigned int * const iRow = ids + y*w;
+		xp = tile->roi.x - stepwidth; //only used if roi.x < tile->roi.x
+		for( x=tile->roi.x; x<=xlast; xp=x, x=threshtree_grid_next(x, stepwidth, xlast) ){
+			const unsigned int c = *(comp_map+*(comp_same+*(iRow+x)));
+			*(iRow+x) = first_id + c;
+			if( c != next ) continue;
+
+			//first pixel of component c
+			*(tile->first_pixel+c) = y*w + x;
+			if( x > roi.x ){
+				*(tile->ref_pixel+c) = y*w + xp;
+			}else if( y > roi.y ){
+				*(tile->ref_pixel+c) = yp*w + x;
+			}else{
+				*(tile->ref_pixel+c) = UINT_MAX;
+			}
+			next++;
+		}
+	}
+}
+
+/* Add offset to the ids of an unchanged tile. */
+static void threshtree_shift_tile(
+		const ThreshtreeTile *tile,
+		const unsigned int w,
+		const unsigned int stepwidth,
+		const unsigned int stepheight,
+		const unsigned int offset,
+		unsigned int *ids )
+{
+	const unsigned int xlast = tile->roi.x + tile->roi.width - 1;
+	const unsigned int ylast = tile->offset_y + tile->roi.height - 1;
+	unsigned int x, y;
+
+	for( y=tile->offset_y; y<=ylast; y=threshtree_grid_next(y, stepheight, ylast) ){
+		unsigned int * const iRow = ids + y*w;
+		for( x=tile->roi.x; x<=xlast; x=threshtree_grid_next(x, stepwidth, xlast) ){
+			*(iRow+x) += offset;
+		}
+	}
+}
+
+static inline bool threshtree_tile_add_pair(
+		ThreshtreeTile *tile,
+		const unsigned int a,
+		const unsigned int b )
+{
+	if( tile->seam_len > 0 && *(tile->seam+tile->seam_len-2) == a
+			&& *(tile->seam+tile->seam_len-1) == b ){
+		return true;
+	}
+	if( tile->seam_len+2 > tile->seam_max ){
+		const unsigned int seam_max = 2*tile->seam_max + 64;
+		unsigned int *tmp = (unsigned int*) realloc(tile->seam, seam_max*sizeof(unsigned int) );
+		if( tmp == NULL ) return false;
+		tile->seam = tmp;
+		tile->seam_max = seam_max;
+	}
+	*(tile->seam+tile->seam_len) = a;
+	*(tile->seam+tile->seam_len+1) = b;
+	tile->seam_len += 2;
+	return true;
+}
+
+/* Collect the pairs of ids with the same class along the left and
+ * upper border of the tile. The diagonal neighbours across the corners
+ * of the tile are part of the upper border.
+ * Moreover, the ids of the neighbours of the first pixels will be updated. */
+static bool threshtree_tile_seams(
+		ThreshtreeTile *tile,
+		const unsigned char *data,
+		const unsigned int w,
+		const BlobtreeRect roi,
+		const unsigned char thresh,
+		const unsigned int stepwidth,
+		const unsigned int stepheight,
+		const unsigned int *ids )
+{
+	const unsigned int xlast = tile->roi.x + tile->roi.width - 1;
+	const unsigned int ylast = tile->offset_y + tile->roi.height - 1;
+	const unsigned int roi_xlast = roi.x + roi.width - 1;
+	unsigned int x, y, xp, xn;
+	bool ok = true;
+#define CLASS(X, Y) ( *(data + (Y)*w + (X)) > thresh )
+#define ID(X, Y) *(ids + (Y)*w + (X))
+
+	tile->seam_len = 0;
+
+	//left border
+	if( tile->roi.x > roi.x ){
+		const unsigned int x0 = tile->roi.x;
+		const unsigned int xl = x0 - stepwidth;
+		unsigned int yp = ylast+1, yn;
+		for( y=tile->offset_y; ok && y<=ylast; yp=y, y=yn ){
+			yn = threshtree_grid_next(y, stepheight, ylast);
+			const int c = CLASS(x0, y);
+			const unsigned int g = ID(x0, y);
+			if( CLASS(xl, y) == c ) ok &= threshtree_tile_add_pair(tile, g, ID(xl, y));
+#ifdef BLOB_DIAGONAL_CHECK
+			if( yp<=ylast && CLASS(xl, yp) == c ) ok &= threshtree_tile_add_pair(tile, g, ID(xl, yp));
+			if( yn<=ylast && CLASS(xl, yn) == c ) ok &= threshtree_tile_add_pair(tile, g, ID(xl, yn));
+#endif
+		}
+	}
+
+	//upper border
+	if( tile->offset_y > roi.y ){
+		const unsigned int y0 = tile->offset_y;
+		const unsigned int yu = y0 - stepheight;
+		xp = ( tile->roi.x > roi.x ) ? tile->roi.x - stepwidth : roi_xlast+1;
+		for( x=tile->roi.x; ok && x<=xlast; xp=x, x=xn ){
+			xn = threshtree_grid_next(x, stepwidth, xlast);
+			const int c = CLASS(x, y0);
+			const unsigned int g = ID(x, y0);
+			if( CLASS(x, yu) == c ) ok &= threshtree_tile_add_pair(tile, g, ID(x, yu));
+#ifdef BLOB_DIAGONAL_CHECK
+			/* The next tile begins on the next column of the grid. */
+			const unsigned int xd = ( xn<=xlast ) ? xn :
+				( x<roi_xlast ? x+stepwidth : roi_xlast+1 );
+			if( xp<=roi_xlast && CLASS(xp, yu) == c ) ok &= threshtree_tile_add_pair(tile, g, ID(xp, yu));
+			if( xd<=roi_xlast && CLASS(xd, yu) == c ) ok &= threshtree_tile_add_pair(tile, g, ID(xd, yu));
+#endif
+		}
+	}
+#undef CLASS
+#undef ID
+
+	for( x=0; x<tile->ncomp; x++){
+		const unsigned int ref = *(tile->ref_pixel+x);
+		*(tile->ref_id+x) = ( ref == UINT_MAX ) ? UINT_MAX : *(ids+ref);
+	}
+	return ok;
+}
+
+/* Join the components of all tiles and patch the tree of the last image.
+ * Only components with parts in changed tiles (or parts of nodes
+ * which lose pixels) get new data. All other nodes will be kept.
+ * relayout - the ids of unchanged tiles were shifted.
+ * Returns false if the allocation fails. */
+static bool threshtree_patch_tree_tiles(
+		const unsigned int stepwidth,
+		const unsigned int stepheight,
+		const unsigned int nids,
+		const bool relayout,
+		ThreshtreeWorkspace *workspace,
+		TreeArena *arena )
+{
+	TreePatch * const tp = &workspace->patch;
+	ThreshtreeTile * const tiles = workspace->tiles;
+	const unsigned int num_tiles = workspace->num_tiles;
+	unsigned int j, k, l, t, r, n;
+
+	if( nids > workspace->max_comp ){
+		if( !threshtree_realloc_workspace( nids + nids/4, &workspace ) ){
+			return false;
+		}
+	}
+	if( workspace->comp_len < workspace->max_comp ){
+		const unsigned int len = workspace->max_comp;
+		if(
+				( workspace->comp_first = (unsigned int*) realloc(workspace->comp_first, len*sizeof(unsigned int) ) ) == NULL ||
+				( workspace->comp_node = (unsigned int*) realloc(workspace->comp_node, len*sizeof(unsigned int) ) ) == NULL ||
+				( workspace->comp_list = (unsigned int*) realloc(workspace->comp_list, len*sizeof(unsigned int) ) ) == NULL ||
+				( workspace->comp_changed = (unsigned char*) realloc(workspace->comp_changed, len*sizeof(unsigned char) ) ) == NULL ||
+				0 ){
+			workspace->comp_len = 0;
+			return false;
+		}
+		workspace->comp_len = len;
+	}
+
+	const unsigned int * const ids = workspace->ids;
+	unsigned int * const comp_same = workspace->comp_same;
+#ifdef BLOB_COUNT_PIXEL
+	unsigned int * const comp_size = workspace->comp_size;
+#endif
+#ifdef BLOB_DIMENSION
+	unsigned int * const top_index = workspace->top_index;
+	unsigned int * const left_index = workspace->left_index;
+	unsigned int * const right_index = workspace->right_index;
+	unsigned int * const bottom_index = workspace->bottom_index;
+#endif
+#ifdef BLOB_BARYCENTER
+	BLOB_BARYCENTER_TYPE * const pixel_sum_X = workspace->pixel_sum_X;
+	BLOB_BARYCENTER_TYPE * const pixel_sum_Y = workspace->pixel_sum_Y;
+#endif
+	unsigned int * const comp_first = workspace->comp_first;
+	unsigned int * const comp_node = workspace->comp_node;
+	unsigned int * const comp_list = workspace->comp_list;
+	unsigned char * const comp_changed = workspace->comp_changed;
+	unsigned int * const real_ids_inv = workspace->real_ids_inv;
+	unsigned int num_changed = 0;
+
+	BLOB_PHASE_BEGIN(t_merge)
+	/* 1. Join the components along the seams. */
+	for( t=0; t<num_tiles; t++){
+		const ThreshtreeTile * const tile = tiles+t;
+		for( k=tile->first_id; k<tile->first_id+tile->ncomp; k++){
+			*(comp_same+k) = k;
+		}
+	}
+	for( t=0; t<num_tiles; t++){
+		const ThreshtreeTile * const tile = tiles+t;
+		for( j=0; j<tile->seam_len; j+=2){
+			uf_union(comp_same, *(tile->seam+j), *(tile->seam+j+1));
+		}
+	}
+
+	/* 2. uf_union keeps comp_same(x) <= x, thus one pass in increasing
+	 * order creates the projection. A component has changed if a part
+	 * belongs to a changed tile or to a flagged node or if its parts
+	 * belonged to different nodes. */
+	for( t=0; t<num_tiles; t++){
+		const ThreshtreeTile * const tile = tiles+t;
+		for( j=0; j<tile->ncomp; j++){
+			const unsigned int g = tile->first_id + j;
+			r = *(comp_same+*(comp_same+g));
+			*(comp_same+g) = r;
+			n = tile->dirty ? UINT_MAX : *(tile->node+j);
+			if( r == g ){
+				*(comp_node+r) = n;
+				*(comp_changed+r) = ( n == UINT_MAX || tree_patch_is_flagged(tp, n) );
+			}else if( n != *(comp_node+r) ){
+				*(comp_changed+r) = 1;
+			}
+		}
+	}
+
+	/* 3. Sum up the data of changed components. The row values of
+	 * the tiles are relative to offset_y. The old nodes of the parts
+	 * will be flagged. */
+	for( t=0; t<num_tiles; t++){
+		const ThreshtreeTile * const tile = tiles+t;
+		const ThreshtreeWorkspace * const sw = tile->workspace;
+		const unsigned int oy = tile->offset_y;
+		for( j=0; j<tile->ncomp; j++){
+			const unsigned int g = tile->first_id + j;
+			r = *(comp_same+g);
+			if( !*(comp_changed+r) ) continue;
+			if( !tile->dirty ) tree_patch_flag(tp, *(tile->node+j));
+
+			if( r == g ){
+				*(comp_list+num_changed) = r;
+				num_changed++;
+				*(comp_node+r) = UINT_MAX;
+				*(comp_first+r) = *(tile->first_pixel+j);
+#ifdef BLOB_COUNT_PIXEL
+				BLOB_COMP(comp_size, r) = BLOB_COMP(sw->comp_size, j);
+#endif
+#ifdef BLOB_DIMENSION
+				BLOB_COMP(top_index, r) = BLOB_COMP(sw->top_index, j) + oy;
+				BLOB_COMP(left_index, r) = BLOB_COMP(sw->left_index, j);
+				BLOB_COMP(right_index, r) = BLOB_COMP(sw->right_index, j);
+				BLOB_COMP(bottom_index, r) = BLOB_COMP(sw->bottom_index, j) + oy;
+#endif
+#ifdef BLOB_BARYCENTER
+				BLOB_COMP(pixel_sum_X, r) = BLOB_COMP(sw->pixel_sum_X, j);
+				BLOB_COMP(pixel_sum_Y, r) = BLOB_COMP(sw->pixel_sum_Y, j)
+					+ (BLOB_BARYCENTER_TYPE) oy * BLOB_COMP(sw->comp_size, j);
+#endif
+				continue;
+			}
+
+#ifdef BLOB_COUNT_PIXEL
+			BLOB_COMP(comp_size, r) += BLOB_COMP(sw->comp_size, j);
+#endif
+#ifdef BLOB_DIMENSION
+			if( BLOB_COMP(top_index, r) > BLOB_COMP(sw->top_index, j) + oy )
+				BLOB_COMP(top_index, r) = BLOB_COMP(sw->top_index, j) + oy;
+			if( BLOB_COMP(left_index, r) > BLOB_COMP(sw->left_index, j) )
+				BLOB_COMP(left_index, r) = BLOB_COMP(sw->left_index, j);
+			if( BLOB_COMP(right_index, r) < BLOB_COMP(sw->right_index, j) )
+				BLOB_COMP(right_index, r) = BLOB_COMP(sw->right_index, j);
+			if( BLOB_COMP(bottom_index, r) < BLOB_COMP(sw->bottom_index, j) + oy )
+				BLOB_COMP(bottom_index, r) = BLOB_COMP(sw->bottom_index, j) + oy;
+#endif
+#ifdef BLOB_BARYCENTER
+			BLOB_COMP(pixel_sum_X, r) += BLOB_COMP(sw->pixel_sum_X, j);
+			BLOB_COMP(pixel_sum_Y, r) += BLOB_COMP(sw->pixel_sum_Y, j)
+				+ (BLOB_BARYCENTER_TYPE) oy * BLOB_COMP(sw->comp_size, j);
+#endif
+			if( *(tile->first_pixel+j) < *(comp_first+r) ){
+				*(comp_first+r) = *(tile->first_pixel+j);
+			}
+		}
+	}
+
+	/* 4. A flagged node will be reused if its first pixel is
+	 * still the first pixel of a component. */
+	for( l=0; l<tp->num_flagged; l++){
+		n = *(tp->flagged+l);
+		const unsigned int key = (tp->nodes+n)->key;
+		r = *(comp_same+*(ids+key));
+		if( *(comp_changed+r) && *(comp_first+r) == key && *(comp_node+r) == UINT_MAX ){
+			*(comp_node+r) = n;
+		}
+	}
+
+	/* 5. Set data of changed components. */
+	for( l=0; l<num_changed; l++){
+		r = *(comp_list+l);
+		n = *(comp_node+r);
+		if( n == UINT_MAX ){
+			n = tree_patch_new_node(tp, arena);
+			if( n == UINT_MAX ) return false;
+			*(comp_node+r) = n;
+		}
+		TreePatchNode * const pn = tree_patch_set_data(tp, n, *(comp_first+r));
+#ifdef BLOB_COUNT_PIXEL
+		pn->size = BLOB_COMP(comp_size, r);
+#endif
+#ifdef BLOB_BARYCENTER
+		pn->sum_x = BLOB_COMP(pixel_sum_X, r);
+		pn->sum_y = BLOB_COMP(pixel_sum_Y, r);
+#endif
+#ifdef BLOB_DIMENSION
+		pn->rect.y = BLOB_COMP(top_index, r);
+		pn->rect.height = BLOB_COMP(bottom_index, r) - pn->rect.y + 1;
+		pn->rect.x = BLOB_COMP(left_index, r);
+		pn->rect.width = BLOB_COMP(right_index, r) - pn->rect.x + 1;
+#endif
+#ifdef SAVE_DEPTH_MAP_VALUE
+		(arena->blobs+n)->depth_level = 0;
+#endif
+	}
+
+	/* 6. Set parents of the nodes. The parent contains the left
+	 * (or upper) neighbour of the first pixel. The parent of an
+	 * unchanged component only changes with the neighbour. */
+	Tree * const tree = &arena->tree;
+	for( t=0; t<num_tiles; t++){
+		ThreshtreeTile * const tile = tiles+t;
+		for( j=0; j<tile->ncomp; j++){
+			r = *(comp_same+tile->first_id+j);
+			const unsigned int ref = *(tile->ref_id+j);
+			if( *(comp_changed+r) ){
+				n = *(comp_node+r);
+				*(tile->node+j) = n;
+				*(tile->is_first+j) = ( *(tile->first_pixel+j) == *(comp_first+r) );
+				if( !*(tile->is_first+j) ) continue;
+			}else{
+				if( !*(tile->is_first+j) ) continue;
+				n = *(tile->node+j);
+				if( tree_patch_is_flagged(tp, n) ) return false;
+				if( !relayout && ( ref == UINT_MAX || !*(comp_changed+*(comp_same+ref)) ) ){
+					continue;
+				}
+			}
+
+			tree_patch_set_parent(tp, tree, n,
+					( ref == UINT_MAX ) ? 0 : *(comp_node+*(comp_same+ref)) );
+			(arena->blobs+n)->id = r;
+			*(real_ids_inv+r) = n-1; //root pos shift
+		}
+	}
+
+	/* Unused ids of the ranges belong to no pixel. Map them on
+	 * the first component to get valid values in threshtree_filter_blob_ids. */
+	for( t=0; t<num_tiles; t++){
+		const ThreshtreeTile * const tile = tiles+t;
+		if( !relayout && !tile->dirty ) continue;
+		for( k=tile->first_id+tile->ncomp; k<tile->first_id+tile->id_range; k++){
+			*(comp_same+k) = 0;
+		}
+	}
+	workspace->used_comp = nids-1;
+	BLOB_PHASE_END(BLOB_PHASE_MERGE, t_merge)
+
+	BLOB_PHASE_BEGIN(t_tree)
+	/* Evaluate exact areas of blobs for stepwidth==1
+	 * and try to approximate for stepwith>1. See threshtree_build_tree. */
+	unsigned int options = 0;
+#ifdef BLOB_DIMENSION
+	#ifdef BLOB_COUNT_PIXEL
+	if( stepwidth > 1 ) options |= TREE_PATCH_APPROX_AREAS;
+	#else
+	options |= TREE_PATCH_BOX_AREAS;
+	#endif
+#endif
+	const bool ok = tree_patch_apply(tp, tree, stepwidth, stepheight, options);
+	BLOB_PHASE_END(BLOB_PHASE_TREE, t_tree)
+	return ok;
+}
+
+void threshtree_find_blobs_incremental( Blobtree *blob,
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char thresh,
+		const unsigned char *dirty_tiles,
+		ThreshtreeWorkspace *workspace )
+{
+#if !defined(BLOB_SUBGRID_CHECK) && !defined(BLOB_SORT_TREE)
+	const unsigned int stepwidth = blob->grid.width;
+	const unsigned int stepheight = blob->grid.height;
+	/* Number of columns and rows of the coarse grid without the
+	 * remainder. Every tile should contain at least two of them. */
+	const unsigned int grid_cols = (roi.width-1)/stepwidth + 1;
+	const unsigned int grid_rows = (roi.height-1)/stepheight + 1;
+	unsigned int cols_per_tile = BLOB_TILE_SIZE/stepwidth;
+	unsigned int rows_per_tile = BLOB_TILE_SIZE/stepheight;
+	if( cols_per_tile < 2 ) cols_per_tile = 2;
+	if( rows_per_tile < 2 ) rows_per_tile = 2;
+	const unsigned int tiles_x = grid_cols/cols_per_tile;
+	const unsigned int tiles_y = grid_rows/rows_per_tile;
+
+	if( workspace->prev_data == NULL ){
+		workspace->prev_data = (unsigned char*) malloc( w*h*sizeof(unsigned char) );
+	}
+
+	if( tiles_x < 1 || tiles_y < 1 || workspace->prev_data == NULL ||
+			!threshtree_create_tiles(tiles_x, tiles_y, workspace) )
+#endif
+	{
+		threshtree_find_blobs(blob, data, w, h, roi, thresh, workspace);
+		return;
+	}
+
+#if !defined(BLOB_SUBGRID_CHECK) && !defined(BLOB_SORT_TREE)
+	BLOB_PHASE_BEGIN(t_label)
+	/* Labels of the last image are only usable for the same settings. */
+	const bool valid = workspace->incremental_valid &&
+		blob->tree == &blob->arena.tree &&
+		tree_patch_valid(&workspace->patch, &blob->arena) &&
+		0 == memcmp( &workspace->prev_roi, &roi, sizeof(BlobtreeRect) ) &&
+		workspace->prev_thresh == thresh &&
+		workspace->prev_grid.width == stepwidth &&
+		workspace->prev_grid.height == stepheight;
+	workspace->incremental_valid = false;
+
+	const unsigned int num_tiles = tiles_x*tiles_y;
+	ThreshtreeTile * const tiles = workspace->tiles;
+	bool any_dirty = false;
+	bool relayout = !valid;
+	unsigned int j, k, tx, ty, nids;
+
+	/* 1. Split roi into tiles and find tiles with changes. */
+	for( ty=0, k=0; ty<tiles_y; ty++){
+		for( tx=0; tx<tiles_x; tx++, k++){
+			ThreshtreeTile * const tile = tiles+k;
+			const unsigned int c0 = tx*cols_per_tile;
+			const unsigned int r0 = ty*rows_per_tile;
+
+			tile->roi.x = roi.x + c0*stepwidth;
+			tile->roi.y = 0;
+			tile->roi.width = ( tx+1<tiles_x ) ?
+				(cols_per_tile-1)*stepwidth + 1 : roi.x + roi.width - tile->roi.x;
+			tile->offset_y = roi.y + r0*stepheight;
+			tile->roi.height = ( ty+1<tiles_y ) ?
+				(rows_per_tile-1)*stepheight + 1 : roi.y + roi.height - tile->offset_y;
+			tile->workspace->ids = workspace->ids + tile->offset_y*w;
+
+			if( !valid ){
+				tile->dirty = true;
+				threshtree_tile_store(tile, data, w, stepheight, workspace->prev_data);
+			}else if( dirty_tiles != NULL ){
+				tile->dirty = threshtree_tile_has_dirty_cell(tile, roi, dirty_tiles);
+				if( tile->dirty ){
+					threshtree_tile_store(tile, data, w, stepheight, workspace->prev_data);
+				}
+			}else{
+				tile->dirty = threshtree_tile_diff(tile, data, w, thresh,
+						stepwidth, stepheight, workspace->prev_data);
+			}
+			any_dirty |= tile->dirty;
+		}
+	}
+
+	if( !any_dirty ){
+		//Nothing changed. Ids and tree of last image are still valid.
+		workspace->incremental_valid = true;
+		BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+		return;
+	}
+
+	/* The nodes of the components in changed tiles lose pixels.
+	 * Without valid labels, the tree starts from scratch. */
+	if( valid ){
+		for( k=0; k<num_tiles; k++){
+			const ThreshtreeTile * const tile = tiles+k;
+			if( !tile->dirty ) continue;
+			for( j=0; j<tile->ncomp; j++){
+				tree_patch_flag(&workspace->patch, *(tile->node+j));
+			}
+		}
+	}else{
+		blobtree_clear_tree(blob);
+		blob->tree = tree_patch_reset(&workspace->patch, &blob->arena, roi);
+		if( blob->tree == NULL ){
+			printf("(threshtree) Critical error: Allocation of tree failed\n");
+			BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+			return;
+		}
+	}
+
+	/* 2. Label changed tiles */
+	for( k=0; k<num_tiles; k++){
+		ThreshtreeTile * const tile = tiles+k;
+		if( !tile->dirty ) continue;
+		if( !threshtree_label_tile(tile, data, w, thresh, stepwidth, stepheight) ){
+			printf("(threshtree) Critical error: Labeling of tile failed\n");
+			blobtree_clear_tree(blob);
+			BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+			return;
+		}
+		if( tile->ncomp > tile->id_range ) relayout = true;
+	}
+
+	/* 3. Assign id ranges to the tiles. The ranges contain some spare
+	 * ids to avoid a new layout if the number of components grows a
+	 * little bit. The ids of unchanged tiles will be shifted. */
+	if( relayout ){
+		nids = 0;
+		for( k=0; k<num_tiles; k++){
+			ThreshtreeTile * const tile = tiles+k;
+			const unsigned int first_id = nids;
+			if( !tile->dirty && first_id != tile->first_id ){
+				threshtree_shift_tile(tile, w, stepwidth, stepheight,
+						first_id - tile->first_id, workspace->ids);
+			}
+			tile->first_id = first_id;
+			tile->id_range = tile->ncomp + tile->ncomp/2 + 16;
+			nids += tile->id_range;
+		}
+	}else{
+		nids = (tiles+num_tiles-1)->first_id + (tiles+num_tiles-1)->id_range;
+	}
+
+	/* 4. Write ids of changed tiles */
+	for( k=0; k<num_tiles; k++){
+		if( (tiles+k)->dirty ){
+			threshtree_remap_tile(tiles+k, roi, w, stepwidth, stepheight, workspace->ids);
+		}
+	}
+
+	/* 5. Update seams next to changed tiles. The upper border of
+	 * a tile touches the three upper tiles. */
+	for( ty=0, k=0; ty<tiles_y; ty++){
+		for( tx=0; tx<tiles_x; tx++, k++){
+			bool update = relayout || (tiles+k)->dirty || ( tx>0 && (tiles+k-1)->dirty );
+			if( ty>0 ){
+				update |= (tiles+k-tiles_x)->dirty
+					|| ( tx>0 && (tiles+k-tiles_x-1)->dirty )
+					|| ( tx+1<tiles_x && (tiles+k-tiles_x+1)->dirty );
+			}
+			if( update && !threshtree_tile_seams(tiles+k, data, w, roi, thresh,
+						stepwidth, stepheight, workspace->ids) ){
+				printf("(threshtree) Critical error: Merging of tiles failed\n");
+				blobtree_clear_tree(blob);
+				BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+				return;
+			}
+		}
+	}
+	BLOB_PHASE_END(BLOB_PHASE_LABEL, t_label)
+
+	//update blob tree structure.
+	if( !threshtree_patch_tree_tiles(stepwidth, stepheight, nids, relayout,
+				workspace, &blob->arena) ){
+		printf("(threshtree) Critical error: Merging of tiles failed\n");
+		blobtree_clear_tree(blob);
+		return;
+	}
+	blob->tree = &blob->arena.tree;
+	blob->tree_data = blob->arena.blobs;
+
+	workspace->incremental_valid = true;
+	workspace->prev_roi = roi;
+	workspace->prev_thresh = thresh;
+	workspace->prev_grid = blob->grid;
 #endif
 }
 
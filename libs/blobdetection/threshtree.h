@@ -5,9 +5,13 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+
 #include "settings.h"
 #include "tree.h"
 #include "blob.h"
+#include "workers.h"
+#include "treepatch.h"
 
 /* Workspace struct for array storage */
 typedef struct {
@@ -17,6 +21,9 @@ typedef struct {
 	unsigned char *depths; // use monotone function to map image data into different depths
 	unsigned int *comp_same; //map ids to unique ids g:{0,...,}->{0,....}
 	unsigned int *prob_parent; //store ⊂-Relation.
+#ifdef BLOB_COMPONENT_RECORDS
+	BlobComponent *components; //storage of the following arrays, see settings.h
+#endif
 #ifdef BLOB_COUNT_PIXEL
 	unsigned int *comp_size;
 #endif
@@ -38,11 +45,72 @@ typedef struct {
 	size_t triangle_len;
 #endif
 
+#ifdef THRESHTREE_RUN_LENGTH
+	unsigned int runs_width; // number of grid columns the row buffers can hold.
+	uint64_t *row_bits; // bit masks of current and previous row.
+	unsigned int *runs; // start columns and ids of runs in current and previous row.
+#endif
+
 	//extra data
 	unsigned int *blob_id_filtered; //like comp_same, but respect blob tree filter.
 
+	//parallel labeling, see threshtree_find_blobs_parallel
+	unsigned int num_strips;
+	struct ThreshtreeStrip *strips;
+	BlobWorkers *workers; // threads for the strips 1, …, num_strips-1. Reused for all frames.
+
+	//incremental labeling, see threshtree_find_blobs_incremental
+	bool incremental_valid; // ids and tiles contain labels of the last image.
+	unsigned char *prev_data; // last image (grid rows of roi). Used to detect changes.
+	BlobtreeRect prev_roi;
+	unsigned char prev_thresh;
+	Grid prev_grid;
+	unsigned int num_tiles, tiles_x, tiles_y;
+	struct ThreshtreeTile *tiles;
+	unsigned int comp_len; // length of the following four arrays.
+	unsigned int *comp_first; // position of first pixel of component.
+	unsigned int *comp_node; // tree node of component.
+	unsigned int *comp_list; // changed components.
+	unsigned char *comp_changed;
+	TreePatch patch; // nodes of the tree of the last image.
+
 } ThreshtreeWorkspace;
 
+/* Slice of the workspace for one horizontal strip of the roi.
+ * The first strip will be labeled in the parent workspace,
+ * all other strips use their own component arrays.
+ */
+typedef struct ThreshtreeStrip {
+	ThreshtreeWorkspace *workspace; // ids points into ids array of parent workspace while labeling.
+	BlobtreeRect roi; // roi of strip. Relative to offset_y for all strips except the first.
+	unsigned int offset_y; // image row of the strip begin.
+	unsigned int nids; // number of ids found in this strip.
+	unsigned int *id_map; // map strip ids on ids of the serial labeling.
+	unsigned int id_map_len;
+} ThreshtreeStrip;
+
+/* Tile of the roi for the incremental labeling.
+ * The component data of the tile survives until the tile changes.
+ */
+typedef struct ThreshtreeTile {
+	ThreshtreeWorkspace *workspace; // component j of the tile is stored at index j.
+	BlobtreeRect roi; // roi of tile. Relative to offset_y.
+	unsigned int offset_y; // image row of the tile begin.
+	bool dirty; // tile changed in the current image.
+	unsigned int ncomp; // number of components in this tile.
+	unsigned int first_id; // ids of the components are first_id, …, first_id+ncomp-1.
+	unsigned int id_range; // number of reserved ids, >= ncomp.
+	unsigned int *first_pixel; // position of first pixel of component.
+	unsigned int *ref_pixel; // left (or upper) neighbour of first pixel, UINT_MAX on roi corner.
+	unsigned int *ref_id; // id of ref_pixel. Updated with the seams.
+	unsigned int *comp_map; // map tile-local ids on components.
+	unsigned int *node; // tree node of component.
+	unsigned char *is_first; // component contains the first pixel of the node.
+	unsigned int comp_len; // length of the six arrays above.
+	unsigned int *seam; // pairs of ids along left and upper border with the same class.
+	unsigned int seam_len, seam_max;
+} ThreshtreeTile;
+
 
 bool threshtree_create_workspace(
 		const unsigned int w, const unsigned int h,
@@ -171,17 +239,54 @@ Tree* find_connection_components_coarse(
 		Blob **tree_data,
 		ThreshtreeWorkspace *workspace );
 
-/* Let compiler optimize code for fixed stepwidth and stepheight */
-FORCEINLINE
-Tree* find_connection_components_coarse2(
+/* Building blocks of find_connection_components_coarse.
+ *
+ * threshtree_label_coarse fills the ids array and the component
+ * arrays of the workspace and returns the number of used ids (0 on error).
+ * threshtree_build_tree joins the ids and creates the tree.
+ *
+ * If arena is NULL, the tree and *tree_data will be allocated on the heap.
+ * Otherwise, the storage of the arena will be reused, see blobtree_clear_tree.
+ */
+unsigned int threshtree_label_coarse(
 		const unsigned char *data,
 		const unsigned int w, const unsigned int h,
 		const BlobtreeRect roi,
 		const unsigned char thresh,
 		const unsigned int stepwidth,
 		const unsigned int stepheight,
+		ThreshtreeWorkspace *workspace );
+
+Tree* threshtree_build_tree(
+		const BlobtreeRect roi,
+		const unsigned int stepwidth,
+		const unsigned int stepheight,
+		const unsigned int nids,
 		Blob **tree_data,
+		ThreshtreeWorkspace *workspace,
+		TreeArena *arena );
+
+#ifdef THRESHTREE_RUN_LENGTH
+/* Drop-in replacement for threshtree_label_coarse.
+ *
+ * Each grid row will be binarized into a bit mask and
+ * splitted into runs of foreground/background pixels. Runs
+ * will be joined with the overlapping runs of the previous row.
+ * The created ids are equal to threshtree_label_coarse,
+ * but pixels of one run share the same id.
+ */
+unsigned int threshtree_label_runs(
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char thresh,
+		const unsigned int stepwidth,
+		const unsigned int stepheight,
 		ThreshtreeWorkspace *workspace );
+#define THRESHTREE_LABEL threshtree_label_runs
+#else
+#define THRESHTREE_LABEL threshtree_label_coarse
+#endif
 
 #ifdef BLOB_SUBGRID_CHECK 
 /* Find Blobs. With flexible stepwidth and
@@ -236,6 +341,63 @@ void threshtree_find_blobs( Blobtree *blob,
 		const unsigned char thresh,
 		ThreshtreeWorkspace *workspace );
 
+/* Multi-threaded variant of threshtree_find_blobs.
+ *
+ * The roi will be split into num_threads horizontal strips.
+ * Each strip is labeled by its own thread. Afterwards, the ids
+ * of neighbouring strips will be joined along the strip borders
+ * and mapped onto the ids of the serial algorithm. Thus, the
+ * resulting tree is the same as for threshtree_find_blobs.
+ *
+ * The threads will be started on the first call and kept in the
+ * workspace (workspace->workers) until threshtree_destroy_workspace.
+ * Do not use the workspace in two threads at the same time.
+ *
+ * Falls back on the serial algorithm if num_threads<2 or
+ * the roi is too small.
+ */
+void threshtree_find_blobs_parallel( Blobtree *blob, 
+		const unsigned char *data, 
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char thresh,
+		const unsigned int num_threads,
+		ThreshtreeWorkspace *workspace );
+
+/* Incremental variant of threshtree_find_blobs for image sequences.
+ *
+ * The roi will be split into tiles of about BLOB_TILE_SIZE x BLOB_TILE_SIZE
+ * pixels. The labels and component data of each tile are stored in the
+ * workspace and only changed tiles will be labeled again. The tiles will
+ * be joined by the pairs of labels along their borders. These pairs will
+ * only be updated next to changed tiles. Finally, the tree of the last
+ * call will be patched: Only the nodes of components with parts in
+ * changed tiles will be created, removed or moved. Area, barycenter, …
+ * will only be evaluated for these nodes and their ancestors.
+ * The tree is the same as for threshtree_find_blobs, only the ids of
+ * the blobs differ. If nothing has changed, the tree of the last call
+ * will be kept.
+ *
+ * The join of the tiles needs one pass over the components of all tiles
+ * (not over the pixels). Thus, it grows with the number of components.
+ *
+ * dirty_tiles - NULL or one byte per cell of BLOB_TILE_SIZE x BLOB_TILE_SIZE
+ *   pixels of the roi (row major, ceil(roi.width/BLOB_TILE_SIZE) x
+ *   ceil(roi.height/BLOB_TILE_SIZE) bytes). Cells with value != 0 will be
+ *   handled as changed. If NULL, the image will be compared with the last image.
+ *
+ * Use the same Blobtree for all calls. The workspace requires
+ * w*h bytes of additional memory.
+ * With BLOB_SUBGRID_CHECK or BLOB_SORT_TREE, threshtree_find_blobs will be used.
+ */
+void threshtree_find_blobs_incremental( Blobtree *blob,
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char thresh,
+		const unsigned char *dirty_tiles,
+		ThreshtreeWorkspace *workspace );
+
 #ifdef __cplusplus
 }
 #endif
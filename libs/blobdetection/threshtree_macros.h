@@ -1,6 +1,8 @@
 #ifndef THRESHTREE_MACROS
 #define THRESHTREE_MACROS
 
+#include "unionfind.h"
+
 /*
  *
  * Notes:
@@ -40,9 +42,9 @@
 #ifdef BLOB_COUNT_PIXEL
 #define COUNT(X) X;
 #define BLOB_REALLOC_COMP_SIZE comp_size = realloc(comp_size, max_comp*sizeof(unsigned int) );
-#define BLOB_INIT_COMP_SIZE *(comp_size+id) = 0; /*Increase now every pixel. => Can't start with 1 anymore. Overhead of |ids| operations */
-//#define BLOB_INC_COMP_SIZE *(comp_size+*(iPi)) += 1;
-#define BLOB_INC_COMP_SIZE(ID) *(comp_size+ID) += 1; 
+#define BLOB_INIT_COMP_SIZE BLOB_COMP(comp_size, id) = 0; /*Increase now every pixel. => Can't start with 1 anymore. Overhead of |ids| operations */
+//#define BLOB_INC_COMP_SIZE BLOB_COMP(comp_size, *(iPi)) += 1;
+#define BLOB_INC_COMP_SIZE(ID) BLOB_COMP(comp_size, ID) += 1; 
 #else
 /* empty definitions */
 #define COUNT(X) ;
@@ -61,22 +63,22 @@
 #ifdef BLOB_DIMENSION
 #define BD(X) X;
 #define BLOB_INIT_INDEX_ARRAYS \
-*(top_index+id) = z; \
-*(left_index+id) = s; \
-*(right_index+id) = s; \
-*(bottom_index+id) = z;
+BLOB_COMP(top_index, id) = z; \
+BLOB_COMP(left_index, id) = s; \
+BLOB_COMP(right_index, id) = s; \
+BLOB_COMP(bottom_index, id) = z;
 
 #define BLOB_DIMENSION_LEFT(STEPWIDTH) \
-	/*	if( *( left_index+*(iPi) ) > s ) *( left_index+*(iPi) ) -= STEPWIDTH; */ \
-	if( *( left_index+*(iPi) ) > s ) *( left_index+*(iPi) ) = s; /* Is this correct for STEPWITDTH>1?! */
+	/*	if( BLOB_COMP(left_index, *(iPi)) > s ) BLOB_COMP(left_index, *(iPi)) -= STEPWIDTH; */ \
+	if( BLOB_COMP(left_index, *(iPi)) > s ) BLOB_COMP(left_index, *(iPi)) = s; /* Is this correct for STEPWITDTH>1?! */
 
 #define BLOB_DIMENSION_RIGHT(STEPWIDTH) \
-	/*	if( *( right_index+*(iPi) ) < s ) *( right_index+*(iPi) ) += STEPWIDTH; */ \
-	if( *( right_index+*(iPi) ) < s ) *( right_index+*(iPi) ) = s;
+	/*	if( BLOB_COMP(right_index, *(iPi)) < s ) BLOB_COMP(right_index, *(iPi)) += STEPWIDTH; */ \
+	if( BLOB_COMP(right_index, *(iPi)) < s ) BLOB_COMP(right_index, *(iPi)) = s;
 
 #define BLOB_DIMENSION_BOTTOM(STEPHEIGHT) \
-	/*	if( *( bottom_index+*(iPi) ) < z ) *( bottom_index+*(iPi) ) += STEPHEIGHT; */ \
-	if( *( bottom_index+*(iPi) ) < z ) *( bottom_index+*(iPi) ) = z;
+	/*	if( BLOB_COMP(bottom_index, *(iPi)) < z ) BLOB_COMP(bottom_index, *(iPi)) += STEPHEIGHT; */ \
+	if( BLOB_COMP(bottom_index, *(iPi)) < z ) BLOB_COMP(bottom_index, *(iPi)) = z;
 
 #else
 /* empty definitions */
@@ -93,9 +95,9 @@
 	pixel_sum_X = realloc(pixel_sum_X, max_comp*sizeof(BLOB_BARYCENTER_TYPE) ); \
 pixel_sum_X = realloc(pixel_sum_X, max_comp*sizeof(BLOB_BARYCENTER_TYPE) );
 
-//#define BLOB_INIT_BARY *(pixel_sum_X+id) = s; *(pixel_sum_Y+id) = z;
-#define BLOB_INIT_BARY *(pixel_sum_X+id) = 0; *(pixel_sum_Y+id) = 0; /* (0,0) is the matching start value for BLOB_INIT_COMP_SIZE(...) = 0. Prevent values on 'subpixels'. */
-#define BLOB_INC_BARY(ID) *(pixel_sum_X+ID) += s;  *(pixel_sum_Y+ID) += z;
+//#define BLOB_INIT_BARY BLOB_COMP(pixel_sum_X, id) = s; BLOB_COMP(pixel_sum_Y, id) = z;
+#define BLOB_INIT_BARY BLOB_COMP(pixel_sum_X, id) = 0; BLOB_COMP(pixel_sum_Y, id) = 0; /* (0,0) is the matching start value for BLOB_INIT_COMP_SIZE(...) = 0. Prevent values on 'subpixels'. */
+#define BLOB_INC_BARY(ID) BLOB_COMP(pixel_sum_X, ID) += s;  BLOB_COMP(pixel_sum_Y, ID) += z;
 #else
 /* empty definitions */
 #define BARY(X) ;
@@ -137,6 +139,12 @@ if( id>=max_comp ){ \
 }
 
 
+/* Follow comp_same to the smallest id of the component.
+ * Overwriting comp_same of a non-root id would cut its old link.
+ * The path will be halved, see unionfind.h. */
+#define COMP_ROOT(A) \
+	A = uf_find(comp_same, A);
+
 #define TOP_CHECK(STEPHEIGHT,WIDTH) \
 	*(iPi) = *(iPi-WIDTH); \
 /*	BLOB_INC_COMP_SIZE;*/ \
@@ -148,6 +156,8 @@ BLOB_DIMENSION_BOTTOM(STEPHEIGHT);
 #define TOP_LEFT_COMP(STEPWIDTH) \
 	a1 = *(comp_same+*(iPi-STEPWIDTH)); \
 	a2 = *(comp_same+*(iPi  )); \
+	COMP_ROOT(a1); \
+	COMP_ROOT(a2); \
 	if( a1<a2 ){ \
 VPRINTF("(%i=>%i), (%i=>%i) changed to ", *(iPi), a2, *(iPi-STEPWIDTH),a1); \
 		*(comp_same+a2) = a1; \
@@ -169,6 +179,8 @@ BLOB_DIMENSION_RIGHT(STEPWIDTH);
 #define LEFT_DIAG_COMP(STEPWIDTHRIGHT,WIDTH) \
 	a1 = *(comp_same+*(iPi-WIDTH+STEPWIDTHRIGHT)); \
 	a2 = *(comp_same+*(iPi    )); \
+	COMP_ROOT(a1); \
+	COMP_ROOT(a2); \
 	if( a1<a2 ){ \
 VPRINTF("(%i=>%i), (%i=>%i) changed to ", *(iPi), a2, *(iPi+STEPWIDTHRIGHT-WIDTH),a1); \
 		*(comp_same+a2) = a1; \
@@ -193,6 +205,8 @@ BLOB_DIMENSION_BOTTOM(STEPHEIGHT);
 #define ANTI_DIAG_COMP(STEPWIDTHRIGHT,WIDTH) \
 	a1 = *(comp_same+*(iPi-WIDTH+STEPWIDTHRIGHT)); \
 	a2 = *(comp_same+*(iPi    )); \
+	COMP_ROOT(a1); \
+	COMP_ROOT(a2); \
 	if( a1<a2 ){ \
 VPRINTF("(%i=>%i), (%i=>%i) changed to ", *(iPi), a2, *(iPi+STEPWIDTHRIGHT-WIDTH),a1); \
 		*(comp_same+a2) = a1; \
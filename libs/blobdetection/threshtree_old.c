@@ -9,6 +9,18 @@
 #include "threshtree_macros.h"
 #include "threshtree_macros_old.h"
 
+/* Labeling (threshtree_label_coarse2) will be inlined for fixed stepwidth and stepheight. */
+static
+Tree* find_connection_components_coarse2(
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char thresh,
+		const unsigned int stepwidth,
+		const unsigned int stepheight,
+		Blob **tree_data,
+		ThreshtreeWorkspace *workspace );
+
 Tree* find_connection_components_coarse(
 		const unsigned char *data,
 		const unsigned int w, const unsigned int h,
@@ -31,14 +43,13 @@ Tree* find_connection_components_coarse(
 }
 
 	FORCEINLINE
-Tree* find_connection_components_coarse2(
+unsigned int threshtree_label_coarse2(
 		const unsigned char *data,
 		const unsigned int w, const unsigned int h,
 		const BlobtreeRect roi,
 		const unsigned char thresh,
 		const unsigned int stepwidth,
 		const unsigned int stepheight,
-		Blob **tree_data,
 		ThreshtreeWorkspace *workspace )
 {
 	/* Marks of 10 Cases:
@@ -72,8 +83,7 @@ Tree* find_connection_components_coarse2(
 	unsigned int b=h-roi.y-roi.height; //bottom border
 	if( r<0 || b<0 ){
 		fprintf(stderr,"[blob.c] BlobtreeRect not matching.\n");
-		*tree_data = NULL;
-		return NULL;
+		return 0;
 	}
 
 	unsigned int swr = (roi.width-1)%stepwidth; // remainder of width/stepwidth;
@@ -85,7 +95,6 @@ Tree* find_connection_components_coarse2(
 #define DUMMY_ID -1 //id virtual parent of first element (id=0)
 	unsigned int id=-1;//id for next component would be ++id
 	unsigned int a1,a2; // for comparation of g(f(x))=a1,a2=g(f(y))
-	unsigned int k; //loop variable
 
 	/* Create pointer to workspace arrays */
 	unsigned int max_comp = workspace->max_comp;
@@ -439,7 +448,7 @@ Tree* find_connection_components_coarse2(
 					ANTI_DIAG_CHECK(swr, stepheight, sh)
 #endif				
 				}else{//new component
-					NEW_COMPONENT_OLD( *(iPi-stepwidth) )
+					NEW_COMPONENT_OLD( *(iPi-swr) )
 				}
 			}else{
 				/**** H'-CASE *****/
@@ -456,7 +465,7 @@ Tree* find_connection_components_coarse2(
 					ANTI_DIAG_CHECK(swr, stepheight, sh)
 #endif				
 				}else{//new component
-					NEW_COMPONENT_OLD( *(iPi-stepwidth) )
+					NEW_COMPONENT_OLD( *(iPi-swr) )
 				}
 			}
 			BLOB_INC_COMP_SIZE( *iPi );
@@ -713,7 +722,7 @@ Tree* find_connection_components_coarse2(
 					ANTI_DIAG_CHECK(swr, shr, sh2)
 #endif				
 				}else{//new component
-					NEW_COMPONENT_OLD( *(iPi-stepwidth) )
+					NEW_COMPONENT_OLD( *(iPi-swr) )
 				}
 			}else{
 				/**** P'-CASE *****/
@@ -730,7 +739,7 @@ Tree* find_connection_components_coarse2(
 					ANTI_DIAG_CHECK(swr, shr, sh2)
 #endif				
 				}else{//new component
-					NEW_COMPONENT_OLD( *(iPi-stepwidth) )
+					NEW_COMPONENT_OLD( *(iPi-swr) )
 				}
 			}
 
@@ -752,22 +761,48 @@ Tree* find_connection_components_coarse2(
 	debug_print_matrix2( ids, comp_same, w, h, roi, 1, 1, 0);
 #endif
 
+	return id+1;
+}
+
+Tree* threshtree_build_tree(
+		const BlobtreeRect roi,
+		const unsigned int stepwidth,
+		const unsigned int stepheight,
+		const unsigned int nids,
+		Blob **tree_data,
+		ThreshtreeWorkspace *workspace,
+		TreeArena *arena )
+{
+	const unsigned int id = nids-1; //maximal used id
+	unsigned int k; //loop variable
+
+	unsigned int* comp_same = workspace->comp_same;
+	unsigned int* prob_parent = workspace->prob_parent;
+#ifdef BLOB_COUNT_PIXEL
+	unsigned int* comp_size = workspace->comp_size;
+#endif
+#ifdef BLOB_DIMENSION
+	unsigned int* top_index = workspace->top_index;
+	unsigned int* left_index = workspace->left_index;
+	unsigned int* right_index = workspace->right_index;
+	unsigned int* bottom_index = workspace->bottom_index;
+#endif
+#ifdef BLOB_BARYCENTER
+	BLOB_BARYCENTER_TYPE *pixel_sum_X = workspace->pixel_sum_X; 
+	BLOB_BARYCENTER_TYPE *pixel_sum_Y = workspace->pixel_sum_Y; 
+#endif
+
+	BLOB_PHASE_BEGIN(t_merge)
 	/* Postprocessing.
 	 * Sum up all areas with connecteted ids.
 	 * Then create nodes and connect them.
 	 * If BLOB_DIMENSION is set, detect
 	 * extremal limits in [left|right|bottom]_index(*(real_ids+X)).
 	 * */
-	unsigned int nids = id+1; //number of ids
 	unsigned int tmp_id,tmp_id2, real_ids_size=0,l;
 
-	free(workspace->real_ids);
-	workspace->real_ids = calloc( nids, sizeof(unsigned int) ); //store join of ids.
-	unsigned int* const real_ids = workspace->real_ids;
-
-	free(workspace->real_ids_inv);
-	workspace->real_ids_inv = calloc( nids, sizeof(unsigned int) ); //store for every id with position in real_id link to it's position.
-	unsigned int* const real_ids_inv = workspace->real_ids_inv;
+	unsigned int* const real_ids = workspace->real_ids; //store join of ids.
+	unsigned int* const real_ids_inv = workspace->real_ids_inv; //store for every id with position in real_id link to it's position.
 
 #if 1
 	for(k=0;k<nids;k++){
@@ -796,28 +831,28 @@ Tree* find_connection_components_coarse2(
 
 #ifdef BLOB_COUNT_PIXEL
 			//move area size to other id.
-			*(comp_size+tmp_id) += *(comp_size+k);
-			*(comp_size+k) = 0;
+			BLOB_COMP(comp_size, tmp_id) += BLOB_COMP(comp_size, k);
+			BLOB_COMP(comp_size, k) = 0;
 #endif
 
 #ifdef BLOB_DIMENSION
 			//update dimension
-			if( *( top_index+tmp_id ) > *( top_index+k ) )
-				*( top_index+tmp_id ) = *( top_index+k );
-			if( *( left_index+tmp_id ) > *( left_index+k ) )
-				*( left_index+tmp_id ) = *( left_index+k );
-			if( *( right_index+tmp_id ) < *( right_index+k ) )
-				*( right_index+tmp_id ) = *( right_index+k );
-			if( *( bottom_index+tmp_id ) < *( bottom_index+k ) )
-				*( bottom_index+tmp_id ) = *( bottom_index+k );
+			if( BLOB_COMP(top_index, tmp_id) > BLOB_COMP(top_index, k) )
+				BLOB_COMP(top_index, tmp_id) = BLOB_COMP(top_index, k);
+			if( BLOB_COMP(left_index, tmp_id) > BLOB_COMP(left_index, k) )
+				BLOB_COMP(left_index, tmp_id) = BLOB_COMP(left_index, k);
+			if( BLOB_COMP(right_index, tmp_id) < BLOB_COMP(right_index, k) )
+				BLOB_COMP(right_index, tmp_id) = BLOB_COMP(right_index, k);
+			if( BLOB_COMP(bottom_index, tmp_id) < BLOB_COMP(bottom_index, k) )
+				BLOB_COMP(bottom_index, tmp_id) = BLOB_COMP(bottom_index, k);
 #endif
 
 #ifdef BLOB_BARYCENTER
 					//shift values to other id
-					*(pixel_sum_X+tmp_id) += *(pixel_sum_X+k); 
-					*(pixel_sum_X+k) = 0;
-					*(pixel_sum_Y+tmp_id) += *(pixel_sum_Y+k); 
-					*(pixel_sum_Y+k) = 0;
+					BLOB_COMP(pixel_sum_X, tmp_id) += BLOB_COMP(pixel_sum_X, k); 
+					BLOB_COMP(pixel_sum_X, k) = 0;
+					BLOB_COMP(pixel_sum_Y, tmp_id) += BLOB_COMP(pixel_sum_Y, k); 
+					BLOB_COMP(pixel_sum_Y, k) = 0;
 #endif
 
 		}else{
@@ -843,28 +878,28 @@ Tree* find_connection_components_coarse2(
 
 #ifdef BLOB_COUNT_PIXEL
 			//move area size to other id.
-			*(comp_size+tmp_id2) += *(comp_size+tmp_id);
-			*(comp_size+tmp_id) = 0;
+			BLOB_COMP(comp_size, tmp_id2) += BLOB_COMP(comp_size, tmp_id);
+			BLOB_COMP(comp_size, tmp_id) = 0;
 #endif
 
 #ifdef BLOB_DIMENSION
 			//update dimension
-			if( *( top_index+tmp_id2 ) > *( top_index+k ) )
-				*( top_index+tmp_id2 ) = *( top_index+k );
-			if( *( left_index+tmp_id2 ) > *( left_index+k ) )
-				*( left_index+tmp_id2 ) = *( left_index+k );
-			if( *( right_index+tmp_id2 ) < *( right_index+k ) )
-				*( right_index+tmp_id2 ) = *( right_index+k );
-			if( *( bottom_index+tmp_id2 ) < *( bottom_index+k ) )
-				*( bottom_index+tmp_id2 ) = *( bottom_index+k );
+			if( BLOB_COMP(top_index, tmp_id2) > BLOB_COMP(top_index, k) )
+				BLOB_COMP(top_index, tmp_id2) = BLOB_COMP(top_index, k);
+			if( BLOB_COMP(left_index, tmp_id2) > BLOB_COMP(left_index, k) )
+				BLOB_COMP(left_index, tmp_id2) = BLOB_COMP(left_index, k);
+			if( BLOB_COMP(right_index, tmp_id2) < BLOB_COMP(right_index, k) )
+				BLOB_COMP(right_index, tmp_id2) = BLOB_COMP(right_index, k);
+			if( BLOB_COMP(bottom_index, tmp_id2) < BLOB_COMP(bottom_index, k) )
+				BLOB_COMP(bottom_index, tmp_id2) = BLOB_COMP(bottom_index, k);
 #endif
 
 #ifdef BLOB_BARYCENTER
 					//shift values to other id
-					*(pixel_sum_X+tmp_id) += *(pixel_sum_X+k); 
-					*(pixel_sum_X+k) = 0;
-					*(pixel_sum_Y+tmp_id) += *(pixel_sum_Y+k); 
-					*(pixel_sum_Y+k) = 0;
+					BLOB_COMP(pixel_sum_X, tmp_id) += BLOB_COMP(pixel_sum_X, k); 
+					BLOB_COMP(pixel_sum_X, k) = 0;
+					BLOB_COMP(pixel_sum_Y, tmp_id) += BLOB_COMP(pixel_sum_Y, k); 
+					BLOB_COMP(pixel_sum_Y, k) = 0;
 #endif
 
 			tmp_id = tmp_id2;
@@ -895,21 +930,36 @@ Tree* find_connection_components_coarse2(
 	}
 #endif
 
+	BLOB_PHASE_END(BLOB_PHASE_MERGE, t_merge)
+	BLOB_PHASE_BEGIN(t_tree)
 	/*
 	 * Generate tree structure
 	 */
 
-	/* store for real_ids the index of the node in the tree array */
-	unsigned int *tree_id_relation = malloc( (real_ids_size+1)*sizeof(unsigned int) );
-
-	Node *nodes = malloc( (real_ids_size+1)*sizeof(Node) );
-	Blob *blobs = malloc( (real_ids_size+1)*sizeof(Blob) );
-	Tree *tree = malloc( sizeof(Tree) );
-	tree->root = nodes;
-	tree->size = real_ids_size + 1;
-
-	//init all node as leafs
-	for(l=0;l<real_ids_size+1;l++) *(nodes+l)=Leaf;
+	Node *nodes;
+	Blob *blobs;
+	Tree *tree;
+	/* store for every node the index of its last child */
+	unsigned int *last_child;
+	if( arena != NULL ){
+		tree = tree_arena_alloc(arena, real_ids_size+1, &blobs);
+		last_child = tree_arena_scratch(arena, real_ids_size+1);
+		if( tree == NULL || last_child == NULL ){
+			*tree_data = NULL;
+			return NULL;
+		}
+		nodes = tree->root;
+	}else{
+		nodes = malloc( (real_ids_size+1)*sizeof(Node) );
+		blobs = malloc( (real_ids_size+1)*sizeof(Blob) );
+		tree = malloc( sizeof(Tree) );
+		tree->root = nodes;
+		tree->size = real_ids_size + 1;
+		last_child = calloc( real_ids_size+1, sizeof(unsigned int) );
+
+		//init all node as leafs
+		for(l=0;l<real_ids_size+1;l++) *(nodes+l)=Leaf;
+	}
 
 	//set root node (the desired output are the child(ren) of this node.)
 	Node * const root = nodes;
@@ -937,15 +987,15 @@ Tree* find_connection_components_coarse2(
 		//unsigned int anchor = *(anchors+*(real_ids+l)); //get anchor of this blob
 #ifdef BLOB_DIMENSION
 		rect = &curdata->roi;
-		rect->y = *(top_index + rid);
-		rect->height = *(bottom_index + rid) - rect->y + 1;
-		rect->x = *(left_index + rid);
-		rect->width = *(right_index + rid) - rect->x + 1;
+		rect->y = BLOB_COMP(top_index, rid);
+		rect->height = BLOB_COMP(bottom_index, rid) - rect->y + 1;
+		rect->x = BLOB_COMP(left_index, rid);
+		rect->width = BLOB_COMP(right_index, rid) - rect->x + 1;
 #endif
 #ifdef BLOB_BARYCENTER
 		/* The barycenter will not set here, but in eval_barycenters(...) */
-		//curdata->barycenter[0] = *(pixel_sum_X + rid) / *(comp_same + rid);
-		//curdata->barycenter[1] = *(pixel_sum_Y + rid) / *(comp_same + rid);
+		//curdata->barycenter[0] = BLOB_COMP(pixel_sum_X, rid) / *(comp_same + rid);
+		//curdata->barycenter[1] = BLOB_COMP(pixel_sum_Y, rid) / *(comp_same + rid);
 #endif
 #ifdef SAVE_DEPTH_MAP_VALUE
 		curdata->depth_level = 0; /* ??? without anchor not trivial.*/
@@ -955,7 +1005,7 @@ Tree* find_connection_components_coarse2(
 		if( tmp_id == DUMMY_ID ){
 			/* Use root as parent node. */
 			//cur->parent = root;
-			add_child(root, cur );
+			add_child_indexed(root, root, cur, last_child);
 		}else{
 			//find real id of parent id.
 #if 1
@@ -971,8 +1021,8 @@ Tree* find_connection_components_coarse2(
 
 			/*Now, tmp_id is in real_id array. And real_ids_inv is defined. */
 			//cur->parent = root + 1/*root pos shift*/ + *(real_ids_inv+tmp_id );
-			add_child( root + 1/*root pos shift*/ + *(real_ids_inv+tmp_id ),
-					cur );
+			add_child_indexed(root, root + 1/*root pos shift*/ + *(real_ids_inv+tmp_id ),
+					cur, last_child);
 		}
 
 	}
@@ -980,6 +1030,8 @@ Tree* find_connection_components_coarse2(
 	/*
 	 *
 	 */
+	BLOB_PHASE_END(BLOB_PHASE_TREE, t_tree)
+	BLOB_PHASE_BEGIN(t_areas)
 #ifdef BLOB_BARYCENTER
 	eval_barycenters(root->child, root, comp_size, pixel_sum_X, pixel_sum_Y);
 #define SUM_AREAS_IS_REDUNDANT
@@ -996,7 +1048,7 @@ Tree* find_connection_components_coarse2(
 		sum_areas(root->child, comp_size);
 #endif
 	}else{
-		approx_areas(tree, root->child, comp_size, stepwidth, stepheight);
+		approx_areas(tree, root->child, comp_size, stepwidth, stepheight, arena);
 		//replace estimation with exact value for full image area
 		Blob* img = (Blob*)root->child->data;
 		img->area = img->roi.width * img->roi.height;
@@ -1018,6 +1070,8 @@ Tree* find_connection_components_coarse2(
 	#endif
 #endif
 
+	BLOB_PHASE_END(BLOB_PHASE_AREAS, t_areas)
+
 #ifdef BLOB_SORT_TREE
 	sort_tree(root);
 #endif
@@ -1026,9 +1080,48 @@ Tree* find_connection_components_coarse2(
 	workspace->used_comp=id;
 
 	//clean up
-	free(tree_id_relation);
+	if( arena == NULL ) free(last_child);
 
 	//set output parameter
 	*tree_data = blobs;
 	return tree;
 }
+
+static
+Tree* find_connection_components_coarse2(
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char thresh,
+		const unsigned int stepwidth,
+		const unsigned int stepheight,
+		Blob **tree_data,
+		ThreshtreeWorkspace *workspace )
+{
+	const unsigned int nids = threshtree_label_coarse2(data,w,h,roi,thresh,
+			stepwidth,stepheight, workspace);
+	if( nids == 0 ){
+		*tree_data = NULL;
+		return NULL;
+	}
+	return threshtree_build_tree(roi, stepwidth, stepheight,
+			nids, tree_data, workspace, NULL);
+}
+
+unsigned int threshtree_label_coarse(
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char thresh,
+		const unsigned int stepwidth,
+		const unsigned int stepheight,
+		ThreshtreeWorkspace *workspace )
+{
+	if( stepwidth == 1 && stepheight == 1 ){
+		return threshtree_label_coarse2(data,w,h,roi,thresh,
+				1,1, workspace);
+	}else{
+		return threshtree_label_coarse2(data,w,h,roi,thresh,
+				stepwidth,stepheight, workspace);
+	}
+}
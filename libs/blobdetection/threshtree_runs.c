@@ -0,0 +1,260 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h> //for memset
+
+#include "threshtree.h"
+#include "rowbits.h"
+#include "unionfind.h"
+
+#ifdef THRESHTREE_RUN_LENGTH
+
+#ifndef DUMMY_ID
+#define DUMMY_ID -1 //id virtual parent of first element (id=0)
+#endif
+
+/* Run based labeling
+ *
+ * Every row of the grid will be binarized into a bit mask
+ * (bit i = data of column i > thresh) and splitted into runs of
+ * pixels of the same class. The runs are labeled by comparison
+ * with the overlapping runs of the previous row.
+ *
+ * The algorithm creates the same ids like threshtree_label_coarse,
+ * because a new id will be created on the same positions:
+ * on the first pixel of a run, if no neighbour in the row above
+ * has the same class. Thus, threshtree_build_tree returns
+ * the same tree.
+ */
+
+static bool threshtree_realloc_runs(
+		const unsigned int ncols,
+		ThreshtreeWorkspace *workspace )
+{
+	if( workspace->runs_width >= ncols ) return true;
+
+	free(workspace->row_bits);
+	free(workspace->runs);
+	workspace->runs_width = 0;
+	if(
+			( workspace->row_bits = (uint64_t*) malloc( 2*ROWBITS_WORDS(ncols)*sizeof(uint64_t) ) ) == NULL ||
+			( workspace->runs = (unsigned int*) malloc( 4*(ncols+1)*sizeof(unsigned int) ) ) == NULL ||
+			0 ){
+		free(workspace->row_bits);
+		workspace->row_bits = NULL;
+		return false;
+	}
+	workspace->runs_width = ncols;
+	return true;
+}
+
+#define RUN_NEW_COMPONENT(PARENTID) \
+	id++; \
+	if( id>=max_comp ){ \
+		max_comp += max_comp; \
+		VPRINTF("Extend max_comp=%i\n", max_comp); \
+		if( !threshtree_realloc_workspace(max_comp, &workspace) ) return 0; \
+		/* Reallocation requires update of pointers */ \
+		comp_same = workspace->comp_same; \
+		prob_parent = workspace->prob_parent; \
+		COUNT( comp_size = workspace->comp_size; ) \
+		BD( \
+		top_index = workspace->top_index; \
+		left_index = workspace->left_index; \
+		right_index = workspace->right_index; \
+		bottom_index = workspace->bottom_index; \
+		) \
+		BARY( pixel_sum_X = workspace->pixel_sum_X; pixel_sum_Y = workspace->pixel_sum_Y; ) \
+	} \
+	*(prob_parent+id) = PARENTID; \
+	*(comp_same+id) = id; \
+	COUNT( BLOB_COMP(comp_size, id) = 0; ) \
+	BD( \
+	BLOB_COMP(top_index, id) = y; \
+	BLOB_COMP(left_index, id) = xs; \
+	BLOB_COMP(right_index, id) = xe; \
+	BLOB_COMP(bottom_index, id) = y; \
+	) \
+	BARY( BLOB_COMP(pixel_sum_X, id) = 0; BLOB_COMP(pixel_sum_Y, id) = 0; )
+
+#ifdef BLOB_COUNT_PIXEL
+#define COUNT(X) X
+#else
+#define COUNT(X)
+#endif
+#ifdef BLOB_DIMENSION
+#define BD(X) X
+#else
+#define BD(X)
+#endif
+#ifdef BLOB_BARYCENTER
+#define BARY(X) X
+#else
+#define BARY(X)
+#endif
+
+unsigned int threshtree_label_runs(
+		const unsigned char *data,
+		const unsigned int w, const unsigned int h,
+		const BlobtreeRect roi,
+		const unsigned char thresh,
+		const unsigned int stepwidth,
+		const unsigned int stepheight,
+		ThreshtreeWorkspace *workspace )
+{
+	if( roi.x+roi.width > w || roi.y+roi.height > h ){
+		fprintf(stderr,"[blob.c] BlobtreeRect not matching.\n");
+		return 0;
+	}
+
+	const unsigned int lastx = roi.width-1;
+	const unsigned int lasty = roi.height-1;
+	const unsigned int ncols = lastx/stepwidth + 1 + ( lastx%stepwidth ? 1 : 0 );
+	const unsigned int nrows = lasty/stepheight + 1 + ( lasty%stepheight ? 1 : 0 );
+	const unsigned int nwords = ROWBITS_WORDS(ncols);
+
+	if( !threshtree_realloc_runs(ncols, workspace) ){
+		fprintf(stderr,"(threshtree) Critical error: Mem allocation failed\n");
+		return 0;
+	}
+
+	unsigned int id=-1;//id for next component would be ++id
+	unsigned int max_comp = workspace->max_comp;
+
+	unsigned int* const ids = workspace->ids;
+	unsigned int* comp_same = workspace->comp_same;
+	unsigned int* prob_parent = workspace->prob_parent;
+#ifdef BLOB_COUNT_PIXEL
+	unsigned int* comp_size = workspace->comp_size;
+#endif
+#ifdef BLOB_DIMENSION
+	unsigned int* top_index = workspace->top_index;
+	unsigned int* left_index = workspace->left_index;
+	unsigned int* right_index = workspace->right_index;
+	unsigned int* bottom_index = workspace->bottom_index;
+#endif
+#ifdef BLOB_BARYCENTER
+	BLOB_BARYCENTER_TYPE *pixel_sum_X = workspace->pixel_sum_X;
+	BLOB_BARYCENTER_TYPE *pixel_sum_Y = workspace->pixel_sum_Y;
+#endif
+
+	/* Double buffer for rows. *_start[n] is the start column of run n,
+	 * *_id[n] its id. */
+	uint64_t *cur_bits = workspace->row_bits;
+	uint64_t *up_bits = cur_bits + nwords;
+	unsigned int *cur_start = workspace->runs;
+	unsigned int *cur_id = cur_start + ncols+1;
+	unsigned int *up_start = cur_id + ncols+1;
+	unsigned int *up_id = up_start + ncols+1;
+	unsigned int up_n = 0, up_c = 0;
+
+	unsigned int r, k, j, jj;
+	for( r=0; r<nrows; r++ ){
+		const unsigned int y = roi.y + ( r*stepheight < lasty ? r*stepheight : lasty );
+		const unsigned char * const row = data + y*w + roi.x;
+		unsigned int * const iRow = ids + y*w + roi.x;
+
+		rowbits_binarize_row(row, ncols, stepwidth, lastx, thresh, cur_bits);
+		const unsigned int n = rowbits_to_runs(cur_bits, ncols, cur_start);
+		const unsigned int c0 = *cur_bits & 1;
+
+		j = 0;
+		for( k=0; k<n; k++ ){
+			const unsigned int s = *(cur_start+k);
+			const unsigned int e = *(cur_start+k+1)-1;
+			const unsigned int c = c0 ^ (k&1);
+			const unsigned int xs = roi.x + ( s*stepwidth < lastx ? s*stepwidth : lastx );
+			const unsigned int xe = roi.x + ( e*stepwidth < lastx ? e*stepwidth : lastx );
+			unsigned int rid;
+
+			if( r == 0 ){
+				RUN_NEW_COMPONENT( k==0 ? DUMMY_ID : *(cur_id+k-1) );
+				rid = id;
+			}else{
+#define UP_CLASS(X) ROWBITS_GET(up_bits, X)
+#ifdef BLOB_DIAGONAL_CHECK
+				const unsigned int lo = s>0 ? s-1 : 0;
+				const unsigned int hi = e+1<ncols ? e+1 : e;
+				const int is_new = UP_CLASS(s) != c
+					&& ( s==0 || UP_CLASS(s-1) != c )
+					&& ( s+1>=ncols || UP_CLASS(s+1) != c );
+#else
+				const unsigned int lo = s;
+				const unsigned int hi = e;
+				const int is_new = UP_CLASS(s) != c;
+#endif
+#undef UP_CLASS
+				//first run of upper row which overlaps [lo, hi].
+				while( *(up_start+j+1) <= lo ) j++;
+
+				if( is_new ){
+					/* Parent is the left neighbour or the top neighbour
+					 * on the left border. */
+					RUN_NEW_COMPONENT( k==0 ? *(up_id+j) : *(cur_id+k-1) );
+					rid = id;
+				}else{
+					rid = -1;
+				}
+
+				for( jj=j; jj<up_n && *(up_start+jj)<=hi; jj++ ){
+					if( (up_c ^ (jj&1)) == c ){
+						if( rid == (unsigned int) -1 ){
+							rid = *(up_id+jj);
+						}else{
+							uf_union(comp_same, rid, *(up_id+jj));
+						}
+					}
+				}
+			}
+			*(cur_id+k) = rid;
+
+			/* Add pixels of run to rid. */
+			const unsigned int len = e-s+1;
+#ifdef BLOB_COUNT_PIXEL
+			BLOB_COMP(comp_size, rid) += len;
+#endif
+#ifdef BLOB_DIMENSION
+			if( BLOB_COMP(left_index, rid) > xs ) BLOB_COMP(left_index, rid) = xs;
+			if( BLOB_COMP(right_index, rid) < xe ) BLOB_COMP(right_index, rid) = xe;
+			BLOB_COMP(bottom_index, rid) = y;
+#endif
+#ifdef BLOB_BARYCENTER
+			BLOB_BARYCENTER_TYPE sum_x;
+			if( xe == roi.x+e*stepwidth ){
+				sum_x = (BLOB_BARYCENTER_TYPE) len*roi.x + (BLOB_BARYCENTER_TYPE) stepwidth*(s+e)*len/2;
+			}else{
+				//last column with remainder
+				sum_x = xe + (BLOB_BARYCENTER_TYPE) (len-1)*roi.x + (BLOB_BARYCENTER_TYPE) stepwidth*(s+e-1)*(len-1)/2;
+			}
+			BLOB_COMP(pixel_sum_X, rid) += sum_x;
+			BLOB_COMP(pixel_sum_Y, rid) += (BLOB_BARYCENTER_TYPE) y*len;
+#endif
+
+			if( stepwidth == 1 ){
+				unsigned int *iPi = iRow+s;
+				unsigned int * const iE = iRow+e;
+				for( ; iPi<=iE; ++iPi ) *iPi = rid;
+			}else{
+				unsigned int i;
+				for( i=s; i<=e; i++ ){
+					*(iRow + ( i*stepwidth < lastx ? i*stepwidth : lastx ) ) = rid;
+				}
+			}
+		}
+
+		//swap row buffers
+		uint64_t *tb = up_bits; up_bits = cur_bits; cur_bits = tb;
+		unsigned int *ts = up_start; up_start = cur_start; cur_start = ts;
+		unsigned int *ti = up_id; up_id = cur_id; cur_id = ti;
+		up_n = n;
+		up_c = c0;
+	}
+
+	return id+1;
+}
+
+#undef COUNT
+#undef BD
+#undef BARY
+
+#endif // THRESHTREE_RUN_LENGTH
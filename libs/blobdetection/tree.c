@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 
 #define INLINE inline
@@ -29,6 +30,98 @@ void tree_destroy(Tree **ptree){
 	*ptree = NULL;
 }
 
+void tree_arena_init(TreeArena *arena){
+	memset(arena, 0, sizeof(TreeArena));
+}
+
+void tree_arena_destroy(TreeArena *arena){
+	free(arena->tree.root);
+	free(arena->blobs);
+	free(arena->scratch);
+	tree_arena_init(arena);
+}
+
+Tree *tree_arena_alloc(TreeArena *arena, const unsigned int size, Blob **blobs){
+	unsigned int l;
+	if( size > arena->nodes_high_water ) arena->nodes_high_water = size;
+	if( size > arena->capacity ){
+		//grow with some reserve to avoid reallocations for small changes.
+		const unsigned int capacity = size + size/4 + 16;
+		Node *nodes = (Node*) realloc( arena->tree.root, capacity*sizeof(Node) );
+		if( nodes != NULL ) arena->tree.root = nodes;
+		Blob *b = (Blob*) realloc( arena->blobs, capacity*sizeof(Blob) );
+		if( b != NULL ) arena->blobs = b;
+		arena->heap_allocs++;
+		if( nodes == NULL || b == NULL ){
+			return NULL;
+		}
+		arena->capacity = capacity;
+	}
+
+	//init all node as leafs
+	Node * const nodes = arena->tree.root;
+	for(l=0;l<size;l++) *(nodes+l)=Leaf;
+
+	arena->tree.size = size;
+	arena->generation++;
+	*blobs = arena->blobs;
+	return &arena->tree;
+}
+
+Tree *tree_arena_reserve(TreeArena *arena, const unsigned int size){
+	unsigned int l;
+	if( size > arena->nodes_high_water ) arena->nodes_high_water = size;
+	if( size <= arena->capacity ) return &arena->tree;
+
+	const unsigned int capacity = size + size/4 + 16;
+	Node * const nodes = (Node*) malloc( capacity*sizeof(Node) );
+	Blob * const b = (Blob*) malloc( capacity*sizeof(Blob) );
+	arena->heap_allocs++;
+	if( nodes == NULL || b == NULL ){
+		free(nodes);
+		free(b);
+		return NULL;
+	}
+
+	Node * const old = arena->tree.root;
+#define MOVE_NODE_PTR(P) ( (P) == NULL ? NULL : nodes + ((P) - old) )
+	for( l=0; l<arena->tree.size; l++){
+		const Node * const o = old+l;
+		Node * const n = nodes+l;
+		n->parent = MOVE_NODE_PTR(o->parent);
+		n->silbing = MOVE_NODE_PTR(o->silbing);
+		n->child = MOVE_NODE_PTR(o->child);
+		n->height = o->height;
+		n->width = o->width;
+		n->data = ( o->data == NULL ) ? NULL : b + ((Blob*)o->data - arena->blobs);
+	}
+#undef MOVE_NODE_PTR
+	if( arena->tree.size > 0 ){
+		memcpy(b, arena->blobs, arena->tree.size*sizeof(Blob));
+	}
+
+	free(arena->tree.root);
+	free(arena->blobs);
+	arena->tree.root = nodes;
+	arena->blobs = b;
+	arena->capacity = capacity;
+	return &arena->tree;
+}
+
+unsigned int *tree_arena_scratch(TreeArena *arena, const unsigned int len){
+	if( len > arena->scratch_high_water ) arena->scratch_high_water = len;
+	if( len > arena->scratch_len ){
+		const unsigned int scratch_len = len + len/4 + 16;
+		unsigned int *s = (unsigned int*) realloc( arena->scratch, scratch_len*sizeof(unsigned int) );
+		arena->heap_allocs++;
+		if( s == NULL ) return NULL;
+		arena->scratch = s;
+		arena->scratch_len = scratch_len;
+	}
+	memset(arena->scratch, 0, len*sizeof(unsigned int));
+	return arena->scratch;
+}
+
 
 /* Eval height and number of children for each Node */
 void gen_redundant_information(Node * const root, unsigned int *pheight, unsigned int *psilbings){
@@ -84,6 +177,28 @@ void gen_redundant_information_recursive(Node* root, unsigned int *pheight, unsi
 }
 
 
+void add_child_indexed(Node * const root, Node *parent, Node *child,
+		unsigned int * const last_child){
+	unsigned int * const last = last_child + (parent-root);
+	if( *last == 0 ){
+		parent->child = child;
+	}else{
+		(root + *last)->silbing = child;
+	}
+	*last = child-root;
+	//set parent of child
+	child->parent = parent;
+
+	//update redundant information
+	parent->width++;
+	Node *p=parent, *c=child;
+	while( p != NULL && p->height < c->height+1 ){
+		p->height = c->height+1;
+		c=p;
+		p=p->parent;
+	}
+}
+
 void add_child(Node *parent, Node *child){
 	if( parent->child == NULL ){
 		parent->child = child;
@@ -274,12 +389,12 @@ unsigned int sum_areas(Node * const root, const unsigned int * const comp_size){
 	Node *node = root;
 	Blob* data = (Blob*)node->data;
 	if( root->child == NULL){
-		data->area = *(comp_size + data->id );
+		data->area = BLOB_COMP(comp_size, data->id);
 		return data->area;
 	}
 
 	do{
-		data->area = *(comp_size + data->id );
+		data->area = BLOB_COMP(comp_size, data->id);
 
 		/* Go to next node. update parent node on uprising flank */
 		if( node->child != NULL ){
@@ -315,7 +430,7 @@ unsigned int sum_areas(Node * const root, const unsigned int * const comp_size){
 	/* Recursive formulation */
     Blob* data = (Blob*)root->data;
 	int *val=&data->area;
-	*val = *(comp_size + data->id );
+	*val = BLOB_COMP(comp_size, data->id);
 	if( root->child != NULL) *val += sum_areas(root->child,comp_size);
 	if( root->silbing != NULL) return *val+sum_areas(root->silbing, comp_size);
 	else return *val;
@@ -378,12 +493,13 @@ unsigned int sum_areas(Node * const root, const unsigned int * const comp_size){
  * After all children of a node was processed the approimation
  * starts, which will replace node->data->area.
  *
+ * The temporary array will be taken from arena (or allocated if arena is NULL).
+ *
  * */
-static inline unsigned int number_of_coarse_roi(BlobtreeRect* roi, unsigned int sw, unsigned int sh);
-
 void approx_areas(const Tree * const tree, Node * const startnode,
 		const unsigned int * const comp_size,
-		const unsigned int stepwidth, const unsigned int stepheight)
+		const unsigned int stepwidth, const unsigned int stepheight,
+		TreeArena *arena)
 {
 
 	Node *node = startnode;
@@ -403,10 +519,13 @@ void approx_areas(const Tree * const tree, Node * const startnode,
 	 * need the root node of the tree as anchor (or doubles the array size)
 	 * to avoid access errors.
 	 * */
-	unsigned int * const pA_F = (unsigned int*) calloc(tree->size, sizeof(unsigned int) );
+	unsigned int * const pA_F = (arena != NULL)?
+		tree_arena_scratch(arena, tree->size):
+		(unsigned int*) calloc(tree->size, sizeof(unsigned int) );
+	if( pA_F == NULL ) return;
 
 	do{
-		data->area = *(comp_size + data->id );
+		data->area = BLOB_COMP(comp_size, data->id);
 
 		/* To to next node. update parent node on uprising flank */
 		if( node->child != NULL ){
@@ -415,11 +534,11 @@ void approx_areas(const Tree * const tree, Node * const startnode,
 			continue;
 		}
 
-		printf("Id: %u Roi: (%u,%u,%u,%u)\n",data->id,
+		VPRINTF("Id: %u Roi: (%u,%u,%u,%u)\n",data->id,
 				data->roi.x, data->roi.y, data->roi.width, data->roi.height);
 		const unsigned int N_C = number_of_coarse_roi(&data->roi, stepwidth, stepheight);
 		const unsigned int A_C = (data->roi.width*data->roi.height);
-		printf("N_C=%u, A_C=%u\n\n", N_C, A_C);
+		VPRINTF("N_C=%u, A_C=%u\n\n", N_C, A_C);
 
 
 		/* Update parent node. N_C,A_C of this level is part of N_F, A_F from parent*/
@@ -474,7 +593,7 @@ void approx_areas(const Tree * const tree, Node * const startnode,
 	}//while( node != startnode );
 	while( node->parent != root );
 
-	free( pA_F);
+	if( arena == NULL ) free( pA_F);
 }
 
 /* Returns the number of coarse pixels of a roi, see sketch for 
@@ -491,7 +610,7 @@ void approx_areas(const Tree * const tree, Node * const startnode,
 	 x - - - x - - - x -
 	 - - - - - - - - - -
 */
-static inline unsigned int number_of_coarse_roi(BlobtreeRect* roi, unsigned int sw, unsigned int sh){
+unsigned int number_of_coarse_roi(const BlobtreeRect* roi, unsigned int sw, unsigned int sh){
 	/* Note:
 	 * Three steps for each dimension of [a1,b1]x[a2,b2], a_i < b_i (not <= !)
 	 * 1. Shift roi to [0,b-a]
@@ -538,14 +657,14 @@ void eval_barycenters( Node *const start_node,
 	Blob *data = (Blob*)node->data;
 	Blob *parentdata;
 	if( node->child == NULL){
-		data->area = *(comp_size + data->id );
-		data->barycenter[0] = (*(pixel_sum_X + data->id )+(data->area>>1)) / data->area;
-		data->barycenter[1] = (*(pixel_sum_Y + data->id )+(data->area>>1)) / data->area;
+		data->area = BLOB_COMP(comp_size, data->id);
+		data->barycenter[0] = (BLOB_COMP(pixel_sum_X, data->id)+(data->area>>1)) / data->area;
+		data->barycenter[1] = (BLOB_COMP(pixel_sum_Y, data->id)+(data->area>>1)) / data->area;
 		return data->area;
 	}
 
 	do{
-		data->area = *(comp_size + data->id );
+		data->area = BLOB_COMP(comp_size, data->id);
 
 		/* Go to next node. update parent node on uprising flank */
 		if( node->child != NULL ){
@@ -556,18 +675,18 @@ void eval_barycenters( Node *const start_node,
 
 		//Node is Leaf
 #if 1
-		data->barycenter[0] = (*(pixel_sum_X + data->id )+(data->area>>1)) / data->area;
-		data->barycenter[1] = (*(pixel_sum_Y + data->id )+(data->area>>1)) / data->area;
+		data->barycenter[0] = (BLOB_COMP(pixel_sum_X, data->id)+(data->area>>1)) / data->area;
+		data->barycenter[1] = (BLOB_COMP(pixel_sum_Y, data->id)+(data->area>>1)) / data->area;
 #else
-		data->barycenter[0] = round( *(pixel_sum_X + data->id )*1.0 / data->area);
-		data->barycenter[1] = round( *(pixel_sum_Y + data->id )*1.0 / data->area);
+		data->barycenter[0] = round( BLOB_COMP(pixel_sum_X, data->id)*1.0 / data->area);
+		data->barycenter[1] = round( BLOB_COMP(pixel_sum_Y, data->id)*1.0 / data->area);
 #endif
 
 		//((Blob*)node->parent->data)->area += data->area;
 		parentdata = (Blob*)node->parent->data;
 		parentdata->area += data->area;
-		*(pixel_sum_X + parentdata->id ) += *(pixel_sum_X + data->id );
-		*(pixel_sum_Y + parentdata->id ) += *(pixel_sum_Y + data->id );
+		BLOB_COMP(pixel_sum_X, parentdata->id) += BLOB_COMP(pixel_sum_X, data->id);
+		BLOB_COMP(pixel_sum_Y, parentdata->id) += BLOB_COMP(pixel_sum_Y, data->id);
 
 		if( node->silbing != NULL ){
 			node = node->silbing;
@@ -581,18 +700,18 @@ void eval_barycenters( Node *const start_node,
 
 			// All children was handled 
 #if 1
-		data->barycenter[0] = (*(pixel_sum_X + data->id )+(data->area>>1)) / data->area;
-		data->barycenter[1] = (*(pixel_sum_Y + data->id )+(data->area>>1)) / data->area;
+		data->barycenter[0] = (BLOB_COMP(pixel_sum_X, data->id)+(data->area>>1)) / data->area;
+		data->barycenter[1] = (BLOB_COMP(pixel_sum_Y, data->id)+(data->area>>1)) / data->area;
 #else
-			data->barycenter[0] = round( *(pixel_sum_X + data->id )*1.0 / data->area);
-			data->barycenter[1] = round( *(pixel_sum_Y + data->id )*1.0 / data->area);
+			data->barycenter[0] = round( BLOB_COMP(pixel_sum_X, data->id)*1.0 / data->area);
+			data->barycenter[1] = round( BLOB_COMP(pixel_sum_Y, data->id)*1.0 / data->area);
 #endif
 
 			if(node->parent != root ){
 				parentdata = (Blob*)node->parent->data;
 				parentdata->area += data->area;
-				*(pixel_sum_X + parentdata->id ) += *(pixel_sum_X + data->id );
-				*(pixel_sum_Y + parentdata->id ) += *(pixel_sum_Y + data->id );
+				BLOB_COMP(pixel_sum_X, parentdata->id) += BLOB_COMP(pixel_sum_X, data->id);
+				BLOB_COMP(pixel_sum_Y, parentdata->id) += BLOB_COMP(pixel_sum_Y, data->id);
 			}
 			if( node->silbing != NULL ){
 				node = node->silbing;
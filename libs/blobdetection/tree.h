@@ -54,6 +54,66 @@ typedef struct Blob{
 } Blob;
 
 
+#if !defined(BLOB_COUNT_PIXEL) && !defined(BLOB_DIMENSION) && !defined(BLOB_BARYCENTER)
+/* No component properties to pack. */
+#undef BLOB_COMPONENT_RECORDS
+#endif
+
+#ifdef BLOB_COMPONENT_RECORDS
+/* Properties of one id, see BLOB_COMPONENT_RECORDS.
+ * The workspace pointers comp_size, top_index, … point to the fields
+ * of the first record. Thus, the stride of this arrays is sizeof(BlobComponent).
+ * */
+typedef struct {
+#ifdef BLOB_COUNT_PIXEL
+	unsigned int size;
+#endif
+#ifdef BLOB_DIMENSION
+	unsigned int top;
+	unsigned int left;
+	unsigned int right;
+	unsigned int bottom;
+#endif
+#ifdef BLOB_BARYCENTER
+	BLOB_BARYCENTER_TYPE sum_x;
+	BLOB_BARYCENTER_TYPE sum_y;
+#endif
+} BlobComponent;
+
+/* Access value of id in one of the component arrays (comp_size, top_index, …).*/
+#define BLOB_COMP(array, id) \
+	(*(__typeof__(&*(array))) ( (char*) (array) + (size_t)(id)*sizeof(BlobComponent) ))
+
+/* Set the component array pointers of a workspace on the
+ * fields of the records in ws->components. */
+#ifdef BLOB_COUNT_PIXEL
+#define BLOB_COMP_LINK_SIZE(ws) (ws)->comp_size = &(ws)->components->size;
+#else
+#define BLOB_COMP_LINK_SIZE(ws)
+#endif
+#ifdef BLOB_DIMENSION
+#define BLOB_COMP_LINK_DIMENSION(ws) \
+	(ws)->top_index = &(ws)->components->top; \
+	(ws)->left_index = &(ws)->components->left; \
+	(ws)->right_index = &(ws)->components->right; \
+	(ws)->bottom_index = &(ws)->components->bottom;
+#else
+#define BLOB_COMP_LINK_DIMENSION(ws)
+#endif
+#ifdef BLOB_BARYCENTER
+#define BLOB_COMP_LINK_BARY(ws) \
+	(ws)->pixel_sum_X = &(ws)->components->sum_x; \
+	(ws)->pixel_sum_Y = &(ws)->components->sum_y;
+#else
+#define BLOB_COMP_LINK_BARY(ws)
+#endif
+#define BLOB_COMP_LINK(ws) \
+	BLOB_COMP_LINK_SIZE(ws) BLOB_COMP_LINK_DIMENSION(ws) BLOB_COMP_LINK_BARY(ws)
+
+#else
+#define BLOB_COMP(array, id) (*((array)+(id)))
+#endif
+
 typedef struct {
 	Node *root; // root of tree. Required to release mem in tree_destroy(). 
 	unsigned int size;//length of data and root array.
@@ -68,6 +128,44 @@ Tree *tree_create(unsigned int size);
 /* Dealloc tree. Attention, target of data pointer is not free'd. */
 void tree_destroy(Tree **tree);
 
+/* Reusable storage for the result trees of the blob algorithms.
+ * The arrays grow on demand and will be kept between the images.
+ * Thus, the tree construction needs no heap operations
+ * if the number of blobs does not exceed the high water mark.
+ * The tree and blobs of the arena are valid until the next
+ * call of tree_arena_alloc. Do not call tree_destroy on them.
+ */
+typedef struct {
+	Tree tree;
+	Blob *blobs;
+	unsigned int capacity; //number of nodes and blobs.
+	unsigned int *scratch; //temporary array of tree algorithms.
+	unsigned int scratch_len;
+
+	//statistics
+	unsigned int nodes_high_water; //maximal requested number of nodes.
+	unsigned int scratch_high_water; //maximal requested length of scratch.
+	unsigned int heap_allocs; //number of (re)allocations.
+	unsigned int generation; //incremented by tree_arena_alloc.
+} TreeArena;
+
+void tree_arena_init(TreeArena *arena);
+void tree_arena_destroy(TreeArena *arena);
+
+/* Returns tree with size nodes (initialized as leafs) and the blob array.
+ * Returns NULL if the allocation fails. */
+Tree *tree_arena_alloc(TreeArena *arena, const unsigned int size, Blob **blobs);
+
+/* Grows the capacity of the arena to at least size nodes. Unlike
+ * tree_arena_alloc, the nodes of the tree will be kept. The pointers
+ * of the nodes will be moved into the new arrays.
+ * Returns NULL if the allocation fails. */
+Tree *tree_arena_reserve(TreeArena *arena, const unsigned int size);
+
+/* Returns zeroed array with len elements or NULL. The
+ * array is valid until the next call of tree_arena_scratch. */
+unsigned int *tree_arena_scratch(TreeArena *arena, const unsigned int len);
+
 /* Eval height and number of children for each Node */
 void gen_redundant_information(Node * const root, unsigned int *pheight, unsigned int *psilbings);
 
@@ -76,6 +174,12 @@ void gen_redundant_information_recursive(Node* root, unsigned int *pheight, unsi
 
 void add_child(Node *parent, Node *child);
 
+/* Like add_child, but without the search of the last silbing.
+ * last_child[i] stores the index of the last child of root[i]
+ * and has to be 0 before the first call. */
+void add_child_indexed(Node * const root, Node *parent, Node *child,
+		unsigned int * const last_child);
+
 unsigned int number_of_nodes(Node *root);
 
 /* Textual output of tree. Shift defines number of spaces at line beginning. */
@@ -187,8 +291,14 @@ unsigned int sum_areas(Node * const root, const unsigned int * const comp_size);
 #ifdef BLOB_DIMENSION
 void approx_areas(const Tree * const tree, Node * const startnode,
 		const unsigned int * const comp_size,
-		const unsigned int stepwidth, const unsigned int stepheight);
+		const unsigned int stepwidth, const unsigned int stepheight,
+		TreeArena *arena);
+#endif
 #endif
+
+#if defined(BLOB_COUNT_PIXEL) && defined(BLOB_DIMENSION)
+/* Returns the number of coarse pixels of a roi. */
+unsigned int number_of_coarse_roi(const BlobtreeRect* roi, unsigned int sw, unsigned int sh);
 #endif
 
 #ifdef BLOB_BARYCENTER
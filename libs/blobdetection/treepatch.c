@@ -0,0 +1,522 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "treepatch.h"
+
+void tree_patch_init(TreePatch *tp){
+	memset(tp, 0, sizeof(TreePatch));
+}
+
+void tree_patch_destroy(TreePatch *tp){
+	free(tp->nodes);
+	free(tp->state);
+	free(tp->free_nodes);
+	free(tp->flagged);
+	free(tp->moved);
+	free(tp->seeds);
+	free(tp->marked);
+	free(tp->tmp);
+	free(tp->cursor);
+	tree_patch_init(tp);
+}
+
+static bool tree_patch_grow(TreePatch *tp, const unsigned int capacity){
+	if( capacity <= tp->capacity ) return true;
+	void *p;
+#define TREE_PATCH_REALLOC(ARRAY) \
+	p = realloc(tp->ARRAY, capacity*sizeof(*tp->ARRAY)); \
+	if( p == NULL ) return false; \
+	tp->ARRAY = p;
+
+	TREE_PATCH_REALLOC(nodes)
+	TREE_PATCH_REALLOC(state)
+	TREE_PATCH_REALLOC(free_nodes)
+	TREE_PATCH_REALLOC(flagged)
+	TREE_PATCH_REALLOC(moved)
+	TREE_PATCH_REALLOC(seeds)
+	TREE_PATCH_REALLOC(marked)
+	TREE_PATCH_REALLOC(tmp)
+	TREE_PATCH_REALLOC(cursor)
+#undef TREE_PATCH_REALLOC
+	tp->capacity = capacity;
+	return true;
+}
+
+bool tree_patch_valid(const TreePatch *tp, const TreeArena *arena){
+	return tp->nodes != NULL && arena->tree.root != NULL
+		&& tp->generation == arena->generation
+		&& tp->capacity >= arena->capacity;
+}
+
+static void tree_patch_init_node(TreePatch *tp, const unsigned int node){
+	memset(tp->nodes+node, 0, sizeof(TreePatchNode));
+	(tp->nodes+node)->prev = UINT_MAX;
+	*(tp->state+node) = TREE_PATCH_ALIVE;
+}
+
+Tree *tree_patch_reset(TreePatch *tp, TreeArena *arena, const BlobtreeRect roi){
+	Blob *blobs;
+	Tree * const tree = tree_arena_alloc(arena, 1, &blobs);
+	if( tree == NULL || !tree_patch_grow(tp, arena->capacity) ){
+		return NULL;
+	}
+	tp->generation = arena->generation;
+	tp->num_free = 0;
+	tp->num_flagged = 0;
+	tp->num_moved = 0;
+	tp->num_seeds = 0;
+
+	//root node (the desired output are the child(ren) of this node.)
+	blobs->id = -1; /* = MAX_UINT */
+	memcpy( &blobs->roi, &roi, sizeof(BlobtreeRect) );
+	blobs->area = roi.width * roi.height;
+#ifdef SAVE_DEPTH_MAP_VALUE
+	blobs->depth_level = 0;
+#endif
+	tree->root->data = blobs;
+	tree_patch_init_node(tp, 0);
+	return tree;
+}
+
+unsigned int tree_patch_new_node(TreePatch *tp, TreeArena *arena){
+	unsigned int node;
+	if( tp->num_free > 0 ){
+		tp->num_free--;
+		node = *(tp->free_nodes+tp->num_free);
+	}else{
+		node = arena->tree.size;
+		if( tree_arena_reserve(arena, node+1) == NULL
+				|| !tree_patch_grow(tp, arena->capacity) ){
+			return UINT_MAX;
+		}
+		arena->tree.size++;
+	}
+
+	Node * const n = arena->tree.root+node;
+	*n = Leaf;
+	n->data = arena->blobs+node;
+	tree_patch_init_node(tp, node);
+	return node;
+}
+
+static inline void tree_patch_seed(TreePatch *tp, const unsigned int node){
+	unsigned char * const state = tp->state+node;
+	if( *state & TREE_PATCH_SEED ) return;
+	*state |= TREE_PATCH_SEED;
+	*(tp->seeds+tp->num_seeds) = node;
+	tp->num_seeds++;
+}
+
+#ifdef BLOB_DIMENSION
+/* True if box a lies on the border of box b. */
+static inline bool tree_patch_touches(const BlobtreeRect *a, const BlobtreeRect *b){
+	return a->x == b->x || a->y == b->y
+		|| a->x + a->width == b->x + b->width
+		|| a->y + a->height == b->y + b->height;
+}
+
+static inline bool tree_patch_contains(const BlobtreeRect *a, const BlobtreeRect *b){
+	return a->x <= b->x && a->y <= b->y
+		&& a->x + a->width >= b->x + b->width
+		&& a->y + a->height >= b->y + b->height;
+}
+
+static inline void tree_patch_union(BlobtreeRect *a, const BlobtreeRect *b){
+	const unsigned int x2 = ( a->x + a->width > b->x + b->width ) ?
+		a->x + a->width : b->x + b->width;
+	const unsigned int y2 = ( a->y + a->height > b->y + b->height ) ?
+		a->y + a->height : b->y + b->height;
+	if( a->x > b->x ) a->x = b->x;
+	if( a->y > b->y ) a->y = b->y;
+	a->width = x2 - a->x;
+	a->height = y2 - a->y;
+}
+#endif
+
+/* Add the values of the subtree of child to the sums of its new parent p.
+ * p->width has to include the child. */
+static void tree_patch_add_child(TreePatch *tp, Node * const root,
+		Node * const p, const Node * const child, const unsigned int options)
+{
+	TreePatchNode * const pp = tp->nodes+(p-root);
+	TreePatchNode * const pc = tp->nodes+(child-root);
+	unsigned char * const pstate = tp->state+(p-root);
+	pc->sub_height = child->height;
+#ifdef BLOB_COUNT_PIXEL
+	pp->child_size += pc->sub_size;
+#ifdef BLOB_DIMENSION
+	pp->child_raw += pc->sub_raw;
+	pp->child_area += pc->sub_area;
+#endif
+#endif
+#ifdef BLOB_BARYCENTER
+	pp->child_x += pc->sub_x;
+	pp->child_y += pc->sub_y;
+#endif
+	if( *pstate & TREE_PATCH_RESCAN ) return;
+	if( p->height < child->height+1 ){
+		p->height = child->height+1;
+		pp->num_max = 1;
+	}else if( p->height == child->height+1 ){
+		pp->num_max++;
+	}
+#ifdef BLOB_DIMENSION
+	if( options & TREE_PATCH_EXTEND_BOXES ){
+		if( *(tp->state+(child-root)) & TREE_PATCH_NEW_ROI ){
+			//the box of child will be added by tree_patch_eval.
+			if( p->width == 1 ) *pstate |= TREE_PATCH_RESCAN;
+		}else if( p->width == 1 ){
+			pp->child_roi = ((Blob*)child->data)->roi;
+		}else{
+			tree_patch_union(&pp->child_roi, &((Blob*)child->data)->roi);
+		}
+	}
+#endif
+}
+
+/* Subtract the values of the subtree of child from the sums of its parent p. */
+static void tree_patch_sub_child(TreePatch *tp, Node * const root,
+		Node * const p, const Node * const child, const unsigned int options)
+{
+	TreePatchNode * const pp = tp->nodes+(p-root);
+	const TreePatchNode * const pc = tp->nodes+(child-root);
+	unsigned char * const pstate = tp->state+(p-root);
+#ifdef BLOB_COUNT_PIXEL
+	pp->child_size -= pc->sub_size;
+#ifdef BLOB_DIMENSION
+	pp->child_raw -= pc->sub_raw;
+	pp->child_area -= pc->sub_area;
+#endif
+#endif
+#ifdef BLOB_BARYCENTER
+	pp->child_x -= pc->sub_x;
+	pp->child_y -= pc->sub_y;
+#endif
+	if( *pstate & TREE_PATCH_RESCAN ) return;
+	if( p->height == pc->sub_height+1 && --pp->num_max == 0 ){
+		*pstate |= TREE_PATCH_RESCAN;
+	}
+#ifdef BLOB_DIMENSION
+	if( (options & TREE_PATCH_EXTEND_BOXES)
+			&& !(*(tp->state+(child-root)) & TREE_PATCH_NEW_ROI)
+			&& tree_patch_touches(&((Blob*)child->data)->roi, &pp->child_roi) ){
+		*pstate |= TREE_PATCH_RESCAN;
+	}
+#endif
+}
+
+/* Unlink node from the children of its parent. */
+static void tree_patch_detach(TreePatch *tp, Node * const root,
+		const unsigned int node, const unsigned int options)
+{
+	Node * const n = root+node;
+	Node * const p = n->parent;
+	TreePatchNode * const pn = tp->nodes+node;
+	tree_patch_seed(tp, p-root);
+	tree_patch_sub_child(tp, root, p, n, options);
+	p->width--;
+	if( pn->prev == UINT_MAX ){
+		p->child = n->silbing;
+	}else{
+		(root+pn->prev)->silbing = n->silbing;
+	}
+	if( n->silbing != NULL ){
+		(tp->nodes+(n->silbing-root))->prev = pn->prev;
+	}
+	n->parent = NULL;
+	n->silbing = NULL;
+	pn->prev = UINT_MAX;
+}
+
+/* LSD radix sort of the nodes in list by values[node].
+ * Only the lowest bits of the values will be compared.
+ * tmp is an array of the same length. */
+static void tree_patch_sort(unsigned int *list, unsigned int *tmp,
+		const unsigned int len, const unsigned int *values,
+		const unsigned int bits)
+{
+	unsigned int count[256];
+	unsigned int *src = list, *dst = tmp, *swap;
+	unsigned int shift, l, sum;
+
+	for( shift=0; shift<bits; shift+=8 ){
+		memset(count, 0, sizeof(count));
+		for( l=0; l<len; l++){
+			count[ (*(values+*(src+l)) >> shift) & 0xFF ]++;
+		}
+		for( l=0, sum=0; l<256; l++){
+			const unsigned int c = count[l];
+			count[l] = sum;
+			sum += c;
+		}
+		for( l=0; l<len; l++){
+			const unsigned int v = *(src+l);
+			*(dst + count[ (*(values+v) >> shift) & 0xFF ]++) = v;
+		}
+		swap = src; src = dst; dst = swap;
+	}
+	if( src != list ) memcpy(list, src, len*sizeof(unsigned int));
+}
+
+/* Evaluate the values of node n from its own data and the sums of its
+ * children. The difference to the old values will be added to the parent. */
+static void tree_patch_eval(TreePatch *tp, Node * const root, Node * const n,
+		const unsigned int stepwidth, const unsigned int stepheight,
+		const unsigned int options)
+{
+	TreePatchNode * const pn = tp->nodes+(n-root);
+	unsigned char * const state = tp->state+(n-root);
+	Node *c;
+
+	if( *state & TREE_PATCH_RESCAN ){
+		n->height = 0;
+		pn->num_max = 0;
+		for( c=n->child; c!=NULL; c=c->silbing ){
+			(tp->nodes+(c-root))->sub_height = c->height;
+			if( n->height < c->height+1 ){
+				n->height = c->height+1;
+				pn->num_max = 1;
+			}else if( n->height == c->height+1 ){
+				pn->num_max++;
+			}
+#ifdef BLOB_DIMENSION
+			if( options & TREE_PATCH_EXTEND_BOXES ){
+				if( c == n->child ){
+					pn->child_roi = ((Blob*)c->data)->roi;
+				}else{
+					tree_patch_union(&pn->child_roi, &((Blob*)c->data)->roi);
+				}
+			}
+#endif
+		}
+		*state &= ~TREE_PATCH_RESCAN;
+	}
+	if( n == root ) return;
+
+	//old values of the subtree for the update of the parent.
+	Blob * const data = (Blob*)n->data;
+	const TreePatchNode old = *pn;
+#ifdef BLOB_DIMENSION
+	const BlobtreeRect old_roi = data->roi;
+#endif
+
+#ifdef BLOB_COUNT_PIXEL
+	pn->sub_size = pn->size + pn->child_size;
+	data->area = pn->sub_size;
+#endif
+#ifdef BLOB_BARYCENTER
+	pn->sub_x = pn->sum_x + pn->child_x;
+	pn->sub_y = pn->sum_y + pn->child_y;
+	data->barycenter[0] = (pn->sub_x + (pn->sub_size>>1)) / pn->sub_size;
+	data->barycenter[1] = (pn->sub_y + (pn->sub_size>>1)) / pn->sub_size;
+#endif
+#ifdef BLOB_DIMENSION
+	data->roi = pn->rect;
+	if( (options & TREE_PATCH_EXTEND_BOXES) && n->width > 0 ){
+		tree_patch_union(&data->roi, &pn->child_roi);
+	}
+#ifdef BLOB_COUNT_PIXEL
+	if( options & TREE_PATCH_APPROX_AREAS ){
+		/* See approx_areas. N_C,A_C of this level is part of N_F, A_F from parent. */
+		const unsigned int N_C = number_of_coarse_roi(&data->roi, stepwidth, stepheight);
+		const unsigned int A_C = data->roi.width*data->roi.height;
+		const unsigned int A_F = pn->child_area;
+		const unsigned int S = pn->size + pn->child_raw;
+		pn->sub_raw = (S << 1) - N_C;
+		pn->sub_area = A_C;
+		if( n->parent == root ){
+			//exact value for full image area
+			data->area = A_C;
+		}else if( N_C == 0 ){
+			data->area = 0;//area contains only subpixel
+		}else if( n->width == 0 ){
+			data->area = A_C * ((float)S/N_C) + 0.5f;
+		}else{
+			data->area = A_F + (A_C - A_F) * ((float)S/N_C) + 0.5f;
+		}
+	}
+#else
+	if( options & TREE_PATCH_BOX_AREAS ){
+		data->area = data->roi.width*data->roi.height;
+	}
+#endif
+#endif
+
+	//update parent
+	Node * const p = n->parent;
+	TreePatchNode * const pp = tp->nodes+(p-root);
+	unsigned char * const pstate = tp->state+(p-root);
+#ifdef BLOB_COUNT_PIXEL
+	pp->child_size += pn->sub_size - old.sub_size;
+#ifdef BLOB_DIMENSION
+	pp->child_raw += pn->sub_raw - old.sub_raw;
+	pp->child_area += pn->sub_area - old.sub_area;
+#endif
+#endif
+#ifdef BLOB_BARYCENTER
+	pp->child_x += pn->sub_x - old.sub_x;
+	pp->child_y += pn->sub_y - old.sub_y;
+#endif
+	if( !(*pstate & TREE_PATCH_RESCAN) && pn->sub_height != n->height ){
+		if( p->height == pn->sub_height+1 && --pp->num_max == 0 ){
+			*pstate |= TREE_PATCH_RESCAN;
+		}else if( p->height < n->height+1 ){
+			p->height = n->height+1;
+			pp->num_max = 1;
+		}else if( p->height == n->height+1 ){
+			pp->num_max++;
+		}
+	}
+	pn->sub_height = n->height;
+#ifdef BLOB_DIMENSION
+	if( (options & TREE_PATCH_EXTEND_BOXES) && !(*pstate & TREE_PATCH_RESCAN) ){
+		if( !(*state & TREE_PATCH_NEW_ROI)
+				&& !tree_patch_contains(&data->roi, &old_roi)
+				&& tree_patch_touches(&old_roi, &pp->child_roi) ){
+			*pstate |= TREE_PATCH_RESCAN;
+		}else{
+			tree_patch_union(&pp->child_roi, &data->roi);
+		}
+	}
+	*state &= ~TREE_PATCH_NEW_ROI;
+#endif
+}
+
+bool tree_patch_apply(TreePatch *tp, Tree *tree,
+		const unsigned int stepwidth, const unsigned int stepheight,
+		const unsigned int options)
+{
+	Node * const root = tree->root;
+	TreePatchNode * const nodes = tp->nodes;
+	unsigned char * const state = tp->state;
+	unsigned int l, num_marked = 0, max_depth = 0;
+
+	/* 1. Detach moved nodes. */
+	for( l=0; l<tp->num_moved; l++){
+		const unsigned int node = *(tp->moved+l);
+		if( (root+node)->parent != NULL ) tree_patch_detach(tp, root, node, options);
+	}
+
+	/* 2. Remove flagged nodes without new data. All children
+	 * of these nodes has to be moved or removed, too. */
+	for( l=0; l<tp->num_flagged; l++){
+		const unsigned int node = *(tp->flagged+l);
+		if( *(state+node) & TREE_PATCH_CHANGED ) continue;
+		if( *(state+node) & TREE_PATCH_MOVED ) return false;
+		if( (root+node)->parent != NULL ) tree_patch_detach(tp, root, node, options);
+	}
+	for( l=0; l<tp->num_flagged; l++){
+		const unsigned int node = *(tp->flagged+l);
+		if( *(state+node) & TREE_PATCH_CHANGED ) continue;
+		Node * const n = root+node;
+		if( n->child != NULL ) return false;
+		void * const data = n->data;
+		*n = Leaf;
+		n->data = data;
+		*(state+node) &= ~TREE_PATCH_ALIVE;
+		*(tp->free_nodes+tp->num_free) = node;
+		tp->num_free++;
+	}
+
+	/* 3. Attach moved nodes in the order of their keys. Thus,
+	 * the insertion position in the children of a parent
+	 * only moves forward. */
+	for( l=0; l<tp->num_moved; l++){
+		const unsigned int node = *(tp->moved+l);
+		*(tp->tmp+node) = (nodes+node)->key;
+	}
+	tree_patch_sort(tp->moved, tp->cursor, tp->num_moved, tp->tmp, 32);
+	for( l=0; l<tp->num_moved; l++){
+		*(tp->cursor + (nodes+*(tp->moved+l))->parent) = UINT_MAX;
+	}
+	for( l=0; l<tp->num_moved; l++){
+		const unsigned int node = *(tp->moved+l);
+		TreePatchNode * const pn = nodes+node;
+		const unsigned int parent = pn->parent;
+		Node * const n = root+node;
+		Node * const p = root+parent;
+		if( !(*(state+parent) & TREE_PATCH_ALIVE) ) return false;
+
+		const unsigned int cursor = *(tp->cursor+parent);
+		Node *prev = ( cursor == UINT_MAX ) ? NULL : root+cursor;
+		Node *c = ( prev == NULL ) ? p->child : prev->silbing;
+		while( c != NULL && (nodes+(c-root))->key < pn->key ){
+			prev = c;
+			c = c->silbing;
+		}
+
+		n->parent = p;
+		n->silbing = c;
+		if( prev == NULL ){
+			p->child = n;
+			pn->prev = UINT_MAX;
+		}else{
+			prev->silbing = n;
+			pn->prev = prev-root;
+		}
+		if( c != NULL ) (nodes+(c-root))->prev = node;
+		*(tp->cursor+parent) = node;
+
+		if( (options & TREE_PATCH_EXTEND_BOXES) && (*(state+node) & TREE_PATCH_CHANGED) ){
+			*(state+node) |= TREE_PATCH_NEW_ROI;
+		}
+		p->width++;
+		tree_patch_add_child(tp, root, p, n, options);
+		tree_patch_seed(tp, parent);
+	}
+
+	/* 4. Mark seeds and their ancestors and sort them by
+	 * their depth, deepest nodes first. */
+	for( l=0; l<tp->num_seeds; l++){
+		const unsigned int node = *(tp->seeds+l);
+		if( !(*(state+node) & TREE_PATCH_ALIVE) ) continue;
+		const Node *n = root+node;
+		while( n != NULL && !(*(state+(n-root)) & TREE_PATCH_MARKED) ){
+			*(state+(n-root)) |= TREE_PATCH_MARKED;
+			*(tp->marked+num_marked) = n-root;
+			num_marked++;
+			n = n->parent;
+		}
+	}
+	for( l=0; l<num_marked; l++){
+		const unsigned int node = *(tp->marked+l);
+		const Node *n = root+node;
+		unsigned int depth = 0;
+		while( n->parent != NULL ){
+			n = n->parent;
+			depth++;
+		}
+		if( depth > max_depth ) max_depth = depth;
+		*(tp->tmp+node) = depth;
+	}
+	for( l=0; l<num_marked; l++){
+		const unsigned int node = *(tp->marked+l);
+		*(tp->tmp+node) = max_depth - *(tp->tmp+node);
+	}
+	tree_patch_sort(tp->marked, tp->cursor, num_marked, tp->tmp,
+			( max_depth < 256 ) ? 8 : 32 );
+
+	/* 5. Evaluate the marked nodes. The children are handled before
+	 * their parents. */
+	for( l=0; l<num_marked; l++){
+		const unsigned int node = *(tp->marked+l);
+		tree_patch_eval(tp, root, root+node, stepwidth, stepheight, options);
+		*(state+node) &= ~TREE_PATCH_MARKED;
+	}
+
+	/* 6. Reset states for next image. */
+	for( l=0; l<tp->num_seeds; l++){
+		*(state+*(tp->seeds+l)) &= ~(TREE_PATCH_SEED|TREE_PATCH_CHANGED);
+	}
+	for( l=0; l<tp->num_flagged; l++){
+		*(state+*(tp->flagged+l)) &= ~TREE_PATCH_FLAGGED;
+	}
+	for( l=0; l<tp->num_moved; l++){
+		*(state+*(tp->moved+l)) &= ~TREE_PATCH_MOVED;
+	}
+	tp->num_seeds = 0;
+	tp->num_flagged = 0;
+	tp->num_moved = 0;
+	return true;
+}
@@ -0,0 +1,170 @@
+#ifndef TREEPATCH_H
+#define TREEPATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+#include "settings.h"
+#include "tree.h"
+
+/* Update of the tree of the last image.
+ *
+ * The nodes of unchanged components will be kept. Only new, changed and
+ * moved nodes and their ancestors will be evaluated again. The children
+ * of a node are ordered by the keys of the nodes (i.e. the position of
+ * the first pixel of the component). Thus, the tree equals the tree of
+ * the algorithms which build it from scratch.
+ *
+ * Usage for each image:
+ * 1. tree_patch_flag for all nodes whose components lose pixels.
+ * 2. tree_patch_new_node for new components and tree_patch_set_data
+ *    for new and changed components. Flagged nodes without new data
+ *    will be removed. The key of a kept node has to be constant.
+ * 3. tree_patch_set_parent for all nodes. Unchanged parents will be ignored.
+ * 4. tree_patch_apply
+ *
+ * The tree is stored in the arena of the blob struct. Nodes of removed
+ * components stay as holes in the node array (Leaf without parent) and
+ * will be reused for new components.
+ */
+
+typedef enum {
+	TREE_PATCH_ALIVE=1,
+	TREE_PATCH_FLAGGED=2,
+	TREE_PATCH_CHANGED=4,
+	TREE_PATCH_MOVED=8,
+	TREE_PATCH_MARKED=16,
+	TREE_PATCH_SEED=32,
+	TREE_PATCH_RESCAN=64, //height or child_roi of node requires loop over children.
+	TREE_PATCH_NEW_ROI=128, //roi of node is not part of child_roi of parent.
+} TREE_PATCH_STATE;
+
+typedef enum {
+	/* Approximate the areas like approx_areas (stepwidth>1). */
+	TREE_PATCH_APPROX_AREAS=1,
+	/* Use the area of the bounding box if BLOB_COUNT_PIXEL is not set. */
+	TREE_PATCH_BOX_AREAS=2,
+	/* Extend the bounding boxes like extend_bounding_boxes. */
+	TREE_PATCH_EXTEND_BOXES=4,
+} TREE_PATCH_OPTIONS;
+
+/* Data of one node. The caller sets the values of the component
+ * (size, rect, sum_*). The sums over the children (child_*) and
+ * the values of the subtree (sub_*) will be updated by tree_patch_apply.
+ * Thus, the parent of a changed node will be updated by the difference
+ * of the values without a loop over its other children. */
+typedef struct {
+	unsigned int key;
+	unsigned int prev; //previous silbing or UINT_MAX.
+	unsigned int parent; //new parent of moved nodes.
+	unsigned int num_max; //number of children with maximal height.
+	unsigned int sub_height; //height of the node in the sums of its parent.
+#ifdef BLOB_COUNT_PIXEL
+	unsigned int size;
+	unsigned int child_size;
+	unsigned int sub_size;
+#ifdef BLOB_DIMENSION
+	unsigned int child_raw, sub_raw; //sums of approx_areas (2*S - N_C).
+	unsigned int child_area, sub_area; //sums of bounding box areas (A_C).
+#endif
+#endif
+#ifdef BLOB_DIMENSION
+	BlobtreeRect rect;
+	BlobtreeRect child_roi; //union of the (extended) boxes of the children.
+#endif
+#ifdef BLOB_BARYCENTER
+	BLOB_BARYCENTER_TYPE sum_x, sum_y;
+	BLOB_BARYCENTER_TYPE child_x, child_y;
+	BLOB_BARYCENTER_TYPE sub_x, sub_y;
+#endif
+} TreePatchNode;
+
+typedef struct {
+	TreePatchNode *nodes;
+	unsigned char *state; //TREE_PATCH_STATE flags of the nodes.
+	unsigned int capacity; //length of nodes, state and the lists.
+	unsigned int generation; //generation of the arena of the patched tree.
+	unsigned int *free_nodes;
+	unsigned int num_free;
+	unsigned int *flagged;
+	unsigned int num_flagged;
+	unsigned int *moved;
+	unsigned int num_moved;
+	unsigned int *seeds; //nodes whose values has to be evaluated.
+	unsigned int num_seeds;
+	unsigned int *marked; //seeds and their ancestors.
+	unsigned int *tmp;
+	unsigned int *cursor; //last inserted child of each node.
+} TreePatch;
+
+void tree_patch_init(TreePatch *tp);
+void tree_patch_destroy(TreePatch *tp);
+
+/* True if the tree of the arena was created by tree_patch_apply. */
+bool tree_patch_valid(const TreePatch *tp, const TreeArena *arena);
+
+/* Drop all nodes. Only the root node (with roi) remains. */
+Tree *tree_patch_reset(TreePatch *tp, TreeArena *arena, const BlobtreeRect roi);
+
+/* Returns index of a new node (Leaf without parent) or UINT_MAX. */
+unsigned int tree_patch_new_node(TreePatch *tp, TreeArena *arena);
+
+static inline bool tree_patch_is_flagged(const TreePatch *tp, const unsigned int node){
+	return *(tp->state+node) & TREE_PATCH_FLAGGED;
+}
+
+static inline void tree_patch_flag(TreePatch *tp, const unsigned int node){
+	unsigned char * const state = tp->state+node;
+	if( *state & TREE_PATCH_FLAGGED ) return;
+	*state |= TREE_PATCH_FLAGGED;
+	*(tp->flagged+tp->num_flagged) = node;
+	tp->num_flagged++;
+}
+
+/* Mark node as changed. The caller has to set the component values
+ * of the returned struct. */
+static inline TreePatchNode *tree_patch_set_data(TreePatch *tp,
+		const unsigned int node, const unsigned int key)
+{
+	unsigned char * const state = tp->state+node;
+	*state |= TREE_PATCH_CHANGED;
+	if( !(*state & TREE_PATCH_SEED) ){
+		*state |= TREE_PATCH_SEED;
+		*(tp->seeds+tp->num_seeds) = node;
+		tp->num_seeds++;
+	}
+	TreePatchNode * const n = tp->nodes+node;
+	n->key = key;
+	return n;
+}
+
+static inline void tree_patch_set_parent(TreePatch *tp, const Tree *tree,
+		const unsigned int node, const unsigned int parent)
+{
+	if( (tree->root+node)->parent == tree->root+parent ) return;
+	unsigned char * const state = tp->state+node;
+	if( !(*state & TREE_PATCH_MOVED) ){
+		*state |= TREE_PATCH_MOVED;
+		*(tp->moved+tp->num_moved) = node;
+		tp->num_moved++;
+	}
+	(tp->nodes+node)->parent = parent;
+}
+
+/* Removes the flagged nodes without new data, moves the nodes and
+ * evaluates height, width, area, barycenter (and extended bounding box)
+ * of all changed nodes and their ancestors.
+ * stepwidth and stepheight are only used for TREE_PATCH_APPROX_AREAS.
+ * Returns false for an inconsistent patch. Call tree_patch_reset then. */
+bool tree_patch_apply(TreePatch *tp, Tree *tree,
+		const unsigned int stepwidth, const unsigned int stepheight,
+		const unsigned int options);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
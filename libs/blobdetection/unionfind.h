@@ -0,0 +1,76 @@
+#ifndef UNIONFIND_H
+#define UNIONFIND_H
+
+/* Union find on the comp_same arrays of the workspaces.
+ *
+ * comp_same(x) = x marks a root. All algorithms use the
+ * smallest id of a component as root. Thus, comp_same(x) <= x holds
+ * for every id, which is required by the *_build_tree functions
+ * (they resolve the roots in one ascending pass) and guarantees
+ * the same node order for every labeling variant.
+ *
+ * Because of this fixed root choice there is no union by rank/size.
+ * The path compression of the find functions keeps the chains short.
+ */
+
+/* Returns root of id. Path halving: every visited id will be
+ * linked to its grandparent. */
+static inline unsigned int uf_find(
+		unsigned int * const comp_same,
+		unsigned int id
+		){
+	while( *(comp_same+id) != id ){
+		*(comp_same+id) = *(comp_same+*(comp_same+id));
+		id = *(comp_same+id);
+	}
+	return id;
+}
+
+/* Returns root of id. Full path compression: every visited id
+ * will be linked to the root. */
+static inline unsigned int uf_find_compress(
+		unsigned int * const comp_same,
+		unsigned int id
+		){
+	unsigned int root = *(comp_same+id), next;
+	if( *(comp_same+root) == root ) return root;
+
+	while( *(comp_same+root) != root ) root = *(comp_same+root);
+	while( id != root ){
+		next = *(comp_same+id);
+		*(comp_same+id) = root;
+		id = next;
+	}
+	return root;
+}
+
+/* Join components of a and b. The smaller root will be the new root.
+ * Returns the new root. */
+static inline unsigned int uf_union(
+		unsigned int * const comp_same,
+		unsigned int a, unsigned int b
+		){
+	a = uf_find(comp_same, a);
+	b = uf_find(comp_same, b);
+	if( a<b ){
+		*(comp_same+b) = a;
+		return a;
+	}
+	*(comp_same+a) = b;
+	return b;
+}
+
+/* Final labels. Maps every id of [0, nids) directly on its root.
+ * Afterwards comp_same is a projection (comp_same^2 = comp_same).
+ * One ascending pass is enough because comp_same(x) <= x. */
+static inline void uf_flatten(
+		unsigned int * const comp_same,
+		const unsigned int nids
+		){
+	unsigned int k;
+	for( k=0; k<nids; k++){
+		*(comp_same+k) = *(comp_same+*(comp_same+k));
+	}
+}
+
+#endif
@@ -0,0 +1,135 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "settings.h"
+#include "workers.h"
+
+static void *blob_worker_loop( void *arg ){
+	BlobWorker * const worker = (BlobWorker*) arg;
+	BlobWorkers * const pool = worker->pool;
+
+	pthread_mutex_lock(&pool->mutex);
+	while( 1 ){
+		while( !pool->quit && pool->generation == worker->seen ){
+			pthread_cond_wait(&pool->start, &pool->mutex);
+		}
+		if( pool->quit ) break;
+		worker->seen = pool->generation;
+
+		/* Workers without job of this generation wait for the next one. */
+		const unsigned int job = pool->first + 1 + worker->index;
+		if( job >= pool->num_jobs ) continue;
+		const BlobWorkerFunc func = pool->func;
+		void * const job_arg = pool->jobs + job*pool->job_size;
+
+		pthread_mutex_unlock(&pool->mutex);
+		func(job_arg);
+		pthread_mutex_lock(&pool->mutex);
+
+		if( --pool->pending == 0 ){
+			pthread_cond_signal(&pool->done);
+		}
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+bool blob_workers_create(
+		const unsigned int num_workers,
+		BlobWorkers **ppool )
+{
+	if( *ppool != NULL ){
+		if( (*ppool)->num_workers == num_workers ) return true;
+		blob_workers_destroy( ppool );
+	}
+	if( num_workers == 0 ) return false;
+
+	BlobWorkers *pool = (BlobWorkers*) calloc( 1, sizeof(BlobWorkers) );
+	if( pool == NULL ) return false;
+	pool->workers = (BlobWorker*) calloc( num_workers, sizeof(BlobWorker) );
+	if( pool->workers == NULL ){
+		free(pool);
+		return false;
+	}
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	/* num_workers counts the running threads. Thus, the pool
+	 * can be destroyed on partial start. */
+	unsigned int k;
+	for( k=0; k<num_workers; k++){
+		BlobWorker * const worker = pool->workers+k;
+		worker->pool = pool;
+		worker->index = k;
+		if( 0 != pthread_create(&worker->thread, NULL, blob_worker_loop, worker) ){
+			VPRINTF("Critical error: Start of worker thread failed!\n");
+			blob_workers_destroy( &pool );
+			return false;
+		}
+		pool->num_workers++;
+	}
+
+	*ppool = pool;
+	return true;
+}
+
+void blob_workers_destroy( BlobWorkers **ppool ){
+	if( *ppool == NULL ) return;
+	BlobWorkers *pool = *ppool;
+	unsigned int k;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->mutex);
+	for( k=0; k<pool->num_workers; k++){
+		pthread_join((pool->workers+k)->thread, NULL);
+	}
+
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool->workers);
+	free(pool);
+	*ppool = NULL;
+}
+
+void blob_workers_run(
+		BlobWorkers *pool,
+		BlobWorkerFunc func,
+		void *jobs, const size_t job_size,
+		const unsigned int first, const unsigned int num_jobs )
+{
+	char * const j = (char*) jobs;
+	unsigned int k, num_pooled = 0;
+
+	if( pool != NULL && first+1 < num_jobs ){
+		num_pooled = num_jobs - first - 1;
+		if( num_pooled > pool->num_workers ) num_pooled = pool->num_workers;
+
+		pthread_mutex_lock(&pool->mutex);
+		pool->func = func;
+		pool->jobs = j;
+		pool->job_size = job_size;
+		pool->first = first;
+		pool->num_jobs = first + 1 + num_pooled;
+		pool->pending = num_pooled;
+		pool->generation++;
+		pthread_cond_broadcast(&pool->start);
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	func( j + first*job_size );
+	for( k=first+1+num_pooled; k<num_jobs; k++){
+		func( j + k*job_size );
+	}
+
+	if( num_pooled > 0 ){
+		pthread_mutex_lock(&pool->mutex);
+		while( pool->pending > 0 ){
+			pthread_cond_wait(&pool->done, &pool->mutex);
+		}
+		pthread_mutex_unlock(&pool->mutex);
+	}
+}
@@ -0,0 +1,71 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/* Persistent threads for the parallel labeling of strips.
+ *
+ * The threads will be created once and wait on a condition variable
+ * between the calls of blob_workers_run. Thus, the labeling of a
+ * frame costs no pthread_create/pthread_join.
+ */
+
+typedef void *(*BlobWorkerFunc)(void *arg);
+
+typedef struct BlobWorkers BlobWorkers;
+
+typedef struct {
+	BlobWorkers *pool;
+	unsigned int index; // worker i runs job first+1+i.
+	unsigned int seen; // last handled generation.
+	pthread_t thread;
+} BlobWorker;
+
+struct BlobWorkers {
+	unsigned int num_workers;
+	BlobWorker *workers;
+	pthread_mutex_t mutex;
+	pthread_cond_t start; // signaled on new jobs or quit.
+	pthread_cond_t done; // signaled if pending reaches 0.
+	unsigned int generation; // incremented for every blob_workers_run call.
+	unsigned int pending; // number of running jobs of the workers.
+	bool quit;
+
+	// Jobs of the current generation
+	BlobWorkerFunc func;
+	char *jobs;
+	size_t job_size;
+	unsigned int first, num_jobs;
+};
+
+/* Start num_workers threads. An existing pool with the same number
+ * of threads will be kept. Returns false if not all threads could
+ * be started. Then, *ppool is NULL. */
+bool blob_workers_create(
+		const unsigned int num_workers,
+		BlobWorkers **ppool );
+
+void blob_workers_destroy( BlobWorkers **ppool );
+
+/* Call func for the jobs first, …, num_jobs-1 of the array jobs
+ * (elements of job_size bytes). Job 'first' runs in the calling thread,
+ * all others on the workers. Returns after all jobs are finished.
+ * Without pool (NULL) or for too many jobs, the calling thread runs
+ * the remaining jobs. */
+void blob_workers_run(
+		BlobWorkers *pool,
+		BlobWorkerFunc func,
+		void *jobs, const size_t job_size,
+		const unsigned int first, const unsigned int num_jobs );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
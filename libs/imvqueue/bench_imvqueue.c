@@ -0,0 +1,146 @@
+/* Synthetic producer/consumer test of imvqueue.
+ *
+ * The producer thread simulates the camera and pushes numbered frames
+ * with a fixed frame rate. The consumer simulates the blob detection
+ * with a fixed processing time per frame. If the consumer is slower
+ * than the producer, frames will be dropped.
+ *
+ * Checks that the consumer gets increasing frame numbers with
+ * unchanged content and that no frame gets lost without counting.
+ *
+ * With retained=1 the producer queues malloc'd frames without copying
+ * (imvqueue_push_retained), like the zero copy mode of RaspiImv.
+ * Checks that each frame will be released once.
+ *
+ * Usage: bench_imvqueue [frames] [producer fps] [consumer us per frame] [queue len] [retained]
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "imvqueue.h"
+
+#define FRAME_LEN (121*68*4)
+
+static IMV_QUEUE queue;
+static unsigned int num_frames = 1000;
+static unsigned int fps = 1000;
+static unsigned int consumer_us = 500;
+static volatile int producer_done = 0;
+static int retained = 0;
+static unsigned int released = 0;
+
+static void release_frame(void *handle){
+	free(handle);
+	__atomic_add_fetch(&released, 1, __ATOMIC_RELAXED);
+}
+
+static unsigned long long now_us(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/* Frame content: number, timestamp and a pattern depending on the number. */
+static void fill_frame(char *buf, unsigned int n){
+	const unsigned long long t = now_us();
+	memcpy(buf, &n, sizeof(n));
+	memcpy(buf+sizeof(n), &t, sizeof(t));
+	memset(buf+sizeof(n)+sizeof(t), (char)n, FRAME_LEN-sizeof(n)-sizeof(t));
+}
+
+static int check_frame(const char *buf, unsigned int *n, unsigned long long *t){
+	size_t i;
+	memcpy(n, buf, sizeof(*n));
+	memcpy(t, buf+sizeof(*n), sizeof(*t));
+	for( i=sizeof(*n)+sizeof(*t); i<FRAME_LEN; i++){
+		if( buf[i] != (char)*n ) return 0;
+	}
+	return 1;
+}
+
+static void *producer(void *arg){
+	unsigned int n;
+	const unsigned long long period = 1000000 / fps;
+	unsigned long long next = now_us();
+	for( n=1; n<=num_frames; n++){
+		if( retained ){
+			char *frame = (char*) malloc(FRAME_LEN);
+			fill_frame(frame, n);
+			imvqueue_push_retained(&queue, frame, release_frame, frame);
+		}else{
+			fill_frame(imvqueue_write_buffer(&queue), n);
+			imvqueue_push(&queue);
+		}
+		next += period;
+		const unsigned long long t = now_us();
+		if( next > t ) usleep(next - t);
+	}
+	__atomic_store_n(&producer_done, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+int main(int argc, char **argv){
+	unsigned int len = 3;
+	if( argc > 1 ) num_frames = atoi(argv[1]);
+	if( argc > 2 ) fps = atoi(argv[2]);
+	if( argc > 3 ) consumer_us = atoi(argv[3]);
+	if( argc > 4 ) len = atoi(argv[4]);
+	if( argc > 5 ) retained = atoi(argv[5]);
+	if( fps == 0 ) fps = 1;
+
+	if( imvqueue_init(&queue, len, FRAME_LEN) ){
+		fprintf(stderr, "Allocation failed.\n");
+		return -1;
+	}
+
+	pthread_t tid;
+	pthread_create(&tid, NULL, &producer, NULL);
+
+	unsigned int last = 0, received = 0, errors = 0;
+	unsigned long long latency_sum = 0, latency_max = 0;
+	while( 1 ){
+		const char *frame = imvqueue_pop(&queue, 100);
+		if( frame == NULL ){
+			if( __atomic_load_n(&producer_done, __ATOMIC_ACQUIRE) ) break;
+			continue;
+		}
+		unsigned int n;
+		unsigned long long t;
+		const unsigned long long latency = now_us();
+		if( !check_frame(frame, &n, &t) || n <= last ){
+			fprintf(stderr, "Corrupted frame %u after frame %u\n", n, last);
+			++errors;
+		}
+		last = n;
+		++received;
+		latency_sum += latency - t;
+		if( latency - t > latency_max ) latency_max = latency - t;
+		if( consumer_us ) usleep(consumer_us);
+	}
+	pthread_join(tid, NULL);
+
+	IMVQUEUE_STATS stats;
+	imvqueue_stats(&queue, &stats);
+	printf("frames=%u received=%u pushed=%llu popped=%llu dropped=%llu"
+			" latency_mean_us=%.1f latency_max_us=%llu errors=%u\n",
+			num_frames, received, stats.pushed, stats.popped, stats.dropped,
+			received?(double)latency_sum/received:0.0, latency_max, errors);
+
+	if( stats.pushed != num_frames
+			|| stats.popped != received
+			|| stats.popped + stats.dropped != stats.pushed
+			|| last != num_frames ){
+		fprintf(stderr, "Counters do not match.\n");
+		++errors;
+	}
+	imvqueue_uninit(&queue);
+	if( retained && released != num_frames ){
+		fprintf(stderr, "Released %u of %u frames.\n", released, num_frames);
+		++errors;
+	}
+	return errors?1:0;
+}
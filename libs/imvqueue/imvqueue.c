@@ -0,0 +1,175 @@
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "imvqueue.h"
+
+#define IMVQUEUE_NONE ((unsigned int)-1)
+
+#define LOAD(p, order) __atomic_load_n(p, __ATOMIC_##order)
+#define STORE(p, v, order) __atomic_store_n(p, v, __ATOMIC_##order)
+#define COUNT(p) __atomic_add_fetch(p, 1, __ATOMIC_RELAXED)
+
+static inline unsigned long long imvqueue_clock_ms(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static inline void futex_wait(unsigned int *addr, unsigned int val, int timeout_ms){
+	struct timespec ts;
+	ts.tv_sec = timeout_ms / 1000;
+	ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, (timeout_ms<0)?NULL:&ts, NULL, 0);
+}
+
+static inline void futex_wake(unsigned int *addr){
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+/* Hands back external memory and switch index to own buffer. */
+static inline void imvqueue_recycle(IMV_QUEUE *q, unsigned int index){
+	IMVQUEUE_FRAME *f = &q->frames[index];
+	if( f->release != NULL ){
+		f->release(f->handle);
+		f->release = NULL;
+		f->handle = NULL;
+	}
+	f->data = q->buffers[index];
+}
+
+int imvqueue_init(IMV_QUEUE *q, unsigned int len, size_t buffer_len){
+	unsigned int i;
+	memset(q, 0, sizeof(IMV_QUEUE));
+	if( len < 1 ) len = 1;
+	if( len > IMVQUEUE_MAX_LEN ) len = IMVQUEUE_MAX_LEN;
+
+	q->memory = (char*) malloc( (len+2) * buffer_len );
+	if( q->memory == NULL ){
+		return -1;
+	}
+	q->len = len;
+	q->buffer_len = buffer_len;
+	for( i=0; i<len+2; i++){
+		q->buffers[i] = q->memory + i*buffer_len;
+		q->frames[i].data = q->buffers[i];
+	}
+
+	/* Buffer 0 belongs to the producer, all other buffers are free. */
+	q->write_index = 0;
+	q->read_index = IMVQUEUE_NONE;
+	for( i=1; i<len+2; i++){
+		q->free_slots[i-1] = i;
+	}
+	q->free_head = len+1;
+	return 0;
+}
+
+void imvqueue_uninit(IMV_QUEUE *q){
+	unsigned int i;
+	for( i=0; i<q->len+2; i++){
+		imvqueue_recycle(q, i);
+	}
+	free(q->memory);
+	q->memory = NULL;
+	q->len = 0;
+}
+
+char *imvqueue_write_buffer(IMV_QUEUE *q){
+	return q->buffers[q->write_index];
+}
+
+void imvqueue_push(IMV_QUEUE *q){
+	const unsigned int h = q->head;
+	unsigned int next = IMVQUEUE_NONE;
+
+	/* Drop oldest frame if the queue is full. If the CAS fails,
+	 * the consumer had popped a frame and there is space now. */
+	unsigned int t = LOAD(&q->tail, ACQUIRE);
+	while( h - t >= q->len ){
+		const unsigned int oldest = LOAD(&q->slots[t % q->len], RELAXED);
+		if( __atomic_compare_exchange_n(&q->tail, &t, t+1, 0,
+					__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ){
+			next = oldest;
+			imvqueue_recycle(q, next);
+			COUNT(&q->stats.dropped);
+			break;
+		}
+	}
+
+	STORE(&q->slots[h % q->len], q->write_index, RELAXED);
+	STORE(&q->head, h+1, SEQ_CST);
+	COUNT(&q->stats.pushed);
+
+	if( __atomic_exchange_n(&q->waiting, 0, __ATOMIC_SEQ_CST) ){
+		futex_wake(&q->head);
+	}
+
+	/* New write buffer. The consumer holds at most one buffer, thus
+	 * the free list is not empty if no frame was dropped. */
+	if( next == IMVQUEUE_NONE ){
+		const unsigned int ft = q->free_tail;
+		while( LOAD(&q->free_head, ACQUIRE) == ft ){ }
+		next = q->free_slots[ft % (q->len+2)];
+		STORE(&q->free_tail, ft+1, RELEASE);
+	}
+	q->write_index = next;
+}
+
+void imvqueue_push_retained(IMV_QUEUE *q, const char *data,
+		IMVQUEUE_RELEASE release, void *handle){
+	IMVQUEUE_FRAME *f = &q->frames[q->write_index];
+	f->data = data;
+	f->release = release;
+	f->handle = handle;
+	imvqueue_push(q);
+}
+
+const char *imvqueue_pop(IMV_QUEUE *q, int timeout_ms){
+	const unsigned long long deadline = imvqueue_clock_ms() + (timeout_ms<0?0:timeout_ms);
+	while( 1 ){
+		unsigned int t = LOAD(&q->tail, ACQUIRE);
+		const unsigned int h = LOAD(&q->head, ACQUIRE);
+
+		if( h == t ){
+			int remaining = -1;
+			if( timeout_ms >= 0 ){
+				const unsigned long long now = imvqueue_clock_ms();
+				if( now >= deadline ) return NULL;
+				remaining = deadline - now;
+			}
+			STORE(&q->waiting, 1, SEQ_CST);
+			if( LOAD(&q->head, SEQ_CST) == h ){
+				futex_wait(&q->head, h, remaining);
+			}
+			continue;
+		}
+
+		/* Return previous frame before the new one will be taken. */
+		if( q->read_index != IMVQUEUE_NONE ){
+			imvqueue_recycle(q, q->read_index);
+			const unsigned int fh = q->free_head;
+			q->free_slots[fh % (q->len+2)] = q->read_index;
+			STORE(&q->free_head, fh+1, RELEASE);
+			q->read_index = IMVQUEUE_NONE;
+		}
+
+		const unsigned int index = LOAD(&q->slots[t % q->len], RELAXED);
+		if( __atomic_compare_exchange_n(&q->tail, &t, t+1, 0,
+					__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ){
+			q->read_index = index;
+			COUNT(&q->stats.popped);
+			return q->frames[index].data;
+		}
+		// Frame was dropped by the producer. Try again.
+	}
+}
+
+void imvqueue_stats(IMV_QUEUE *q, IMVQUEUE_STATS *stats){
+	stats->pushed = LOAD(&q->stats.pushed, RELAXED);
+	stats->popped = LOAD(&q->stats.popped, RELAXED);
+	stats->dropped = LOAD(&q->stats.dropped, RELAXED);
+}
@@ -0,0 +1,110 @@
+/* Bounded single-producer/single-consumer queue of frame buffers.
+ *
+ * All buffers will be allocated by imvqueue_init. The producer
+ * (MMAL callback) fills its write buffer and pushes it. The consumer
+ * (blob detection thread) pops the oldest pushed buffer and can read
+ * it until the next pop.
+ * If the queue is full, the producer drops the oldest frame, thus
+ * the consumer always gets the newest frames.
+ *
+ * Usage:
+ * 	// Producer
+ * 	memcpy(imvqueue_write_buffer(&q), data, len);
+ * 	imvqueue_push(&q);
+ *
+ * 	// Consumer
+ * 	const char *frame = imvqueue_pop(&q, 100); // Waits up to 100ms
+ * 	if( frame != NULL ){ ... }
+ *
+ * The indices are atomic (no locks), the consumer sleeps
+ * on a futex if the queue is empty.
+ *
+ * Zero copy: Instead of filling the write buffer, the producer can
+ * queue external memory with imvqueue_push_retained. The release
+ * function will be called if the consumer is done with the frame
+ * (next pop) or if the frame was dropped. Thus, it can be called
+ * by both threads.
+ * */
+#ifndef IMVQUEUE_H
+#define IMVQUEUE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdlib.h>
+
+/* Maximal number of frames in the queue. */
+#define IMVQUEUE_MAX_LEN 16
+
+/* Returns external memory of imvqueue_push_retained, see above. */
+typedef void (*IMVQUEUE_RELEASE)(void *handle);
+
+/* Frame content of a buffer index. */
+typedef struct {
+	const char *data; // own buffer or external memory
+	IMVQUEUE_RELEASE release; // NULL for own buffer
+	void *handle;
+} IMVQUEUE_FRAME;
+
+typedef struct {
+	unsigned long long pushed; // frames pushed by the producer
+	unsigned long long popped; // frames returned to the consumer
+	unsigned long long dropped; // oldest frames overwritten by the producer
+} IMVQUEUE_STATS;
+
+typedef struct {
+	size_t buffer_len;
+	unsigned int len; // capacity of the queue
+	char *memory; // len+2 buffers
+	char *buffers[IMVQUEUE_MAX_LEN+2];
+	IMVQUEUE_FRAME frames[IMVQUEUE_MAX_LEN+2];
+
+	/* Queued buffer indices: slots[tail%len], ..., slots[(head-1)%len].
+	 * head will only be written by the producer. tail will
+	 * be increased by the consumer (pop) and the producer (drop). */
+	unsigned int slots[IMVQUEUE_MAX_LEN];
+	unsigned int head, tail;
+	unsigned int waiting; // consumer waits on futex of head.
+
+	/* Returned buffers of the consumer: free_slots[free_tail%(len+2)], ... */
+	unsigned int free_slots[IMVQUEUE_MAX_LEN+2];
+	unsigned int free_head, free_tail;
+
+	unsigned int write_index; // owned by producer
+	unsigned int read_index; // owned by consumer
+
+	IMVQUEUE_STATS stats;
+} IMV_QUEUE;
+
+/* Allocates len+2 buffers of buffer_len bytes.
+ * Returns 0 on success. */
+int imvqueue_init(IMV_QUEUE *q, unsigned int len, size_t buffer_len);
+/* Releases the external frames, too. */
+void imvqueue_uninit(IMV_QUEUE *q);
+
+/* Producer side */
+char *imvqueue_write_buffer(IMV_QUEUE *q);
+/* Queue the write buffer, drop the oldest frame if the queue is full
+ * and wake up the consumer. */
+void imvqueue_push(IMV_QUEUE *q);
+/* Queue data without copying. release(handle) will be called
+ * if the frame is not needed anymore. */
+void imvqueue_push_retained(IMV_QUEUE *q, const char *data,
+		IMVQUEUE_RELEASE release, void *handle);
+
+/* Consumer side */
+/* Returns the oldest queued frame, which is valid until the next call.
+ * Waits timeout_ms milliseconds (<0: infinite) if the queue is empty
+ * and returns NULL if no frame arrives. */
+const char *imvqueue_pop(IMV_QUEUE *q, int timeout_ms);
+
+/* Counters of the queue. Can be called from every thread. */
+void imvqueue_stats(IMV_QUEUE *q, IMVQUEUE_STATS *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
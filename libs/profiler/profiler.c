@@ -0,0 +1,188 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "profiler.h"
+
+/* Bucket k<8 holds the value k. Above, every power of two
+ * is split into 8 buckets. 2^40ns ≈ 18 minutes is enough. */
+#define PROFILER_SUB_BITS 3
+#define PROFILER_SUB (1<<PROFILER_SUB_BITS)
+#define PROFILER_BUCKETS ((40-PROFILER_SUB_BITS+1)*PROFILER_SUB)
+
+typedef struct {
+	pthread_mutex_t mutex;
+	unsigned long long start; // timestamp of profiler_begin
+	unsigned long long window[PROFILER_WINDOW]; // ring buffer of durations
+	unsigned int pos; // next position in window
+	unsigned int count; // used entries of window
+	unsigned long long total;
+	unsigned long long sum; // sum of window
+	unsigned int hist[PROFILER_BUCKETS];
+} ProfilerStage;
+
+static ProfilerStage profiler_stages[PROFILER_NUM_STAGES] = {
+	[0 ... PROFILER_NUM_STAGES-1] = { .mutex = PTHREAD_MUTEX_INITIALIZER }
+};
+
+static const char *profiler_names[PROFILER_NUM_STAGES] = {
+	"frame", "norm", "blobs", "tracker", "gestures", "eval_ids", "gl" };
+
+static FILE *profiler_stream = NULL;
+static unsigned int profiler_period = 500;
+static PROFILER_OUTPUT profiler_format = PROFILER_OUTPUT_TEXT;
+static unsigned int profiler_frame = 0;
+
+static inline unsigned long long profiler_clock(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline unsigned int profiler_bucket(unsigned long long ns){
+	if( ns < PROFILER_SUB ) return ns;
+	const unsigned int msb = 63 - __builtin_clzll(ns);
+	const unsigned int sub = (ns >> (msb-PROFILER_SUB_BITS)) & (PROFILER_SUB-1);
+	const unsigned int k = (msb-PROFILER_SUB_BITS+1)*PROFILER_SUB + sub;
+	return (k<PROFILER_BUCKETS)?k:PROFILER_BUCKETS-1;
+}
+
+/* Center of the bucket */
+static inline double profiler_bucket_value(const unsigned int k){
+	if( k < PROFILER_SUB ) return k;
+	const unsigned int msb = k/PROFILER_SUB + PROFILER_SUB_BITS - 1;
+	const unsigned long long width = 1ULL << (msb-PROFILER_SUB_BITS);
+	const unsigned long long lower = (PROFILER_SUB + k%PROFILER_SUB) * width;
+	return lower + 0.5*width;
+}
+
+void profiler_init(FILE *stream, const unsigned int period, const PROFILER_OUTPUT format){
+	profiler_stream = stream;
+	profiler_period = (period>0)?period:1;
+	profiler_format = format;
+	profiler_frame = 0;
+}
+
+void profiler_reset(){
+	unsigned int s;
+	for( s=0; s<PROFILER_NUM_STAGES; s++){
+		ProfilerStage * const stage = &profiler_stages[s];
+		pthread_mutex_lock(&stage->mutex);
+		stage->pos = 0;
+		stage->count = 0;
+		stage->total = 0;
+		stage->sum = 0;
+		memset(stage->hist, 0, sizeof(stage->hist));
+		pthread_mutex_unlock(&stage->mutex);
+	}
+}
+
+void profiler_begin(const PROFILER_STAGE stage){
+	profiler_stages[stage].start = profiler_clock();
+}
+
+void profiler_end(const PROFILER_STAGE stage){
+	profiler_add(stage, profiler_clock() - profiler_stages[stage].start);
+}
+
+void profiler_add(const PROFILER_STAGE s, const unsigned long long ns){
+	ProfilerStage * const stage = &profiler_stages[s];
+	pthread_mutex_lock(&stage->mutex);
+	if( stage->count == PROFILER_WINDOW ){
+		//remove oldest duration
+		const unsigned long long old = stage->window[stage->pos];
+		stage->hist[profiler_bucket(old)]--;
+		stage->sum -= old;
+	}else{
+		stage->count++;
+	}
+	stage->window[stage->pos] = ns;
+	stage->hist[profiler_bucket(ns)]++;
+	stage->sum += ns;
+	stage->total++;
+	if( ++stage->pos == PROFILER_WINDOW ) stage->pos = 0;
+	pthread_mutex_unlock(&stage->mutex);
+}
+
+bool profiler_stats(const PROFILER_STAGE s, ProfilerStats *stats){
+	ProfilerStage * const stage = &profiler_stages[s];
+	unsigned int k, n;
+	memset(stats, 0, sizeof(ProfilerStats));
+
+	pthread_mutex_lock(&stage->mutex);
+	if( stage->count == 0 ){
+		pthread_mutex_unlock(&stage->mutex);
+		return false;
+	}
+	unsigned long long max = 0;
+	for( k=0; k<stage->count; k++){
+		if( stage->window[k] > max ) max = stage->window[k];
+	}
+
+	//ranks of the percentiles (1-based)
+	const unsigned int r50 = (stage->count+1)/2;
+	const unsigned int r99 = stage->count - stage->count/100;
+	double p50 = -1.0, p99 = -1.0;
+	for( k=0, n=0; k<PROFILER_BUCKETS; k++){
+		n += stage->hist[k];
+		if( p50 < 0 && n >= r50 ) p50 = profiler_bucket_value(k);
+		if( n >= r99 ){
+			p99 = profiler_bucket_value(k);
+			break;
+		}
+	}
+
+	stats->count = stage->count;
+	stats->total = stage->total;
+	stats->max_us = max/1000.0;
+	stats->p50_us = (p50<max?p50:max)/1000.0;
+	stats->p99_us = (p99<max?p99:max)/1000.0;
+	stats->mean_us = stage->sum/(1000.0*stage->count);
+	pthread_mutex_unlock(&stage->mutex);
+	return true;
+}
+
+const char *profiler_stage_name(const PROFILER_STAGE stage){
+	return (stage<PROFILER_NUM_STAGES)?profiler_names[stage]:"unknown";
+}
+
+void profiler_dump(FILE *stream){
+	ProfilerStats stats;
+	unsigned int s;
+	fprintf(stream, "%-10s %8s %9s %9s %9s %9s\n",
+			"stage", "count", "p50[us]", "p99[us]", "max[us]", "mean[us]");
+	for( s=0; s<PROFILER_NUM_STAGES; s++){
+		if( !profiler_stats((PROFILER_STAGE) s, &stats) ) continue;
+		fprintf(stream, "%-10s %8u %9.1f %9.1f %9.1f %9.1f\n",
+				profiler_names[s], stats.count,
+				stats.p50_us, stats.p99_us, stats.max_us, stats.mean_us );
+	}
+}
+
+void profiler_dump_json(FILE *stream){
+	ProfilerStats stats;
+	unsigned int s;
+	bool first = true;
+	fprintf(stream, "{\"frame\": %u, \"stages\": {", profiler_frame);
+	for( s=0; s<PROFILER_NUM_STAGES; s++){
+		if( !profiler_stats((PROFILER_STAGE) s, &stats) ) continue;
+		fprintf(stream, "%s\"%s\": {\"count\": %u, \"total\": %llu, "
+				"\"p50_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f, \"mean_us\": %.1f}",
+				first?"":", ", profiler_names[s], stats.count, stats.total,
+				stats.p50_us, stats.p99_us, stats.max_us, stats.mean_us );
+		first = false;
+	}
+	fprintf(stream, "}}\n");
+}
+
+void profiler_next_frame(){
+	profiler_frame++;
+	if( profiler_stream == NULL || profiler_frame%profiler_period != 0 ) return;
+	if( profiler_format == PROFILER_OUTPUT_JSON ){
+		profiler_dump_json(profiler_stream);
+	}else{
+		profiler_dump(profiler_stream);
+	}
+	fflush(profiler_stream);
+}
@@ -0,0 +1,100 @@
+/* Timing of the stages of the blob detection pipeline.
+ *
+ * Every stage keeps a rolling histogram of the last PROFILER_WINDOW
+ * durations. The histogram buckets are logarithmic (8 buckets per
+ * power of two), thus the percentiles have a relative error below 7%.
+ * The maximum is exact.
+ *
+ * Usage:
+ * 	PROFILE_BEGIN(PROFILER_NORM);
+ * 	imv_eval_norm2(&motion_data);
+ * 	PROFILE_END(PROFILER_NORM);
+ * 	...
+ * 	PROFILE_NEXT_FRAME(); // prints statistics every n-th frame.
+ *
+ * The macros are empty if WITH_PROFILING is not defined
+ * (cmake option WITH_PROFILING).
+ *
+ * A stage should only be measured by one thread. The statistics
+ * can be read from every thread.
+ * */
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/* Number of durations in the rolling window of each stage. */
+#define PROFILER_WINDOW 1024
+
+typedef enum {
+	PROFILER_FRAME=0, // whole iteration of the blob detection thread
+	PROFILER_NORM, // imv vectors to norm
+	PROFILER_BLOBS, // *_find_blobs
+	PROFILER_TRACKER, // trackBlobs
+	PROFILER_GESTURES, // gesture recognition
+	PROFILER_EVAL_IDS, // debug output of ids
+	PROFILER_GL, // texture update and drawing in the gl thread
+	PROFILER_NUM_STAGES
+} PROFILER_STAGE;
+
+typedef enum {
+	PROFILER_OUTPUT_TEXT=0,
+	PROFILER_OUTPUT_JSON=1
+} PROFILER_OUTPUT;
+
+typedef struct {
+	unsigned int count; // number of durations in the window.
+	unsigned long long total; // number of all durations since last reset.
+	double p50_us;
+	double p99_us;
+	double max_us;
+	double mean_us; // mean of the window.
+} ProfilerStats;
+
+/* Setup of the periodic output of profiler_next_frame.
+ * stream - Target of output, NULL disables the output.
+ * period - Number of frames between two outputs.
+ * */
+void profiler_init(FILE *stream, const unsigned int period, const PROFILER_OUTPUT format);
+
+/* Clear all histograms. */
+void profiler_reset();
+
+void profiler_begin(const PROFILER_STAGE stage);
+void profiler_end(const PROFILER_STAGE stage);
+/* Add a duration which was measured elsewhere. */
+void profiler_add(const PROFILER_STAGE stage, const unsigned long long ns);
+
+/* Returns false if no duration was added to the stage. */
+bool profiler_stats(const PROFILER_STAGE stage, ProfilerStats *stats);
+
+const char *profiler_stage_name(const PROFILER_STAGE stage);
+
+/* Print statistics of all used stages. */
+void profiler_dump(FILE *stream);
+void profiler_dump_json(FILE *stream);
+
+/* Count frames and print statistics every period frames. */
+void profiler_next_frame();
+
+#ifdef WITH_PROFILING
+#define PROFILE_BEGIN(STAGE) profiler_begin(STAGE)
+#define PROFILE_END(STAGE) profiler_end(STAGE)
+#define PROFILE_NEXT_FRAME() profiler_next_frame()
+#else
+#define PROFILE_BEGIN(STAGE)
+#define PROFILE_END(STAGE)
+#define PROFILE_NEXT_FRAME()
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,18 +1,15 @@
 //#include "RaspiVid.h"
-#include "norm2.h"
+#include "imv_norm.h"
 #include "RaspiImv.h"
 
-MOTION_DATA motion_data = {0, NULL, NULL, 0,0,0,0 };
+MOTION_DATA motion_data;
 
 int init_motion_data(MOTION_DATA *md, RASPIVID_STATE *state){
-	
-	//prefill some global arrays for fast 2-norm evaluation.
-	norm2_init_arrays();
 
 	md->width = (state->width+15)/16 + 1;//1920 => 121
 	md->height = (state->height+15)/16;
-	md->available = 0;
-	md->mutex = 0;
+	md->imv_array_buffer = NULL;
+	md->accum.field = NULL;
 
 	//md->imv_array_len = 120*68*4;
 	if( md->width < 0 || md->height < 0 ){
@@ -20,11 +17,10 @@ int init_motion_data(MOTION_DATA *md, RASPIVID_STATE *state){
 		return -2;
 	}
 	md->imv_array_len = md->width * md->height;
-	md->imv_array_in = (char*) malloc( md->imv_array_len * sizeof(INLINE_MOTION_VECTOR) );
-	md->imv_array_buffer = (char*) malloc( md->imv_array_len * sizeof(INLINE_MOTION_VECTOR) );
 	md->imv_norm = (unsigned char*) malloc( md->imv_array_len );
-	if( md->imv_array_in == NULL
-			|| md->imv_array_buffer == NULL 
+	if( imvqueue_init(&md->queue, IMV_QUEUE_LEN,
+				md->imv_array_len * sizeof(INLINE_MOTION_VECTOR))
+			|| imv_accum_init(&md->accum, md->imv_array_len, state->imv_decay, IMV_MAX_CARRY)
 			|| md->imv_norm == NULL )
 	{
 		uninit_motion_data(md, state);
@@ -35,70 +31,59 @@ int init_motion_data(MOTION_DATA *md, RASPIVID_STATE *state){
 
 void uninit_motion_data(MOTION_DATA *md, RASPIVID_STATE *state){
 	md->imv_array_len = 0;
-	free( md->imv_array_in); md->imv_array_in = NULL;
-	free( md->imv_array_buffer); md->imv_array_buffer = NULL;
+	imvqueue_uninit(&md->queue);
+	imv_accum_uninit(&md->accum);
+	md->imv_array_buffer = NULL;
 	free( md->imv_norm); md->imv_norm = NULL;
 }
 
 //uses global var.
 void handle_imv_data(char *data, size_t data_len){
 	if( data_len <= motion_data.imv_array_len * sizeof(INLINE_MOTION_VECTOR) ){
-		memcpy( motion_data.imv_array_in, data, data_len);
-		while(motion_data.mutex){}
-		motion_data.mutex = 1;
-		motion_data.available = 1;
-		motion_data.mutex = 0;
+		memcpy( imvqueue_write_buffer(&motion_data.queue), data, data_len);
+		imvqueue_push(&motion_data.queue);
 	}
 }
 
-/* Eval 1-norm of imv vector. 
- * Note: x=y=128 (signed char) will be mapped on 0=256 (unsigned char), 
- * but this motion will not occur.
- * */
-void imv_eval_norm(MOTION_DATA *md){
-	INLINE_MOTION_VECTOR *curImv = (INLINE_MOTION_VECTOR*) md->imv_array_buffer; 
-	INLINE_MOTION_VECTOR *curImvEnd = curImv+md->imv_array_len;
-	unsigned char* curNorm = md->imv_norm;
+static void release_imv_buffer(void *handle){
+	MMAL_BUFFER_HEADER_T *buffer = (MMAL_BUFFER_HEADER_T*) handle;
+	mmal_buffer_header_mem_unlock(buffer);
+	mmal_buffer_header_release(buffer);
+}
 
-#if 0
-#if 0
-	int j,i,J,I;
-	for( j=0,J=md->height; j<J; ++j){
-		for( i=0,I=md->width-1; i<I; ++i){
-			curNorm[i+(md->width-1)*j] = abs(curImv[i+md->width*j].x_vector)
-				+ abs(curImv[i+md->width*j].y_vector);
-		}
-	}
-#else
-	int j,i,J,I;
-	for( j=0,J=md->height; j<J; ++j){
-		for( i=0,I=md->width; i<I; ++i){
-			curNorm[i+(md->width)*j] = abs(curImv[i+md->width*j].x_vector)
-				+ abs(curImv[i+md->width*j].y_vector);
-		}
-	}
-#endif
-#else
-	while( curImv<curImvEnd ){
-		*curNorm = abs(curImv->x_vector) + abs(curImv->y_vector);
-		++curImv;
-		++curNorm;
+//uses global var.
+void handle_imv_buffer(MMAL_BUFFER_HEADER_T *buffer){
+	if( buffer->length <= motion_data.imv_array_len * sizeof(INLINE_MOTION_VECTOR) ){
+		/* Keep the buffer after the encoder callback returns. */
+		mmal_buffer_header_acquire(buffer);
+		mmal_buffer_header_mem_lock(buffer);
+		imvqueue_push_retained(&motion_data.queue, (const char*) buffer->data,
+				release_imv_buffer, buffer);
 	}
-#endif
+}
 
+int motion_data_wait(MOTION_DATA *md, int timeout_ms){
+	const char *frame = imvqueue_pop(&md->queue, timeout_ms);
+	if( frame == NULL ) return 0;
+	md->imv_array_buffer = (md->accum.decay>0)?imv_accum_update(&md->accum, frame):frame;
+	return 1;
+}
+
+/* Eval 1-norm of imv vector. 
+ * Note: x=y=128 (signed char) will be mapped on 255.
+ * */
+void imv_eval_norm(MOTION_DATA *md){
+	imv_norm_l1(md->imv_array_buffer, md->imv_norm, md->imv_array_len);
 }
 
 /* Eval 2-norm of imv vector. 
  * */
 void imv_eval_norm2(MOTION_DATA *md){
-	INLINE_MOTION_VECTOR *curImv = (INLINE_MOTION_VECTOR*) md->imv_array_buffer; 
-	INLINE_MOTION_VECTOR *curImvEnd = curImv+md->imv_array_len;
-	unsigned char* curNorm = md->imv_norm;
-
-	while( curImv<curImvEnd ){
-		*curNorm = norm2(curImv->x_vector,curImv->y_vector);
-		++curImv;
-		++curNorm;
-	}
+	imv_norm_l2(md->imv_array_buffer, md->imv_norm, md->imv_array_len);
+}
 
+/* Eval 2-norm of imv vector, but ignore vectors with a sad above max_sad.
+ * */
+void imv_eval_norm_sad(MOTION_DATA *md, unsigned short max_sad){
+	imv_norm_sad(md->imv_array_buffer, md->imv_norm, md->imv_array_len, max_sad);
 }
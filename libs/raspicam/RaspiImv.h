@@ -43,6 +43,19 @@ extern "C"
 #include <string.h>
 
 #include "RaspiVid.h"
+#include "imvqueue.h"
+#include "imv_accum.h"
+
+/* Number of frames which can wait for the blob detection.
+ * If the detection is too slow, the oldest frames will be dropped. */
+#define IMV_QUEUE_LEN 2
+
+/* Temporal filter of the vectors, see imv_accum.h.
+ * Disabled by default because it costs an extra pass over each frame.
+ * Enable it by -vectorsDecay <1-255>, e.g. 160. */
+#define IMV_DECAY_DEFAULT 0
+/* Skip single I-frames */
+#define IMV_MAX_CARRY 1
 
 typedef struct
 {
@@ -54,23 +67,32 @@ typedef struct
 typedef struct 
 {
 	size_t imv_array_len;
-	char *imv_array_in; //target array for video process
-	char *imv_array_buffer; // source array for blob detection. Will be swapped with imv_array.
+	IMV_QUEUE queue; // frames of the video process
+	const char *imv_array_buffer; // source array for blob detection, see motion_data_wait.
+	IMV_ACCUM accum; // filtered vectors
 	unsigned char *imv_norm;
 	size_t width;
 	size_t height;
-	char available; // 1 - New data from video process available
-	char mutex; // mutex for array pointer swapping
 } MOTION_DATA;
 
 extern MOTION_DATA motion_data;// = motion_data_init;
 
 void handle_imv_data(char *data, size_t data_len);
+/* Zero copy variant of handle_imv_data. The encoder buffer will be
+ * queued itself and released after the detection (next motion_data_wait)
+ * or if it was dropped. */
+void handle_imv_buffer(MMAL_BUFFER_HEADER_T *buffer);
 
 int init_motion_data(MOTION_DATA *md, RASPIVID_STATE *state);
 void uninit_motion_data(MOTION_DATA *md, RASPIVID_STATE *state);
+/* Take the next frame of the video process as imv_array_buffer.
+ * If the filter is enabled, imv_array_buffer points to the accumulated vectors.
+ * Waits up to timeout_ms milliseconds. Returns 0 if no frame arrives. */
+int motion_data_wait(MOTION_DATA *md, int timeout_ms);
 void imv_eval_norm(MOTION_DATA *md);
 void imv_eval_norm2(MOTION_DATA *md);
+/* 2-norm, vectors with sad > max_sad are set to 0 (noise rejection). */
+void imv_eval_norm_sad(MOTION_DATA *md, unsigned short max_sad);
 
 
 
@@ -151,6 +151,8 @@ static void display_valid_parameters(char *app_name);
 #define CommandWaitAndFix   24
 #define CommandGL           25
 #define CommandGLCapture    26
+#define CommandIMVZeroCopy  27
+#define CommandIMVDecay     28
 
 static COMMAND_LIST cmdline_commands[] =
 {
@@ -181,6 +183,8 @@ static COMMAND_LIST cmdline_commands[] =
    { CommandWaitAndFix,    "-waitAndFix", "waf","Wait <t>ms before capture, fix AGC afterwards", 1},
    { CommandGL,      "-gl",         "g",  "Draw preview to texture instead of using video render component", 0},
    { CommandGLCapture, "-glcapture","gc", "Capture the GL frame-buffer instead of the camera image", 0},
+   { CommandIMVZeroCopy, "-vectorsZeroCopy","xz", "Pass inline motion vectors to the detection without copying", 0},
+   { CommandIMVDecay, "-vectorsDecay","xd", "Accumulate motion vectors with decay <0-255>/256 per frame. 0 to disable. Default 0 (off)", 1},
 };
 
 static int cmdline_commands_size = sizeof(cmdline_commands) / sizeof(cmdline_commands[0]);
@@ -246,6 +250,8 @@ static void default_status(RASPIVID_STATE *state)
 
    state->inlineMotionVectors = 0;
 	 state->callback_data.imv_handler =  handle_imv_data;
+	 state->callback_data.imv_buffer_handler =  NULL;
+	 state->imv_decay = IMV_DECAY_DEFAULT;
 
 	 state->waitAndFix = 0;
 	 state->fixWait = 0;
@@ -595,6 +601,21 @@ static int parse_cmdline(int argc, const char **argv, RASPIVID_STATE *state)
          break;
       }
 
+      case CommandIMVZeroCopy:
+      {
+         state->callback_data.imv_buffer_handler = handle_imv_buffer;
+         break;
+      }
+
+      case CommandIMVDecay:
+      {
+         if (sscanf(argv[i + 1], "%u", &state->imv_decay) == 1 && state->imv_decay < 256)
+            i++;
+         else
+            valid = 0;
+         break;
+      }
+
       case CommandIMV:  // output filename
       {
          state->inlineMotionVectors = 1;
@@ -975,7 +996,10 @@ static void encoder_buffer_callback(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buf
                {
 								 //bytes_written = fwrite(buffer->data, 1, buffer->length, pData->imv_file_handle);
 								 //memcpy( pData->imv_array, buffer->data, buffer->length);
-								 pData->imv_handler( buffer->data, buffer->length);
+								 if( pData->imv_buffer_handler )
+									 pData->imv_buffer_handler( buffer );
+								 else
+									 pData->imv_handler( buffer->data, buffer->length);
 								 bytes_written = buffer->length;
                }
                else
@@ -1273,6 +1297,10 @@ static MMAL_STATUS_T create_encoder_component(RASPIVID_STATE *state)
    if (encoder_output->buffer_num < encoder_output->buffer_num_min)
       encoder_output->buffer_num = encoder_output->buffer_num_min;
 
+   // Buffers with motion vectors can be held by the detection thread, see handle_imv_buffer.
+   if (state->callback_data.imv_buffer_handler)
+      encoder_output->buffer_num += IMV_QUEUE_LEN + 1;
+
    // We need to set the frame rate on output to 0, to ensure it gets
    // updated correctly from the input framerate when port connected
    encoder_output->format->es->video.frame_rate.num = 0;
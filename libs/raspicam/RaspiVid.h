@@ -30,6 +30,8 @@ typedef struct RASPIVID_STATE_S RASPIVID_STATE;
 
 //Callback prototype for motion data handling
 typedef void (*MOTION_CALLBACK)(char* data, size_t data_len);
+//Zero copy variant. The callback can keep the buffer (mmal_buffer_header_acquire)
+typedef void (*MOTION_BUFFER_CALLBACK)(MMAL_BUFFER_HEADER_T *buffer);
 
 
 /** Struct used to pass information in encoder port userdata to callback
@@ -52,6 +54,7 @@ typedef struct
    int  header_wptr;
    FILE *imv_file_handle;               /// File handle to write inline motion vectors to.
 	 MOTION_CALLBACK imv_handler;
+	 MOTION_BUFFER_CALLBACK imv_buffer_handler; /// Used instead of imv_handler if set.
 } PORT_USERDATA;
 
 /** Structure containing all state information for the current run
@@ -103,6 +106,7 @@ struct RASPIVID_STATE_S
 
    int inlineMotionVectors;             /// Encoder outputs inline Motion Vectors
    char *imv_filename;                  /// filename of inline Motion Vectors output
+   unsigned int imv_decay;              /// decay of the vector filter (0-255, 0: off), see imv_accum.h
 
 	 int waitAndFix;
 	 int fixWait;
@@ -0,0 +1,170 @@
+/* Temporal filter of inline motion vectors, 16 vectors at a time.
+ * See imv_accum.h
+ */
+#include <string.h>
+
+#include "imv_accum.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+int imv_accum_init(IMV_ACCUM *a, size_t len, unsigned int decay, unsigned int max_carry){
+	a->len = len;
+	a->decay = (decay>255)?255:decay;
+	a->max_carry = max_carry;
+	a->carried = 0;
+	if( a->decay == 0 ){
+		// Disabled filter
+		a->field = NULL;
+		return 0;
+	}
+	a->field = (char*) calloc(len, 4);
+	return (a->field == NULL)?-1:0;
+}
+
+void imv_accum_uninit(IMV_ACCUM *a){
+	free(a->field);
+	a->field = NULL;
+	a->len = 0;
+}
+
+int imv_is_empty(const char *imv, size_t n){
+	size_t i;
+	for( i=0; i<n; ++i){
+		if( imv[4*i] | imv[4*i+1] ) return 0;
+	}
+	return 1;
+}
+
+const char *imv_accum_update(IMV_ACCUM *a, const char *imv){
+	if( a->field == NULL ) return imv; // disabled
+	if( imv_is_empty(imv, a->len) && a->carried < a->max_carry ){
+		++a->carried;
+		return a->field;
+	}
+	a->carried = 0;
+	imv_accum_max(imv, a->field, a->len, a->decay);
+	return a->field;
+}
+
+/* v*decay/256, rounded towards zero. */
+static inline int decay_q8(const int v, const int decay){
+	const int t = v*decay;
+	return (t<0)?-((-t)>>8):(t>>8);
+}
+
+void imv_accum_max_ref(const char *imv, char *acc, size_t n, unsigned int decay){
+	size_t i;
+	for( i=0; i<n; ++i){
+		const int x = (signed char)imv[4*i], y = (signed char)imv[4*i+1];
+		const int ax = decay_q8((signed char)acc[4*i], decay);
+		const int ay = decay_q8((signed char)acc[4*i+1], decay);
+		if( x*x + y*y >= ax*ax + ay*ay ){
+			memcpy(acc + 4*i, imv + 4*i, 4);
+		}else{
+			acc[4*i] = ax;
+			acc[4*i+1] = ay;
+		}
+	}
+}
+
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+/* vld4 deinterleaves 16 vectors into x, y, sad low and sad high bytes. */
+
+static inline int8x16_t decay_16(const int8x16_t v, const int16x8_t decay){
+	const int16x8_t tlo = vmulq_s16(vmovl_s8(vget_low_s8(v)), decay);
+	const int16x8_t thi = vmulq_s16(vmovl_s8(vget_high_s8(v)), decay);
+	/* Add 255 to negative values to round towards zero. */
+	const int16x8_t rlo = vshrq_n_s16(vaddq_s16(tlo,
+				vandq_s16(vshrq_n_s16(tlo, 15), vdupq_n_s16(255))), 8);
+	const int16x8_t rhi = vshrq_n_s16(vaddq_s16(thi,
+				vandq_s16(vshrq_n_s16(thi, 15), vdupq_n_s16(255))), 8);
+	return vcombine_s8(vmovn_s16(rlo), vmovn_s16(rhi));
+}
+
+/* x*x+y*y <= 2^15, thus the unsigned interpretation is correct. */
+#define NEON_SQR_LO(x, y) vreinterpretq_u16_s16( vmlal_s8( \
+			vmull_s8(vget_low_s8(x), vget_low_s8(x)), vget_low_s8(y), vget_low_s8(y)) )
+#define NEON_SQR_HI(x, y) vreinterpretq_u16_s16( vmlal_s8( \
+			vmull_s8(vget_high_s8(x), vget_high_s8(x)), vget_high_s8(y), vget_high_s8(y)) )
+
+static inline void max_16(const char *imv, char *acc, const int16x8_t decay){
+	const uint8x16x4_t v = vld4q_u8((const uint8_t*)imv);
+	const uint8x16x4_t a = vld4q_u8((const uint8_t*)acc);
+	const int8x16_t x = vreinterpretq_s8_u8(v.val[0]);
+	const int8x16_t y = vreinterpretq_s8_u8(v.val[1]);
+	const int8x16_t ax = decay_16(vreinterpretq_s8_u8(a.val[0]), decay);
+	const int8x16_t ay = decay_16(vreinterpretq_s8_u8(a.val[1]), decay);
+	const uint8x16_t keep = vcombine_u8(
+			vmovn_u16(vcgtq_u16(NEON_SQR_LO(ax, ay), NEON_SQR_LO(x, y))),
+			vmovn_u16(vcgtq_u16(NEON_SQR_HI(ax, ay), NEON_SQR_HI(x, y))) );
+	uint8x16x4_t r;
+	r.val[0] = vbslq_u8(keep, vreinterpretq_u8_s8(ax), v.val[0]);
+	r.val[1] = vbslq_u8(keep, vreinterpretq_u8_s8(ay), v.val[1]);
+	r.val[2] = vbslq_u8(keep, a.val[2], v.val[2]);
+	r.val[3] = vbslq_u8(keep, a.val[3], v.val[3]);
+	vst4q_u8((uint8_t*)acc, r);
+}
+
+void imv_accum_max(const char *imv, char *acc, size_t n, unsigned int decay){
+	const int16x8_t d = vdupq_n_s16(decay);
+	size_t i;
+	for( i=0; i+16<=n; i+=16){
+		max_16(imv + 4*i, acc + 4*i, d);
+	}
+	imv_accum_max_ref(imv + 4*i, acc + 4*i, n - i, decay);
+}
+
+#elif defined(__SSE2__)
+/* Each 32 bit lane holds one vector. The low 16 bits of
+ * x16 and y16 are the sign extended components, see imv_norm.c */
+#define SSE2_X16(v) _mm_srai_epi16(_mm_slli_epi16(v, 8), 8)
+#define SSE2_Y16(v) _mm_srai_epi16(v, 8)
+
+/* v*decay/256, rounded towards zero. */
+static inline __m128i decay_4(const __m128i v, const __m128i decay){
+	const __m128i t = _mm_mullo_epi16(v, decay);
+	const __m128i s = _mm_srai_epi16(t, 15);
+	const __m128i r = _mm_srli_epi16(_mm_sub_epi16(_mm_xor_si128(t, s), s), 8);
+	return _mm_sub_epi16(_mm_xor_si128(r, s), s);
+}
+
+static inline __m128i sqr_4(const __m128i x, const __m128i y){
+	return _mm_and_si128( _mm_add_epi16(_mm_mullo_epi16(x, x), _mm_mullo_epi16(y, y)),
+			_mm_set1_epi32(0xFFFF) );
+}
+
+static inline __m128i max_4(const __m128i v, const __m128i a, const __m128i decay){
+	const __m128i ax = decay_4(SSE2_X16(a), decay);
+	const __m128i ay = decay_4(SSE2_Y16(a), decay);
+	const __m128i keep = _mm_cmpgt_epi32(sqr_4(ax, ay), sqr_4(SSE2_X16(v), SSE2_Y16(v)));
+	/* Decayed vector with the sad of the accumulator */
+	const __m128i xy = _mm_or_si128( _mm_and_si128(ax, _mm_set1_epi16(0x00FF)),
+			_mm_slli_epi16(ay, 8) );
+	const __m128i d = _mm_or_si128( _mm_and_si128(xy, _mm_set1_epi32(0xFFFF)),
+			_mm_andnot_si128(_mm_set1_epi32(0xFFFF), a) );
+	return _mm_or_si128(_mm_and_si128(keep, d), _mm_andnot_si128(keep, v));
+}
+
+#define SSE2_LOAD(p, k) _mm_loadu_si128((const __m128i*)(p) + (k))
+#define SSE2_MAX(k) _mm_storeu_si128((__m128i*)(acc) + (k), \
+		max_4(SSE2_LOAD(imv, k), SSE2_LOAD(acc, k), d))
+
+void imv_accum_max(const char *imv, char *acc, size_t n, unsigned int decay){
+	const __m128i d = _mm_set1_epi16(decay);
+	size_t i;
+	for( i=0; i+16<=n; i+=16, imv+=64, acc+=64){
+		SSE2_MAX(0); SSE2_MAX(1); SSE2_MAX(2); SSE2_MAX(3);
+	}
+	imv_accum_max_ref(imv, acc, n - i, decay);
+}
+
+#else
+void imv_accum_max(const char *imv, char *acc, size_t n, unsigned int decay){
+	imv_accum_max_ref(imv, acc, n, decay);
+}
+#endif
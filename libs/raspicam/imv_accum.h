@@ -0,0 +1,61 @@
+/* Temporal filter of inline motion vectors.
+ *
+ * The raw vector field is noisy and the I-frames of the encoder
+ * contain no motion at all. The accumulator holds a decayed maximum
+ * of the last fields:
+ *
+ * 	acc = (|v| >= |decay*acc|) ? v : decay*acc
+ *
+ * for each vector v of the new frame. decay is a fixed point factor
+ * with 8 fractional bits (0-255, e.g. 192 = 0.75). The components
+ * will be rounded towards zero, thus old motion vanishes after a
+ * few frames. The sad of the selected vector will be kept.
+ *
+ * Frames without any motion (I-frames) will be skipped, i.e. the
+ * previous field will be carried over up to max_carry times.
+ *
+ * The output has the layout of the input (see imv_norm.h), thus it
+ * can be passed to imv_norm_* or depthtree_find_blobs_imv.
+ *
+ * The kernel uses NEON (ARM) or SSE2 (x86) if the compiler supports
+ * it (see IMV_NORM_KERNEL), like imv_norm.c.
+ */
+
+#ifndef IMV_ACCUM_H
+#define IMV_ACCUM_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdlib.h>
+
+typedef struct {
+	char *field; // accumulated vectors
+	size_t len; // number of vectors
+	unsigned int decay; // 0-255, fixed point with 8 fractional bits
+	unsigned int max_carry; // maximal number of skipped frames in a row
+	unsigned int carried; // number of skipped frames in a row
+} IMV_ACCUM;
+
+/* Returns 0 on success. decay=0 disables the filter (no allocation). */
+int imv_accum_init(IMV_ACCUM *a, size_t len, unsigned int decay, unsigned int max_carry);
+void imv_accum_uninit(IMV_ACCUM *a);
+
+/* Adds frame imv and returns the accumulated field, which
+ * is valid until the next call. Returns imv if the filter is disabled. */
+const char *imv_accum_update(IMV_ACCUM *a, const char *imv);
+
+/* Returns 1 if all vectors are zero. */
+int imv_is_empty(const char *imv, size_t n);
+
+/* Kernel of imv_accum_update: acc = max(imv, decay*acc) */
+void imv_accum_max(const char *imv, char *acc, size_t n, unsigned int decay);
+void imv_accum_max_ref(const char *imv, char *acc, size_t n, unsigned int decay);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
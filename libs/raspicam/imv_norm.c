@@ -0,0 +1,206 @@
+/* Norms of inline motion vectors, 16 vectors at a time.
+ * See imv_norm.h
+ */
+#include "imv_norm.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define IMV_X(imv,i) ((int)(signed char)(imv)[4*(i)])
+#define IMV_Y(imv,i) ((int)(signed char)(imv)[4*(i)+1])
+#define IMV_SAD(imv,i) ((unsigned int)(unsigned char)(imv)[4*(i)+2] \
+		| ((unsigned int)(unsigned char)(imv)[4*(i)+3] << 8))
+
+/* 4 cycle/bit C routine, see norm2.c
+ * http://www.finesse.demon.co.uk/steven/sqrt.html
+ *  */
+#define iter1(N) \
+	try = root + (1 << (N)); \
+if (n >= try << (N))   \
+{   n -= try << (N);   \
+	root |= 2 << (N); \
+}
+
+static inline unsigned int isqrt(unsigned int n)
+{
+	unsigned int root = 0, try;
+	iter1 (15);    iter1 (14);    iter1 (13);    iter1 (12);
+	iter1 (11);    iter1 (10);    iter1 ( 9);    iter1 ( 8);
+	iter1 ( 7);    iter1 ( 6);    iter1 ( 5);    iter1 ( 4);
+	iter1 ( 3);    iter1 ( 2);    iter1 ( 1);    iter1 ( 0);
+	return root >> 1;
+}
+
+void imv_norm_l1_ref(const char *imv, unsigned char *out, size_t n){
+	size_t i;
+	for( i=0; i<n; ++i){
+		const int s = abs(IMV_X(imv,i)) + abs(IMV_Y(imv,i));
+		out[i] = (s>255)?255:s;
+	}
+}
+
+void imv_norm_l2_ref(const char *imv, unsigned char *out, size_t n){
+	size_t i;
+	for( i=0; i<n; ++i){
+		const int x = IMV_X(imv,i), y = IMV_Y(imv,i);
+		out[i] = isqrt(x*x + y*y);
+	}
+}
+
+void imv_norm_sad_ref(const char *imv, unsigned char *out, size_t n, unsigned short max_sad){
+	size_t i;
+	for( i=0; i<n; ++i){
+		const int x = IMV_X(imv,i), y = IMV_Y(imv,i);
+		out[i] = (IMV_SAD(imv,i) > max_sad)?0:isqrt(x*x + y*y);
+	}
+}
+
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+/* vld4 deinterleaves 16 vectors into x, y, sad low and sad high bytes. */
+
+static inline void l1_16(const char *imv, unsigned char *out){
+	const uint8x16x4_t v = vld4q_u8((const uint8_t*)imv);
+	const int8x16_t x = vreinterpretq_s8_u8(v.val[0]);
+	const int8x16_t y = vreinterpretq_s8_u8(v.val[1]);
+	const int16x8_t lo = vaddq_s16( vabsq_s16(vmovl_s8(vget_low_s8(x))),
+			vabsq_s16(vmovl_s8(vget_low_s8(y))) );
+	const int16x8_t hi = vaddq_s16( vabsq_s16(vmovl_s8(vget_high_s8(x))),
+			vabsq_s16(vmovl_s8(vget_high_s8(y))) );
+	vst1q_u8((uint8_t*)out, vcombine_u8(vqmovun_s16(lo), vqmovun_s16(hi)));
+}
+
+/* floor(sqrt(s)) for s <= 2^15. The estimate of vrsqrte is refined
+ * by two Newton steps and the result is corrected by +-1. */
+static inline uint32x4_t isqrt_4(const uint32x4_t s){
+	const float32x4_t f = vcvtq_f32_u32(s);
+	const float32x4_t g = vmaxq_f32(f, vdupq_n_f32(1.0f)); // avoid rsqrt(0)
+	float32x4_t e = vrsqrteq_f32(g);
+	e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(g, e), e));
+	e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(g, e), e));
+	uint32x4_t r = vcvtq_u32_f32(vmulq_f32(f, e));
+	const uint32x4_t r1 = vaddq_u32(r, vdupq_n_u32(1));
+	r = vbslq_u32(vcleq_u32(vmulq_u32(r1, r1), s), r1, r);
+	r = vbslq_u32(vcgtq_u32(vmulq_u32(r, r), s), vsubq_u32(r, vdupq_n_u32(1)), r);
+	return r;
+}
+
+static inline uint8x16_t l2_16_regs(const uint8x16x4_t v){
+	const int8x16_t x = vreinterpretq_s8_u8(v.val[0]);
+	const int8x16_t y = vreinterpretq_s8_u8(v.val[1]);
+	/* x*x+y*y <= 2^15, thus the unsigned interpretation is correct. */
+	const uint16x8_t slo = vreinterpretq_u16_s16( vmlal_s8(
+				vmull_s8(vget_low_s8(x), vget_low_s8(x)), vget_low_s8(y), vget_low_s8(y)) );
+	const uint16x8_t shi = vreinterpretq_u16_s16( vmlal_s8(
+				vmull_s8(vget_high_s8(x), vget_high_s8(x)), vget_high_s8(y), vget_high_s8(y)) );
+	const uint16x8_t rlo = vcombine_u16( vmovn_u32(isqrt_4(vmovl_u16(vget_low_u16(slo)))),
+			vmovn_u32(isqrt_4(vmovl_u16(vget_high_u16(slo)))) );
+	const uint16x8_t rhi = vcombine_u16( vmovn_u32(isqrt_4(vmovl_u16(vget_low_u16(shi)))),
+			vmovn_u32(isqrt_4(vmovl_u16(vget_high_u16(shi)))) );
+	return vcombine_u8(vmovn_u16(rlo), vmovn_u16(rhi));
+}
+
+static inline void l2_16(const char *imv, unsigned char *out){
+	const uint8x16x4_t v = vld4q_u8((const uint8_t*)imv);
+	vst1q_u8((uint8_t*)out, l2_16_regs(v));
+}
+
+static inline void sad_16(const char *imv, unsigned char *out, const unsigned short max_sad){
+	const uint8x16x4_t v = vld4q_u8((const uint8_t*)imv);
+	const uint16x8_t max = vdupq_n_u16(max_sad);
+	const uint16x8_t sadlo = vorrq_u16( vmovl_u8(vget_low_u8(v.val[2])),
+			vshll_n_u8(vget_low_u8(v.val[3]), 8) );
+	const uint16x8_t sadhi = vorrq_u16( vmovl_u8(vget_high_u8(v.val[2])),
+			vshll_n_u8(vget_high_u8(v.val[3]), 8) );
+	const uint8x16_t keep = vcombine_u8( vmovn_u16(vcleq_u16(sadlo, max)),
+			vmovn_u16(vcleq_u16(sadhi, max)) );
+	vst1q_u8((uint8_t*)out, vandq_u8(l2_16_regs(v), keep));
+}
+
+#elif defined(__SSE2__)
+/* Each 32 bit lane holds one vector. The low 16 bits of
+ * x16 and y16 are the sign extended components. */
+#define SSE2_X16(v) _mm_srai_epi16(_mm_slli_epi16(v, 8), 8)
+#define SSE2_Y16(v) _mm_srai_epi16(v, 8)
+
+static inline __m128i l1_4(const __m128i v){
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i x = SSE2_X16(v), y = SSE2_Y16(v);
+	const __m128i s = _mm_add_epi16( _mm_max_epi16(x, _mm_sub_epi16(zero, x)),
+			_mm_max_epi16(y, _mm_sub_epi16(zero, y)) );
+	return _mm_and_si128(s, _mm_set1_epi32(0xFFFF));
+}
+
+/* floor(sqrt(x*x+y*y)). The single precision sqrt is
+ * exact enough for integers <= 2^15. */
+static inline __m128i l2_4(const __m128i v){
+	const __m128i x = SSE2_X16(v), y = SSE2_Y16(v);
+	__m128i s = _mm_add_epi16(_mm_mullo_epi16(x, x), _mm_mullo_epi16(y, y));
+	s = _mm_and_si128(s, _mm_set1_epi32(0xFFFF));
+	return _mm_cvttps_epi32(_mm_sqrt_ps(_mm_cvtepi32_ps(s)));
+}
+
+static inline __m128i sad_4(const __m128i v, const __m128i max){
+	const __m128i reject = _mm_cmpgt_epi32(_mm_srli_epi32(v, 16), max);
+	return _mm_andnot_si128(reject, l2_4(v));
+}
+
+#define SSE2_LOAD(imv, k) _mm_loadu_si128((const __m128i*)(imv) + (k))
+#define SSE2_STORE(out, a, b, c, d) _mm_storeu_si128((__m128i*)(out), \
+		_mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)))
+
+static inline void l1_16(const char *imv, unsigned char *out){
+	SSE2_STORE(out, l1_4(SSE2_LOAD(imv,0)), l1_4(SSE2_LOAD(imv,1)),
+			l1_4(SSE2_LOAD(imv,2)), l1_4(SSE2_LOAD(imv,3)));
+}
+
+static inline void l2_16(const char *imv, unsigned char *out){
+	SSE2_STORE(out, l2_4(SSE2_LOAD(imv,0)), l2_4(SSE2_LOAD(imv,1)),
+			l2_4(SSE2_LOAD(imv,2)), l2_4(SSE2_LOAD(imv,3)));
+}
+
+static inline void sad_16(const char *imv, unsigned char *out, const unsigned short max_sad){
+	const __m128i max = _mm_set1_epi32(max_sad);
+	SSE2_STORE(out, sad_4(SSE2_LOAD(imv,0), max), sad_4(SSE2_LOAD(imv,1), max),
+			sad_4(SSE2_LOAD(imv,2), max), sad_4(SSE2_LOAD(imv,3), max));
+}
+
+#else
+static inline void l1_16(const char *imv, unsigned char *out){
+	imv_norm_l1_ref(imv, out, 16);
+}
+static inline void l2_16(const char *imv, unsigned char *out){
+	imv_norm_l2_ref(imv, out, 16);
+}
+static inline void sad_16(const char *imv, unsigned char *out, const unsigned short max_sad){
+	imv_norm_sad_ref(imv, out, 16, max_sad);
+}
+#endif
+
+
+void imv_norm_l1(const char *imv, unsigned char *out, size_t n){
+	size_t i;
+	for( i=0; i+16<=n; i+=16){
+		l1_16(imv + 4*i, out + i);
+	}
+	imv_norm_l1_ref(imv + 4*i, out + i, n - i);
+}
+
+void imv_norm_l2(const char *imv, unsigned char *out, size_t n){
+	size_t i;
+	for( i=0; i+16<=n; i+=16){
+		l2_16(imv + 4*i, out + i);
+	}
+	imv_norm_l2_ref(imv + 4*i, out + i, n - i);
+}
+
+void imv_norm_sad(const char *imv, unsigned char *out, size_t n, unsigned short max_sad){
+	size_t i;
+	for( i=0; i+16<=n; i+=16){
+		sad_16(imv + 4*i, out + i, max_sad);
+	}
+	imv_norm_sad_ref(imv + 4*i, out + i, n - i, max_sad);
+}
@@ -0,0 +1,49 @@
+/* Norms of inline motion vectors, 16 vectors at a time.
+ * See misc/testIntegerSqrt.c for accuracy and performance test.
+ *
+ * Input is the raw imv buffer of the encoder, 4 bytes per vector:
+ * signed char x, signed char y, unsigned short sad (little endian).
+ * Output is one byte per vector.
+ *
+ * imv_norm_l1  - |x|+|y|, saturated to 255.
+ * imv_norm_l2  - floor(sqrt(x*x+y*y)), exact.
+ * imv_norm_sad - Like l2, but 0 for vectors with sad > max_sad.
+ *                A high sad marks a bad match of the encoder, i.e. noise.
+ *
+ * The kernels use NEON (ARM) or SSE2 (x86) if the compiler
+ * supports it (see IMV_NORM_KERNEL) and the scalar
+ * reference implementations (*_ref) otherwise.
+ */
+
+#ifndef IMV_NORM_H
+#define IMV_NORM_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdlib.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define IMV_NORM_KERNEL "neon"
+#elif defined(__SSE2__)
+#define IMV_NORM_KERNEL "sse2"
+#else
+#define IMV_NORM_KERNEL "scalar"
+#endif
+
+void imv_norm_l1(const char *imv, unsigned char *out, size_t n);
+void imv_norm_l2(const char *imv, unsigned char *out, size_t n);
+void imv_norm_sad(const char *imv, unsigned char *out, size_t n, unsigned short max_sad);
+
+/* Scalar reference implementations */
+void imv_norm_l1_ref(const char *imv, unsigned char *out, size_t n);
+void imv_norm_l2_ref(const char *imv, unsigned char *out, size_t n);
+void imv_norm_sad_ref(const char *imv, unsigned char *out, size_t n, unsigned short max_sad);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -33,15 +33,15 @@ void tracker_drawBlobs(Tracker &tracker, cv::Mat &out, bool drawHistoryLines, st
 
 		if( drawHistoryLines ){
 #ifdef WITH_HISTORY
-			if( b.history.get() != nullptr ){
+			const HistoryRing *history = tracker.getHistory(b);
+			if( history != NULL ){
 				cv::Point p1((int)b.location.x,(int)b.location.y);
 				cv::Point p2;
 
-				std::deque<cBlob>::iterator it = b.history.get()->begin();
-				const std::deque<cBlob>::iterator itEnd = b.history.get()->end();
 				int time=0;
-				for ( ; it != itEnd ; ++it){
-					p2.x = (*it).location.x; 	p2.y = (*it).location.y; 	
+				for ( unsigned int k=0; k<history->size; ++k){
+					const HistorySample &sample = history_at(history, k);
+					p2.x = sample.location.x; 	p2.y = sample.location.y; 	
 					//cv::Scalar color(200+10*time,200+10*time,200+10*time);
 					cv::Scalar color(30,30,200+10*time);
 					cv::line(out,p1,p2,color,2);
@@ -12,10 +12,11 @@
 
 #ifdef WITH_HISTORY
 /* Connect midpoints of the saved history of a blob */
-void tracker_drawHistory( Tracker &tracker, int screenWidth, int screenHeight, cBlob &blob, GfxTexture *target){
-	if( blob.history.get() == nullptr ) return;
+void tracker_drawHistory( Tracker &tracker, int screenWidth, int screenHeight, const cBlob &blob, GfxTexture *target){
+	const HistoryRing *history = tracker.getSnapshot().getHistory(blob);
+	if( history == NULL ) return;
 
-	unsigned int numPoints = 1+blob.history.get()->size();
+	unsigned int numPoints = 1+history->size;
 	float scaleW = 2.0/screenWidth;
 	float scaleH = 2.0/screenHeight;
 	GLfloat points[numPoints*2];
@@ -33,11 +34,10 @@ void tracker_drawHistory( Tracker &tracker, int screenWidth, int screenHeight, c
 	//*c++ = 1.0; *c++ = 0.0; *c++ = 1.0; *c++ = 0.7;
 
 	int pointIndex = 1;
-	std::deque<cBlob>::iterator it = blob.history.get()->begin();
-	const std::deque<cBlob>::iterator itEnd = blob.history.get()->end();
-	for ( ; it != itEnd ; ++it){
-		x0 = 1 - (*it).location.x*scaleW;
-		y0 = (*it).location.y*scaleH - 1;
+	for ( unsigned int k=0; k<history->size; ++k){
+		const HistorySample &sample = history_at(history, k);
+		x0 = 1 - sample.location.x*scaleW;
+		y0 = sample.location.y*scaleH - 1;
 		*p++ = x0; 	*p++ = y0; 	
 		//*c++ = 1.0-pointIndex/30.0; *c++ = 0.0; *c++ = 1.0; *c++ = 0.7;
 
@@ -49,10 +49,10 @@ void tracker_drawHistory( Tracker &tracker, int screenWidth, int screenHeight, c
 }
 #endif
 
-void tracker_drawBlobsGL(Tracker &tracker, int screenWidth, int screenHeight, bool drawHistoryLines, std::vector<cBlob> *toDraw, GfxTexture *target){
+void tracker_drawBlobsGL(Tracker &tracker, int screenWidth, int screenHeight, bool drawHistoryLines, const std::vector<cBlob> *toDraw, GfxTexture *target){
 	if( toDraw == NULL ){
 		//toDraw = &tracker.blobs;
-		toDraw = &tracker.getBlobs();
+		toDraw = &tracker.acquireSnapshot().blobs;
 	}
 
 	/* Clear target. It's not neccessary to unbind the
@@ -64,12 +64,6 @@ void tracker_drawBlobsGL(Tracker &tracker, int screenWidth, int screenHeight, bo
 		glClear(GL_COLOR_BUFFER_BIT);
 	}
 
-	//Wait and look mutex.
-	while( tracker.m_swap_mutex ){
-		usleep(900);
-	}
-	tracker.m_swap_mutex = 1;
-
 	GLfloat points[toDraw->size()*12];
 	GLfloat colors[toDraw->size()*24];
 	int quadIndex = 0;
@@ -79,7 +73,7 @@ void tracker_drawBlobsGL(Tracker &tracker, int screenWidth, int screenHeight, bo
 	GLfloat *c = &colors[0];
 
 	for (unsigned int i = 0; i < toDraw->size(); i++) {
-		cBlob &b = (*toDraw).at(i);
+		const cBlob &b = (*toDraw).at(i);
 		float col[3];
 #define C(r,g,b) {col[0]=(r)/255.0; col[1]=(g)/255.0; col[2]=(b)/255.0;}
 		if( b.event == BLOB_DOWN ){
@@ -130,7 +124,6 @@ void tracker_drawBlobsGL(Tracker &tracker, int screenWidth, int screenHeight, bo
 		}
 
 	}
-	tracker.m_swap_mutex = 0;
 
 	DrawBlobRects(&points[0], &colors[0], quadIndex, target);
 
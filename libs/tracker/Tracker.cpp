@@ -7,19 +7,32 @@
 
 #include "Tracker.h"
 
+#define SNAPSHOT_INDEX 3
+#define SNAPSHOT_FRESH 4
+
 bool oldest_sort_function (const cBlob &a,const cBlob &b) { return (a.duration>b.duration); }
 
 
-Tracker::Tracker():m_frameId(0),m_max_radius(7), m_max_missing_duration(5), m_swap_mutex(0),
+Tracker::Tracker():m_frameId(0),m_max_radius(7), m_max_missing_duration(5),
 	m_use_N_oldest_blobs(0),
 #ifdef WITH_HISTORY
 	m_phistory_line_colors(NULL),
 #endif
-	m_minimal_frames_till_active(10)
+	m_minimal_frames_till_active(10),
+	m_snapshot_ready(1), m_snapshot_write(0), m_snapshot_read(2)
 {
+	for(unsigned int i=0; i<3; i++) m_snapshots[i].frameId = 0;
+
 	for(unsigned int i=0; i<MAXHANDS; i++) handids[i] = false;
 	last_handid = 0;
 
+#ifdef WITH_HISTORY
+	for(unsigned int i=0; i<MAXHANDS; i++){
+		history_clear(&m_history[i], 0);
+		for(unsigned int j=0; j<3; j++) history_clear(&m_snapshots[j].history[i], 0);
+	}
+#endif
+
 #ifdef WITH_HISTORY
 	m_phistory_line_colors = new float[MAX_HISTORY_LEN*4];
 	float *rgba = m_phistory_line_colors;
@@ -48,6 +61,72 @@ std::vector<cBlob>& Tracker::getBlobs()
 	return blobs;
 }
 
+int Tracker::getFrameId() const
+{
+	return m_frameId;
+}
+
+int Tracker::getMaxMissingDuration() const
+{
+	return m_max_missing_duration;
+}
+
+#ifdef WITH_HISTORY
+const HistoryRing *Tracker::getHistory(const cBlob &b) const
+{
+	if( b.handid < 0 || b.handid >= MAXHANDS ) return NULL;
+	const HistoryRing *ring = &m_history[b.handid];
+	if( ring->id != b.id || ring->size == 0 ) return NULL;
+	return ring;
+}
+#endif
+
+#ifdef WITH_HISTORY
+const HistoryRing *TrackerSnapshot::getHistory(const cBlob &b) const
+{
+	if( b.handid < 0 || b.handid >= MAXHANDS ) return NULL;
+	const HistoryRing *ring = &history[b.handid];
+	if( ring->id != b.id || ring->size == 0 ) return NULL;
+	return ring;
+}
+#endif
+
+void Tracker::publish()
+{
+	TrackerSnapshot &snap = m_snapshots[m_snapshot_write];
+	snap.blobs = blobs; // reuses the capacity of the vector
+	snap.frameId = m_frameId;
+#ifdef WITH_HISTORY
+	for (unsigned int i = 0; i < blobs.size(); i++) {
+		const int handid = blobs[i].handid;
+		if( handid >= 0 && handid < MAXHANDS ){
+			snap.history[handid] = m_history[handid];
+		}
+	}
+#endif
+
+	/* Release the written buffer and take the old ready buffer
+	 * (which could be unread) for the next frame. */
+	const unsigned int old = m_snapshot_ready.exchange(
+			m_snapshot_write | SNAPSHOT_FRESH, std::memory_order_acq_rel);
+	m_snapshot_write = old & SNAPSHOT_INDEX;
+}
+
+const TrackerSnapshot &Tracker::acquireSnapshot()
+{
+	if( m_snapshot_ready.load(std::memory_order_relaxed) & SNAPSHOT_FRESH ){
+		const unsigned int fresh = m_snapshot_ready.exchange(
+				m_snapshot_read, std::memory_order_acq_rel);
+		m_snapshot_read = fresh & SNAPSHOT_INDEX;
+	}
+	return m_snapshots[m_snapshot_read];
+}
+
+const TrackerSnapshot &Tracker::getSnapshot() const
+{
+	return m_snapshots[m_snapshot_read];
+}
+
 void Tracker::setMaxRadius(int max_radius){
 	 m_max_radius = max_radius;
 }
@@ -64,13 +143,17 @@ void Tracker::setOldestDurationFilter(int N_oldest_blobs){
 }
 
 
-void Tracker::getFilteredBlobs(int /*Trackfilter*/ filter, std::vector<cBlob> &output)
+void Tracker::getFilteredBlobs(int /*Trackfilter*/ filter, std::vector<cBlob> &output,
+		const std::vector<cBlob> *input)
 {
+	const std::vector<cBlob> &blobs = (input!=NULL)?*input:this->blobs;
+
 	/* I-Frames are without motions. Allow one missing frame. 
-	 * A general skipping of I-Frames would be a better solution.
+	 * A general skipping of I-Frames would be a better solution
+	 * (see the optional vector filter of raspicam, imv_accum.h).
 	 */
 	for (unsigned int i = 0; i < blobs.size(); i++) {
-		cBlob &b = blobs[i];
+		const cBlob &b = blobs[i];
 		if( ( filter & b.event )
 				|| ( filter&TRACK_ALL_ACTIVE
 					&& b.event & (BLOB_MOVE|BLOB_DOWN)
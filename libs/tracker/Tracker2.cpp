@@ -3,13 +3,18 @@
  */
 #include <unistd.h>
 
+#include <algorithm> //for std::sort
+
 //get ENV variables from BlobDetection lib
 #include "settings.h"
 
 #include "Tracker2.h"
 
 
-Tracker2::Tracker2()
+Tracker2::Tracker2():
+	m_prediction(false),
+	m_process_noise(KALMAN_PROCESS_NOISE),
+	m_measurement_noise(KALMAN_MEASUREMENT_NOISE)
 {
 }
 
@@ -17,17 +22,178 @@ Tracker2::~Tracker2()
 {
 }
 
+static bool match_sort_function(const TrackerMatch &a, const TrackerMatch &b){
+	if( a.dist2 != b.dist2 ) return a.dist2 < b.dist2;
+	if( a.current != b.current ) return a.current < b.current;
+	return a.previous < b.previous;
+}
+
+/* Floor of a/b for b>0 */
+static inline int floor_div(int a, int b){
+	return (a>=0)?a/b:-((-a+b-1)/b);
+}
+
+void Tracker2::setMotionPrediction(bool enable, int process_noise, int measurement_noise)
+{
+	if( enable && !m_prediction ){
+		// Start the filters of the existing blobs
+		for( unsigned int i=0; i<blobs.size(); i++){
+			kalman_init(&blobs[i].kalman, blobs[i].location.x, blobs[i].location.y,
+					measurement_noise, m_max_radius*m_max_radius);
+		}
+	}
+	m_prediction = enable;
+	m_process_noise = process_noise;
+	m_measurement_noise = measurement_noise;
+}
+
+void Tracker2::predictPrevious()
+{
+	const int max_radius_2 = m_max_radius * m_max_radius;
+	const unsigned int nprev = blobs_previous.size();
+	m_previous_positions.resize(nprev);
+	m_previous_gates.resize(nprev);
+
+	for( unsigned int j=0; j<nprev; j++){
+		cBlob &b = blobs_previous[j];
+		if( !m_prediction ){
+			m_previous_positions[j] = b.location;
+			m_previous_gates[j] = max_radius_2;
+			continue;
+		}
+		kalman_predict(&b.kalman, m_process_noise);
+		m_previous_positions[j].x = kalman_round(b.kalman.x[0]);
+		m_previous_positions[j].y = kalman_round(b.kalman.x[1]);
+		const int gate = KALMAN_GATE * kalman_innovation_var(&b.kalman, m_measurement_noise);
+		m_previous_gates[j] = (gate<max_radius_2)?gate:max_radius_2;
+	}
+}
+
+void Tracker2::findMatches(int cell_size)
+{
+	m_matches.clear();
+	if( blobs_previous.empty() || blobsTmp.empty() ) return;
+
+	const unsigned int nprev = blobs_previous.size();
+	unsigned int i, j;
+
+	// Bounding box of previous positions
+	int min_x = m_previous_positions[0].x, max_x = min_x;
+	int min_y = m_previous_positions[0].y, max_y = min_y;
+	for( j=1; j<nprev; j++){
+		const point &p = m_previous_positions[j];
+		if( p.x < min_x ) min_x = p.x;
+		if( p.x > max_x ) max_x = p.x;
+		if( p.y < min_y ) min_y = p.y;
+		if( p.y > max_y ) max_y = p.y;
+	}
+	const int cols = (max_x-min_x)/cell_size + 1;
+	const int rows = (max_y-min_y)/cell_size + 1;
+	const unsigned int ncells = cols*rows;
+
+	// Counting sort of previous blobs by cell
+	m_grid_start.assign(ncells+1, 0);
+	m_grid_items.resize(nprev);
+	for( j=0; j<nprev; j++){
+		const point &p = m_previous_positions[j];
+		const int c = ((p.y-min_y)/cell_size)*cols + (p.x-min_x)/cell_size;
+		m_grid_start[c+1]++;
+	}
+	for( i=0; i<ncells; i++){
+		m_grid_start[i+1] += m_grid_start[i];
+	}
+	for( j=0; j<nprev; j++){
+		const point &p = m_previous_positions[j];
+		const int c = ((p.y-min_y)/cell_size)*cols + (p.x-min_x)/cell_size;
+		m_grid_items[m_grid_start[c]++] = j;
+	}
+	// m_grid_start[c] is now the begin of cell c+1. Shift back.
+	for( i=ncells; i>0; i--){
+		m_grid_start[i] = m_grid_start[i-1];
+	}
+	m_grid_start[0] = 0;
+
+	// Search in the 3x3 neighbourhood of the cell of each current blob.
+	for( i=0; i<blobsTmp.size(); i++){
+		const point &p = blobsTmp[i].location;
+		const int cx = floor_div(p.x-min_x, cell_size);
+		const int cy = floor_div(p.y-min_y, cell_size);
+		const int x0 = std::max(cx-1, 0), x1 = std::min(cx+1, cols-1);
+		const int y0 = std::max(cy-1, 0), y1 = std::min(cy+1, rows-1);
+		for( int y=y0; y<=y1; y++){
+			for( int x=x0; x<=x1; x++){
+				const unsigned int c = y*cols + x;
+				for( unsigned int k=m_grid_start[c]; k<m_grid_start[c+1]; k++){
+					const unsigned int jp = m_grid_items[k];
+					const int d1 = p.x - m_previous_positions[jp].x;
+					const int d2 = p.y - m_previous_positions[jp].y;
+					const int dist2 = d1*d1 + d2*d2;
+					if( dist2 < m_previous_gates[jp] ){
+						TrackerMatch m = {dist2, i, jp};
+						m_matches.push_back(m);
+					}
+				}
+			}
+		}
+	}
+
+	std::sort(m_matches.begin(), m_matches.end(), match_sort_function);
+}
+
+void Tracker2::applyMatch(cBlob &currentBlob, cBlob &previousBlob, bool history)
+{
+	previousBlob.tracked = true;
+	currentBlob.tracked = true;
+	currentBlob.event = BLOB_MOVE;
+	if( history ){
+		currentBlob.origin.x = previousBlob.origin.x;
+		currentBlob.origin.y = previousBlob.origin.y;
+		currentBlob.id = previousBlob.id;
+#ifdef WITH_HISTORY
+		/* Add the previous Blob to the history of the track.
+		 * Like before the rings, pending blobs will be added, too
+		 * (with their last position). */
+		HistoryRing *ring = &m_history[previousBlob.handid];
+		if( ring->id != previousBlob.id ){
+			history_clear(ring, previousBlob.id);
+		}
+		history_push(ring, previousBlob, m_frameId-1);
+#endif
+	}else{
+		currentBlob.origin.x = previousBlob.location.x;
+		currentBlob.origin.y = previousBlob.location.y;
+	}
+
+	currentBlob.handid = previousBlob.handid;
+	currentBlob.duration = previousBlob.duration;
+	currentBlob.missing_duration = 0;
+
+	if( m_prediction ){
+		currentBlob.kalman = previousBlob.kalman;
+		kalman_update(&currentBlob.kalman,
+				currentBlob.location.x, currentBlob.location.y, m_measurement_noise);
+	}
+}
+
+void Tracker2::assignMatches(bool history)
+{
+	for (unsigned int k = 0; k < m_matches.size(); k++) {
+		cBlob &currentBlob = blobsTmp[m_matches[k].current];
+		cBlob &previousBlob = blobs_previous[m_matches[k].previous];
+		if (currentBlob.tracked || previousBlob.tracked) continue;
+		applyMatch(currentBlob, previousBlob, history);
+	}
+}
+
 void Tracker2::trackBlobs(
 		Blobtree * frameblobs,
 		bool history )
 {
 	++m_frameId;
 
-	int max_radius_2 = m_max_radius * m_max_radius;
 	int x, y, min_x, min_y, max_x, max_y;
 
 	cBlob temp;
-	bool new_hand(true);
 
 	// clear the blobs from two frames ago
 	blobs_previous.clear();
@@ -37,9 +203,9 @@ void Tracker2::trackBlobs(
 		if (blobs[i].event != BLOB_UP){
 			blobs_previous.push_back(blobs[i]);
 	
-			blobs_previous[i].duration++;
+			blobs_previous.back().duration++;
 			// init previous blobs as untracked blobs
-			blobs_previous[i].tracked = false;
+			blobs_previous.back().tracked = false;
 		}
 	}
 
@@ -71,49 +237,21 @@ void Tracker2::trackBlobs(
 
 		temp.min.x = min_x; temp.min.y = min_y;
 		temp.max.x = max_x; temp.max.y = max_y;
+		temp.tracked = false;
 
 		blobsTmp.push_back(temp);
 		curNode = blobtree_next(frameblobs);
 	}
 
-	float d1,d2;
-	// main tracking loop -- O(n^2) -- simply looks for a blob in the previous frame within a specified radius
+	// main tracking loop -- O(n) on average -- assign pairs of nearby blobs.
+	predictPrevious();
+	findMatches( m_max_radius>0?m_max_radius:1 );
+	assignMatches( history );
+
 	for (unsigned int i = 0; i < blobsTmp.size(); i++) {
 		cBlob &currentBlob = blobsTmp[i];
-		new_hand = true;
-		for (unsigned int j = 0; j < blobs_previous.size(); j++) {
-			cBlob &previousBlob = blobs_previous[j];
-			if (previousBlob.tracked) continue;
-
-			d1=currentBlob.location.x - previousBlob.location.x;
-			d2=currentBlob.location.y - previousBlob.location.y;
-			if ( (d1*d1 + d2*d2) < max_radius_2) {
-				previousBlob.tracked = true;
-				currentBlob.event = BLOB_MOVE;
-				if( history ){
-					currentBlob.origin.x = previousBlob.origin.x;
-					currentBlob.origin.y = previousBlob.origin.y;
-#ifdef WITH_HISTORY
-					/* Grab history stack pointer and
-					 * add the previous Blob to the history.
-					 */
-					currentBlob.transfer_history(previousBlob);
-					currentBlob.update_history(previousBlob);
-#endif
-				}else{
-					currentBlob.origin.x = previousBlob.location.x;
-					currentBlob.origin.y = previousBlob.location.y;
-				}
-
-				currentBlob.handid = previousBlob.handid;
-				currentBlob.duration = previousBlob.duration;
-				currentBlob.missing_duration = 0;
-				new_hand = false;
-				break;
-			}
-		}
 		/* assing free handid if new blob */
-		if( new_hand){
+		if( !currentBlob.tracked ){
 
 			//search next free id.
 			int next_handid = (last_handid+1) % MAXHANDS;
@@ -127,11 +265,18 @@ void Tracker2::trackBlobs(
 
 			handids[next_handid] = true;
 			currentBlob.handid = next_handid;
+			currentBlob.id = ++CBlob_Id; // new track, see Tracker::getHistory
 			last_handid = next_handid;
 
 			currentBlob.event = BLOB_DOWN;
 			currentBlob.duration = 1;
 			currentBlob.missing_duration = 0;
+			if( m_prediction ){
+				// Unknown velocity, up to max radius per frame.
+				kalman_init(&currentBlob.kalman,
+						currentBlob.location.x, currentBlob.location.y,
+						m_measurement_noise, m_max_radius*m_max_radius);
+			}
 			//currentBlob.cursor = NULL;
 		}
 	}
@@ -152,13 +297,9 @@ void Tracker2::trackBlobs(
 		}
 	}
 
-	//Now wait until no other thread works with blob vector
-	//and swap with blobTmp
-	while( m_swap_mutex ){
-		usleep(1000);
-	}
-	m_swap_mutex = 1;
 	blobs.swap( blobsTmp );
-	m_swap_mutex = 0;
+
+	// Other threads read the blobs through acquireSnapshot()
+	publish();
 }
 
@@ -0,0 +1,215 @@
+/*
+ * Tracker with optimal assignment, see Tracker3.h
+ */
+
+//get ENV variables from BlobDetection lib
+#include "settings.h"
+#include "unionfind.h"
+
+#include "Tracker3.h"
+
+/* Cost of forbidden pairs. Large enough to exceed every
+ * sum of allowed costs and small enough to omit overflows. */
+static const int TRACKER3_INF = 1<<28;
+
+Tracker3::Tracker3()
+{
+}
+
+Tracker3::~Tracker3()
+{
+}
+
+/* Hungarian algorithm (shortest augmenting paths) for the
+ * n x m matrix m_cost, n <= m (1-based, row stride m+1).
+ * Continues the partial assignment m_p by augmenting
+ * the rows of m_free_rows.
+ * m_u and m_v has to be a feasible dual solution, i.e.
+ * cost(i,j) - u(i) - v(j) >= 0, with v(j) = 0 for unassigned
+ * columns and cost(i,j) - u(i) - v(j) = 0 for assigned pairs. */
+void Tracker3::hungarian(unsigned int n, unsigned int m)
+{
+	const int *a = &m_cost[0];
+	int *u = &m_u[0];
+	int *v = &m_v[0];
+	int *minv = &m_minv[0];
+	unsigned int *p = &m_p[0];
+	unsigned int *way = &m_way[0];
+	char *used = &m_used[0];
+	unsigned int k, j;
+
+	for( k=0; k<m_free_rows.size(); k++){
+		p[0] = m_free_rows[k];
+		unsigned int j0 = 0;
+		for( j=0; j<=m; j++){
+			minv[j] = TRACKER3_INF;
+			used[j] = 0;
+		}
+		do{
+			used[j0] = 1;
+			const unsigned int i0 = p[j0];
+			const int *row = a + i0*(m+1);
+			int delta = TRACKER3_INF;
+			unsigned int j1 = 0;
+			for( j=1; j<=m; j++){
+				if( used[j] ) continue;
+				const int cur = row[j] - u[i0] - v[j];
+				if( cur < minv[j] ){
+					minv[j] = cur;
+					way[j] = j0;
+				}
+				if( minv[j] < delta ){
+					delta = minv[j];
+					j1 = j;
+				}
+			}
+			for( j=0; j<=m; j++){
+				if( used[j] ){
+					u[p[j]] += delta;
+					v[j] -= delta;
+				}else{
+					minv[j] -= delta;
+				}
+			}
+			j0 = j1;
+		}while( p[j0] != 0 );
+
+		do{
+			const unsigned int j1 = way[j0];
+			p[j0] = p[j1];
+			j0 = j1;
+		}while( j0 );
+	}
+}
+
+/* Rectangular problem for R current and C previous blobs:
+ *
+ *           previous          dummy columns
+ * current   2*(dist2-g)/INF   0
+ *
+ * with g = max_radius^2. A pair saves 2*(g-dist2) > 0 compared with
+ * leaving both blobs unassigned. Rows without partner
+ * take a dummy column. */
+void Tracker3::solveComponent(const unsigned int *pair_begin,
+		const unsigned int *pair_end, bool history)
+{
+	const unsigned int n_cur = blobsTmp.size();
+	const int g = m_max_radius * m_max_radius;
+	const unsigned int *pair;
+	unsigned int i, j;
+
+	m_rows.clear();
+	m_cols.clear();
+	for( pair=pair_begin; pair<pair_end; ++pair){
+		const TrackerMatch &m = m_matches[*pair];
+		if( m_local[m.current] == (unsigned int)-1 ){
+			m_local[m.current] = m_rows.size();
+			m_rows.push_back(m.current);
+		}
+		if( m_local[n_cur+m.previous] == (unsigned int)-1 ){
+			m_local[n_cur+m.previous] = m_cols.size();
+			m_cols.push_back(m.previous);
+		}
+	}
+
+	const unsigned int R = m_rows.size();
+	const unsigned int C = m_cols.size();
+	const unsigned int n = R;
+	const unsigned int m = C+R;
+	const unsigned int stride = m+1;
+
+	m_cost.assign((n+1)*stride, 0);
+	m_u.assign(n+1, 0);
+	m_v.assign(stride, 0);
+	m_minv.resize(stride);
+	m_way.resize(stride);
+	m_used.resize(stride);
+
+	for( i=1; i<=n; i++){
+		int *row = &m_cost[i*stride];
+		for( j=1; j<=C; j++) row[j] = TRACKER3_INF;
+	}
+	for( pair=pair_begin; pair<pair_end; ++pair){
+		const TrackerMatch &mt = m_matches[*pair];
+		m_cost[(1+m_local[mt.current])*stride + 1+m_local[n_cur+mt.previous]] = 2*(mt.dist2-g);
+	}
+
+	/* Warm start: Row reduction (v=0) and assignment of every row to
+	 * its nearest previous blob, if this one is still free. This is the
+	 * greedy solution of Tracker2, thus the augmentation only
+	 * has to repair the conflicting rows. */
+	m_p.assign(stride, 0);
+	m_free_rows.clear();
+	for( i=1; i<=n; i++){
+		const int *row = &m_cost[i*stride];
+		unsigned int jmin = 1;
+		for( j=2; j<=C; j++){
+			if( row[j] < row[jmin] ) jmin = j;
+		}
+		m_u[i] = row[jmin]; // < 0, the dummy columns cost 0.
+		if( m_p[jmin] == 0 ){
+			m_p[jmin] = i;
+		}else{
+			m_free_rows.push_back(i);
+		}
+	}
+
+	hungarian(n, m);
+
+	for( j=1; j<=C; j++){
+		i = m_p[j];
+		if( i>=1 ){
+			applyMatch(blobsTmp[m_rows[i-1]], blobs_previous[m_cols[j-1]], history);
+		}
+	}
+
+	//reset local indizes for next component
+	for( i=0; i<R; i++) m_local[m_rows[i]] = (unsigned int)-1;
+	for( j=0; j<C; j++) m_local[n_cur+m_cols[j]] = (unsigned int)-1;
+}
+
+void Tracker3::assignMatches(bool history)
+{
+	const unsigned int n_cur = blobsTmp.size();
+	const unsigned int n = n_cur + blobs_previous.size();
+	const unsigned int num_matches = m_matches.size();
+	unsigned int k;
+	if( num_matches == 0 ) return;
+
+	/* Connected components of the bipartite graph.
+	 * Nodes 0,...,n_cur-1 are current blobs, followed by the previous blobs. */
+	m_comp_same.resize(n);
+	for( k=0; k<n; k++) m_comp_same[k] = k;
+	for( k=0; k<num_matches; k++){
+		uf_union(&m_comp_same[0], m_matches[k].current, n_cur+m_matches[k].previous);
+	}
+	uf_flatten(&m_comp_same[0], n);
+
+	// Counting sort of the matches by component.
+	m_comp_start.assign(n+1, 0);
+	m_comp_order.resize(num_matches);
+	for( k=0; k<num_matches; k++){
+		m_comp_start[ m_comp_same[m_matches[k].current]+1 ]++;
+	}
+	for( k=0; k<n; k++){
+		m_comp_start[k+1] += m_comp_start[k];
+	}
+	for( k=0; k<num_matches; k++){
+		m_comp_order[ m_comp_start[ m_comp_same[m_matches[k].current] ]++ ] = k;
+	}
+	// m_comp_start[c] is now the begin of component c+1.
+
+	m_local.assign(n, (unsigned int)-1);
+	unsigned int begin = 0;
+	for( k=0; k<n; k++){
+		const unsigned int end = m_comp_start[k];
+		if( end - begin == 1 ){
+			// Single pair. Nothing to optimize.
+			const TrackerMatch &m = m_matches[m_comp_order[begin]];
+			applyMatch(blobsTmp[m.current], blobs_previous[m.previous], history);
+		}else if( end > begin ){
+			solveComponent(&m_comp_order[0]+begin, &m_comp_order[0]+end, history);
+		}
+		begin = end;
+	}
+}
@@ -0,0 +1,214 @@
+/* Benchmark of the blob assignment of Tracker2 (greedy)
+ * and Tracker3 (optimal).
+ *
+ * MAXHANDS squares move on circles with constant speed, thus
+ * their paths cross often. The frames are labeled by threshtree and
+ * only the duration of trackBlobs will be measured.
+ *
+ * Identity swaps: Every frame, each square looks up the handid
+ * of the blob at its position. A change of this handid between two
+ * frames counts as swap. (Merged squares produce swaps for
+ * both trackers.)
+ *
+ * Scenarios:
+ * - sparse: max radius 20, most components consists of one pair.
+ * - fast: Velocities up to 16 pixels per frame. With motion
+ *   prediction (+kf, see Tracker2::setMotionPrediction) the same
+ *   radius is enough.
+ * - dense: max radius covers the whole image, i.e. the assignment
+ *   problem is a single component of size MAXHANDS x MAXHANDS.
+ *
+ * The mean, the 99th percentile and the maximum of the per frame
+ * times will be printed. Each scenario runs repeats times and
+ * the minimum of each frame will be used, see run().
+ *
+ * Usage: bench_tracker [-n frames] [-r repeats] [-s seed]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "threshtree.h"
+
+#include "Tracker2.h"
+#include "Tracker3.h"
+
+static const int W = 640;
+static const int H = 480;
+static const int S = 5; // edge length of squares
+
+typedef struct {
+	int x, y; // upper left corner
+	float cx, cy, radius; // circle
+	float angle, omega; // position on circle, angle per frame
+	int handid; // handid in last frame, -1 if not found.
+} Square;
+
+static unsigned long long bench_clock(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void place_square(Square &s){
+	s.x = (int)(s.cx + s.radius*cosf(s.angle));
+	s.y = (int)(s.cy + s.radius*sinf(s.angle));
+}
+
+/* vmax - Maximal speed in pixels per frame. */
+static void init_squares(Square *squares, const int n, const int vmax,
+		const unsigned int seed){
+	srand(seed);
+	for( int i=0; i<n; i++){
+		Square &s = squares[i];
+		s.radius = 40 + rand()%120;
+		s.cx = s.radius + rand()%(int)(W-S-2*s.radius);
+		s.cy = s.radius + rand()%(int)(H-S-2*s.radius);
+		s.angle = (rand()%628)/100.0f;
+		const float speed = vmax*(0.5f + (rand()%50)/100.0f);
+		s.omega = ((rand()%2)?1:-1) * speed/s.radius;
+		s.handid = -1;
+		place_square(s);
+	}
+}
+
+static void move_squares(Square *squares, const int n){
+	for( int i=0; i<n; i++){
+		squares[i].angle += squares[i].omega;
+		place_square(squares[i]);
+	}
+}
+
+static void draw_squares(unsigned char *img, const Square *squares, const int n){
+	memset(img, 0, W*H);
+	for( int i=0; i<n; i++){
+		for( int y=squares[i].y; y<squares[i].y+S; y++){
+			memset(img + y*W + squares[i].x, 255, S);
+		}
+	}
+}
+
+/* Returns number of swaps in this frame */
+static int count_swaps(Square *squares, const int n, std::vector<cBlob> &blobs){
+	int swaps = 0;
+	for( int i=0; i<n; i++){
+		Square &s = squares[i];
+		int handid = -1;
+		for( size_t k=0; k<blobs.size(); k++){
+			const cBlob &b = blobs[k];
+			if( b.event == BLOB_UP ) continue;
+			if( b.min.x <= s.x && s.x < b.max.x && b.min.y <= s.y && s.y < b.max.y ){
+				handid = b.handid;
+				break;
+			}
+		}
+		if( handid != -1 && s.handid != -1 && handid != s.handid ) swaps++;
+		s.handid = handid;
+	}
+	return swaps;
+}
+
+/* One pass over all frames. Adds the time of each frame to times. */
+static void run_once(Tracker2 &tracker,
+		const int max_radius, const int vmax, const bool predict,
+		const int frames, const unsigned int seed,
+		std::vector<unsigned long long> &times, size_t &nblobs, int &swaps){
+	Square squares[MAXHANDS];
+	unsigned char *img = (unsigned char*) malloc(W*H);
+	ThreshtreeWorkspace *workspace = NULL;
+	Blobtree *frameblobs = NULL;
+	threshtree_create_workspace(W, H, &workspace);
+	blobtree_create(&frameblobs);
+	blobtree_set_filter(frameblobs, F_TREE_DEPTH_MIN, 1);
+	blobtree_set_filter(frameblobs, F_TREE_DEPTH_MAX, 1);
+	const BlobtreeRect roi = {0, 0, W, H};
+
+	tracker.setMaxRadius(max_radius);
+	tracker.setMotionPrediction(predict);
+	init_squares(squares, MAXHANDS, vmax, seed);
+
+	nblobs = 0;
+	swaps = 0;
+	for( int f=0; f<frames; f++){
+		draw_squares(img, squares, MAXHANDS);
+		threshtree_find_blobs(frameblobs, img, W, H, roi, 128, workspace);
+
+		const unsigned long long t0 = bench_clock();
+		tracker.trackBlobs(frameblobs, false);
+		const unsigned long long dt = bench_clock() - t0;
+		times[f] = dt;
+
+		nblobs += tracker.getBlobs().size();
+		swaps += count_swaps(squares, MAXHANDS, tracker.getBlobs());
+		move_squares(squares, MAXHANDS);
+	}
+
+	blobtree_destroy(&frameblobs);
+	threshtree_destroy_workspace(&workspace);
+	free(img);
+}
+
+/* The passes are deterministic. Thus, the minimum of each frame over
+ * all passes removes most of the noise of the scheduler and the
+ * maximum of these minima is the worst case of the tracker. */
+template<class T>
+static void run(const char *scenario, const char *name,
+		const int max_radius, const int vmax, const bool predict,
+		const int frames, const int repeats, const unsigned int seed){
+	std::vector<unsigned long long> times(frames), best(frames, ~0ULL);
+	size_t nblobs = 0;
+	int swaps = 0;
+	for( int r=0; r<repeats; r++){
+		T tracker;
+		run_once(tracker, max_radius, vmax, predict, frames, seed, times, nblobs, swaps);
+		for( int f=0; f<frames; f++) best[f] = std::min(best[f], times[f]);
+	}
+
+	unsigned long long sum = 0;
+	for( int f=0; f<frames; f++) sum += best[f];
+	std::sort(best.begin(), best.end());
+	const unsigned long long p99 = best[(frames*99)/100];
+	const unsigned long long max = best[frames-1];
+
+	printf("%-8s %-12s %6d %8.1f %8.4f %8.4f %8.4f %6d\n", scenario, name, max_radius,
+			(double)nblobs/frames, sum/(1e6*frames), p99/1e6, max/1e6, swaps);
+}
+
+int main(int argc, char **argv){
+	int frames = 1000;
+	int repeats = 3;
+	unsigned int seed = 1;
+	int opt;
+	while( (opt = getopt(argc, argv, "n:r:s:")) != -1 ){
+		switch(opt){
+			case 'n': frames = std::max(1, atoi(optarg)); break;
+			case 'r': repeats = std::max(1, atoi(optarg)); break;
+			case 's': seed = atoi(optarg); break;
+			default:
+				fprintf(stderr, "Usage: %s [-n frames] [-r repeats] [-s seed]\n", argv[0]);
+				return -1;
+		}
+	}
+
+	printf("%-8s %-12s %6s %8s %8s %8s %8s %6s\n",
+			"scenario", "tracker", "radius", "blobs", "mean[ms]", "p99[ms]", "max[ms]", "swaps");
+	run<Tracker2>("sparse", "Tracker2", 20, 6, false, frames, repeats, seed);
+	run<Tracker3>("sparse", "Tracker3", 20, 6, false, frames, repeats, seed);
+	run<Tracker2>("sparse", "Tracker2+kf", 20, 6, true, frames, repeats, seed);
+	run<Tracker3>("sparse", "Tracker3+kf", 20, 6, true, frames, repeats, seed);
+	run<Tracker2>("fast", "Tracker2", 20, 16, false, frames, repeats, seed);
+	run<Tracker3>("fast", "Tracker3", 20, 16, false, frames, repeats, seed);
+	run<Tracker2>("fast", "Tracker2+kf", 20, 16, true, frames, repeats, seed);
+	run<Tracker3>("fast", "Tracker3+kf", 20, 16, true, frames, repeats, seed);
+	run<Tracker2>("dense", "Tracker2", W+H, 6, false, frames, repeats, seed);
+	run<Tracker3>("dense", "Tracker3", W+H, 6, false, frames, repeats, seed);
+
+	return 0;
+}
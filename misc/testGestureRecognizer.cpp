@@ -0,0 +1,182 @@
+/*
+ * Test of the online recognition (GestureRecognizer) of Gestures.cpp.
+ *
+ * Compiling: Built by cmake (target testGestureRecognizer, run it with ctest)
+ *            or by
+ *            g++ -std=gnu++0x -O2 -o testGestureRecognizer \
+ *              testGestureRecognizer.cpp ../Gestures.cpp ../libs/tracker/Tracker.cpp \
+ *              -I.. -I../include -I../libs/blobdetection -lpthread
+ *
+ * The tracker will be simulated by the blob positions of test curves.
+ * Like Tracker2, the history contains the positions of the previous frames,
+ * thus a GestureRecognizer which loses a track would restart it with the
+ * history of the blob.
+ *
+ * Test 1: The blob does not move for a while and draws the gesture afterwards.
+ *         The whole track is longer than MAX_DURATION_STEPS frames, but
+ *         the gesture should still be detected.
+ * Test 2: The blob is missing for one frame after the first match.
+ *         This should not emit the same pattern twice in a row.
+ *
+ * The thresholds are the results of the current recognizer. Test 1 misses
+ * a few gestures because the idle nodes at the begin of the window disturb
+ * the comparison with the patterns.
+ *
+ * Returns 0 if both tests pass.
+ * */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "Gestures.h"
+
+#ifndef WITH_HISTORY
+#error "The test requires the history of the tracker (WITH_HISTORY in Blob.h)."
+#endif
+
+#define NUM_PATTERNS 20
+#define PATTERN_LEN 100
+#define IDLE_FRAMES 60
+/* Required detections of test 1 (of NUM_PATTERNS) */
+#define MIN_DETECTED_AFTER_IDLE 15
+
+/* Tracker without detection. The frames will be counted by nextFrame()
+ * and the positions of a blob added by addToHistory(). */
+class TestTracker: public Tracker {
+	public:
+		void trackBlobs(Blobtree *frameblobs, bool history){}
+		void nextFrame(){ ++m_frameId; }
+		void addToHistory(const cBlob &b){
+			HistoryRing *ring = &m_history[b.handid];
+			if( ring->id != b.id ){
+				history_clear(ring, b.id);
+			}
+			history_push(ring, b, m_frameId);
+		}
+};
+
+/* Position i of the test curve with the given seed. */
+static void curvePoint(unsigned int seed, size_t i, double *x, double *y){
+	double a[6];
+	srand(seed);
+	for( int j=0; j<6; ++j) a[j] = (rand()%2000-1000)/10.0;
+	const double s = i/(PATTERN_LEN-1.0);
+	*x = 300 + a[0]*s + a[1]*sin(3*s) + a[2]*cos(5*s);
+	*y = 200 + a[3]*s + a[4]*sin(4*s) + a[5]*cos(2*s);
+}
+
+static void addPatterns(GestureStore &store){
+	int t[PATTERN_LEN];
+	double xy[2*PATTERN_LEN];
+	char name[32];
+	for( size_t i=0; i<PATTERN_LEN; ++i){
+		t[i] = i;
+		curvePoint(1, i, &xy[2*i], &xy[2*i+1]);
+	}
+	for( unsigned int p=0; p<NUM_PATTERNS; ++p){
+		for( size_t i=0; i<PATTERN_LEN; ++i){
+			curvePoint(p+1, i, &xy[2*i], &xy[2*i+1]);
+		}
+		Gesture *g = new Gesture(t, xy, PATTERN_LEN, true);
+		snprintf(name, 32, "pattern%u", p);
+		g->setGestureName(name);
+		store.addPattern(g);
+	}
+}
+
+/* Feed the recognizer with the curve of pattern p.
+ * idle: Number of frames without movement before the gesture starts.
+ * missingFrame: Frame without blob (after the first match if < 0).
+ * Returns the number of matches of pattern p. The frame of the first
+ * match will be written into firstMatchFrame and the number of matches
+ * which repeat the previous match into repeated. */
+static int runTrack(GestureRecognizer &recognizer, TestTracker &tracker,
+		unsigned int blobId, unsigned int p, int idle, int missingFrame,
+		int *firstMatchFrame, int *repeated){
+	char name[32];
+	snprintf(name, 32, "pattern%u", p);
+
+	std::vector<cBlob> blobs(1), none;
+	std::vector<GestureProvisionalMatch> out;
+	cBlob &b = blobs[0];
+	b.id = blobId;
+	b.handid = blobId%MAXHANDS;
+	b.event = BLOB_MOVE;
+	double x, y;
+
+	int matches = 0;
+	const Gesture *lastPattern = NULL;
+	*firstMatchFrame = -1;
+	*repeated = 0;
+	for( int f=0; f<idle+PATTERN_LEN; ++f){
+		tracker.nextFrame();
+		curvePoint(p+1, (f<idle)?0:f-idle, &x, &y);
+		b.location.x = x;
+		b.location.y = y;
+		out.clear();
+		if( f == missingFrame ){
+			recognizer.update(tracker, none, out);
+			continue;
+		}
+		recognizer.update(tracker, blobs, out);
+		tracker.addToHistory(b);
+
+		for( const auto& m: out ){
+			if( m.pattern == lastPattern ) ++(*repeated);
+			lastPattern = m.pattern;
+			if( strcmp(m.pattern->getGestureName(), name) != 0 ) continue;
+			++matches;
+			if( *firstMatchFrame < 0 ){
+				*firstMatchFrame = f;
+				if( missingFrame < 0 ) missingFrame = f+1;
+			}
+		}
+	}
+
+	// Finish track
+	for( int f=0; f<tracker.getMaxMissingDuration()+2; ++f){
+		tracker.nextFrame();
+		recognizer.update(tracker, none, out);
+	}
+	return matches;
+}
+
+int main(int argc, char** argv){
+	GestureStore store;
+	addPatterns(store);
+	GestureRecognizer recognizer(store);
+	TestTracker tracker;
+
+	unsigned int blobId = 1;
+	int failed = 0;
+	int firstMatchFrame, repeated;
+
+	/* Test 1 */
+	int ok = 0;
+	for( unsigned int p=0; p<NUM_PATTERNS; ++p){
+		if( runTrack(recognizer, tracker, blobId++, p, IDLE_FRAMES, -2, &firstMatchFrame, &repeated) > 0
+				&& firstMatchFrame >= MAX_DURATION_STEPS ){
+			++ok;
+		}
+	}
+	printf("Test 1 (%i frames): %i of %i gestures detected.\n",
+			IDLE_FRAMES+PATTERN_LEN, ok, NUM_PATTERNS);
+	if( ok < MIN_DETECTED_AFTER_IDLE ) failed = 1;
+
+	/* Test 2 */
+	int repeatedSum = 0;
+	ok = 0;
+	for( unsigned int p=0; p<NUM_PATTERNS; ++p){
+		if( runTrack(recognizer, tracker, blobId++, p, 0, -1, &firstMatchFrame, &repeated) > 0 ){
+			++ok;
+		}
+		repeatedSum += repeated;
+	}
+	printf("Test 2 (one missing frame): %i of %i gestures detected, %i repeated matches.\n",
+			ok, NUM_PATTERNS, repeatedSum);
+	if( ok < NUM_PATTERNS || repeatedSum > 0 ) failed = 1;
+
+	printf("%s\n", failed?"Failed":"Passed");
+	return failed;
+}
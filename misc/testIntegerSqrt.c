@@ -2,7 +2,12 @@
  * Test of several routines for square root
  * function on integer space.
  *
- * Compiling: gcc -o testIntegerSqrt -O3 testIntegerSqrt.c -lm
+ * Compiling: gcc -o testIntegerSqrt -O3 testIntegerSqrt.c ../libs/raspicam/imv_norm.c \
+ *              -I../libs/raspicam -lm
+ *            (add -mfpu=neon on the Raspberry Pi 2 to use the NEON kernels)
+ *
+ * Argument 4 tests the norm kernels of imv_norm.h against their
+ * scalar reference and measures the throughput on whole frames.
  *
  * Conclusion: First and second algorithm are
  *    as fast as the normal sqrt method (math.h).
@@ -15,6 +20,9 @@
 #include <limits.h>
 #include <string.h>
 #include <sys/time.h>
+#include <time.h>
+
+#include "imv_norm.h"
 
 
 //=============================================================
@@ -32,6 +40,7 @@
  * ]
  * BIC    root, root, #3 << 30  ; for rounding add: CMP n, root  ADC root, #1
  */
+#ifdef __arm__
 static unsigned int sqrt_asm(unsigned int n){
 	volatile unsigned int root; 
 	unsigned int offset;
@@ -98,6 +107,9 @@ static unsigned int sqrt_asm(unsigned int n){
 }
 
 
+#endif
+
+
 //=============================================================
 // 4 cycle/bit C routine
 #define iter1(N) \
@@ -233,6 +245,88 @@ void testPerformance(unsigned int N, unsigned int (*handler ) (unsigned int) ){
 	}
 }
 
+//=============================================================
+// Kernels of imv_norm.h
+static double now_s(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+static unsigned int compareNorms(const char *name, const unsigned char *a,
+		const unsigned char *b, unsigned int n){
+	unsigned int i, errors = 0;
+	for( i=0; i<n; ++i){
+		if( a[i] != b[i] ){
+			if( errors < 5 ) printf("%s: Position %u: %u != %u\n", name, i, a[i], b[i]);
+			++errors;
+		}
+	}
+	return errors;
+}
+
+static void testImvNorm(){
+	/* All pairs (x,y) with a couple of sad values. The number
+	 * of vectors is no multiple of 16 to check the tail handling, too. */
+	const unsigned int N = 256*256*4 + 7;
+	const unsigned short max_sad = 1000;
+	char *imv = (char*) malloc(4*N);
+	unsigned char *ref = (unsigned char*) malloc(N);
+	unsigned char *out = (unsigned char*) malloc(N);
+	unsigned int i, errors = 0;
+
+	for( i=0; i<N; ++i){
+		const unsigned int sad = (i>>16)*400 + (i%3); // 0,...,1202
+		imv[4*i] = i & 0xFF;
+		imv[4*i+1] = (i>>8) & 0xFF;
+		imv[4*i+2] = sad & 0xFF;
+		imv[4*i+3] = sad >> 8;
+	}
+
+	printf("Kernel: %s\n", IMV_NORM_KERNEL);
+
+	// Reference against math.h
+	imv_norm_l2_ref(imv, ref, N);
+	for( i=0; i<N; ++i){
+		const int x = (signed char)imv[4*i], y = (signed char)imv[4*i+1];
+		if( ref[i] != (unsigned int)sqrt(x*x+y*y) ) ++errors;
+	}
+	printf("l2 reference errors: %u\n", errors);
+
+	imv_norm_l1_ref(imv, ref, N); imv_norm_l1(imv, out, N);
+	errors += compareNorms("l1", ref, out, N);
+	imv_norm_l2_ref(imv, ref, N); imv_norm_l2(imv, out, N);
+	errors += compareNorms("l2", ref, out, N);
+	imv_norm_sad_ref(imv, ref, N, max_sad); imv_norm_sad(imv, out, N, max_sad);
+	errors += compareNorms("sad", ref, out, N);
+	printf("Kernel errors: %u\n", errors);
+
+	/* Throughput on 1080p frames (121x68 vectors). */
+	const unsigned int F = 121*68, R = 2000;
+	unsigned int r;
+	double t;
+	srand(0);
+	for( i=0; i<4*F; ++i){
+		imv[i] = rand();
+	}
+
+#define MEASURE(NAME, CALL) \
+	t = now_s(); \
+	for( r=0; r<R; ++r){ CALL; } \
+	t = now_s() - t; \
+	printf("%-10s %8.1f Mvectors/s\n", NAME, R*(double)F/t*1e-6);
+
+	MEASURE("l1_ref", imv_norm_l1_ref(imv, out, F));
+	MEASURE("l1", imv_norm_l1(imv, out, F));
+	MEASURE("l2_ref", imv_norm_l2_ref(imv, out, F));
+	MEASURE("l2", imv_norm_l2(imv, out, F));
+	MEASURE("sad_ref", imv_norm_sad_ref(imv, out, F, max_sad));
+	MEASURE("sad", imv_norm_sad(imv, out, F, max_sad));
+#undef MEASURE
+
+	free(imv); free(ref); free(out);
+}
+
 int main (int argn, char** argv ) {
 	unsigned int i,imax, s1, s2;
 
@@ -253,9 +347,14 @@ int main (int argn, char** argv ) {
 			m_root[n] = sqrtf( n) * (1<<16);
 			//printf("m_root(%i)=%u \n",n,m_root[n]);
 		}
+#ifdef __arm__
 	}else	if( argn>1 && argv[1][0] == '1' ){
 		handler = &sqrt_asm;
 		printf("Use assembler routine\n");
+#endif
+	}else	if( argn>1 && argv[1][0] == '4' ){
+		testImvNorm();
+		return 0;
 	}else	if( argn>1 && argv[1][0] == '3' ){
 		handler = &sqrt_default;
 		printf("Use default math.h routine\n");